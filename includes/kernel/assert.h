@@ -0,0 +1,30 @@
+#ifndef ASSERT_H
+#define ASSERT_H
+
+#include <kprintf.h>
+
+// Checked only in the debug build, make VARIANT=debug; a failed check halts the CPU.
+// Otherwise the condition is not evaluated, but still has to compile.
+#ifdef CONFIG_DEBUG
+#define ASSERT(cond)                                        \
+    do                                                      \
+    {                                                       \
+        if (!(cond))                                        \
+        {                                                   \
+            assert_fail(#cond, __FILE__, __LINE__);         \
+        }                                                   \
+    } while (0)
+#else
+#define ASSERT(cond) ((void)sizeof(!(cond)))
+#endif
+
+static inline void __attribute__((noreturn)) assert_fail(const char* cond, const char* file, int line)
+{
+    kprintf("ASSERT(%s) failed at %s:%d\n", cond, file, line);
+    for (;;)
+    {
+        asm volatile("cli; hlt");
+    }
+}
+
+#endif //ASSERT_H
@@ -0,0 +1,66 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/block/block.h>
+#include <kernel/mm/vmalloc.h>
+#include <kernel/mm/heap.h>
+#include <kernel/sync/spinlock.h>
+
+// Cached blocks are one page, eight sectors
+#define BCACHE_BLOCK_SIZE    PAGE_SIZE
+#define BCACHE_BLOCK_SECTORS (BCACHE_BLOCK_SIZE / SECTOR_SIZE)
+
+// Independent shards, each with its own lock, hash table and LRU list
+#define BCACHE_SHARDS            8
+#define BCACHE_BUCKETS_PER_SHARD 64
+#define BCACHE_MAX_BUFFERS       1024
+#define BCACHE_SHARD_BUFFERS     (BCACHE_MAX_BUFFERS / BCACHE_SHARDS)
+
+// Sequential read-ahead window, in blocks
+#define BCACHE_READAHEAD_MIN 4
+#define BCACHE_READAHEAD_MAX 64
+
+// Dirty buffers allowed before bdirty() writes them back
+#define BCACHE_DIRTY_LIMIT (BCACHE_MAX_BUFFERS / 4)
+
+#define BUF_VALID (1 << 0)      // Holds the block's contents
+#define BUF_DIRTY (1 << 1)      // Modified and not yet written back
+#define BUF_IO    (1 << 2)      // A read or write is in flight
+#define BUF_ERROR (1 << 3)      // The last transfer failed
+
+typedef struct buffer
+{
+    block_device_t* dev;
+    uint64_t block;
+    uint8_t* data;
+    phys_addr_t phys;
+    volatile uint32_t flags;
+    uint32_t refcount;
+    struct buffer* hash_next;
+    struct buffer* lru_prev;    // Toward more recently used
+    struct buffer* lru_next;
+    struct buffer* sync_next;   // Private to bsync()
+    bio_t bio;
+} buffer_t;
+
+typedef struct bcache_stats
+{
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t readahead;
+    uint32_t writebacks;
+    uint32_t evictions;
+    uint32_t buffers;
+    uint32_t dirty;
+} bcache_stats_t;
+
+buffer_t* bread(block_device_t* dev, uint64_t block);
+void brelse(buffer_t* buf);
+void bdirty(buffer_t* buf);
+int bsync(block_device_t* dev);
+size_t bcache_shrink(size_t count);
+void bcache_get_stats(bcache_stats_t* stats);
+
+#endif //BCACHE_H
@@ -0,0 +1,105 @@
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+#include <kernel/mm/physical_memory.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sched/kthread.h>
+#include <kernel/sched/softirq.h>
+#include <kernel/sched/workqueue.h>
+
+#define SECTOR_SIZE 512
+#define SECTOR_SHIFT 9
+
+#define BLK_MAX_DEVICES 4
+// Requests per device, queued and in flight together
+#define BLK_QUEUE_DEPTH 64
+// Bios merged into one request; a bio covers at most one page
+#define BLK_MAX_SEGMENTS 32
+
+#define BIO_PENDING 0
+#define BIO_OK      1
+#define BIO_ERROR   2
+
+struct bio;
+struct block_device;
+
+typedef void (*bio_end_io_fn)(struct bio* bio);
+
+// One contiguous transfer between the device and a buffer inside a single frame
+typedef struct bio
+{
+    uint64_t sector;
+    phys_addr_t phys;
+    uint32_t size;              // Bytes, a multiple of SECTOR_SIZE
+    int write;
+    volatile int status;
+    bio_end_io_fn end_io;       // Called once the bio completes; may be NULL
+    void* private;
+    struct bio* next;           // Next bio in the same request
+} bio_t;
+
+// Adjacent bios merged into one device command
+typedef struct blk_request
+{
+    uint64_t sector;
+    uint32_t sectors;
+    int write;
+    int status;
+    bio_t* bios;
+    bio_t* tail;
+    uint32_t nr_bios;
+    struct blk_request* next;
+} blk_request_t;
+
+typedef struct block_device_ops
+{
+    // Starts a request on the hardware; returns -1 if the device has no room right now
+    int (*submit)(struct block_device* dev, blk_request_t* req);
+    // Returns one finished request with its status set, or NULL
+    blk_request_t* (*poll)(struct block_device* dev);
+} block_device_ops_t;
+
+typedef struct block_device_stats
+{
+    uint32_t bios;
+    uint32_t merges;
+    uint32_t requests;
+    uint32_t errors;
+    uint64_t sectors_read;
+    uint64_t sectors_written;
+} block_device_stats_t;
+
+typedef struct block_device
+{
+    const char* name;
+    uint32_t id;
+    uint64_t sectors;
+    uint32_t max_in_flight;
+    const block_device_ops_t* ops;
+    void* private;
+
+    spinlock_t lock;
+    blk_request_t* queue;       // Waiting requests, sorted by sector
+    blk_request_t* free_requests;
+    uint32_t in_flight;
+    uint64_t head_sector;       // Where the last dispatched request ended, for the elevator
+    blk_request_t requests[BLK_QUEUE_DEPTH];
+    block_device_stats_t stats;
+} block_device_t;
+
+int blk_register_device(block_device_t* dev);
+block_device_t* blk_get_device(uint32_t id);
+size_t blk_device_count();
+
+void submit_bio(block_device_t* dev, bio_t* bio);
+void blk_run_queue(block_device_t* dev);
+void blk_poll(block_device_t* dev);
+void blk_init();
+void blk_complete_irq(block_device_t* dev);
+int blk_wait_bio(block_device_t* dev, bio_t* bio);
+int blk_rw(block_device_t* dev, uint64_t sector, phys_addr_t phys, uint32_t size, int write);
+
+#endif //BLOCK_H
@@ -0,0 +1,79 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+
+#define MSR_APIC_BASE 0x1B
+#define MSR_EFER      0xC0000080
+#define MSR_SYSENTER_CS  0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+#define EFER_NXE      (1 << 11)
+#define CR4_PSE       (1 << 4)
+#define CR4_PAE       (1 << 5)
+
+#define CPUID_FEAT_EDX_PSE   (1 << 3)
+#define CPUID_FEAT_EDX_TSC   (1 << 4)
+#define CPUID_FEAT_EDX_MSR   (1 << 5)
+#define CPUID_FEAT_EDX_PAE   (1 << 6)
+#define CPUID_FEAT_EDX_APIC  (1 << 9)
+#define CPUID_FEAT_EDX_SEP   (1 << 11)
+#define CPUID_EXT_FEAT_EDX_NX (1 << 20)
+
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx)
+{
+    asm volatile("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
+}
+
+static inline uint32_t cpuid_features_edx()
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    return edx;
+}
+
+static inline int cpu_has_nx()
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax < 0x80000001)
+    {
+        return 0;
+    }
+    cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+    return (edx & CPUID_EXT_FEAT_EDX_NX) != 0;
+}
+
+static inline uint64_t rdmsr(uint32_t msr)
+{
+    uint32_t low, high;
+    asm volatile("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value)
+{
+    asm volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline uint32_t read_cr3()
+{
+    uint32_t cr3;
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    return cr3;
+}
+
+static inline uint64_t rdtsc()
+{
+    uint32_t low, high;
+    asm volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+static inline void cpu_relax()
+{
+    asm volatile("pause" : : : "memory");
+}
+
+#endif //CPU_H
@@ -0,0 +1,39 @@
+#ifndef GDT_H
+#define GDT_H
+
+#include <stdint.h>
+#include <string.h>
+#include <kprintf.h>
+#include <kernel/cpu/cpu.h>
+
+// Selectors of the descriptors in boot.S. The order is fixed by sysenter and
+// sysexit, which derive every other selector from MSR_SYSENTER_CS.
+#define KERNEL_CS   0x08
+#define KERNEL_DS   0x10
+#define USER_CS     0x1B        // Index 3, RPL 3
+#define USER_DS     0x23        // Index 4, RPL 3
+#define TSS_SEL     0x28
+
+#define GDT_TSS_INDEX 5
+
+// 32-bit TSS. Only ss0:esp0 is used, for entries from ring 3 through interrupt gates.
+typedef struct tss
+{
+    uint32_t prev_task;
+    uint32_t esp0, ss0;
+    uint32_t esp1, ss1;
+    uint32_t esp2, ss2;
+    uint32_t cr3, eip, eflags;
+    uint32_t eax, ecx, edx, ebx, esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs;
+    uint32_t ldt;
+    uint16_t trap;
+    uint16_t iomap_base;
+} __attribute__((packed)) tss_t;
+
+void gdt_init();
+int gdt_sysenter_supported();
+void tss_enable_sysenter(uintptr_t entry);
+void tss_set_kernel_stack(uint32_t top);
+
+#endif //GDT_H
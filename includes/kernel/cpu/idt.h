@@ -0,0 +1,92 @@
+#ifndef IDT_H
+#define IDT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+#include <kernel/cpu/io.h>
+#include <kernel/cpu/lapic.h>
+
+#define IDT_ENTRIES 256
+
+// Code selector set up by boot.S, and a present 32-bit interrupt gate for ring 0, or open to ring 3
+#define IDT_KERNEL_CS       0x08
+#define IDT_GATE_INTERRUPT  0x8E
+#define IDT_GATE_USER_INTERRUPT 0xEE
+
+// Vectors below this are CPU exceptions
+#define IDT_EXCEPTIONS 32
+
+// The legacy PICs are remapped past the exceptions and stay masked until a driver unmasks a line
+#define PIC1_CMD         0x20
+#define PIC1_DATA        0x21
+#define PIC2_CMD         0xA0
+#define PIC2_DATA        0xA1
+#define PIC_EOI          0x20
+#define PIC_VECTOR_BASE  0x20
+#define PIC_IRQS         16
+#define IRQ_VECTOR(irq)  (PIC_VECTOR_BASE + (irq))
+
+#define EFLAGS_IF (1 << 9)
+
+#define PAGE_FAULT_VECTOR 14
+// Page fault error code bits
+#define PF_ERROR_PRESENT (1 << 0)   // Protection violation, not a missing page
+#define PF_ERROR_WRITE   (1 << 1)
+#define PF_ERROR_USER    (1 << 2)
+#define PF_ERROR_FETCH   (1 << 4)   // Instruction fetch, set for NX violations
+
+// Saved state on the stack of an interrupted context, as pushed by isr.S
+typedef struct interrupt_frame
+{
+    uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;    // pusha; esp is the value before pusha
+    uint32_t vector;
+    uint32_t error;             // CPU error code, 0 for vectors without one
+    uint32_t eip, cs, eflags;   // Pushed by the CPU
+    uint32_t user_esp, user_ss; // Pushed by the CPU only on entry from ring 3
+} interrupt_frame_t;
+
+// Nonzero if the frame interrupted user code, which also means user_esp and user_ss are valid
+#define FRAME_FROM_USER(frame) (((frame)->cs & 3) == 3)
+
+typedef void (*interrupt_handler_t)(interrupt_frame_t* frame);
+
+void idt_init();
+void idt_register_handler(uint8_t vector, interrupt_handler_t handler);
+interrupt_handler_t idt_get_handler(uint8_t vector);
+void idt_set_user_gate(uint8_t vector, uintptr_t entry);
+void idt_set_user_exception_handler(interrupt_handler_t handler);
+void irq_unmask(uint8_t irq);
+void irq_mask(uint8_t irq);
+void interrupt_dispatch(interrupt_frame_t* frame);
+void exception_panic(interrupt_frame_t* frame) __attribute__((noreturn));
+
+static inline void local_irq_enable()
+{
+    asm volatile("sti" : : : "memory");
+}
+
+static inline void local_irq_disable()
+{
+    asm volatile("cli" : : : "memory");
+}
+
+/**
+ * @brief Disables interrupts and returns the previous EFLAGS for local_irq_restore().
+ */
+static inline uint32_t local_irq_save()
+{
+    uint32_t flags;
+    asm volatile("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void local_irq_restore(uint32_t flags)
+{
+    if (flags & EFLAGS_IF)
+    {
+        local_irq_enable();
+    }
+}
+
+#endif //IDT_H
@@ -0,0 +1,60 @@
+#ifndef IO_H
+#define IO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+static inline void outb(uint16_t port, uint8_t value)
+{
+    asm volatile("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline void outw(uint16_t port, uint16_t value)
+{
+    asm volatile("outw %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline void outl(uint16_t port, uint32_t value)
+{
+    asm volatile("outl %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port)
+{
+    uint8_t value;
+    asm volatile("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static inline uint16_t inw(uint16_t port)
+{
+    uint16_t value;
+    asm volatile("inw %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static inline uint32_t inl(uint16_t port)
+{
+    uint32_t value;
+    asm volatile("inl %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+// String forms move `count` 16-bit words in one instruction
+static inline void insw(uint16_t port, void* buffer, size_t count)
+{
+    asm volatile("rep insw" : "+D"(buffer), "+c"(count) : "d"(port) : "memory");
+}
+
+static inline void outsw(uint16_t port, const void* buffer, size_t count)
+{
+    asm volatile("rep outsw" : "+S"(buffer), "+c"(count) : "d"(port));
+}
+
+// About a microsecond; port 0x80 is the unused POST diagnostic port
+static inline void io_wait()
+{
+    outb(0x80, 0);
+}
+
+#endif //IO_H
@@ -0,0 +1,45 @@
+#ifndef LAPIC_H
+#define LAPIC_H
+
+#include <stdint.h>
+#include <kernel/cpu/cpu.h>
+#include <kprintf.h>
+#include <stddef.h>
+
+#define LAPIC_DEFAULT_BASE 0xFEE00000
+
+// Register offsets from the local APIC base
+#define LAPIC_REG_ID        0x020
+#define LAPIC_REG_EOI       0x0B0
+#define LAPIC_REG_SPURIOUS  0x0F0
+#define LAPIC_REG_ICR_LOW   0x300
+#define LAPIC_REG_ICR_HIGH  0x310
+#define LAPIC_REG_LVT_TIMER 0x320
+#define LAPIC_REG_LVT_PERF  0x340
+#define LAPIC_REG_TIMER_INITIAL 0x380
+#define LAPIC_REG_TIMER_CURRENT 0x390
+#define LAPIC_REG_TIMER_DIVIDE  0x3E0
+
+// The timer counts down at the bus clock divided by 16
+#define LAPIC_TIMER_DIVIDE_16 0x3
+
+// Local vector table entries
+#define LAPIC_LVT_MASKED    (1 << 16)
+
+#define LAPIC_SPURIOUS_ENABLE   (1 << 8)
+#define LAPIC_SPURIOUS_VECTOR   0xFF
+#define LAPIC_ICR_PENDING       (1 << 12)
+
+extern volatile uint32_t* lapic_base;
+
+void lapic_init();
+int lapic_present();
+uint32_t lapic_id();
+void lapic_eoi();
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector);
+void lapic_set_lvt(uint32_t reg, uint32_t entry);
+void lapic_timer_oneshot(uint32_t entry, uint32_t count);
+void lapic_timer_stop();
+uint32_t lapic_timer_current();
+
+#endif //LAPIC_H
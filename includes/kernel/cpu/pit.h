@@ -0,0 +1,27 @@
+#ifndef PIT_H
+#define PIT_H
+
+#include <stdint.h>
+#include <kernel/cpu/io.h>
+
+#define PIT_FREQUENCY      1193182
+#define PIT_CHANNEL0       0x40
+#define PIT_CHANNEL2       0x42
+#define PIT_COMMAND        0x43
+
+// Channel 0 drives IRQ 0
+#define PIT_IRQ 0
+
+// Channel 2 is used as a reference clock for calibration; its gate is driven through port 0x61
+#define PIT_GATE_PORT      0x61
+#define PIT_GATE_ENABLE    0x01
+#define PIT_SPEAKER_ENABLE 0x02
+#define PIT_GATE_OUTPUT    0x20
+
+// Lowest rate the 16-bit divisor reaches
+#define PIT_MIN_HZ 19
+
+uint32_t pit_set_periodic(uint32_t hz);
+void pit_stop();
+
+#endif //PIT_H
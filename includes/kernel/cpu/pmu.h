@@ -0,0 +1,62 @@
+#ifndef PMU_H
+#define PMU_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/cpu/lapic.h>
+#include <kernel/cpu/idt.h>
+
+// Architectural performance monitoring, described by CPUID leaf 0x0A
+#define CPUID_LEAF_PERFMON 0x0A
+
+#define MSR_PERFEVTSEL0          0x186
+#define MSR_PMC0                 0xC1
+#define MSR_PERF_GLOBAL_STATUS   0x38E
+#define MSR_PERF_GLOBAL_CTRL     0x38F
+#define MSR_PERF_GLOBAL_OVF_CTRL 0x390
+
+#define PERFEVTSEL_USR (1 << 16)
+#define PERFEVTSEL_OS  (1 << 17)
+#define PERFEVTSEL_INT (1 << 20)
+#define PERFEVTSEL_EN  (1 << 22)
+
+// Events a counter set can count; pmu_event_name() gives their names
+#define PMU_EVENT_CYCLES           0
+#define PMU_EVENT_INSTRUCTIONS     1
+#define PMU_EVENT_LLC_REFERENCES   2
+#define PMU_EVENT_LLC_MISSES       3
+#define PMU_EVENT_BRANCHES         4
+#define PMU_EVENT_BRANCH_MISSES    5
+#define PMU_EVENT_DTLB_LOAD_MISSES 6    // Model specific: load misses that walked the page tables
+#define PMU_EVENT_COUNT            7
+
+// General-purpose counters this code drives at most
+#define PMU_MAX_COUNTERS 8
+
+// Raised by a counter overflow while sampling
+#define PMU_VECTOR 0xFC
+
+typedef struct pmu_set
+{
+    uint32_t count;                             // Events in use, one counter each
+    uint8_t events[PMU_MAX_COUNTERS];
+    uint64_t values[PMU_MAX_COUNTERS];          // Counts between pmu_start() and pmu_stop()
+} pmu_set_t;
+
+void pmu_init();
+int pmu_available();
+uint32_t pmu_num_counters();
+int pmu_event_supported(uint32_t event);
+const char* pmu_event_name(uint32_t event);
+int pmu_set_init(pmu_set_t* set, const uint8_t* events, uint32_t count);
+void pmu_start(pmu_set_t* set);
+void pmu_stop(pmu_set_t* set);
+uint64_t pmu_read(uint32_t counter);
+void pmu_print(const pmu_set_t* set, const char* label);
+void pmu_trace(const pmu_set_t* set);
+int pmu_sample_start(uint32_t event, uint32_t period);
+void pmu_sample_stop();
+
+#endif //PMU_H
@@ -0,0 +1,17 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+#include <kernel/cpu/lapic.h>
+
+#define MAX_CPUS CONFIG_NR_CPUS
+
+extern volatile uint32_t cpu_online_mask;
+extern uint32_t cpu_apic_ids[MAX_CPUS];
+
+void smp_init();
+void smp_cpu_online(uint32_t cpu, uint32_t apic_id);
+uint32_t smp_processor_id();
+uint32_t smp_num_online();
+
+#endif //SMP_H
@@ -0,0 +1,19 @@
+#ifndef TSC_H
+#define TSC_H
+
+#include <stdint.h>
+#include <kprintf.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/cpu/io.h>
+#include <kernel/cpu/pit.h>
+#include <kernel/lib/div64.h>
+
+// Shortest calibration window, about 0.05 percent accuracy against the PIT
+#define TSC_CALIBRATE_MS 2
+
+extern uint32_t tsc_khz;
+
+void tsc_calibrate_start();
+void tsc_init();
+
+#endif //TSC_H
@@ -0,0 +1,53 @@
+#ifndef ATA_H
+#define ATA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/cpu/io.h>
+#include <kernel/block/block.h>
+#include <kernel/mm/highmem.h>
+#include <kernel/mm/heap.h>
+
+#define ATA_PRIMARY_IO   0x1F0
+#define ATA_PRIMARY_CTRL 0x3F6
+
+// Task file registers, relative to the I/O base
+#define ATA_REG_DATA     0
+#define ATA_REG_ERROR    1
+#define ATA_REG_SECCOUNT 2
+#define ATA_REG_LBA0     3
+#define ATA_REG_LBA1     4
+#define ATA_REG_LBA2     5
+#define ATA_REG_DRIVE    6
+#define ATA_REG_STATUS   7
+#define ATA_REG_COMMAND  7
+
+#define ATA_SR_ERR  0x01
+#define ATA_SR_DRQ  0x08
+#define ATA_SR_DF   0x20
+#define ATA_SR_DRDY 0x40
+#define ATA_SR_BSY  0x80
+
+#define ATA_CMD_READ_PIO        0x20
+#define ATA_CMD_READ_PIO_EXT    0x24
+#define ATA_CMD_WRITE_PIO       0x30
+#define ATA_CMD_WRITE_PIO_EXT   0x34
+#define ATA_CMD_CACHE_FLUSH     0xE7
+#define ATA_CMD_CACHE_FLUSH_EXT 0xEA
+#define ATA_CMD_IDENTIFY        0xEC
+
+// Status polls before a command is considered hung
+#define ATA_TIMEOUT 1000000
+
+typedef struct ata_drive
+{
+    block_device_t dev;
+    uint16_t io_base;
+    uint16_t ctrl_base;
+    int lba48;
+    blk_request_t* done;        // Finished requests waiting to be reaped by poll
+} ata_drive_t;
+
+void ata_init();
+
+#endif //ATA_H
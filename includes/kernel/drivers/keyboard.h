@@ -0,0 +1,57 @@
+#ifndef KEYBOARD_H
+#define KEYBOARD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/cpu/io.h>
+#include <kernel/cpu/idt.h>
+
+#define KEYBOARD_IRQ 1
+
+// 8042 controller ports
+#define KEYBOARD_DATA   0x60
+#define KEYBOARD_STATUS 0x64    // Command register when written
+
+#define KEYBOARD_STATUS_OUTPUT 0x01
+#define KEYBOARD_STATUS_INPUT  0x02
+
+#define KEYBOARD_CMD_READ_CONFIG  0x20
+#define KEYBOARD_CMD_WRITE_CONFIG 0x60
+#define KEYBOARD_CMD_ENABLE_PORT1 0xAE
+
+#define KEYBOARD_CONFIG_IRQ1      0x01
+#define KEYBOARD_CONFIG_CLOCK_OFF 0x10
+#define KEYBOARD_CONFIG_TRANSLATE 0x40  // Scancodes reach us as set 1
+
+// Scancode set 1
+#define KEYBOARD_SC_RELEASE   0x80
+#define KEYBOARD_SC_EXTENDED  0xE0
+#define KEYBOARD_SC_LCTRL     0x1D
+#define KEYBOARD_SC_LSHIFT    0x2A
+#define KEYBOARD_SC_RSHIFT    0x36
+#define KEYBOARD_SC_CAPSLOCK  0x3A
+#define KEYBOARD_SC_ENTER     0x1C
+#define KEYBOARD_SC_SLASH     0x35
+#define KEYBOARD_SC_KEYPAD    0x47  // Keypad 7, the first of the keypad block
+
+// Scancodes queued between the interrupt and the reader; a power of two
+#define KEYBOARD_RING_SIZE 128
+
+// Polls of the controller before a command is given up on
+#define KEYBOARD_TIMEOUT 100000
+
+typedef struct keyboard_stats
+{
+    uint32_t scancodes;     // Queued by the interrupt
+    uint32_t dropped;       // Lost because the ring was full
+} keyboard_stats_t;
+
+void keyboard_init();
+int keyboard_present();
+void keyboard_push(uint8_t scancode);
+int keyboard_pending();
+int keyboard_getc();
+void keyboard_reset();
+void keyboard_get_stats(keyboard_stats_t* stats);
+
+#endif //KEYBOARD_H
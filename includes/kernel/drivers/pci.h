@@ -0,0 +1,59 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+#include <kernel/cpu/io.h>
+
+// Configuration mechanism #1
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA    0xCFC
+
+// Configuration space offsets
+#define PCI_VENDOR_ID      0x00
+#define PCI_DEVICE_ID      0x02
+#define PCI_COMMAND        0x04
+#define PCI_REVISION       0x08
+#define PCI_HEADER_TYPE    0x0E
+#define PCI_BAR0           0x10
+#define PCI_SECONDARY_BUS  0x19
+#define PCI_SUBSYSTEM_ID   0x2E
+#define PCI_INTERRUPT_LINE 0x3C
+
+#define PCI_COMMAND_IO          (1 << 0)
+#define PCI_COMMAND_MEMORY      (1 << 1)
+#define PCI_COMMAND_BUS_MASTER  (1 << 2)
+
+#define PCI_BAR_IO              0x1
+#define PCI_HEADER_MULTIFUNCTION 0x80
+#define PCI_HEADER_BRIDGE       0x01
+
+#define PCI_MAX_DEVICES 32
+
+typedef struct pci_device
+{
+    uint8_t bus;
+    uint8_t slot;
+    uint8_t func;
+    uint16_t vendor_id;
+    uint16_t device_id;
+    uint16_t subsystem_id;
+    uint8_t class_code;
+    uint8_t subclass;
+    uint8_t prog_if;
+    uint8_t irq_line;
+    uint32_t bar[6];
+} pci_device_t;
+
+uint32_t pci_config_read32(const pci_device_t* dev, uint8_t offset);
+uint16_t pci_config_read16(const pci_device_t* dev, uint8_t offset);
+void pci_config_write32(const pci_device_t* dev, uint8_t offset, uint32_t value);
+void pci_config_write16(const pci_device_t* dev, uint8_t offset, uint16_t value);
+
+void pci_init();
+const pci_device_t* pci_find_device(uint16_t vendor_id, uint16_t device_id, const pci_device_t* from);
+void pci_enable_bus_master(const pci_device_t* dev);
+uint16_t pci_io_base(const pci_device_t* dev, int bar);
+
+#endif //PCI_H
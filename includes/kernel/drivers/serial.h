@@ -0,0 +1,40 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/cpu/io.h>
+#include <kernel/cpu/idt.h>
+
+#define SERIAL_COM1 0x3F8
+#define SERIAL_COM1_IRQ 4
+
+// 16550 registers, relative to the I/O base
+#define SERIAL_REG_DATA        0    // Divisor low byte while DLAB is set
+#define SERIAL_REG_INT_ENABLE  1    // Divisor high byte while DLAB is set
+#define SERIAL_REG_FIFO_CTRL   2    // Interrupt identification when read
+#define SERIAL_REG_LINE_CTRL   3
+#define SERIAL_REG_MODEM_CTRL  4
+#define SERIAL_REG_LINE_STATUS 5
+
+#define SERIAL_IER_RX   0x01
+#define SERIAL_LCR_8N1  0x03
+#define SERIAL_LCR_DLAB 0x80
+#define SERIAL_LSR_DATA_READY 0x01
+#define SERIAL_LSR_THR_EMPTY  0x20
+
+#define SERIAL_BAUD_BASE 115200
+#define SERIAL_BAUD      115200
+
+// Transmit polls before a character is dropped, so a missing port cannot hang output
+#define SERIAL_TIMEOUT 100000
+
+int serial_init();
+int serial_present();
+void serial_putc(char c);
+void serial_write(const void* data, size_t size);
+int serial_getc();
+int serial_rx_ready();
+void serial_enable_rx_interrupt();
+
+#endif //SERIAL_H
@@ -0,0 +1,101 @@
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+#include <kernel/cpu/io.h>
+#include <kernel/drivers/pci.h>
+#include <kernel/mm/vmalloc.h>
+#include <kernel/mm/heap.h>
+
+#define VIRTIO_VENDOR_ID 0x1AF4
+
+// Legacy (virtio 0.9.5) register block at the start of BAR0
+#define VIRTIO_REG_DEVICE_FEATURES 0x00
+#define VIRTIO_REG_GUEST_FEATURES  0x04
+#define VIRTIO_REG_QUEUE_ADDRESS   0x08
+#define VIRTIO_REG_QUEUE_SIZE      0x0C
+#define VIRTIO_REG_QUEUE_SELECT    0x0E
+#define VIRTIO_REG_QUEUE_NOTIFY    0x10
+#define VIRTIO_REG_DEVICE_STATUS   0x12
+#define VIRTIO_REG_ISR_STATUS      0x13
+#define VIRTIO_REG_DEVICE_CONFIG   0x14
+
+#define VIRTIO_STATUS_ACKNOWLEDGE  1
+#define VIRTIO_STATUS_DRIVER       2
+#define VIRTIO_STATUS_DRIVER_OK    4
+#define VIRTIO_STATUS_FAILED       0x80
+
+// Reading the ISR status register returns these bits and deasserts the interrupt
+#define VIRTIO_ISR_QUEUE           1
+#define VIRTIO_ISR_CONFIG          2
+
+#define VIRTQ_DESC_F_NEXT          1
+#define VIRTQ_DESC_F_WRITE         2
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 1
+#define VIRTQ_USED_F_NO_NOTIFY     1
+#define VIRTQ_ALIGN                4096
+
+typedef struct virtq_desc
+{
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) virtq_desc_t;
+
+typedef struct virtq_avail
+{
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} __attribute__((packed)) virtq_avail_t;
+
+typedef struct virtq_used_elem
+{
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed)) virtq_used_elem_t;
+
+typedef struct virtq_used
+{
+    uint16_t flags;
+    uint16_t idx;
+    virtq_used_elem_t ring[];
+} __attribute__((packed)) virtq_used_t;
+
+// A buffer handed to the device; `write` marks buffers the device fills in
+typedef struct virtq_buf
+{
+    uint64_t phys;
+    uint32_t len;
+    int write;
+} virtq_buf_t;
+
+typedef struct virtqueue
+{
+    uint16_t io_base;
+    uint16_t index;
+    uint16_t size;
+    uint16_t free_head;
+    uint16_t num_free;
+    uint16_t last_used;
+    volatile virtq_desc_t* desc;
+    volatile virtq_avail_t* avail;
+    volatile virtq_used_t* used;
+    void** tokens;              // Caller's token for each chain, indexed by its head descriptor
+} virtqueue_t;
+
+void virtio_reset(uint16_t io_base);
+void virtio_set_status(uint16_t io_base, uint8_t status);
+int virtqueue_init(virtqueue_t* vq, uint16_t io_base, uint16_t index);
+int virtqueue_add(virtqueue_t* vq, const virtq_buf_t* bufs, size_t count, void* token);
+void virtqueue_free(virtqueue_t* vq);
+void virtqueue_kick(virtqueue_t* vq);
+void* virtqueue_get(virtqueue_t* vq, uint32_t* len);
+int virtqueue_has_used(virtqueue_t* vq);
+void virtqueue_disable_cb(virtqueue_t* vq);
+int virtqueue_enable_cb(virtqueue_t* vq);
+
+#endif //VIRTIO_H
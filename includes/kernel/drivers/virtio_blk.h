@@ -0,0 +1,44 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/drivers/virtio.h>
+#include <kernel/block/block.h>
+#include <kernel/cpu/idt.h>
+
+// Transitional virtio-blk device, driven through the legacy interface
+#define VIRTIO_BLK_DEVICE_ID 0x1001
+
+#define VIRTIO_BLK_T_IN  0
+#define VIRTIO_BLK_T_OUT 1
+#define VIRTIO_BLK_S_OK  0
+
+// Requests in flight per device
+#define VIRTIO_BLK_SLOTS 32
+
+typedef struct virtio_blk_header
+{
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) virtio_blk_header_t;
+
+typedef struct virtio_blk
+{
+    block_device_t dev;
+    uint16_t io_base;
+    uint8_t irq;                // Legacy PIC line, PIC_IRQS if none
+    virtqueue_t vq;
+    // Per-slot request headers followed by per-slot status bytes, in one DMA page
+    virtio_blk_header_t* headers;
+    volatile uint8_t* status;
+    phys_addr_t headers_phys;
+    phys_addr_t status_phys;
+    blk_request_t* slots[VIRTIO_BLK_SLOTS];
+    uint32_t free_slots;
+} virtio_blk_t;
+
+void virtio_blk_init();
+
+#endif //VIRTIO_BLK_H
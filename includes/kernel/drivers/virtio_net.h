@@ -0,0 +1,50 @@
+#ifndef VIRTIO_NET_H
+#define VIRTIO_NET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/drivers/virtio.h>
+#include <kernel/net/net.h>
+#include <kernel/cpu/idt.h>
+
+// Transitional virtio-net device, driven through the legacy interface
+#define VIRTIO_NET_DEVICE_ID 0x1000
+
+#define VIRTIO_NET_F_MAC (1u << 5)
+
+#define VIRTIO_NET_RX_QUEUE 0
+#define VIRTIO_NET_TX_QUEUE 1
+
+// Receive buffers kept posted; each takes two descriptors
+#define VIRTIO_NET_RX_BUFS 128
+
+// Used when the device has no address of its own, QEMU's default
+#define VIRTIO_NET_DEFAULT_MAC {0x52, 0x54, 0x00, 0x12, 0x34, 0x56}
+
+// Precedes every frame, in a descriptor of its own
+typedef struct virtio_net_hdr
+{
+    uint8_t flags;
+    uint8_t gso_type;
+    uint16_t hdr_len;
+    uint16_t gso_size;
+    uint16_t csum_start;
+    uint16_t csum_offset;
+} __attribute__((packed)) virtio_net_hdr_t;
+
+typedef struct virtio_net
+{
+    net_device_t dev;
+    uint16_t io_base;
+    uint8_t irq;                // Legacy PIC line, PIC_IRQS if none
+    virtqueue_t rx;
+    virtqueue_t tx;
+    spinlock_t tx_lock;
+    uint32_t rx_posted;
+    uint32_t tx_unkicked;       // Frames added since the last kick
+    int in_poll;                // Replies sent while polling are kicked once at the end
+} virtio_net_t;
+
+void virtio_net_init();
+
+#endif //VIRTIO_NET_H
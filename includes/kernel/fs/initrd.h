@@ -0,0 +1,39 @@
+#ifndef INITRD_H
+#define INITRD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <multiboot.h>
+#include <kernel/mm/paging.h>
+#include <kernel/mm/vmalloc.h>
+#include <kernel/mm/heap.h>
+#include <kernel/fs/tar.h>
+#include <kernel/fs/vfs.h>
+#include <kernel/mm/page_cache.h>
+#include <kernel/mm/highmem.h>
+
+// Multiboot modules remembered at boot; further modules are ignored
+#define INITRD_MAX_MODULES 8
+#define INITRD_CMDLINE_MAX 64
+
+// A regular file inside a module; the contents are never copied out of the module
+typedef struct initrd_file
+{
+    const char* name;           // Path without a leading "/" or "./"
+    const uint8_t* data;        // Read-only kernel mapping of the contents
+    phys_addr_t phys;           // Physical address of the contents
+    size_t size;
+    uint32_t hash;
+    struct initrd_file* next;   // Next file in the same hash bucket
+    inode_t inode;
+} initrd_file_t;
+
+void initrd_probe(multiboot_info_t* mbi);
+void initrd_init();
+const initrd_file_t* initrd_lookup(const char* path);
+size_t initrd_read(const initrd_file_t* file, size_t offset, void* buffer, size_t size);
+size_t initrd_file_count();
+const initrd_file_t* initrd_file_at(size_t index);
+
+#endif //INITRD_H
@@ -0,0 +1,48 @@
+#ifndef TAR_H
+#define TAR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kernel/mm/heap.h>
+
+// ustar archive layout
+#define TAR_BLOCK_SIZE 512
+#define TAR_TYPE_FILE  '0'
+#define TAR_TYPE_AFILE '\0'
+
+typedef struct tar_header
+{
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char mtime[12];
+    char checksum[8];
+    char typeflag;
+    char linkname[100];
+    char magic[6];
+    char version[2];
+    char uname[32];
+    char gname[32];
+    char devmajor[8];
+    char devminor[8];
+    char prefix[155];
+    char pad[12];
+} __attribute__((packed)) tar_header_t;
+
+int tar_header_valid(const tar_header_t* header);
+size_t tar_field_length(const char* field, size_t max);
+size_t tar_parse_octal(const char* field, size_t max);
+char* tar_entry_path(const tar_header_t* header);
+int tar_entry_is_file(const tar_header_t* header);
+size_t tar_entry_size(const tar_header_t* header);
+
+// Offset of the header after an entry whose header is at `offset`
+static inline uint64_t tar_next_header(uint64_t offset, size_t size)
+{
+    return offset + TAR_BLOCK_SIZE + ((size + TAR_BLOCK_SIZE - 1) & ~(TAR_BLOCK_SIZE - 1));
+}
+
+#endif //TAR_H
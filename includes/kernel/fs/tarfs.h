@@ -0,0 +1,32 @@
+#ifndef TARFS_H
+#define TARFS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/fs/tar.h>
+#include <kernel/fs/vfs.h>
+#include <kernel/block/bcache.h>
+#include <kernel/mm/page_cache.h>
+
+// A regular file in a ustar archive stored on a block device
+typedef struct tarfs_file
+{
+    inode_t inode;
+    const char* name;
+    uint64_t data_sector;       // First sector of the contents
+    uint32_t hash;
+    struct tarfs_file* next;    // Next file in the same hash bucket
+} tarfs_file_t;
+
+typedef struct tarfs
+{
+    filesystem_t fs;
+    block_device_t* dev;
+    tarfs_file_t** buckets;
+    uint32_t bucket_mask;
+    size_t file_count;
+} tarfs_t;
+
+int tarfs_mount(block_device_t* dev, const char* mount_point);
+
+#endif //TARFS_H
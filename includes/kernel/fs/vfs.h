@@ -0,0 +1,58 @@
+#ifndef VFS_H
+#define VFS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kprintf.h>
+#include <kernel/block/block.h>
+#include <kernel/lib/radix_tree.h>
+#include <kernel/sync/spinlock.h>
+
+#define VFS_MAX_MOUNTS 4
+
+struct inode;
+struct page;
+
+typedef struct inode_ops
+{
+    // Starts filling a page-cache page; the filesystem calls page_end_read() when it is done
+    int (*readpage)(struct inode* inode, struct page* page);
+    // Optional: a frame that already holds page `index` and can be shared by the cache as is, or 0
+    phys_addr_t (*share_page)(struct inode* inode, uint32_t index);
+} inode_ops_t;
+
+typedef struct inode
+{
+    uint32_t ino;
+    uint64_t size;
+    const inode_ops_t* ops;
+    block_device_t* bdev;       // Device reads are queued on, NULL for memory-backed files
+    void* private;
+
+    // Page cache state, see page_cache.c
+    spinlock_t lock;
+    radix_tree_root_t pages;
+    uint32_t nr_pages;
+    uint32_t ra_next;
+    uint32_t ra_end;
+    uint32_t ra_window;
+} inode_t;
+
+typedef struct filesystem
+{
+    const char* name;
+    const char* mount_point;
+    // Resolves a path relative to the mount point
+    inode_t* (*lookup)(struct filesystem* fs, const char* path);
+    void* private;
+} filesystem_t;
+
+void inode_init(inode_t* inode, uint64_t size, const inode_ops_t* ops, block_device_t* bdev, void* private);
+int vfs_mount(filesystem_t* fs);
+inode_t* vfs_lookup(const char* path);
+
+uint32_t vfs_path_hash(const char* path);
+const char* vfs_skip_root(const char* path);
+
+#endif //VFS_H
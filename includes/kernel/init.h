@@ -0,0 +1,51 @@
+#ifndef INIT_H
+#define INIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/lib/div64.h>
+
+// Initcall levels, run in this order once the CPU, memory and TSC are set up
+#define INIT_CORE   1   // Scheduler, softirqs, workqueues, timers
+#define INIT_SUBSYS 2   // Block layer, reclaim, tracing, system calls, initrd
+#define INIT_DEVICE 3   // Buses and drivers
+#define INIT_LATE   4   // Whatever needs the devices, such as mounts
+
+// Phases kept for the boot report, see boot_phase()
+#define BOOT_PHASES_MAX 48
+
+typedef struct initcall
+{
+    const char* name;
+    void (*fn)();
+    uint32_t level;
+    const char* after;      // Space separated initcalls of the same level that must run first, or NULL
+    uint32_t order;         // Position in which it ran, from 1; 0 until then
+} initcall_t;
+
+#define INITCALL_STR_1(x) #x
+#define INITCALL_STR(x)   INITCALL_STR_1(x)
+
+// Registers fn to run at boot at the given level. The linker script
+// collects the entries in level order, see do_initcalls().
+#define INITCALL(level, fn, after)                                                     \
+    static initcall_t initcall_##fn                                                    \
+        __attribute__((used, section(".initcall." INITCALL_STR(level)), aligned(4))) = \
+        { #fn, fn, level, after, 0 }
+
+// Filled in by the linker script, sorted by level
+extern initcall_t __initcall_start[];
+extern initcall_t __initcall_end[];
+
+// TSC at the boot loader handoff, stored by _start
+extern uint64_t boot_tsc_start;
+
+void boot_phase(const char* name);
+void do_initcalls();
+const initcall_t* initcall_lookup(const char* name);
+void boot_report();
+
+#endif //INIT_H
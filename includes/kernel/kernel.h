@@ -4,9 +4,52 @@
 #include <multiboot.h>
 #include <kernel/tty/tty.h>
 #include <stdio.h>
+#include <kernel/init.h>
 #include <kernel/mm/physical_memory.h>
 #include <kernel/mm/paging.h>
 #include <kernel/mm/heap.h>
+#include <kernel/mm/reclaim.h>
+#include <kernel/mm/memstat.h>
+#include <kernel/sched/kthread.h>
+#include <kernel/sched/softirq.h>
+#include <kernel/sched/workqueue.h>
+#include <kernel/time/timer.h>
+#include <kernel/cpu/smp.h>
+#include <kernel/cpu/gdt.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/cpu/pmu.h>
+#include <kernel/trace/trace.h>
+#include <kernel/trace/profile.h>
+#include <kernel/trace/gcov.h>
+#include <kernel/fs/initrd.h>
+#include <kernel/fs/tarfs.h>
+#include <kernel/drivers/pci.h>
+#include <kernel/drivers/virtio_blk.h>
+#include <kernel/drivers/ata.h>
+#include <kernel/drivers/serial.h>
+#include <kernel/drivers/keyboard.h>
+#include <kernel/tty/shell.h>
+#include <kernel/user/syscall.h>
+#include <kernel/user/process.h>
+#include <unit_tests/test_init.h>
+#include <unit_tests/test_phymem.h>
+#include <unit_tests/test_vmalloc.h>
+#include <unit_tests/test_initrd.h>
+#include <unit_tests/test_bcache.h>
+#include <unit_tests/test_page_cache.h>
+#include <unit_tests/test_reclaim.h>
+#include <unit_tests/test_memstat.h>
+#include <unit_tests/test_trace.h>
+#include <unit_tests/test_profile.h>
+#include <unit_tests/test_pmu.h>
+#include <unit_tests/test_softirq.h>
+#include <unit_tests/test_workqueue.h>
+#include <unit_tests/test_futex.h>
+#include <unit_tests/test_timer.h>
+#include <unit_tests/test_user.h>
+#include <unit_tests/test_shell.h>
+#include <unit_tests/test_net.h>
 
 
 void kernel_main(multiboot_info_t* mbi);
@@ -0,0 +1,28 @@
+#ifndef DIV64_H
+#define DIV64_H
+
+#include <stdint.h>
+
+/**
+ * @brief Divides a 64-bit value by a 32-bit one with two divl instructions,
+ *        since the kernel does not link libgcc's 64-bit division.
+ */
+static inline uint64_t div64_u32(uint64_t dividend, uint32_t divisor)
+{
+    uint32_t high = dividend >> 32;
+    uint32_t low = (uint32_t)dividend;
+    uint32_t quotient_high = 0;
+    uint32_t remainder;
+
+    if (high >= divisor)
+    {
+        quotient_high = high / divisor;
+        high %= divisor;
+    }
+    // high < divisor here, so the quotient fits in 32 bits
+    asm("divl %4" : "=a"(low), "=d"(remainder) : "0"(low), "1"(high), "rm"(divisor));
+
+    return ((uint64_t)quotient_high << 32) | low;
+}
+
+#endif //DIV64_H
@@ -0,0 +1,35 @@
+#ifndef RADIX_TREE_H
+#define RADIX_TREE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kernel/mm/heap.h>
+
+// Each level resolves six bits of the index
+#define RADIX_TREE_MAP_SHIFT 6
+#define RADIX_TREE_MAP_SIZE  (1 << RADIX_TREE_MAP_SHIFT)
+#define RADIX_TREE_MAP_MASK  (RADIX_TREE_MAP_SIZE - 1)
+#define RADIX_TREE_MAX_HEIGHT ((32 + RADIX_TREE_MAP_SHIFT - 1) / RADIX_TREE_MAP_SHIFT)
+
+typedef struct radix_tree_node
+{
+    void* slots[RADIX_TREE_MAP_SIZE];
+    uint32_t count;             // Occupied slots
+} radix_tree_node_t;
+
+// A sparse map from 32-bit indices to pointers; the tree only grows as tall as the largest index needs
+typedef struct radix_tree_root
+{
+    radix_tree_node_t* node;
+    uint32_t height;
+} radix_tree_root_t;
+
+#define RADIX_TREE_INIT { NULL, 0 }
+
+void* radix_tree_lookup(const radix_tree_root_t* root, uint32_t index);
+int radix_tree_insert(radix_tree_root_t* root, uint32_t index, void* item);
+void* radix_tree_delete(radix_tree_root_t* root, uint32_t index);
+size_t radix_tree_gang_lookup(const radix_tree_root_t* root, uint32_t start, void** results, size_t max);
+
+#endif //RADIX_TREE_H
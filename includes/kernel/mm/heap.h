@@ -5,14 +5,61 @@
 #include <stddef.h>
 #include <kernel/mm/physical_memory.h>
 #include <kernel/mm/paging.h>
+#include <kernel/mm/vmalloc.h>
 
-#define HEAP_START 0xA0000000
-#define HEAP_INIT_SIZE 0x100000
-#define HEAP_MIN_SIZE 0x70000
+#define HEAP_START CONFIG_HEAP_START
+#define HEAP_INIT_SIZE CONFIG_HEAP_INIT_SIZE
+#define HEAP_MIN_SIZE CONFIG_HEAP_MIN_SIZE
+// 大于等于该大小的请求交给 vmalloc，不再永久扩展堆
+#define HEAP_VMALLOC_THRESHOLD (1 << CONFIG_HEAP_VMALLOC_SHIFT)
+
+// kmalloc 的大小分级：数据大小从 2^HEAP_CLASS_MIN_SHIFT 字节起每级翻倍，最后一级是交给 vmalloc 的大块
+#define HEAP_CLASS_MIN_SHIFT CONFIG_HEAP_CLASS_MIN_SHIFT
+#define HEAP_CLASS_LARGE     (CONFIG_HEAP_VMALLOC_SHIFT - CONFIG_HEAP_CLASS_MIN_SHIFT + 1)
+#define HEAP_CLASS_COUNT     (HEAP_CLASS_LARGE + 1)
+
+// 最小的几个分级各有一个空闲块栈，释放的块不合并，直接留给同一分级的下一次分配
+#define HEAP_QUICK_CLASSES CONFIG_HEAP_QUICK_CLASSES
+
+// make ALLOC_TRACK=1 时按调用点统计堆中的分配，用于查找热点和泄漏
+#define ALLOC_TRACK_BITS  8
+#define ALLOC_TRACK_SLOTS (1 << ALLOC_TRACK_BITS)
+
+typedef struct heap_class_stats
+{
+    uint32_t allocs;
+    uint32_t frees;
+} heap_class_stats_t;
+
+typedef struct heap_stats
+{
+    size_t mapped;          // 已映射的堆大小
+    size_t in_use;          // 已分配的块占用的字节数，包括头部
+    size_t free;            // 空闲链表中的字节数
+    size_t free_blocks;
+    size_t largest_free;
+    uint32_t failures;      // 返回 NULL 的分配次数
+    heap_class_stats_t classes[HEAP_CLASS_COUNT];
+} heap_stats_t;
+
+// 一个调用点分配的、还没有释放的块
+typedef struct alloc_site
+{
+    uintptr_t caller;
+    uint32_t allocs;        // 累计分配次数
+    uint32_t live_count;
+    size_t live_bytes;
+} alloc_site_t;
 
 void heap_init();
+void run_heap_tests();
 void* kmalloc(size_t size);
 void kfree(void* ptr);
 void* kmalloc_a(size_t size);
+size_t heap_trim(size_t count);
+void heap_get_stats(heap_stats_t* stats);
+#ifdef CONFIG_ALLOC_TRACK
+size_t heap_get_alloc_sites(alloc_site_t* sites, size_t max);
+#endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef HIGHMEM_H
+#define HIGHMEM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/mm/paging.h>
+#include <kernel/cpu/smp.h>
+
+// Per-CPU temporary mapping slots for frames without a permanent kernel mapping
+#define KMAP_BASE           0xFF000000
+#define KMAP_SLOTS_PER_CPU  16
+
+void* kmap_atomic(phys_addr_t frame);
+void kunmap_atomic(void* addr);
+
+#endif //HIGHMEM_H
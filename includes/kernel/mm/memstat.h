@@ -0,0 +1,29 @@
+#ifndef MEMSTAT_H
+#define MEMSTAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+#include <kernel/mm/physical_memory.h>
+#include <kernel/mm/heap.h>
+#include <kernel/mm/vmalloc.h>
+#include <kernel/mm/page_cache.h>
+#include <kernel/mm/reclaim.h>
+#include <kernel/block/bcache.h>
+
+// Call sites listed by memstat_dump_callers(), largest live bytes first
+#define MEMSTAT_TOP_CALLERS 16
+
+// Single-key commands accepted on the serial port
+#define MEMSTAT_CMD_MEMINFO  'm'
+#define MEMSTAT_CMD_SLABINFO 's'
+#define MEMSTAT_CMD_CALLERS  'c'
+#define MEMSTAT_CMD_MACHINE  'd'
+
+void memstat_dump_meminfo();
+void memstat_dump_slabinfo();
+void memstat_dump_callers();
+void memstat_dump_machine(const char* tag);
+int memstat_command(int command);
+
+#endif //MEMSTAT_H
@@ -0,0 +1,45 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/fs/vfs.h>
+#include <kernel/block/block.h>
+#include <kernel/mm/highmem.h>
+#include <kernel/mm/vmalloc.h>
+#include <kernel/mm/heap.h>
+
+#define PAGE_UPTODATE     (1 << 0)  // Holds the file's contents
+#define PAGE_IO           (1 << 1)  // A read is in flight
+#define PAGE_ERROR        (1 << 2)  // The read failed
+#define PAGE_SHARED_FRAME (1 << 3)  // The frame belongs to the file's backing memory, not the cache
+
+// Sequential read-ahead window, in pages
+#define PAGE_CACHE_READAHEAD_MIN 4
+#define PAGE_CACHE_READAHEAD_MAX 32
+
+// One cached page of a file
+typedef struct page
+{
+    phys_addr_t phys;
+    struct inode* inode;
+    uint32_t index;
+    volatile uint32_t flags;
+    uint32_t refcount;          // Readers and mappings; only unreferenced pages are reclaimed
+    struct page* lru_prev;      // Toward more recently used
+    struct page* lru_next;
+    bio_t bio;                  // For filesystems that read straight into the frame
+} page_t;
+
+page_t* page_cache_get(inode_t* inode, uint32_t index);
+void page_cache_release(page_t* page);
+void page_end_read(page_t* page, int uptodate);
+void page_end_io(bio_t* bio);
+size_t page_cache_shrink(size_t count);
+size_t page_cache_pages();
+
+size_t file_read(inode_t* inode, uint64_t offset, void* buffer, size_t size);
+void* file_mmap(inode_t* inode, uint64_t offset, size_t length);
+void file_munmap(void* addr);
+
+#endif //PAGE_CACHE_H
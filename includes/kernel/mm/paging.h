@@ -6,10 +6,30 @@
 #include <string.h>
 #include <kernel/mm/physical_memory.h>
 #include <kprintf.h>
+#include <kernel/mm/tlb.h>
+#include <kernel/cpu/cpu.h>
 
-#define PAGE_SIZE 4096  
+#ifdef CONFIG_PAE
+// PAE: 64-bit entries, a 4-entry PDPT selecting four page directories of 512 entries.
+// The four directories are allocated contiguously and indexed as one linear array.
+typedef uint64_t pte_t;
+#define PAGE_DIRECTORY_SIZE 2048
+#define PAGE_TABLE_SIZE 512
+#define PAGE_DIR_SHIFT 21
+#define PTE_ADDR_MASK           0x000FFFFFFFFFF000ULL
+#define PG_NX                   (1ULL << 63)
+#else
+typedef uint32_t pte_t;
 #define PAGE_DIRECTORY_SIZE 1024
 #define PAGE_TABLE_SIZE 1024
+#define PAGE_DIR_SHIFT 22
+#define PTE_ADDR_MASK           0xFFFFF000
+#define PG_NX                   0
+#endif
+
+// Virtual memory covered by one page table, and by one large page directory entry
+#define PAGE_TABLE_SPAN         (PAGE_TABLE_SIZE * PAGE_SIZE)
+#define LARGE_PAGE_SIZE         PAGE_TABLE_SPAN
 
 #define PG_PRESENT              (0x1)
 #define PG_WRITE                (0x1 << 1)
@@ -18,13 +38,87 @@
 #define PG_DISABLE_CACHE        (1 << 4)
 #define PG_PDE_4MB              (1 << 7)
 
+// Bits protect_range() is allowed to change
+#define PG_PROT_MASK            (PG_WRITE | PG_ALLOW_USER | PG_WRITE_THROUGHT | PG_DISABLE_CACHE | PG_NX)
+
+#define PAGE_DIR_INDEX(addr)    (((addr) >> PAGE_DIR_SHIFT) & (PAGE_DIRECTORY_SIZE - 1))
+#define PAGE_TABLE_INDEX(addr)  (((addr) >> 12) & (PAGE_TABLE_SIZE - 1))
+
 #define KERNEL_BASE_VIRTUAL_ADDR 0xC0000000
 
+// Low physical memory is mapped linearly at DIRECT_MAP_BASE, with large pages where possible
+#define DIRECT_MAP_BASE KERNEL_BASE_VIRTUAL_ADDR
+#define DIRECT_MAP_SIZE ((uint32_t)LOWMEM_PAGES * PAGE_SIZE)
+
+// Identity mapped at boot: kernel image, VGA buffer and the physical memory bitmap
+#define LOW_IDENTITY_SIZE 0x400000
+
+#if KERNEL_RESERVED_END > LOW_IDENTITY_SIZE
+#error "The page bitmap must end inside the identity mapped low memory, lower CONFIG_MAX_MEMORY_MB or CONFIG_BIT_MAP_ADDR"
+#endif
+
+// The last page directory slot(s) point back at the directory itself, which makes
+// every page table visible at RECURSIVE_PT_BASE and the directory at RECURSIVE_PD_ADDR.
+// Under PAE the last four slots map the four directories, in order.
+#ifdef CONFIG_PAE
+#define RECURSIVE_PT_BASE   0xFF800000
+#define RECURSIVE_PDE_COUNT 4
+#else
+#define RECURSIVE_PT_BASE   0xFFC00000
+#define RECURSIVE_PDE_COUNT 1
+#endif
+#define RECURSIVE_PDE_INDEX PAGE_DIR_INDEX(RECURSIVE_PT_BASE)
+#define RECURSIVE_PD_ADDR   (RECURSIVE_PT_BASE + RECURSIVE_PDE_INDEX * PAGE_SIZE)
+
+// Range reserved for per-address-space user mappings, everything else is shared kernel space
+#define USER_SPACE_START 0x00400000
+#define USER_SPACE_END   0x80000000
+
+// Called for every present page visited by walk(); returning non-zero stops the walk
+typedef int (*page_walk_fn)(uintptr_t virtual_addr, pte_t* entry, void* ctx);
+
+// Page directories of one address space
+#define ADDRESS_SPACE_DIRECTORIES (PAGE_DIRECTORY_SIZE / PAGE_TABLE_SIZE)
+
+// A user address space: a page directory (four under PAE) of its own for the
+// user range, whose kernel entries point at the same page tables as every
+// other directory
+typedef struct address_space
+{
+    uint32_t cr3;               // The directory, or under PAE the page directory pointer table
+    phys_addr_t directories[ADDRESS_SPACE_DIRECTORIES];
+    struct address_space* next; // Every address space, kept in step with kernel directory entries
+} address_space_t;
+
+extern pte_t page_directory[PAGE_DIRECTORY_SIZE];
+
 void page_table_init();
 void page_directory_init();
 void enable_paging();
 void paging_init();
-void map_page(uintptr_t virtual_addr, uintptr_t physical_addr, uint32_t flags);
+void map_page(uintptr_t virtual_addr, phys_addr_t physical_addr, pte_t flags);
 void unmap_page(uintptr_t virtual_addr);
+void map_range(uintptr_t virtual_addr, phys_addr_t physical_addr, size_t size, pte_t flags);
+void map_pages(uintptr_t virtual_addr, const phys_addr_t* frames, size_t count, pte_t flags);
+void unmap_range(uintptr_t virtual_addr, size_t size);
+void protect_range(uintptr_t virtual_addr, size_t size, pte_t flags);
+pte_t* get_pte(uintptr_t virtual_addr, int create);
+phys_addr_t virt_to_phys(uintptr_t virtual_addr);
+void walk(uintptr_t virtual_addr, size_t size, page_walk_fn fn, void* ctx);
+int paging_large_pages_supported();
+int map_large_page(uintptr_t virtual_addr, phys_addr_t physical_addr, pte_t flags);
+void direct_map_init();
+address_space_t* address_space_create();
+void address_space_destroy(address_space_t* space);
+void address_space_switch(address_space_t* space);
+size_t address_space_count();
 void run_paging_tests();
-#endif
\ No newline at end of file
+
+/**
+ * @brief Returns the direct map address of a frame below DIRECT_MAP_SIZE.
+ */
+static inline void* phys_to_virt(phys_addr_t physical_addr)
+{
+    return (void*)(uintptr_t)(DIRECT_MAP_BASE + physical_addr);
+}
+#endif
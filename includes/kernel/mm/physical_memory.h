@@ -6,23 +6,74 @@
 
 #include <string.h>
 #include <kprintf.h>
+#include <multiboot.h>
+
+#ifdef CONFIG_PAE
+// 物理地址可能超过 4GB
+typedef uint64_t phys_addr_t;
+#else
+typedef uint32_t phys_addr_t;
+#endif
 
-#define BIT_MAP_ADDR 0x200000
-#define BIT_MAP 32768 
 #define PAGE_SIZE 4096
 
+// 管理的最大物理内存，以及位图的大小：每 MB 内存 256 个页面，占 32 字节
+#define MAX_MEMORY_SIZE ((uint64_t)CONFIG_MAX_MEMORY_MB << 20)
+#define BIT_MAP (CONFIG_MAX_MEMORY_MB * 32)
+#define BIT_MAP_ADDR CONFIG_BIT_MAP_ADDR
+
+#ifdef CONFIG_PHYS_ALLOC_BUDDY
+// 伙伴系统的阶数，最大的块是 2^(BUDDY_ORDERS - 1) 个页面
+#define BUDDY_ORDERS 11
+// 每一阶一张位图，第 k 阶的位图是页面位图的 1/2^k，紧跟在页面位图之后
+#define BUDDY_MAP_SIZE (BIT_MAP * 2)
+#if CONFIG_MAX_MEMORY_MB % 32 != 0
+#error "CONFIG_MAX_MEMORY_MB must be a multiple of 32 with the buddy allocator"
+#endif
+#else
+#define BUDDY_MAP_SIZE 0
+#endif
+
+// 内核映像、位图和伙伴位图所在的区域，不参与分配
+#define KERNEL_RESERVED_END (BIT_MAP_ADDR + BIT_MAP + BUDDY_MAP_SIZE)
+
+// 低端内存：被直接映射区（256MB）覆盖、可以通过 phys_to_virt 访问的页面
+#define LOWMEM_PAGES 0x10000
+
+// 物理内存区域：直接映射区覆盖的低端内存，以及只能通过页表访问的高端内存
+#define ZONE_LOWMEM  0
+#define ZONE_HIGHMEM 1
+#define NR_ZONES     2
+
+typedef struct zone_stats
+{
+    size_t total;       // 区域内的页面数
+    size_t free;
+    size_t reserved;    // 初始化时就不可分配的页面：内核映像、位图、空洞和 multiboot 模块
+    size_t used;        // 已经分配出去的页面
+} zone_stats_t;
+
 extern uint8_t* memory_bitmap;
 extern size_t memory_bitmap_size;
 
 //Functions:
 
-void physical_memory_init(uint32_t mem_size);
+void physical_memory_init(uint64_t mem_size);
+void physical_memory_init_mmap(multiboot_info_t* mbi);
+void physical_memory_reserve_range(uint64_t start, uint64_t end);
 
 void* alloc_physical_page();
 
 void free_physical_page(void* page);
 
+phys_addr_t alloc_highmem_page();
+void free_highmem_page(phys_addr_t page);
+
+phys_addr_t alloc_physical_pages_aligned(size_t count, size_t align);
+void free_physical_pages(phys_addr_t start, size_t count);
+
 size_t get_free_page_count();
-static int find_first_free_page();
+size_t get_total_page_count();
+void physical_memory_zone_stats(int zone, zone_stats_t* stats);
 int is_page_free(void* ptr);
-#endif //PHYSICAL_MEMORY_H
\ No newline at end of file
+#endif //PHYSICAL_MEMORY_H
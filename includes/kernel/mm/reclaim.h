@@ -0,0 +1,46 @@
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/mm/physical_memory.h>
+#include <kernel/mm/heap.h>
+#include <kernel/mm/page_cache.h>
+#include <kernel/block/bcache.h>
+#include <kernel/sched/kthread.h>
+
+// Pages asked of the shrinkers per reclaim pass
+#define RECLAIM_BATCH 32
+
+// Bounds for the min watermark, in pages; low and high are derived from it
+#define WATERMARK_MIN_FLOOR 32
+#define WATERMARK_MIN_CEIL  1024
+
+// A cache that can give pages back under memory pressure
+typedef struct shrinker
+{
+    const char* name;
+    size_t (*scan)(size_t count);   // Frees up to `count` pages, returns how many it freed
+    struct shrinker* next;
+} shrinker_t;
+
+typedef struct reclaim_stats
+{
+    uint32_t wakeups;           // Times the reclaimer was woken below the low watermark
+    uint32_t background_runs;   // Reclaim passes made by the reclaimer thread
+    uint32_t direct_runs;       // Reclaim passes made by allocations below the min watermark
+    uint32_t pages_reclaimed;
+    uint32_t failures;          // Allocations that failed even after reclaim
+} reclaim_stats_t;
+
+void reclaim_init();
+void register_shrinker(shrinker_t* shrinker);
+size_t reclaim_pages(size_t count);
+void reclaim_throttle(size_t count);
+size_t reclaim_direct(size_t count);
+void reclaim_alloc_failed();
+void reclaim_wake();
+void reclaim_get_watermarks(size_t* min, size_t* low, size_t* high);
+void reclaim_get_stats(reclaim_stats_t* stats);
+
+#endif //RECLAIM_H
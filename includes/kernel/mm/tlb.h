@@ -0,0 +1,55 @@
+#ifndef TLB_H
+#define TLB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/cpu/smp.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/cpu/idt.h>
+
+// Above this many pages a full CR3 reload is cheaper than one invlpg per page
+#define TLB_FLUSH_ALL_THRESHOLD 32
+// Number of disjoint ranges a gather can track before it degrades to a full flush
+#define TLB_GATHER_RANGES 8
+
+// IPI vector used to ask other CPUs to process their queued invalidations
+#define TLB_SHOOTDOWN_VECTOR 0xFD
+
+/**
+ * @brief Collects the virtual pages touched by a batch of page table updates
+ * so they can be invalidated once, after the whole batch has been applied.
+ */
+typedef struct tlb_gather
+{
+    uintptr_t start[TLB_GATHER_RANGES]; // First page of each range
+    uintptr_t end[TLB_GATHER_RANGES];   // One past the last page of each range
+    uint32_t nr_ranges;
+    uint32_t nr_pages;
+    int flush_all;                      // Set once the batch is cheaper to flush with a CR3 reload
+    int kernel;                         // The batch touches addresses shared by every address space
+    uint32_t page_directory;            // CR3 of the address space the batch was collected in
+} tlb_gather_t;
+
+static inline void tlb_invalidate_page(uintptr_t virtual_addr)
+{
+    asm volatile("invlpg (%0)" : : "r"(virtual_addr) : "memory");
+}
+
+static inline void tlb_flush_all()
+{
+    uint32_t cr3;
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    asm volatile("mov %0, %%cr3" : : "r"(cr3) : "memory");
+}
+
+void tlb_gather_init(tlb_gather_t* tlb);
+void tlb_gather_add(tlb_gather_t* tlb, uintptr_t virtual_addr);
+void tlb_gather_add_range(tlb_gather_t* tlb, uintptr_t start, uintptr_t end);
+void tlb_gather_flush(tlb_gather_t* tlb);
+
+void tlb_cpu_init();
+void tlb_switch_address_space(uint32_t page_directory, int lazy);
+void tlb_shootdown_poll();
+void tlb_shootdown_interrupt(interrupt_frame_t* frame);
+
+#endif //TLB_H
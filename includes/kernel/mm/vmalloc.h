@@ -0,0 +1,24 @@
+#ifndef VMALLOC_H
+#define VMALLOC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/mm/paging.h>
+#include <kernel/mm/physical_memory.h>
+
+// Kernel virtual range handed out by vmalloc(), between the direct map and the kmap slots
+#define VMALLOC_START 0xD0000000
+#define VMALLOC_END   0xF0000000
+#define VMALLOC_PAGES ((VMALLOC_END - VMALLOC_START) / PAGE_SIZE)
+
+void* vmalloc(size_t size);
+void vfree(void* ptr);
+void* vmap_range(phys_addr_t physical_addr, size_t size, pte_t flags);
+void* vmap_pages(const phys_addr_t* frames, size_t count, pte_t flags);
+void vunmap(void* ptr);
+void* dma_alloc(size_t size, phys_addr_t* physical_addr);
+void dma_free(void* ptr);
+int is_vmalloc_addr(const void* ptr);
+size_t vmalloc_used_pages();
+
+#endif //VMALLOC_H
@@ -0,0 +1,163 @@
+#ifndef NET_H
+#define NET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kprintf.h>
+#include <kernel/net/netbuf.h>
+#include <kernel/sched/softirq.h>
+#include <kernel/sync/spinlock.h>
+
+#define NET_MAX_DEVICES 4
+#define NET_MAX_PORTS   8
+#define NET_ARP_ENTRIES 8
+
+#define NET_IP(a, b, c, d) ((uint32_t)(a) << 24 | (uint32_t)(b) << 16 | (uint32_t)(c) << 8 | (uint32_t)(d))
+
+// The addresses QEMU user networking hands out; the host is reachable as the gateway
+#define NET_LOCAL_IP    NET_IP(10, 0, 2, 15)
+#define NET_GATEWAY_IP  NET_IP(10, 0, 2, 2)
+#define NET_NETMASK     NET_IP(255, 255, 255, 0)
+#define NET_LOOPBACK_IP NET_IP(127, 0, 0, 1)
+
+// UDP port answered by the echo service on every device
+#define NET_ECHO_PORT 7
+
+#define NET_DEV_LOOPBACK 0x01   // No link layer addresses, never needs ARP
+
+// Ethernet, ARP, IPv4 and UDP on the wire; multi-byte fields are big endian
+#define ETH_ALEN       6
+#define ETH_ZLEN       60       // Shortest frame, without the FCS
+#define ETH_TYPE_IPV4  0x0800
+#define ETH_TYPE_ARP   0x0806
+#define ARP_HW_ETHER   1
+#define ARP_OP_REQUEST 1
+#define ARP_OP_REPLY   2
+#define IP_VERSION_IHL 0x45     // IPv4 without options
+#define IP_PROTO_UDP   17
+#define IP_DEFAULT_TTL 64
+#define IP_FRAG_MASK   0x3FFF   // More fragments flag and fragment offset
+
+typedef struct eth_header
+{
+    uint8_t dest[ETH_ALEN];
+    uint8_t src[ETH_ALEN];
+    uint16_t type;
+} __attribute__((packed)) eth_header_t;
+
+typedef struct arp_packet
+{
+    uint16_t hw_type;
+    uint16_t proto_type;
+    uint8_t hw_len;
+    uint8_t proto_len;
+    uint16_t op;
+    uint8_t sender_mac[ETH_ALEN];
+    uint32_t sender_ip;
+    uint8_t target_mac[ETH_ALEN];
+    uint32_t target_ip;
+} __attribute__((packed)) arp_packet_t;
+
+typedef struct ip_header
+{
+    uint8_t version_ihl;
+    uint8_t tos;
+    uint16_t total_len;
+    uint16_t id;
+    uint16_t frag;
+    uint8_t ttl;
+    uint8_t proto;
+    uint16_t checksum;
+    uint32_t src;
+    uint32_t dest;
+} __attribute__((packed)) ip_header_t;
+
+typedef struct udp_header
+{
+    uint16_t src_port;
+    uint16_t dest_port;
+    uint16_t len;
+    uint16_t checksum;
+} __attribute__((packed)) udp_header_t;
+
+// Bytes in front of the payload of a UDP datagram we send
+#define NET_UDP_HEADERS (sizeof(eth_header_t) + sizeof(ip_header_t) + sizeof(udp_header_t))
+#define NET_UDP_MAX_PAYLOAD (1500 - sizeof(ip_header_t) - sizeof(udp_header_t))
+
+static inline uint16_t net_htons(uint16_t value)
+{
+    return __builtin_bswap16(value);
+}
+
+static inline uint32_t net_htonl(uint32_t value)
+{
+    return __builtin_bswap32(value);
+}
+
+#define net_ntohs net_htons
+#define net_ntohl net_htonl
+
+struct net_device;
+
+typedef struct net_device_ops
+{
+    // Takes the buffer in every case, and frees it once sent or refused
+    int (*transmit)(struct net_device* dev, netbuf_t* nb);
+    // Hands up to `budget` received frames to net_receive(); returns how many
+    int (*poll)(struct net_device* dev, int budget);
+    // Turns the receive interrupt back on; nonzero if frames arrived meanwhile,
+    // in which case it stays off and the device is polled again
+    int (*irq_enable)(struct net_device* dev);
+} net_device_ops_t;
+
+typedef struct net_stats
+{
+    uint32_t rx_packets;
+    uint32_t tx_packets;
+    uint32_t rx_dropped;        // Malformed, not for us, or no listener
+    uint32_t tx_dropped;        // Ring full or no route
+    uint32_t interrupts;        // Receive interrupts that switched the device to polling
+    uint32_t polls;
+    uint32_t polls_full;        // Polls that used their whole budget and kept polling
+} net_stats_t;
+
+typedef struct net_device
+{
+    const char* name;
+    uint32_t id;
+    uint32_t flags;
+    uint8_t mac[ETH_ALEN];
+    uint32_t ip;
+    const net_device_ops_t* ops;
+    void* private;
+    net_stats_t stats;
+} net_device_t;
+
+/**
+ * @brief Called in softirq context for each datagram to a bound port.
+ *
+ * The handler owns the buffer: it frees it, or sends it on, for example
+ * as a reply with net_udp_reply().
+ */
+typedef void (*udp_handler_t)(net_device_t* dev, netbuf_t* nb, uint32_t src_ip, uint16_t src_port,
+                              uint8_t* payload, uint16_t len);
+
+void net_init();
+int net_register_device(net_device_t* dev);
+net_device_t* net_get_device(uint32_t id);
+size_t net_device_count();
+net_device_t* net_route(uint32_t ip);
+void net_schedule(net_device_t* dev);
+int net_transmit(net_device_t* dev, netbuf_t* nb);
+void net_receive(net_device_t* dev, netbuf_t* nb);
+uint16_t net_checksum(const void* data, size_t len);
+int net_arp_lookup(uint32_t ip, uint8_t* mac);
+int net_udp_bind(uint16_t port, udp_handler_t handler);
+void net_udp_unbind(uint16_t port);
+netbuf_t* net_udp_alloc(uint8_t** payload);
+int net_udp_send(uint32_t dest_ip, uint16_t src_port, uint16_t dest_port, netbuf_t* nb, uint16_t len);
+int net_udp_reply(net_device_t* dev, netbuf_t* nb);
+void net_dump_stats();
+
+#endif //NET_H
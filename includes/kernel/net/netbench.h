@@ -0,0 +1,43 @@
+#ifndef NETBENCH_H
+#define NETBENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/net/net.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/sched/kthread.h>
+
+// Local port the replies come back to
+#define NETBENCH_PORT 40000
+
+// Port of the host's echo server, reached through the gateway; see tools/udpbench.py
+#define NETBENCH_HOST_PORT 7777
+
+#define NETBENCH_DEFAULT_COUNT 1000
+#define NETBENCH_MAX_COUNT     100000
+#define NETBENCH_PAYLOAD       64
+
+// Datagrams in flight; latency is measured under this much queueing
+#define NETBENCH_WINDOW 8
+
+// Milliseconds without a reply before the rest are counted as lost
+#define NETBENCH_IDLE_TIMEOUT_MS 500
+
+// Attempts at resolving the next hop before a run is given up
+#define NETBENCH_ARP_TRIES 10
+
+typedef struct netbench_result
+{
+    uint32_t sent;
+    uint32_t received;
+    uint32_t pps;               // Replies per second over the whole run
+    uint32_t p50_ns;
+    uint32_t p90_ns;
+    uint32_t p99_ns;
+    uint32_t max_ns;
+} netbench_result_t;
+
+int netbench_run(uint32_t dest_ip, uint16_t dest_port, uint32_t count, netbench_result_t* result);
+void netbench_report(const char* label, const netbench_result_t* result);
+
+#endif //NETBENCH_H
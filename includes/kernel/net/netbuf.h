@@ -0,0 +1,52 @@
+#ifndef NETBUF_H
+#define NETBUF_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/mm/vmalloc.h>
+#include <kernel/sync/spinlock.h>
+
+#define NETBUF_POOL CONFIG_NET_BUFFERS
+
+// Pages allocated together; each run is physically contiguous, the pool as a whole need not be
+#define NETBUF_CHUNK_PAGES 16
+
+// Bytes in front of a frame, for headers a device wants before it
+#define NETBUF_HEADROOM 64
+#define NETBUF_DATA_MAX (PAGE_SIZE - NETBUF_HEADROOM)
+
+/**
+ * @brief A packet buffer: one page, with the frame at `offset`.
+ *
+ * Devices receive into the page and send from it by physical address, so
+ * a frame travels from the receive ring through the stack and out again
+ * without being copied.
+ */
+typedef struct netbuf
+{
+    struct netbuf* next;
+    uint8_t* page;
+    phys_addr_t phys;
+    uint16_t offset;
+    uint16_t len;
+} netbuf_t;
+
+static inline uint8_t* netbuf_data(netbuf_t* nb)
+{
+    return nb->page + nb->offset;
+}
+
+static inline phys_addr_t netbuf_data_phys(netbuf_t* nb)
+{
+    return nb->phys + nb->offset;
+}
+
+int netbuf_init();
+netbuf_t* netbuf_alloc();
+void netbuf_free(netbuf_t* nb);
+size_t netbuf_free_count();
+size_t netbuf_count();
+
+#endif //NETBUF_H
@@ -0,0 +1,48 @@
+#ifndef KTHREAD_H
+#define KTHREAD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/mm/heap.h>
+#include <kprintf.h>
+#include <kernel/cpu/gdt.h>
+#include <kernel/mm/paging.h>
+#include <kernel/mm/tlb.h>
+
+#define KTHREAD_STACK_SIZE 0x4000
+
+#define KTHREAD_RUNNABLE 0
+#define KTHREAD_SLEEPING 1
+#define KTHREAD_DEAD     2
+
+typedef void (*kthread_fn)(void* arg);
+
+typedef struct kthread
+{
+    uint32_t esp;               // Saved stack pointer while switched out
+    volatile uint32_t state;
+    volatile uint32_t wake_pending; // Woken while running; the next kthread_sleep() returns at once
+    const char* name;
+    kthread_fn fn;
+    void* arg;
+    void* stack;                // NULL for the boot thread, which runs on the boot stack
+    address_space_t* space;     // Of the user program this thread runs, NULL for kernel threads
+    struct process* process;    // The program, which enters the kernel at the top of the stack
+    struct kthread* next;       // Ring of all threads, in round-robin order
+} kthread_t;
+
+void kthread_init();
+kthread_t* kthread_create(kthread_fn fn, void* arg, const char* name);
+kthread_t* kthread_current();
+void kthread_yield();
+void kthread_sleep();
+void kthread_wake(kthread_t* thread);
+int kthread_has_runnable();
+void kthread_set_idle(void (*idle)());
+void kthread_exit();
+
+// Saves the callee-saved registers on the current stack, stores the stack
+// pointer in *old_esp and resumes the thread whose stack pointer is new_esp
+void kthread_switch(uint32_t* old_esp, uint32_t new_esp);
+
+#endif //KTHREAD_H
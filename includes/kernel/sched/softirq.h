@@ -0,0 +1,52 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+#include <kernel/cpu/smp.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/sched/kthread.h>
+
+// Softirq numbers; lower numbers run first
+#define SOFTIRQ_TIMER   0
+#define SOFTIRQ_BLOCK   1
+#define SOFTIRQ_NET     2
+#define SOFTIRQ_TASKLET 3
+#define SOFTIRQ_COUNT   4
+
+// Passes over the pending mask at one interrupt exit before the rest is left to ksoftirqd
+#define SOFTIRQ_MAX_RESTART 10
+
+typedef void (*softirq_handler_t)();
+
+typedef struct tasklet
+{
+    struct tasklet* next;
+    void (*fn)(void* data);
+    void* data;
+    volatile uint32_t scheduled;
+} tasklet_t;
+
+typedef struct softirq_stats
+{
+    uint32_t raised;            // raise_softirq() calls
+    uint32_t runs;              // Handler invocations; each may cover several raises
+    uint32_t deferred;          // Times the restart limit handed work to ksoftirqd
+} softirq_stats_t;
+
+void softirq_init();
+void open_softirq(uint32_t nr, softirq_handler_t handler);
+void raise_softirq(uint32_t nr);
+void do_softirq();
+void irq_enter();
+void irq_exit();
+int in_interrupt();
+int softirq_pending();
+void local_bh_disable();
+void local_bh_enable();
+void tasklet_init(tasklet_t* tasklet, void (*fn)(void* data), void* data);
+void tasklet_schedule(tasklet_t* tasklet);
+void softirq_get_stats(softirq_stats_t* stats);
+
+#endif //SOFTIRQ_H
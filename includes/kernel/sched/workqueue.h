@@ -0,0 +1,50 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+#include <kernel/cpu/smp.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/mm/heap.h>
+#include <kernel/sched/kthread.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/futex.h>
+
+typedef struct work
+{
+    struct work* next;
+    void (*fn)(struct work* work);
+    volatile uint32_t pending;  // Queued and not yet started
+} work_t;
+
+// One per CPU and queue; items queued on a CPU run in order
+typedef struct worker
+{
+    spinlock_t lock;
+    work_t* head;
+    work_t* tail;
+    kthread_t* thread;
+    volatile uint32_t busy;     // Running items taken off the list
+    uint32_t completed;
+    volatile uint32_t batches;  // Bumped as each batch finishes; flush_workqueue() sleeps on it
+} __attribute__((aligned(64))) worker_t;
+
+typedef struct workqueue
+{
+    const char* name;
+    worker_t workers[MAX_CPUS];
+} workqueue_t;
+
+// The shared queue behind schedule_work()
+extern workqueue_t* system_wq;
+
+void workqueue_init();
+workqueue_t* workqueue_create(const char* name);
+void work_init(work_t* work, void (*fn)(work_t* work));
+int queue_work_on(uint32_t cpu, workqueue_t* wq, work_t* work);
+int queue_work(workqueue_t* wq, work_t* work);
+int schedule_work(work_t* work);
+void flush_workqueue(workqueue_t* wq);
+
+#endif //WORKQUEUE_H
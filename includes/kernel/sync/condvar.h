@@ -0,0 +1,45 @@
+#ifndef CONDVAR_H
+#define CONDVAR_H
+
+#include <stdint.h>
+#include <kernel/sync/futex.h>
+#include <kernel/sync/mutex.h>
+
+// A condition variable for use with a mutex_t. Waiters sleep on `seq`,
+// which every signal bumps, so a signal between releasing the mutex and
+// going to sleep is never lost. Signalling with no waiter is atomics only.
+typedef struct condvar
+{
+    volatile uint32_t seq;
+    volatile uint32_t waiters;
+} condvar_t;
+
+#define CONDVAR_INIT { 0, 0 }
+
+void cond_wait(condvar_t* cond, mutex_t* mutex);
+
+static inline void cond_init(condvar_t* cond)
+{
+    cond->seq = 0;
+    cond->waiters = 0;
+}
+
+static inline void cond_signal(condvar_t* cond)
+{
+    __atomic_add_fetch(&cond->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&cond->waiters, __ATOMIC_SEQ_CST) != 0)
+    {
+        futex_wake(&cond->seq, 1);
+    }
+}
+
+static inline void cond_broadcast(condvar_t* cond)
+{
+    __atomic_add_fetch(&cond->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&cond->waiters, __ATOMIC_SEQ_CST) != 0)
+    {
+        futex_wake(&cond->seq, FUTEX_WAKE_ALL);
+    }
+}
+
+#endif //CONDVAR_H
@@ -0,0 +1,45 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/mm/paging.h>
+#include <kernel/sched/kthread.h>
+#include <kernel/sync/spinlock.h>
+
+// Waiters are hashed by address into this many queues
+#define FUTEX_HASH_BITS 6
+#define FUTEX_HASH_SIZE (1 << FUTEX_HASH_BITS)
+
+#define FUTEX_WAKE_ALL 0xFFFFFFFF
+
+// Lives on the waiting thread's stack while it sleeps
+typedef struct futex_waiter
+{
+    const volatile uint32_t* addr;
+    address_space_t* space;     // NULL for kernel addresses
+    kthread_t* thread;
+    volatile uint32_t woken;
+    struct futex_waiter* next;
+} futex_waiter_t;
+
+typedef struct futex_bucket
+{
+    spinlock_t lock;
+    futex_waiter_t* head;       // Oldest first
+} futex_bucket_t;
+
+typedef struct futex_stats
+{
+    uint32_t waits;             // Threads that went to sleep
+    uint32_t retries;           // futex_wait() calls that found the value changed
+    uint32_t wakes;             // futex_wake() calls
+    uint32_t woken;             // Threads woken by them
+} futex_stats_t;
+
+int futex_wait(const volatile uint32_t* addr, uint32_t expected);
+uint32_t futex_wake(const volatile uint32_t* addr, uint32_t count);
+void futex_get_stats(futex_stats_t* stats);
+
+#endif //FUTEX_H
@@ -0,0 +1,55 @@
+#ifndef MUTEX_H
+#define MUTEX_H
+
+#include <stdint.h>
+#include <kernel/assert.h>
+#include <kernel/sync/futex.h>
+
+#define MUTEX_UNLOCKED 0
+#define MUTEX_LOCKED 1
+#define MUTEX_CONTENDED 2       // Locked, and a thread may be sleeping on it
+
+// A sleeping lock: taking and releasing it uncontended is a single atomic
+// instruction, and only a thread that finds it held enters the kernel's
+// wait queues. Unlike a spinlock it may be held across a sleep.
+typedef struct mutex
+{
+    volatile uint32_t state;
+} mutex_t;
+
+#define MUTEX_INIT { MUTEX_UNLOCKED }
+
+void mutex_lock_slow(mutex_t* mutex);
+void mutex_unlock_slow(mutex_t* mutex);
+
+static inline void mutex_init(mutex_t* mutex)
+{
+    mutex->state = MUTEX_UNLOCKED;
+}
+
+static inline void mutex_lock(mutex_t* mutex)
+{
+    uint32_t expected = MUTEX_UNLOCKED;
+    if (!__atomic_compare_exchange_n(&mutex->state, &expected, MUTEX_LOCKED, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        mutex_lock_slow(mutex);
+    }
+}
+
+static inline int mutex_trylock(mutex_t* mutex)
+{
+    uint32_t expected = MUTEX_UNLOCKED;
+    return __atomic_compare_exchange_n(&mutex->state, &expected, MUTEX_LOCKED, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+static inline void mutex_unlock(mutex_t* mutex)
+{
+    uint32_t state = __atomic_exchange_n(&mutex->state, MUTEX_UNLOCKED, __ATOMIC_RELEASE);
+    ASSERT(state != MUTEX_UNLOCKED);
+    if (state == MUTEX_CONTENDED)
+    {
+        mutex_unlock_slow(mutex);
+    }
+}
+
+#endif //MUTEX_H
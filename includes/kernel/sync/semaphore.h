@@ -0,0 +1,61 @@
+#ifndef SEMAPHORE_H
+#define SEMAPHORE_H
+
+#include <stdint.h>
+#include <kernel/sync/futex.h>
+
+// A counting semaphore. down() and up() are atomics only while the count
+// is positive and nobody sleeps; up() enters the kernel only if `waiters`
+// says a thread may be sleeping in down().
+typedef struct semaphore
+{
+    volatile uint32_t count;
+    volatile uint32_t waiters;
+} semaphore_t;
+
+#define SEMAPHORE_INIT(n) { (n), 0 }
+
+void sem_down_slow(semaphore_t* sem);
+
+static inline void sem_init(semaphore_t* sem, uint32_t count)
+{
+    sem->count = count;
+    sem->waiters = 0;
+}
+
+/**
+ * @brief Takes one unit if the count is positive.
+ *
+ * @return 1 if taken, 0 otherwise.
+ */
+static inline int sem_trydown(semaphore_t* sem)
+{
+    uint32_t count = __atomic_load_n(&sem->count, __ATOMIC_RELAXED);
+    while (count != 0)
+    {
+        if (__atomic_compare_exchange_n(&sem->count, &count, count - 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static inline void sem_down(semaphore_t* sem)
+{
+    if (!sem_trydown(sem))
+    {
+        sem_down_slow(sem);
+    }
+}
+
+static inline void sem_up(semaphore_t* sem)
+{
+    __atomic_add_fetch(&sem->count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sem->waiters, __ATOMIC_SEQ_CST) != 0)
+    {
+        futex_wake(&sem->count, 1);
+    }
+}
+
+#endif //SEMAPHORE_H
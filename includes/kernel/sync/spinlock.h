@@ -0,0 +1,37 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/assert.h>
+
+typedef struct spinlock
+{
+    volatile uint32_t locked;
+} spinlock_t;
+
+#define SPINLOCK_INIT { 0 }
+
+static inline void spin_lock(spinlock_t* lock)
+{
+    while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE))
+    {
+        while (lock->locked)
+        {
+            cpu_relax();
+        }
+    }
+}
+
+static inline int spin_trylock(spinlock_t* lock)
+{
+    return !__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE);
+}
+
+static inline void spin_unlock(spinlock_t* lock)
+{
+    ASSERT(lock->locked);
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+#endif //SPINLOCK_H
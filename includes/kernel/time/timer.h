@@ -0,0 +1,70 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/cpu/lapic.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/lib/div64.h>
+#include <kernel/sched/kthread.h>
+#include <kernel/sched/softirq.h>
+#include <kernel/sync/spinlock.h>
+
+// Timer resolution: one jiffy is a millisecond
+#define TIMER_HZ 1000
+
+#define LAPIC_TIMER_VECTOR 0xFB
+
+// Wheel geometry: 256 slots of one jiffy, then four levels of 64 slots, each
+// slot of a level covering one full turn of the level below
+#define TIMER_TV1_BITS  8
+#define TIMER_TVN_BITS  6
+#define TIMER_TV1_SIZE  (1 << TIMER_TV1_BITS)
+#define TIMER_TVN_SIZE  (1 << TIMER_TVN_BITS)
+#define TIMER_TV1_MASK  (TIMER_TV1_SIZE - 1)
+#define TIMER_TVN_MASK  (TIMER_TVN_SIZE - 1)
+#define TIMER_TVN_LEVELS 4
+
+// Timers further out than this are clamped to it
+#define TIMER_MAX_DELTA 0xFFFFFFFFULL
+
+#define TIMER_NEVER (~0ULL)
+
+typedef struct ktimer
+{
+    struct ktimer* next;
+    struct ktimer** pprev;      // The link pointing at this timer, NULL while not pending
+    uint64_t expires;           // In jiffies
+    void (*fn)(struct ktimer* timer);
+} ktimer_t;
+
+typedef struct timer_stats
+{
+    uint32_t ticks;             // Timer interrupts
+    uint32_t expired;           // Timer callbacks run
+    uint32_t cascades;          // Timers moved down a level
+    uint32_t idle_entries;      // Halts with the tick stopped
+    uint32_t idle_jiffies;      // Jiffies spent halted without a tick
+} timer_stats_t;
+
+void timers_init();
+int timers_available();
+uint64_t jiffies_now();
+void timer_get_clock(uint64_t* tsc_base, uint32_t* tsc_per_jiffy);
+uint64_t msecs_to_jiffies(uint32_t ms);
+
+void ktimer_init(ktimer_t* timer, void (*fn)(ktimer_t* timer));
+void ktimer_add(ktimer_t* timer, uint64_t expires);
+int ktimer_mod(ktimer_t* timer, uint64_t expires);
+int ktimer_del(ktimer_t* timer);
+int ktimer_pending(const ktimer_t* timer);
+
+uint64_t timer_next_expiry();
+void timer_sleep_ms(uint32_t ms);
+void cpu_idle();
+void timer_get_stats(timer_stats_t* stats);
+
+#endif //TIMER_H
@@ -0,0 +1,32 @@
+#ifndef GCOV_H
+#define GCOV_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kprintf.h>
+#include <kernel/cpu/io.h>
+#include <kernel/drivers/serial.h>
+
+// Frames a dump of the branch counters on the serial port, see tools/gcov_extract.py
+#define GCOV_DUMP_BEGIN "\n@@GCOV\n"
+#define GCOV_DUMP_END   "\n@@END\n"
+
+// QEMU's isa-debug-exit device, as passed by make bench
+#define GCOV_QEMU_EXIT_PORT 0xF4
+
+// Per object file: a header, the .gcda file name, then its contents.
+// A header with a zero name length ends the dump.
+typedef struct gcov_dump_header
+{
+    uint32_t name_size;
+    uint32_t data_size;
+} gcov_dump_header_t;
+
+#ifdef CONFIG_GCOV
+void gcov_init();
+void gcov_dump_serial();
+uint32_t gcov_unit_count();
+#endif
+
+#endif //GCOV_H
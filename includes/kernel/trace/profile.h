@@ -0,0 +1,61 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kprintf.h>
+#include <kernel/cpu/smp.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/cpu/pit.h>
+#include <kernel/mm/vmalloc.h>
+#include <kernel/drivers/serial.h>
+#include <kernel/sched/kthread.h>
+
+#define PROFILE_DEFAULT_HZ 1000
+
+// Program counters kept per sample: the interrupted eip, then return addresses outward
+#define PROFILE_MAX_DEPTH 14
+// Samples kept per CPU; once full, further samples are counted as dropped
+#define PROFILE_SAMPLES 4096
+
+// How far above the interrupted stack pointer a frame may lie on the boot stack
+#define PROFILE_STACK_LIMIT KTHREAD_STACK_SIZE
+
+// Serial commands
+#define PROFILE_CMD_START 'p'
+#define PROFILE_CMD_STOP  'o'
+#define PROFILE_CMD_DUMP  'f'
+
+// Frames a dump on the serial port, see tools/profile.py
+#define PROFILE_DUMP_BEGIN "\n@@PROFILE\n"
+#define PROFILE_DUMP_END   "\n@@END\n"
+#define PROFILE_DUMP_MAGIC "OSPROF01"
+
+typedef struct profile_sample
+{
+    uint32_t thread;            // kthread_t address of the interrupted thread
+    uint32_t depth;             // Entries of pcs in use
+    uint32_t pcs[PROFILE_MAX_DEPTH];
+} profile_sample_t;
+
+typedef struct profile_dump_header
+{
+    char magic[8];
+    uint32_t sample_size;
+    uint32_t hz;                // 0 when the samples came from counter overflows
+    uint32_t cpus;              // Followed, per CPU, by its id, a sample count, a drop count and the samples
+} profile_dump_header_t;
+
+void profile_init();
+void profile_reset();
+uint32_t profile_start(uint32_t hz);
+void profile_stop();
+void profile_sample(interrupt_frame_t* frame);
+size_t profile_backtrace(uintptr_t fp, uintptr_t stack_low, uintptr_t stack_high, uint32_t* pcs, size_t max);
+size_t profile_count(uint32_t cpu);
+const profile_sample_t* profile_sample_at(uint32_t cpu, size_t index);
+void profile_dump_serial();
+int profile_command(int command);
+
+#endif //PROFILE_H
@@ -0,0 +1,86 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kprintf.h>
+#include <kernel/cpu/cpu.h>
+#include <kernel/cpu/smp.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/drivers/serial.h>
+#include <kernel/sched/kthread.h>
+
+// Event ids; tools/trace2json.py decodes them by the same numbers
+#define TRACE_PAGE_ALLOC  0     // frame number, page count
+#define TRACE_PAGE_FREE   1     // frame number, page count
+#define TRACE_KMALLOC     2     // pointer, size, caller
+#define TRACE_KFREE       3     // pointer
+#define TRACE_MAP_PAGE    4     // virtual address, page count, first frame number, flags
+#define TRACE_UNMAP_PAGE  5     // virtual address, page count
+#define TRACE_IRQ_ENTRY   6     // vector, interrupted eip
+#define TRACE_IRQ_EXIT    7     // vector
+#define TRACE_SWITCH      8     // previous thread, next thread, first 8 bytes of the next thread's name
+#define TRACE_PMU         9     // set size and first three events, 8 bits each; their first three counts
+#define TRACE_EVENT_COUNT 10
+
+#define TRACE_ALL ((1u << TRACE_EVENT_COUNT) - 1)
+
+// Records kept per CPU; the oldest are overwritten
+#define TRACE_RING_RECORDS 4096
+
+// Serial commands
+#define TRACE_CMD_ENABLE  'e'
+#define TRACE_CMD_DISABLE 'x'
+#define TRACE_CMD_DUMP    't'
+
+// Frames a dump on the serial port, so the decoder can find it among console output
+#define TRACE_DUMP_BEGIN "\n@@TRACE\n"
+#define TRACE_DUMP_END   "\n@@END\n"
+#define TRACE_DUMP_MAGIC "OSTRACE1"
+
+typedef struct trace_record
+{
+    uint64_t tsc;
+    uint16_t event;
+    uint8_t cpu;
+    uint8_t reserved;
+    uint32_t thread;            // kthread_t address of the running thread, 0 before threads exist
+    uint32_t args[4];
+} trace_record_t;
+
+typedef struct trace_dump_header
+{
+    char magic[8];
+    uint32_t record_size;
+    uint32_t tsc_khz;
+    uint32_t cpus;              // Followed, per CPU, by its id, a record count and the records
+} trace_dump_header_t;
+
+// Bit n enables event n
+extern volatile uint32_t trace_enabled;
+
+void trace_init();
+void trace_enable(uint32_t mask);
+void trace_disable(uint32_t mask);
+void trace_write(uint32_t event, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+size_t trace_count(uint32_t cpu);
+const trace_record_t* trace_record_at(uint32_t cpu, size_t index);
+void trace_dump_serial();
+int trace_command(int command);
+
+/**
+ * @brief A tracepoint. While the event is disabled this costs one load and
+ *        one branch, laid out as not taken.
+ */
+#define TRACE_EVENT(event, a0, a1, a2, a3)                                                          \
+    do                                                                                              \
+    {                                                                                               \
+        if (__builtin_expect(trace_enabled & (1u << (event)), 0))                                   \
+        {                                                                                           \
+            trace_write((event), (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2), (uint32_t)(a3));   \
+        }                                                                                           \
+    } while (0)
+
+#endif //TRACE_H
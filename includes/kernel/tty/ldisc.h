@@ -0,0 +1,30 @@
+#ifndef LDISC_H
+#define LDISC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+
+// Longest line, without the terminating NUL
+#define LDISC_LINE_MAX 127
+
+#define LDISC_CTRL_C     0x03
+#define LDISC_CTRL_U     0x15
+#define LDISC_BACKSPACE  '\b'
+#define LDISC_DELETE     0x7F    // What serial terminals send for backspace
+
+/**
+ * @brief Cooks raw characters into lines: echo, erase and line kill.
+ */
+typedef struct ldisc
+{
+    char line[LDISC_LINE_MAX + 1];
+    size_t len;
+    int echo;       // Print what is typed, and the erasing of it
+    int done;       // The line was handed out; the next character starts a new one
+} ldisc_t;
+
+void ldisc_init(ldisc_t* ldisc, int echo);
+int ldisc_input(ldisc_t* ldisc, int c);
+
+#endif //LDISC_H
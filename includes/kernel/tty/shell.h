@@ -0,0 +1,32 @@
+#ifndef SHELL_H
+#define SHELL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kprintf.h>
+#include <kernel/tty/ldisc.h>
+
+#define SHELL_PROMPT "> "
+#define SHELL_MAX_ARGS 8
+
+// On the serial port every other key stays a single-key command for the
+// host tools; this one starts a shell line instead
+#define SHELL_SERIAL_LINE ':'
+
+// Where `bench <name>` finds its programs
+#define SHELL_BENCH_DIR "/bin/"
+#define SHELL_PATH_MAX 64
+
+typedef struct shell_command
+{
+    const char* name;
+    const char* usage;
+    int (*fn)(int argc, char** argv);
+} shell_command_t;
+
+int shell_split(char* line, char** argv, int max);
+int shell_execute(char* line);
+void shell_run();
+
+#endif //SHELL_H
@@ -0,0 +1,66 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kprintf.h>
+#include <kernel/fs/vfs.h>
+#include <kernel/mm/paging.h>
+#include <kernel/mm/page_cache.h>
+#include <kernel/user/vma.h>
+
+#define ELF_MAGIC       0x464C457F  // "\x7FELF", little endian
+#define ELF_CLASS_32    1
+#define ELF_DATA_LSB    1
+#define ELF_TYPE_EXEC   2
+#define ELF_MACHINE_386 3
+
+#define ELF_PT_LOAD     1
+
+#define ELF_PF_X        (1 << 0)
+#define ELF_PF_W        (1 << 1)
+#define ELF_PF_R        (1 << 2)
+
+// Program headers read per executable
+#define ELF_MAX_PHDRS   16
+
+typedef struct elf32_ehdr
+{
+    uint32_t magic;
+    uint8_t class;
+    uint8_t data;
+    uint8_t ident_version;
+    uint8_t ident_pad[9];
+    uint16_t type;
+    uint16_t machine;
+    uint32_t version;
+    uint32_t entry;
+    uint32_t phoff;
+    uint32_t shoff;
+    uint32_t flags;
+    uint16_t ehsize;
+    uint16_t phentsize;
+    uint16_t phnum;
+    uint16_t shentsize;
+    uint16_t shnum;
+    uint16_t shstrndx;
+} __attribute__((packed)) elf32_ehdr_t;
+
+typedef struct elf32_phdr
+{
+    uint32_t type;
+    uint32_t offset;
+    uint32_t vaddr;
+    uint32_t paddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint32_t align;
+} __attribute__((packed)) elf32_phdr_t;
+
+int elf_check_header(const elf32_ehdr_t* header, uint64_t file_size);
+int elf_check_segment(const elf32_phdr_t* phdr, uint64_t file_size, uintptr_t limit);
+int elf_load(inode_t* inode, uintptr_t limit, vma_t** vmas, uint32_t* entry);
+
+#endif //ELF_H
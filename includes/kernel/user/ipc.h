@@ -0,0 +1,56 @@
+#ifndef IPC_H
+#define IPC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kprintf.h>
+#include <uapi/ipc.h>
+#include <kernel/mm/paging.h>
+#include <kernel/sched/kthread.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/user/vma.h>
+
+#define IPC_MAX_PORTS 32
+
+struct process;
+
+// A message in flight. It lives on the sender's kernel stack, which sleeps
+// until a receiver has taken it; the frames belong to nobody meanwhile.
+typedef struct ipc_message
+{
+    uint32_t words[IPC_WORDS];
+    phys_addr_t frames[IPC_MAX_PAGES];
+    uint32_t count;
+    uint32_t sender;            // pid, 0 for a kernel thread
+    kthread_t* thread;
+    volatile uint32_t done;     // Taken or refused; the sender may return
+    int status;
+    struct ipc_message* next;
+} ipc_message_t;
+
+typedef struct ipc_port
+{
+    uint32_t id;                // Never reused, so a stale id finds nothing
+    uint32_t open;
+    struct process* owner;      // Closes the port on exit, NULL for the kernel
+    ipc_message_t* head;        // Senders waiting, oldest first
+    ipc_message_t* tail;
+    kthread_t* receiver;        // Sleeping in ipc_recv(), one at a time
+} ipc_port_t;
+
+typedef struct ipc_stats
+{
+    uint32_t messages;          // Delivered
+    uint32_t pages;             // Moved along with them
+    uint32_t refused;           // Did not fit the window, or the port closed
+} ipc_stats_t;
+
+int ipc_port_create(struct process* owner);
+void ipc_port_close(uint32_t id);
+int ipc_send(uint32_t port, const uint32_t* words, uintptr_t pages, uint32_t count);
+int ipc_recv(uint32_t port, uintptr_t window, uint32_t max, uint32_t* words, uint32_t* sender);
+void ipc_exit(struct process* process);
+void ipc_get_stats(ipc_stats_t* stats);
+
+#endif //IPC_H
@@ -0,0 +1,59 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kprintf.h>
+#include <uapi/vdso.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/cpu/gdt.h>
+#include <kernel/fs/vfs.h>
+#include <kernel/mm/heap.h>
+#include <kernel/mm/paging.h>
+#include <kernel/mm/tlb.h>
+#include <kernel/sched/kthread.h>
+#include <kernel/user/elf.h>
+#include <kernel/user/vma.h>
+#include <kernel/user/syscall.h>
+#include <kernel/user/ipc.h>
+#include <kernel/sync/spinlock.h>
+#include <kernel/sync/futex.h>
+
+// The user stack sits below the vDSO pages, with an unmapped gap in between.
+// Its pages are only backed once touched.
+#define USER_STACK_TOP  0x7FFF0000
+#define USER_STACK_SIZE 0x100000
+// Executables must load below the stack
+#define USER_IMAGE_END  (USER_STACK_TOP - USER_STACK_SIZE)
+
+#define PROCESS_NAME_MAX 16
+// Longest path a program can pass to spawn(), terminator included
+#define PROCESS_PATH_MAX 64
+
+typedef struct process
+{
+    uint32_t pid;
+    kthread_t* thread;
+    address_space_t* space;
+    uint32_t entry;
+    uint32_t arg;               // Passed to main()
+    vma_t* vmas;                // The program's memory, filled in on demand
+    int exit_code;
+    volatile uint32_t exited;   // process_wait() sleeps on it
+    struct process* parent;     // The program that spawned it, NULL if the kernel did
+    uint32_t detached;          // Its parent exited first, so nobody waits for it
+    struct process* next;       // Every process not yet waited for
+    char name[PROCESS_NAME_MAX];
+} process_t;
+
+process_t* process_spawn(const char* path, uint32_t arg);
+process_t* process_spawn_inode(inode_t* inode, const char* name, uint32_t arg);
+int process_wait(process_t* process);
+process_t* process_find_child(process_t* parent, uint32_t pid);
+process_t* process_current();
+void process_exit(int code) __attribute__((noreturn));
+void process_fault(interrupt_frame_t* frame);
+void process_page_fault(interrupt_frame_t* frame);
+
+#endif //PROCESS_H
@@ -0,0 +1,35 @@
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <kprintf.h>
+#include <uapi/syscall.h>
+#include <kernel/cpu/idt.h>
+#include <kernel/cpu/gdt.h>
+#include <kernel/mm/paging.h>
+#include <kernel/time/timer.h>
+#include <kernel/user/vdso.h>
+
+// Bytes sys_write() copies out of user memory at a time
+#define SYSCALL_WRITE_CHUNK 128
+
+typedef int32_t (*syscall_fn_t)(uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5);
+
+typedef struct syscall_stats
+{
+    uint32_t calls;             // Every entry, both paths
+    uint32_t sysenter;          // Entries through sysenter
+    uint32_t invalid;           // Unknown call numbers
+} syscall_stats_t;
+
+void syscall_init();
+int syscall_sysenter_enabled();
+void syscall_dispatch(interrupt_frame_t* frame);
+int user_access_ok(uintptr_t addr, size_t size, int write);
+void syscall_get_stats(syscall_stats_t* stats);
+
+// Drops to ring 3 at eip with the given stack and arg in eax, see entry.S
+void user_enter(uint32_t eip, uint32_t esp, uint32_t arg) __attribute__((noreturn));
+
+#endif //SYSCALL_H
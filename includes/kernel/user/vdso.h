@@ -0,0 +1,21 @@
+#ifndef VDSO_H
+#define VDSO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kprintf.h>
+#include <uapi/vdso.h>
+#include <kernel/mm/paging.h>
+#include <kernel/mm/vmalloc.h>
+#include <kernel/cpu/tsc.h>
+#include <kernel/time/timer.h>
+
+// Where sysexit resumes in the user mapping, set by vdso_init(), see entry.S
+extern uint32_t sysenter_return;
+
+void vdso_init(int sysenter);
+void vdso_map();
+const vdso_data_t* vdso_get_data();
+
+#endif //VDSO_H
@@ -0,0 +1,52 @@
+#ifndef VMA_H
+#define VMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <kprintf.h>
+#include <kernel/fs/vfs.h>
+#include <kernel/mm/heap.h>
+#include <kernel/mm/highmem.h>
+#include <kernel/mm/page_cache.h>
+#include <kernel/mm/paging.h>
+#include <kernel/mm/tlb.h>
+#include <kernel/cpu/idt.h>
+
+// A reserved range of the user address space. Nothing is mapped until the
+// program touches a page; vma_fault() then fills it in.
+typedef struct vma
+{
+    uintptr_t start;            // Page aligned
+    uintptr_t end;              // Page aligned, exclusive
+    pte_t flags;                // PG_WRITE and PG_NX as the program sees them
+    inode_t* inode;             // NULL for anonymous memory
+    uintptr_t file_start;       // [file_start, file_end) holds file data, the rest reads as zero
+    uintptr_t file_end;
+    uint64_t offset;            // File offset of file_start
+    page_t** pages;             // Page cache pages mapped in place, per page of the area
+    struct vma* next;           // Sorted by address
+} vma_t;
+
+typedef struct vma_stats
+{
+    uint32_t faults;
+    uint32_t shared;            // Mapped a page cache frame, nothing copied
+    uint32_t private;           // Filled a fresh frame: zeroes, and any partial file data
+    uint32_t cow;               // Copied a shared page on the first write
+    uint32_t detached;          // Frames taken out to move to another program
+    uint32_t attached;          // Frames moved in from another program
+} vma_stats_t;
+
+int vma_map_file(vma_t** vmas, uintptr_t start, size_t size, pte_t flags,
+                 inode_t* inode, uint64_t offset, size_t file_size);
+int vma_map_anon(vma_t** vmas, uintptr_t start, size_t size, pte_t flags);
+vma_t* vma_find(vma_t* vmas, uintptr_t addr);
+int vma_fault(vma_t* vmas, uintptr_t addr, uint32_t error);
+int vma_detach_pages(vma_t* vmas, uintptr_t addr, size_t count, phys_addr_t* frames);
+int vma_attach_pages(vma_t* vmas, uintptr_t addr, size_t count, const phys_addr_t* frames);
+void vma_unmap_all(vma_t** vmas);
+void vma_free_all(vma_t** vmas);
+void vma_get_stats(vma_stats_t* stats);
+
+#endif //VMA_H
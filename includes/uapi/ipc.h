@@ -0,0 +1,25 @@
+#ifndef UAPI_IPC_H
+#define UAPI_IPC_H
+
+// Message passing between programs. A message is IPC_WORDS words, which
+// travel in registers, and up to IPC_MAX_PAGES whole pages, which move from
+// the sender to the receiver by remapping: nothing is copied, and the
+// sender's range reads as fresh memory afterwards.
+//
+// SYS_SEND blocks until a receiver has taken the message. The pages must
+// lie in one writable area of the sender and be page aligned.
+//
+// SYS_RECV blocks until a message arrives and maps its pages at the window,
+// which must lie in one writable area of the receiver and replaces whatever
+// was there. It returns the page count in eax, the words in ebx and esi and
+// the sender's pid in edi, registers the sysenter path preserves. A message
+// with more pages than the window holds is refused: its sender gets -1 and
+// its pages back.
+//
+// Ports are global; any program that knows an id can send or receive on it.
+// A port closes when the program that created it exits.
+
+#define IPC_WORDS     2
+#define IPC_MAX_PAGES 64
+
+#endif //UAPI_IPC_H
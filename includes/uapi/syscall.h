@@ -0,0 +1,23 @@
+#ifndef UAPI_SYSCALL_H
+#define UAPI_SYSCALL_H
+
+// System call interface shared by the kernel and user programs. The call
+// number goes in eax and up to five arguments in ebx, ecx, edx, esi and edi;
+// the result comes back in eax and every other register is preserved.
+// Enter through the stub at vdso_data_t.syscall_entry, see uapi/vdso.h.
+
+#define SYSCALL_VECTOR 0x80
+
+#define SYS_EXIT   0    // exit(code), does not return
+#define SYS_WRITE  1    // write(buf, len): prints to the console, returns len or -1
+#define SYS_YIELD  2    // Lets other threads run
+#define SYS_SLEEP  3    // sleep(ms)
+#define SYS_NULL   4    // Does nothing, for measuring the cost of a round trip
+#define SYS_SPAWN  5    // spawn(path, arg): starts a program with main(arg), returns its pid or -1
+#define SYS_WAIT   6    // wait(pid): waits for a child to exit, returns its exit code or -1
+#define SYS_PORT   7    // port(): creates a message port, returns its id or -1, see uapi/ipc.h
+#define SYS_SEND   8    // send(port, word0, word1, pages, count): returns 0 once received, or -1
+#define SYS_RECV   9    // recv(port, window, max): returns the pages received or -1, see uapi/ipc.h
+#define SYS_COUNT  10
+
+#endif //UAPI_SYSCALL_H
@@ -0,0 +1,27 @@
+#ifndef UAPI_VDSO_H
+#define UAPI_VDSO_H
+
+#include <stdint.h>
+
+// Two pages the kernel maps read-only at the top of every user address
+// space: entry stubs for system calls, and the clock parameters. User code
+// reads the time with rdtsc and the data page, without entering the kernel.
+#define VDSO_TEXT_ADDR 0x7FFFE000
+#define VDSO_DATA_ADDR 0x7FFFF000
+
+#define VDSO_VERSION 1
+
+typedef struct vdso_data
+{
+    uint32_t version;
+    uint32_t syscall_entry;     // Fastest way into the kernel: sysenter if the CPU has it, int 0x80 otherwise
+    uint32_t int80_entry;       // Always int 0x80
+    uint32_t tsc_khz;           // 0 if the TSC was not calibrated
+    uint32_t hz;                // Jiffies per second
+    uint32_t tsc_per_jiffy;     // 0 if there is no clock
+    uint64_t tsc_base;          // TSC value at jiffy 0
+} vdso_data_t;
+
+#define VDSO_DATA ((const volatile vdso_data_t*)VDSO_DATA_ADDR)
+
+#endif //UAPI_VDSO_H
@@ -0,0 +1,9 @@
+#ifndef TEST_BCACHE_H
+#define TEST_BCACHE_H
+
+#include <kernel/block/bcache.h>
+#include <kprintf.h>
+
+void run_bcache_tests();
+
+#endif
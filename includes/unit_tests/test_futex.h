@@ -0,0 +1,13 @@
+#ifndef TEST_FUTEX_H
+#define TEST_FUTEX_H
+
+#include <kernel/sched/kthread.h>
+#include <kernel/sync/futex.h>
+#include <kernel/sync/mutex.h>
+#include <kernel/sync/semaphore.h>
+#include <kernel/sync/condvar.h>
+#include <kprintf.h>
+
+void run_futex_tests();
+
+#endif
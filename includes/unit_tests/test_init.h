@@ -0,0 +1,9 @@
+#ifndef TEST_INIT_H
+#define TEST_INIT_H
+
+#include <kernel/init.h>
+#include <kprintf.h>
+
+void run_init_tests();
+
+#endif
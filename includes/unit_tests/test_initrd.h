@@ -0,0 +1,9 @@
+#ifndef TEST_INITRD_H
+#define TEST_INITRD_H
+
+#include <kernel/fs/initrd.h>
+#include <kprintf.h>
+
+void run_initrd_tests();
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef TEST_MEMSTAT_H
+#define TEST_MEMSTAT_H
+
+#include <kernel/mm/memstat.h>
+#include <kprintf.h>
+
+void run_memstat_tests();
+
+#endif
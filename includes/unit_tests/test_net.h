@@ -0,0 +1,11 @@
+#ifndef TEST_NET_H
+#define TEST_NET_H
+
+#include <kernel/net/net.h>
+#include <kernel/net/netbench.h>
+#include <kernel/sched/softirq.h>
+#include <kprintf.h>
+
+void run_net_tests();
+
+#endif
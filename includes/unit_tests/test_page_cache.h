@@ -0,0 +1,9 @@
+#ifndef TEST_PAGE_CACHE_H
+#define TEST_PAGE_CACHE_H
+
+#include <kernel/mm/page_cache.h>
+#include <kprintf.h>
+
+void run_page_cache_tests();
+
+#endif
@@ -2,9 +2,12 @@
 #define TEST_PHYMEM_H
 
 #include <kernel/mm/physical_memory.h>
+#include <kernel/mm/highmem.h>
 #include <kprintf.h>
 
 void verify_physical_memory();
 void test_physical_memory_limits();
+void test_highmem_mapping();
+void test_physical_pages_aligned();
 
 #endif
\ No newline at end of file
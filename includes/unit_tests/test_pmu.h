@@ -0,0 +1,11 @@
+#ifndef TEST_PMU_H
+#define TEST_PMU_H
+
+#include <kernel/cpu/pmu.h>
+#include <kernel/trace/profile.h>
+#include <kernel/mm/heap.h>
+#include <kprintf.h>
+
+void run_pmu_tests();
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef TEST_PROFILE_H
+#define TEST_PROFILE_H
+
+#include <kernel/trace/profile.h>
+#include <kprintf.h>
+
+void run_profile_tests();
+
+#endif
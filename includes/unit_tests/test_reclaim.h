@@ -0,0 +1,9 @@
+#ifndef TEST_RECLAIM_H
+#define TEST_RECLAIM_H
+
+#include <kernel/mm/reclaim.h>
+#include <kprintf.h>
+
+void run_reclaim_tests();
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef TEST_SHELL_H
+#define TEST_SHELL_H
+
+#include <kernel/drivers/keyboard.h>
+#include <kernel/tty/ldisc.h>
+#include <kernel/tty/shell.h>
+#include <kprintf.h>
+
+void run_shell_tests();
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef TEST_SOFTIRQ_H
+#define TEST_SOFTIRQ_H
+
+#include <kernel/sched/softirq.h>
+#include <kprintf.h>
+
+void run_softirq_tests();
+
+#endif
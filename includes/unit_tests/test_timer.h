@@ -0,0 +1,9 @@
+#ifndef TEST_TIMER_H
+#define TEST_TIMER_H
+
+#include <kernel/time/timer.h>
+#include <kprintf.h>
+
+void run_timer_tests();
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef TEST_TRACE_H
+#define TEST_TRACE_H
+
+#include <kernel/trace/trace.h>
+#include <kprintf.h>
+
+void run_trace_tests();
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef TEST_USER_H
+#define TEST_USER_H
+
+#include <kernel/user/process.h>
+#include <kernel/user/elf.h>
+#include <kernel/user/syscall.h>
+#include <kernel/user/vdso.h>
+#include <kernel/user/ipc.h>
+#include <kprintf.h>
+
+void run_user_tests();
+
+#endif
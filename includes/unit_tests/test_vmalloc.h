@@ -0,0 +1,9 @@
+#ifndef TEST_VMALLOC_H
+#define TEST_VMALLOC_H
+
+#include <kernel/mm/vmalloc.h>
+#include <kprintf.h>
+
+void run_vmalloc_tests();
+
+#endif
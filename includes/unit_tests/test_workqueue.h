@@ -0,0 +1,9 @@
+#ifndef TEST_WORKQUEUE_H
+#define TEST_WORKQUEUE_H
+
+#include <kernel/sched/workqueue.h>
+#include <kprintf.h>
+
+void run_workqueue_tests();
+
+#endif
@@ -6,4 +6,24 @@
 
 void kprintf(const char* format, ...);
 
+// Message levels; messages above CONFIG_LOG_LEVEL are compiled out
+#define LOG_ERR   0
+#define LOG_WARN  1
+#define LOG_INFO  2
+#define LOG_DEBUG 3
+
+#define klog(level, ...)                 \
+    do                                   \
+    {                                    \
+        if ((level) <= CONFIG_LOG_LEVEL) \
+        {                                \
+            kprintf(__VA_ARGS__);        \
+        }                                \
+    } while (0)
+
+#define pr_err(...)   klog(LOG_ERR, __VA_ARGS__)
+#define pr_warn(...)  klog(LOG_WARN, __VA_ARGS__)
+#define pr_info(...)  klog(LOG_INFO, __VA_ARGS__)
+#define pr_debug(...) klog(LOG_DEBUG, __VA_ARGS__)
+
 #endif
\ No newline at end of file
@@ -10,6 +10,7 @@ int memcmp(const void*, const void*, size_t);
 
 size_t strlen(const char*);
 char* strcpy(char*, const char*);
+int strcmp(const char*, const char*);
 
 
 #endif //STRING_H
\ No newline at end of file
@@ -0,0 +1,11 @@
+#include <string.h>
+
+int strcmp(const char* str1, const char* str2)
+{
+    size_t i = 0;
+    while (str1[i] && str1[i] == str2[i])
+    {
+        i++;
+    }
+    return (unsigned char)str1[i] - (unsigned char)str2[i];
+}
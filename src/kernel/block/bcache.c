@@ -0,0 +1,578 @@
+#include <kernel/block/bcache.h>
+
+typedef struct bcache_shard
+{
+    spinlock_t lock;
+    buffer_t* buckets[BCACHE_BUCKETS_PER_SHARD];
+    buffer_t* lru_head;         // Most recently used
+    buffer_t* lru_tail;
+    buffer_t* spare;            // Headers whose page was given back by bcache_shrink()
+    size_t nr_buffers;
+} bcache_shard_t;
+
+// Sequential read detection for one device. Updates from several CPUs may
+// race; that only makes the window less accurate.
+typedef struct bcache_readahead
+{
+    uint64_t next;              // Block a sequential reader asks for next
+    uint64_t end;               // First block not yet read ahead
+    uint32_t window;
+} bcache_readahead_t;
+
+static bcache_shard_t bcache_shards[BCACHE_SHARDS];
+static bcache_readahead_t bcache_ra[BLK_MAX_DEVICES];
+static bcache_stats_t bcache_stats;
+
+static inline void bcache_count(uint32_t* counter, int delta)
+{
+    __atomic_fetch_add(counter, delta, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Hashes (device, block). Consecutive blocks land in different
+ *        shards, so a sequential reader spreads its lock traffic.
+ */
+static inline uint32_t bcache_hash(block_device_t* dev, uint64_t block)
+{
+    return ((uint32_t)block ^ (uint32_t)(block >> 32) ^ (dev->id << 24)) * 2654435761u;
+}
+
+static inline bcache_shard_t* bcache_shard_of(uint32_t hash)
+{
+    return &bcache_shards[hash & (BCACHE_SHARDS - 1)];
+}
+
+static inline buffer_t** bcache_bucket_of(bcache_shard_t* shard, uint32_t hash)
+{
+    return &shard->buckets[(hash / BCACHE_SHARDS) & (BCACHE_BUCKETS_PER_SHARD - 1)];
+}
+
+static inline uint64_t bcache_device_blocks(block_device_t* dev)
+{
+    return dev->sectors / BCACHE_BLOCK_SECTORS;
+}
+
+static void lru_remove(bcache_shard_t* shard, buffer_t* buf)
+{
+    if (buf->lru_prev)
+    {
+        buf->lru_prev->lru_next = buf->lru_next;
+    }
+    else
+    {
+        shard->lru_head = buf->lru_next;
+    }
+
+    if (buf->lru_next)
+    {
+        buf->lru_next->lru_prev = buf->lru_prev;
+    }
+    else
+    {
+        shard->lru_tail = buf->lru_prev;
+    }
+}
+
+static void lru_push_front(bcache_shard_t* shard, buffer_t* buf)
+{
+    buf->lru_prev = NULL;
+    buf->lru_next = shard->lru_head;
+    if (shard->lru_head)
+    {
+        shard->lru_head->lru_prev = buf;
+    }
+    else
+    {
+        shard->lru_tail = buf;
+    }
+    shard->lru_head = buf;
+}
+
+static void hash_remove(bcache_shard_t* shard, buffer_t* buf)
+{
+    buffer_t** link = bcache_bucket_of(shard, bcache_hash(buf->dev, buf->block));
+    while (*link != buf)
+    {
+        link = &(*link)->hash_next;
+    }
+    *link = buf->hash_next;
+}
+
+/**
+ * @brief Takes a new buffer while the shard is below its share of the cache.
+ *
+ * Called with the shard lock held.
+ *
+ * @return A buffer with a page but no block, or NULL if the shard is full.
+ */
+static buffer_t* bcache_alloc_buffer(bcache_shard_t* shard)
+{
+    if (shard->nr_buffers >= BCACHE_SHARD_BUFFERS)
+    {
+        return NULL;
+    }
+
+    buffer_t* buf = shard->spare;
+    if (buf != NULL)
+    {
+        shard->spare = buf->hash_next;
+    }
+    else
+    {
+        buf = (buffer_t*)kmalloc(sizeof(buffer_t));
+        if (buf == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    buf->data = (uint8_t*)vmalloc(BCACHE_BLOCK_SIZE);
+    if (buf->data == NULL)
+    {
+        buf->hash_next = shard->spare;
+        shard->spare = buf;
+        return NULL;
+    }
+    buf->phys = virt_to_phys((uintptr_t)buf->data);
+
+    shard->nr_buffers++;
+    bcache_count(&bcache_stats.buffers, 1);
+    return buf;
+}
+
+/**
+ * @brief Detaches the least recently used clean, idle buffer for reuse.
+ *
+ * Called with the shard lock held.
+ *
+ * @param dirty Receives the least recently used idle dirty buffer if no clean one exists.
+ *
+ * @return The buffer, or NULL.
+ */
+static buffer_t* bcache_evict(bcache_shard_t* shard, buffer_t** dirty)
+{
+    *dirty = NULL;
+
+    for (buffer_t* buf = shard->lru_tail; buf != NULL; buf = buf->lru_prev)
+    {
+        if (buf->refcount != 0 || (buf->flags & BUF_IO))
+        {
+            continue;
+        }
+
+        if (buf->flags & BUF_DIRTY)
+        {
+            if (*dirty == NULL)
+            {
+                *dirty = buf;
+            }
+            continue;
+        }
+
+        hash_remove(shard, buf);
+        lru_remove(shard, buf);
+        bcache_count(&bcache_stats.evictions, 1);
+        return buf;
+    }
+
+    return NULL;
+}
+
+static void bcache_end_io(bio_t* bio)
+{
+    buffer_t* buf = (buffer_t*)bio->private;
+
+    if (bio->status != BIO_OK)
+    {
+        kprintf("bcache: I/O error on %s block %d\n", buf->dev->name, (uint32_t)buf->block);
+        __atomic_or_fetch(&buf->flags, BUF_ERROR, __ATOMIC_RELAXED);
+        if (bio->write && !(__atomic_fetch_or(&buf->flags, BUF_DIRTY, __ATOMIC_RELAXED) & BUF_DIRTY))
+        {
+            bcache_count(&bcache_stats.dirty, 1);
+        }
+    }
+    else
+    {
+        __atomic_and_fetch(&buf->flags, ~BUF_ERROR, __ATOMIC_RELAXED);
+        if (!bio->write)
+        {
+            __atomic_or_fetch(&buf->flags, BUF_VALID, __ATOMIC_RELAXED);
+        }
+    }
+
+    __atomic_and_fetch(&buf->flags, ~BUF_IO, __ATOMIC_RELEASE);
+}
+
+static void bcache_submit(buffer_t* buf, int write)
+{
+    bio_t* bio = &buf->bio;
+    bio->sector = buf->block * BCACHE_BLOCK_SECTORS;
+    bio->phys = buf->phys;
+    bio->size = BCACHE_BLOCK_SIZE;
+    bio->write = write;
+    bio->end_io = bcache_end_io;
+    bio->private = buf;
+    submit_bio(buf->dev, bio);
+}
+
+/**
+ * @brief Queues a read unless the buffer is already valid or being read.
+ *
+ * @return 1 if a read was queued.
+ */
+static int bcache_start_read(buffer_t* buf)
+{
+    if (__atomic_fetch_or(&buf->flags, BUF_IO, __ATOMIC_ACQUIRE) & BUF_IO)
+    {
+        return 0;
+    }
+    if (buf->flags & BUF_VALID)
+    {
+        __atomic_and_fetch(&buf->flags, ~BUF_IO, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    bcache_submit(buf, 0);
+    return 1;
+}
+
+/**
+ * @brief Queues a write of a dirty buffer unless a transfer is already in flight.
+ *
+ * @return 1 if a write was queued.
+ */
+static int bcache_start_write(buffer_t* buf)
+{
+    if (__atomic_fetch_or(&buf->flags, BUF_IO, __ATOMIC_ACQUIRE) & BUF_IO)
+    {
+        return 0;
+    }
+    if (!(__atomic_fetch_and(&buf->flags, ~BUF_DIRTY, __ATOMIC_RELAXED) & BUF_DIRTY))
+    {
+        __atomic_and_fetch(&buf->flags, ~BUF_IO, __ATOMIC_RELEASE);
+        return 0;
+    }
+
+    bcache_count(&bcache_stats.dirty, -1);
+    bcache_count(&bcache_stats.writebacks, 1);
+    bcache_submit(buf, 1);
+    return 1;
+}
+
+static void bcache_wait(buffer_t* buf)
+{
+    while (__atomic_load_n(&buf->flags, __ATOMIC_ACQUIRE) & BUF_IO)
+    {
+        blk_poll(buf->dev);
+        cpu_relax();
+    }
+}
+
+/**
+ * @brief Finds the buffer for a block or assigns one, and takes a reference.
+ *
+ * The buffer need not hold valid data yet. When the shard is full, the
+ * least recently used idle buffer is recycled, writing it back first if
+ * it is dirty.
+ *
+ * @param wait Whether to wait for a buffer when every one in the shard is busy.
+ *
+ * @return The buffer, or NULL if none was free and `wait` is 0.
+ */
+static buffer_t* bcache_get(block_device_t* dev, uint64_t block, int wait)
+{
+    uint32_t hash = bcache_hash(dev, block);
+    bcache_shard_t* shard = bcache_shard_of(hash);
+    buffer_t** bucket = bcache_bucket_of(shard, hash);
+
+    for (;;)
+    {
+        spin_lock(&shard->lock);
+
+        for (buffer_t* buf = *bucket; buf != NULL; buf = buf->hash_next)
+        {
+            if (buf->dev == dev && buf->block == block)
+            {
+                buf->refcount++;
+                lru_remove(shard, buf);
+                lru_push_front(shard, buf);
+                spin_unlock(&shard->lock);
+                return buf;
+            }
+        }
+
+        buffer_t* dirty = NULL;
+        buffer_t* buf = bcache_alloc_buffer(shard);
+        if (buf == NULL)
+        {
+            buf = bcache_evict(shard, &dirty);
+        }
+
+        if (buf != NULL)
+        {
+            buf->dev = dev;
+            buf->block = block;
+            buf->flags = 0;
+            buf->refcount = 1;
+            buf->hash_next = *bucket;
+            *bucket = buf;
+            lru_push_front(shard, buf);
+            spin_unlock(&shard->lock);
+            return buf;
+        }
+
+        if (dirty != NULL)
+        {
+            // Write the victim back and retry; the shard may have changed meanwhile
+            dirty->refcount++;
+            spin_unlock(&shard->lock);
+            bcache_start_write(dirty);
+            blk_run_queue(dirty->dev);
+            bcache_wait(dirty);
+            brelse(dirty);
+            continue;
+        }
+
+        spin_unlock(&shard->lock);
+        if (!wait)
+        {
+            return NULL;
+        }
+        blk_poll(dev);
+        cpu_relax();
+    }
+}
+
+/**
+ * @brief Grows the read-ahead window while reads stay sequential and keeps
+ *        it ahead of the reader.
+ *
+ * Blocks are only queued here; the caller dispatches them together with its
+ * own read, so the elevator merges them into large requests.
+ */
+static void bcache_readahead(block_device_t* dev, uint64_t block)
+{
+    bcache_readahead_t* ra = &bcache_ra[dev->id];
+
+    if (block != ra->next)
+    {
+        // A random read resets the window
+        ra->window = 0;
+        ra->next = block + 1;
+        ra->end = block + 1;
+        return;
+    }
+
+    ra->next = block + 1;
+    ra->window = ra->window ? ra->window * 2 : BCACHE_READAHEAD_MIN;
+    if (ra->window > BCACHE_READAHEAD_MAX)
+    {
+        ra->window = BCACHE_READAHEAD_MAX;
+    }
+
+    // Refill once the reader has consumed half of what is already in flight
+    if (ra->end > block + ra->window / 2)
+    {
+        return;
+    }
+
+    uint64_t start = ra->end > block + 1 ? ra->end : block + 1;
+    uint64_t end = block + 1 + ra->window;
+    if (end > bcache_device_blocks(dev))
+    {
+        end = bcache_device_blocks(dev);
+    }
+
+    for (uint64_t b = start; b < end; b++)
+    {
+        buffer_t* buf = bcache_get(dev, b, 0);
+        if (buf == NULL)
+        {
+            end = b;
+            break;
+        }
+        if (bcache_start_read(buf))
+        {
+            bcache_count(&bcache_stats.readahead, 1);
+        }
+        brelse(buf);
+    }
+
+    if (end > ra->end)
+    {
+        ra->end = end;
+    }
+}
+
+/**
+ * @brief Returns a referenced buffer holding the contents of a block.
+ *
+ * Sequential reads also start reading the following blocks in the
+ * background. Release the buffer with brelse().
+ *
+ * @return The buffer, or NULL if the block is out of range or could not be read.
+ */
+buffer_t* bread(block_device_t* dev, uint64_t block)
+{
+    if (block >= bcache_device_blocks(dev))
+    {
+        return NULL;
+    }
+
+    buffer_t* buf = bcache_get(dev, block, 1);
+
+    if (buf->flags & BUF_VALID)
+    {
+        bcache_count(&bcache_stats.hits, 1);
+    }
+    else
+    {
+        bcache_count(&bcache_stats.misses, 1);
+        bcache_start_read(buf);
+    }
+
+    bcache_readahead(dev, block);
+
+    if (!(buf->flags & BUF_VALID))
+    {
+        blk_run_queue(dev);
+        bcache_wait(buf);
+    }
+
+    if (!(buf->flags & BUF_VALID))
+    {
+        brelse(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+void brelse(buffer_t* buf)
+{
+    bcache_shard_t* shard = bcache_shard_of(bcache_hash(buf->dev, buf->block));
+
+    spin_lock(&shard->lock);
+    buf->refcount--;
+    spin_unlock(&shard->lock);
+}
+
+/**
+ * @brief Marks a buffer as modified; it is written back by bsync() or when evicted.
+ *
+ * Past BCACHE_DIRTY_LIMIT dirty buffers, the device is synced right away.
+ */
+void bdirty(buffer_t* buf)
+{
+    if (__atomic_fetch_or(&buf->flags, BUF_DIRTY, __ATOMIC_RELAXED) & BUF_DIRTY)
+    {
+        return;
+    }
+
+    bcache_count(&bcache_stats.dirty, 1);
+    if (bcache_stats.dirty > BCACHE_DIRTY_LIMIT)
+    {
+        bsync(buf->dev);
+    }
+}
+
+/**
+ * @brief Writes back every dirty buffer of a device, or of all devices if `dev` is NULL.
+ *
+ * All writes are queued before any is dispatched, so runs of adjacent
+ * blocks go out as single requests.
+ *
+ * @return 0 on success, -1 if any write failed.
+ */
+int bsync(block_device_t* dev)
+{
+    buffer_t* list = NULL;
+
+    for (size_t i = 0; i < BCACHE_SHARDS; i++)
+    {
+        bcache_shard_t* shard = &bcache_shards[i];
+        spin_lock(&shard->lock);
+        for (buffer_t* buf = shard->lru_head; buf != NULL; buf = buf->lru_next)
+        {
+            if ((buf->flags & BUF_DIRTY) && (dev == NULL || buf->dev == dev))
+            {
+                buf->refcount++;
+                buf->sync_next = list;
+                list = buf;
+            }
+        }
+        spin_unlock(&shard->lock);
+    }
+
+    for (buffer_t* buf = list; buf != NULL; buf = buf->sync_next)
+    {
+        bcache_start_write(buf);
+    }
+
+    for (size_t i = 0; i < blk_device_count(); i++)
+    {
+        if (dev == NULL || blk_get_device(i) == dev)
+        {
+            blk_run_queue(blk_get_device(i));
+        }
+    }
+
+    int result = 0;
+    while (list != NULL)
+    {
+        buffer_t* buf = list;
+        list = buf->sync_next;
+
+        bcache_wait(buf);
+        if (buf->flags & BUF_ERROR)
+        {
+            result = -1;
+        }
+        brelse(buf);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Gives the pages of up to `count` clean, idle buffers back to the frame allocator.
+ *
+ * Busy shards are skipped, since reclaim can run from an allocation made
+ * under a shard lock.
+ *
+ * @return The number of buffers released.
+ */
+size_t bcache_shrink(size_t count)
+{
+    size_t freed = 0;
+
+    for (size_t i = 0; i < BCACHE_SHARDS && freed < count; i++)
+    {
+        bcache_shard_t* shard = &bcache_shards[i];
+        if (!spin_trylock(&shard->lock))
+        {
+            continue;
+        }
+
+        buffer_t* dirty;
+        buffer_t* buf;
+        while (freed < count && (buf = bcache_evict(shard, &dirty)) != NULL)
+        {
+            vfree(buf->data);
+            buf->data = NULL;
+            buf->hash_next = shard->spare;
+            shard->spare = buf;
+            shard->nr_buffers--;
+            bcache_count(&bcache_stats.buffers, -1);
+            freed++;
+        }
+
+        spin_unlock(&shard->lock);
+    }
+
+    return freed;
+}
+
+void bcache_get_stats(bcache_stats_t* stats)
+{
+    *stats = bcache_stats;
+}
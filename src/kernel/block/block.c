@@ -0,0 +1,375 @@
+#include <kernel/block/block.h>
+#include <kernel/init.h>
+
+static block_device_t* blk_devices[BLK_MAX_DEVICES];
+static size_t blk_devices_count = 0;
+
+// Devices whose interrupt reported completions, by id, reaped by blk_completion_work
+static volatile uint32_t blk_completions_pending = 0;
+static work_t blk_completion_work;
+
+/**
+ * @brief Makes a driver's device available to the rest of the kernel.
+ *
+ * The driver fills in name, sectors, max_in_flight, ops and private; the
+ * queue state is initialized here.
+ *
+ * @return The device id, or -1 if the device table is full.
+ */
+int blk_register_device(block_device_t* dev)
+{
+    if (blk_devices_count == BLK_MAX_DEVICES)
+    {
+        pr_warn("blk: too many devices, ignoring %s\n", dev->name);
+        return -1;
+    }
+
+    dev->lock = (spinlock_t)SPINLOCK_INIT;
+    dev->queue = NULL;
+    dev->free_requests = NULL;
+    dev->in_flight = 0;
+    dev->head_sector = 0;
+    memset(&dev->stats, 0, sizeof(dev->stats));
+
+    for (size_t i = 0; i < BLK_QUEUE_DEPTH; i++)
+    {
+        dev->requests[i].next = dev->free_requests;
+        dev->free_requests = &dev->requests[i];
+    }
+
+    dev->id = blk_devices_count;
+    blk_devices[blk_devices_count++] = dev;
+
+    pr_info("blk: %s registered as device %d, %d MiB\n", dev->name, dev->id, (uint32_t)(dev->sectors >> (20 - SECTOR_SHIFT)));
+    return dev->id;
+}
+
+block_device_t* blk_get_device(uint32_t id)
+{
+    return id < blk_devices_count ? blk_devices[id] : NULL;
+}
+
+size_t blk_device_count()
+{
+    return blk_devices_count;
+}
+
+/**
+ * @brief Merges a bio into a queued request it extends at either end.
+ *
+ * Called with the device lock held.
+ *
+ * @return 1 if the bio was merged, 0 otherwise.
+ */
+static int blk_try_merge(block_device_t* dev, bio_t* bio)
+{
+    uint32_t sectors = bio->size >> SECTOR_SHIFT;
+
+    for (blk_request_t* req = dev->queue; req != NULL; req = req->next)
+    {
+        if (req->write != bio->write || req->nr_bios == BLK_MAX_SEGMENTS)
+        {
+            continue;
+        }
+
+        if (req->sector + req->sectors == bio->sector)
+        {
+            req->tail->next = bio;
+            req->tail = bio;
+        }
+        else if (bio->sector + sectors == req->sector)
+        {
+            bio->next = req->bios;
+            req->bios = bio;
+            req->sector = bio->sector;
+        }
+        else
+        {
+            continue;
+        }
+
+        req->sectors += sectors;
+        req->nr_bios++;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Inserts a request into the queue, which is kept sorted by sector.
+ */
+static void blk_insert_sorted(block_device_t* dev, blk_request_t* req)
+{
+    blk_request_t** link = &dev->queue;
+    while (*link != NULL && (*link)->sector <= req->sector)
+    {
+        link = &(*link)->next;
+    }
+    req->next = *link;
+    *link = req;
+}
+
+/**
+ * @brief Queues a bio without starting it.
+ *
+ * The queue stays plugged until blk_run_queue(), so bios submitted back to
+ * back for adjacent sectors are merged into a single device command. If
+ * every request slot is taken, this polls the device until one frees up.
+ */
+void submit_bio(block_device_t* dev, bio_t* bio)
+{
+    bio->status = BIO_PENDING;
+    bio->next = NULL;
+
+    for (;;)
+    {
+        spin_lock(&dev->lock);
+
+        if (blk_try_merge(dev, bio))
+        {
+            dev->stats.bios++;
+            dev->stats.merges++;
+            spin_unlock(&dev->lock);
+            return;
+        }
+
+        blk_request_t* req = dev->free_requests;
+        if (req != NULL)
+        {
+            dev->free_requests = req->next;
+
+            req->sector = bio->sector;
+            req->sectors = bio->size >> SECTOR_SHIFT;
+            req->write = bio->write;
+            req->status = BIO_PENDING;
+            req->bios = bio;
+            req->tail = bio;
+            req->nr_bios = 1;
+            blk_insert_sorted(dev, req);
+
+            dev->stats.bios++;
+            spin_unlock(&dev->lock);
+            return;
+        }
+
+        spin_unlock(&dev->lock);
+        blk_poll(dev);
+        cpu_relax();
+    }
+}
+
+/**
+ * @brief Takes the next request in C-LOOK order: the first one at or after
+ *        the position of the last dispatch, wrapping around to the lowest sector.
+ */
+static blk_request_t* blk_pick_request(block_device_t* dev)
+{
+    blk_request_t** link = &dev->queue;
+    while (*link != NULL && (*link)->sector < dev->head_sector)
+    {
+        link = &(*link)->next;
+    }
+    if (*link == NULL)
+    {
+        link = &dev->queue;
+    }
+
+    blk_request_t* req = *link;
+    *link = req->next;
+    req->next = NULL;
+    return req;
+}
+
+/**
+ * @brief Dispatches queued requests until the device is full or the queue is empty.
+ */
+void blk_run_queue(block_device_t* dev)
+{
+    spin_lock(&dev->lock);
+
+    while (dev->queue != NULL && dev->in_flight < dev->max_in_flight)
+    {
+        blk_request_t* req = blk_pick_request(dev);
+        if (dev->ops->submit(dev, req) != 0)
+        {
+            blk_insert_sorted(dev, req);
+            break;
+        }
+
+        dev->in_flight++;
+        dev->head_sector = req->sector + req->sectors;
+        dev->stats.requests++;
+        if (req->write)
+        {
+            dev->stats.sectors_written += req->sectors;
+        }
+        else
+        {
+            dev->stats.sectors_read += req->sectors;
+        }
+    }
+
+    spin_unlock(&dev->lock);
+}
+
+/**
+ * @brief Completes every bio of a finished request and recycles the request.
+ */
+static void blk_end_request(block_device_t* dev, blk_request_t* req)
+{
+    int status = req->status == BIO_OK ? BIO_OK : BIO_ERROR;
+
+    bio_t* bio = req->bios;
+    while (bio != NULL)
+    {
+        // Once the status is set or end_io runs, the bio belongs to its owner again
+        bio_t* next = bio->next;
+        __atomic_store_n(&bio->status, status, __ATOMIC_RELEASE);
+        if (bio->end_io != NULL)
+        {
+            bio->end_io(bio);
+        }
+        bio = next;
+    }
+
+    spin_lock(&dev->lock);
+    if (status != BIO_OK)
+    {
+        dev->stats.errors++;
+    }
+    req->next = dev->free_requests;
+    dev->free_requests = req;
+    spin_unlock(&dev->lock);
+}
+
+/**
+ * @brief Reaps finished requests, completes their bios and dispatches more work.
+ *
+ * Completion callbacks run without any block layer lock held. Only one CPU
+ * reaps a device at a time; the others return immediately.
+ */
+void blk_poll(block_device_t* dev)
+{
+    if (!spin_trylock(&dev->lock))
+    {
+        return;
+    }
+
+    blk_request_t* done = NULL;
+    blk_request_t* req;
+    while ((req = dev->ops->poll(dev)) != NULL)
+    {
+        req->next = done;
+        done = req;
+        dev->in_flight--;
+    }
+
+    spin_unlock(&dev->lock);
+
+    while (done != NULL)
+    {
+        req = done;
+        done = req->next;
+        blk_end_request(dev, req);
+    }
+
+    blk_run_queue(dev);
+}
+
+/**
+ * @brief Reaps every device that interrupted since the last run, in thread context.
+ *
+ * Completion callbacks take locks that interrupted code may hold, so they
+ * never run from an interrupt or a softirq.
+ */
+static void blk_completion_fn(work_t* work)
+{
+    (void)work;
+
+    uint32_t pending = __atomic_exchange_n(&blk_completions_pending, 0, __ATOMIC_ACQ_REL);
+    for (uint32_t id = 0; pending != 0; id++, pending >>= 1)
+    {
+        if (pending & 1)
+        {
+            blk_poll(blk_devices[id]);
+        }
+    }
+}
+
+/**
+ * @brief Softirq: hands the devices that interrupted to the completion work item.
+ *
+ * However many interrupts arrived since the last run, this queues one item.
+ */
+static void blk_softirq()
+{
+    if (blk_completions_pending)
+    {
+        schedule_work(&blk_completion_work);
+    }
+}
+
+/**
+ * @brief Sets up interrupt-driven completion. Needs the workqueues.
+ */
+void blk_init()
+{
+    work_init(&blk_completion_work, blk_completion_fn);
+    open_softirq(SOFTIRQ_BLOCK, blk_softirq);
+}
+INITCALL(INIT_SUBSYS, blk_init, NULL);
+
+/**
+ * @brief Called by a driver's interrupt handler when the device finished requests.
+ *
+ * Only records the device; the requests are reaped later in a batch.
+ * Waiters in blk_wait_bio() poll as well, so completion does not depend
+ * on the interrupt arriving.
+ */
+void blk_complete_irq(block_device_t* dev)
+{
+    __atomic_or_fetch(&blk_completions_pending, 1u << dev->id, __ATOMIC_RELEASE);
+    raise_softirq(SOFTIRQ_BLOCK);
+}
+
+/**
+ * @brief Waits for a submitted bio, dispatching the queue if it is still plugged.
+ *
+ * Other kernel threads run while the device works. Only for bios without an
+ * end_io callback; a callback may recycle its bio.
+ *
+ * @return 0 on success, -1 on an I/O error.
+ */
+int blk_wait_bio(block_device_t* dev, bio_t* bio)
+{
+    blk_run_queue(dev);
+
+    while (__atomic_load_n(&bio->status, __ATOMIC_ACQUIRE) == BIO_PENDING)
+    {
+        blk_poll(dev);
+        kthread_yield();
+        cpu_relax();
+    }
+
+    return bio->status == BIO_OK ? 0 : -1;
+}
+
+/**
+ * @brief Synchronously transfers `size` bytes within one frame.
+ *
+ * @return 0 on success, -1 on an I/O error.
+ */
+int blk_rw(block_device_t* dev, uint64_t sector, phys_addr_t phys, uint32_t size, int write)
+{
+    bio_t bio;
+    bio.sector = sector;
+    bio.phys = phys;
+    bio.size = size;
+    bio.write = write;
+    bio.end_io = NULL;
+    bio.private = NULL;
+
+    submit_bio(dev, &bio);
+    return blk_wait_bio(dev, &bio);
+}
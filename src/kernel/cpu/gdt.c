@@ -0,0 +1,90 @@
+#include <kernel/cpu/gdt.h>
+
+// The descriptor table in boot.S, with an empty slot for the TSS
+extern uint64_t gdt_start[];
+
+static tss_t tss __attribute__((aligned(16)));
+static int tss_sysenter = 0;
+
+/**
+ * @brief Returns nonzero if the CPU has working sysenter and sysexit.
+ *
+ * The Pentium Pro reports SEP without implementing the instructions.
+ */
+int gdt_sysenter_supported()
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+
+    if (!(edx & CPUID_FEAT_EDX_SEP) || !(edx & CPUID_FEAT_EDX_MSR))
+    {
+        return 0;
+    }
+    return (eax & 0x0FFF3FFF) >= 0x00000633;
+}
+
+/**
+ * @brief Installs the TSS and reloads every segment register from boot.S's table.
+ *
+ * The data segment registers hold the user data selector from here on, also
+ * in ring 0. Its base and limit are the same as the kernel's, so the kernel
+ * can use it as is, and entries from user mode need not save and reload
+ * them. Only ss uses the kernel data selector.
+ */
+void gdt_init()
+{
+    memset(&tss, 0, sizeof(tss));
+    tss.ss0 = KERNEL_DS;
+    // Past the limit: no I/O permission bitmap, ring 3 has no port access
+    tss.iomap_base = sizeof(tss);
+
+    uint32_t base = (uint32_t)&tss;
+    uint32_t limit = sizeof(tss) - 1;
+    // Present, DPL 0, 32-bit available TSS, byte granular
+    gdt_start[GDT_TSS_INDEX] = (limit & 0xFFFF) | ((uint64_t)(base & 0xFFFFFF) << 16) |
+        (0x89ULL << 40) | ((uint64_t)(limit >> 16) << 48) | ((uint64_t)(base >> 24) << 56);
+
+    asm volatile(
+        "pushl %0\n"
+        "pushl $1f\n"
+        "lret\n"
+        "1:\n"
+        "movw %w1, %%ss\n"
+        "movw %w2, %%ds\n"
+        "movw %w2, %%es\n"
+        "movw %w2, %%fs\n"
+        "movw %w2, %%gs\n"
+        "ltr %w3\n"
+        : : "i"(KERNEL_CS), "r"(KERNEL_DS), "r"(USER_DS), "r"(TSS_SEL) : "memory");
+}
+
+/**
+ * @brief Points sysenter at its kernel entry. The stack is the one set by tss_set_kernel_stack().
+ */
+void tss_enable_sysenter(uintptr_t entry)
+{
+    wrmsr(MSR_SYSENTER_CS, KERNEL_CS);
+    wrmsr(MSR_SYSENTER_ESP, tss.esp0);
+    wrmsr(MSR_SYSENTER_EIP, entry);
+    tss_sysenter = 1;
+}
+
+/**
+ * @brief Sets the stack the CPU switches to when ring 3 enters the kernel.
+ *
+ * Called whenever a thread that runs user code is switched in; the MSR
+ * write is skipped when the stack did not change.
+ */
+void tss_set_kernel_stack(uint32_t top)
+{
+    if (tss.esp0 == top)
+    {
+        return;
+    }
+
+    tss.esp0 = top;
+    if (tss_sysenter)
+    {
+        wrmsr(MSR_SYSENTER_ESP, top);
+    }
+}
@@ -0,0 +1,212 @@
+#include <kernel/cpu/idt.h>
+#include <kernel/trace/trace.h>
+#include <kernel/sched/softirq.h>
+
+typedef struct idt_entry
+{
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t zero;
+    uint8_t type_attr;
+    uint16_t offset_high;
+} __attribute__((packed)) idt_entry_t;
+
+typedef struct idt_descriptor
+{
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) idt_descriptor_t;
+
+// Entry stubs in isr.S, 16 bytes each
+extern uint8_t isr_stubs[];
+#define ISR_STUB_SIZE 16
+
+static idt_entry_t idt[IDT_ENTRIES] __attribute__((aligned(8)));
+static interrupt_handler_t interrupt_handlers[IDT_ENTRIES];
+// Exceptions raised by user code go here instead of halting, see idt_set_user_exception_handler()
+static interrupt_handler_t user_exception_handler = NULL;
+
+static const char* exception_names[IDT_EXCEPTIONS] = {
+    "divide error", "debug", "NMI", "breakpoint", "overflow", "bound range", "invalid opcode",
+    "device not available", "double fault", "coprocessor segment overrun", "invalid TSS",
+    "segment not present", "stack fault", "general protection", "page fault", "reserved",
+    "x87 error", "alignment check", "machine check", "SIMD error", "virtualization",
+    "control protection",
+};
+
+static void idt_set_gate(uint8_t vector, uintptr_t handler, uint8_t type_attr)
+{
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].selector = IDT_KERNEL_CS;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = type_attr;
+    idt[vector].offset_high = handler >> 16;
+}
+
+/**
+ * @brief Moves the PIC vectors past the CPU exceptions and masks every line.
+ */
+static void pic_init()
+{
+    // ICW1: initialize, expect ICW4
+    outb(PIC1_CMD, 0x11);
+    io_wait();
+    outb(PIC2_CMD, 0x11);
+    io_wait();
+    // ICW2: vector offsets
+    outb(PIC1_DATA, PIC_VECTOR_BASE);
+    io_wait();
+    outb(PIC2_DATA, PIC_VECTOR_BASE + 8);
+    io_wait();
+    // ICW3: the slave sits on line 2 of the master
+    outb(PIC1_DATA, 0x04);
+    io_wait();
+    outb(PIC2_DATA, 0x02);
+    io_wait();
+    // ICW4: 8086 mode
+    outb(PIC1_DATA, 0x01);
+    io_wait();
+    outb(PIC2_DATA, 0x01);
+    io_wait();
+
+    // Everything masked except the cascade line
+    outb(PIC1_DATA, 0xFB);
+    outb(PIC2_DATA, 0xFF);
+}
+
+void irq_unmask(uint8_t irq)
+{
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) & ~(1 << (irq & 7)));
+}
+
+void irq_mask(uint8_t irq)
+{
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) | (1 << (irq & 7)));
+}
+
+/**
+ * @brief Fills the IDT with the entry stubs, remaps the PICs and loads the IDT.
+ *
+ * Interrupts stay disabled; the caller enables them once handlers are in place.
+ */
+void idt_init()
+{
+    for (int vector = 0; vector < IDT_ENTRIES; vector++)
+    {
+        idt_set_gate(vector, (uintptr_t)isr_stubs + vector * ISR_STUB_SIZE, IDT_GATE_INTERRUPT);
+    }
+
+    pic_init();
+
+    idt_descriptor_t descriptor = {
+        .limit = sizeof(idt) - 1,
+        .base = (uint32_t)idt,
+    };
+    asm volatile("lidt %0" : : "m"(descriptor));
+}
+
+/**
+ * @brief Points a vector at its own entry code, bypassing interrupt_dispatch(),
+ *        and lets ring 3 raise it with int.
+ *
+ * Interrupts are disabled on entry, as for every other vector.
+ */
+void idt_set_user_gate(uint8_t vector, uintptr_t entry)
+{
+    idt_set_gate(vector, entry, IDT_GATE_USER_INTERRUPT);
+}
+
+/**
+ * @brief Installs the handler for exceptions without their own handler that
+ *        were raised in ring 3. It must not return.
+ */
+void idt_set_user_exception_handler(interrupt_handler_t handler)
+{
+    user_exception_handler = handler;
+}
+
+/**
+ * @brief Installs the handler for a vector, replacing any previous one.
+ *
+ * For PIC lines the handler runs before the end of interrupt is sent; for
+ * local APIC vectors the handler acknowledges the interrupt itself.
+ */
+void idt_register_handler(uint8_t vector, interrupt_handler_t handler)
+{
+    interrupt_handlers[vector] = handler;
+}
+
+/**
+ * @brief Returns the handler installed for a vector, NULL if none, so a
+ *        driver sharing a PIC line can chain to it.
+ */
+interrupt_handler_t idt_get_handler(uint8_t vector)
+{
+    return interrupt_handlers[vector];
+}
+
+/**
+ * @brief Reports an exception and halts. For handlers that cannot resolve theirs.
+ */
+void exception_panic(interrupt_frame_t* frame)
+{
+    const char* name = frame->vector < 22 ? exception_names[frame->vector] : "reserved";
+    uint32_t cr2;
+    asm volatile("mov %%cr2, %0" : "=r"(cr2));
+
+    kprintf("Exception %d (%s), error %x at eip %x, cr2 %x\n", frame->vector, name, frame->error, frame->eip, cr2);
+    local_irq_disable();
+    for (;;)
+    {
+        asm volatile("hlt");
+    }
+}
+
+/**
+ * @brief Common C entry for every vector, called from isr.S.
+ *
+ * Softirqs raised by an interrupt handler run on the way out, after the
+ * end of interrupt, with interrupts enabled again.
+ */
+void interrupt_dispatch(interrupt_frame_t* frame)
+{
+    uint32_t vector = frame->vector;
+    interrupt_handler_t handler = interrupt_handlers[vector];
+    TRACE_EVENT(TRACE_IRQ_ENTRY, vector, frame->eip, 0, 0);
+
+    if (vector >= IDT_EXCEPTIONS)
+    {
+        irq_enter();
+    }
+
+    if (handler != NULL)
+    {
+        handler(frame);
+    }
+    else if (vector < IDT_EXCEPTIONS)
+    {
+        if (FRAME_FROM_USER(frame) && user_exception_handler != NULL)
+        {
+            user_exception_handler(frame);
+        }
+        exception_panic(frame);
+    }
+
+    if (vector >= PIC_VECTOR_BASE && vector < PIC_VECTOR_BASE + PIC_IRQS)
+    {
+        if (vector >= PIC_VECTOR_BASE + 8)
+        {
+            outb(PIC2_CMD, PIC_EOI);
+        }
+        outb(PIC1_CMD, PIC_EOI);
+    }
+
+    TRACE_EVENT(TRACE_IRQ_EXIT, vector, 0, 0, 0);
+
+    if (vector >= IDT_EXCEPTIONS)
+    {
+        irq_exit();
+    }
+}
@@ -0,0 +1,115 @@
+#include <kernel/cpu/lapic.h>
+#include <kernel/mm/paging.h>
+
+// MMIO base of the local APIC, NULL when the processor has none
+volatile uint32_t* lapic_base = NULL;
+
+static inline uint32_t lapic_read(uint32_t reg)
+{
+    return lapic_base[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value)
+{
+    lapic_base[reg / 4] = value;
+}
+
+/**
+ * @brief Detects and software-enables the local APIC of the current CPU.
+ */
+void lapic_init()
+{
+    if (!(cpuid_features_edx() & CPUID_FEAT_EDX_APIC))
+    {
+        kprintf("No local APIC present.\n");
+        return;
+    }
+
+    uintptr_t base = (uintptr_t)(rdmsr(MSR_APIC_BASE) & 0xFFFFF000);
+
+    // Only the low 4MB is identity mapped, so the register page needs its own uncached mapping
+    map_page(base, base, PG_PRESENT | PG_WRITE | PG_DISABLE_CACHE);
+    lapic_base = (volatile uint32_t*)base;
+    lapic_write(LAPIC_REG_SPURIOUS, LAPIC_SPURIOUS_ENABLE | LAPIC_SPURIOUS_VECTOR);
+
+    kprintf("Local APIC %d at %x\n", lapic_id(), (uint32_t)lapic_base);
+}
+
+int lapic_present()
+{
+    return lapic_base != NULL;
+}
+
+uint32_t lapic_id()
+{
+    return lapic_base ? lapic_read(LAPIC_REG_ID) >> 24 : 0;
+}
+
+/**
+ * @brief Signals the end of the interrupt currently being serviced.
+ */
+void lapic_eoi()
+{
+    lapic_write(LAPIC_REG_EOI, 0);
+}
+
+/**
+ * @brief Sends a fixed-delivery inter-processor interrupt.
+ *
+ * @param apic_id The local APIC ID of the target CPU.
+ * @param vector The interrupt vector to raise on the target.
+ */
+void lapic_send_ipi(uint32_t apic_id, uint8_t vector)
+{
+    while (lapic_read(LAPIC_REG_ICR_LOW) & LAPIC_ICR_PENDING)
+    {
+        cpu_relax();
+    }
+
+    lapic_write(LAPIC_REG_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_REG_ICR_LOW, vector);
+}
+
+/**
+ * @brief Programs a local vector table entry, such as LAPIC_REG_LVT_PERF.
+ *
+ * @param entry The vector, delivery bits and LAPIC_LVT_MASKED as needed.
+ */
+void lapic_set_lvt(uint32_t reg, uint32_t entry)
+{
+    if (lapic_base != NULL)
+    {
+        lapic_write(reg, entry);
+    }
+}
+
+/**
+ * @brief Starts the timer counting down once from `count`.
+ *
+ * @param entry The LVT timer entry: the vector raised at zero, or'ed with
+ *              LAPIC_LVT_MASKED to only count.
+ */
+void lapic_timer_oneshot(uint32_t entry, uint32_t count)
+{
+    if (lapic_base == NULL)
+    {
+        return;
+    }
+
+    lapic_write(LAPIC_REG_TIMER_DIVIDE, LAPIC_TIMER_DIVIDE_16);
+    lapic_write(LAPIC_REG_LVT_TIMER, entry);
+    lapic_write(LAPIC_REG_TIMER_INITIAL, count);
+}
+
+void lapic_timer_stop()
+{
+    if (lapic_base != NULL)
+    {
+        lapic_write(LAPIC_REG_TIMER_INITIAL, 0);
+    }
+}
+
+uint32_t lapic_timer_current()
+{
+    return lapic_base ? lapic_read(LAPIC_REG_TIMER_CURRENT) : 0;
+}
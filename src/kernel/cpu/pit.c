@@ -0,0 +1,44 @@
+#include <kernel/cpu/pit.h>
+
+/**
+ * @brief Makes channel 0 raise IRQ 0 periodically.
+ *
+ * The line stays as masked or unmasked as it was; the caller registers a
+ * handler and unmasks it.
+ *
+ * @param hz The rate, clamped to what the divisor can express.
+ *
+ * @return The rate actually programmed.
+ */
+uint32_t pit_set_periodic(uint32_t hz)
+{
+    if (hz < PIT_MIN_HZ)
+    {
+        hz = PIT_MIN_HZ;
+    }
+    else if (hz > PIT_FREQUENCY)
+    {
+        hz = PIT_FREQUENCY;
+    }
+
+    uint32_t divisor = PIT_FREQUENCY / hz;
+
+    // Channel 0, low then high byte, mode 2 (rate generator)
+    outb(PIT_COMMAND, 0x34);
+    outb(PIT_CHANNEL0, divisor & 0xFF);
+    outb(PIT_CHANNEL0, divisor >> 8);
+
+    return PIT_FREQUENCY / divisor;
+}
+
+/**
+ * @brief Stops periodic interrupts by switching channel 0 to a one-shot
+ *        countdown; it fires once more unless IRQ 0 is masked.
+ */
+void pit_stop()
+{
+    // Channel 0, low then high byte, mode 0 (interrupt on terminal count)
+    outb(PIT_COMMAND, 0x30);
+    outb(PIT_CHANNEL0, 0);
+    outb(PIT_CHANNEL0, 0);
+}
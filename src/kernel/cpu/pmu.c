@@ -0,0 +1,308 @@
+#include <kernel/cpu/pmu.h>
+#include <kernel/trace/trace.h>
+#include <kernel/trace/profile.h>
+#include <kernel/lib/div64.h>
+
+typedef struct pmu_event_desc
+{
+    uint8_t select;
+    uint8_t umask;
+    int8_t arch_bit;            // Bit in CPUID.0AH:EBX that is set when the event is missing, -1 if not architectural
+    const char* name;
+} pmu_event_desc_t;
+
+static const pmu_event_desc_t pmu_events[PMU_EVENT_COUNT] = {
+    [PMU_EVENT_CYCLES]           = { 0x3C, 0x00, 0, "cycles" },
+    [PMU_EVENT_INSTRUCTIONS]     = { 0xC0, 0x00, 1, "instructions" },
+    [PMU_EVENT_LLC_REFERENCES]   = { 0x2E, 0x4F, 3, "llc_references" },
+    [PMU_EVENT_LLC_MISSES]       = { 0x2E, 0x41, 4, "llc_misses" },
+    [PMU_EVENT_BRANCHES]         = { 0xC4, 0x00, 5, "branches" },
+    [PMU_EVENT_BRANCH_MISSES]    = { 0xC5, 0x00, 6, "branch_misses" },
+    // DTLB_LOAD_MISSES.MISS_CAUSES_A_WALK on Nehalem through Skylake
+    [PMU_EVENT_DTLB_LOAD_MISSES] = { 0x08, 0x01, -1, "dtlb_load_misses" },
+};
+
+static uint32_t pmu_version = 0;
+static uint32_t pmu_counters = 0;
+static uint64_t pmu_counter_mask = 0;
+static uint32_t pmu_missing_events = 0;    // CPUID.0AH:EBX, restricted to the bits it defines
+
+static volatile uint32_t pmu_sample_period = 0;
+
+static inline uint64_t rdpmc(uint32_t counter)
+{
+    uint32_t low, high;
+    asm volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(counter));
+    return ((uint64_t)high << 32) | low;
+}
+
+static uint32_t pmu_evtsel(uint32_t event)
+{
+    return pmu_events[event].select | (pmu_events[event].umask << 8) | PERFEVTSEL_OS | PERFEVTSEL_USR;
+}
+
+/**
+ * @brief Loads a counter so it overflows after `period` more events.
+ *
+ * Without full-width writes, wrmsr sign-extends bit 31 of the value into
+ * the upper counter bits, which is exactly -period for periods below 2^31.
+ */
+static void pmu_write_period(uint32_t counter, uint32_t period)
+{
+    wrmsr(MSR_PMC0 + counter, (uint32_t)-(int32_t)period);
+}
+
+static void pmu_interrupt(interrupt_frame_t* frame)
+{
+    profile_sample(frame);
+
+    pmu_write_period(0, pmu_sample_period);
+    if (pmu_version >= 2)
+    {
+        wrmsr(MSR_PERF_GLOBAL_OVF_CTRL, 1);
+    }
+
+    // Delivering a PMI sets the mask bit of the entry
+    lapic_set_lvt(LAPIC_REG_LVT_PERF, PMU_VECTOR);
+    lapic_eoi();
+}
+
+/**
+ * @brief Detects architectural performance monitoring on the boot CPU.
+ *
+ * QEMU exposes it under KVM with -cpu host; without it every other call
+ * fails or does nothing.
+ */
+void pmu_init()
+{
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (eax < CPUID_LEAF_PERFMON || !(cpuid_features_edx() & CPUID_FEAT_EDX_MSR))
+    {
+        kprintf("pmu: not supported\n");
+        return;
+    }
+
+    cpuid(CPUID_LEAF_PERFMON, &eax, &ebx, &ecx, &edx);
+    pmu_version = eax & 0xFF;
+    pmu_counters = (eax >> 8) & 0xFF;
+    uint32_t width = (eax >> 16) & 0xFF;
+    uint32_t known_events = (eax >> 24) & 0xFF;
+
+    if (pmu_version == 0 || pmu_counters == 0 || width == 0)
+    {
+        pmu_version = 0;
+        pmu_counters = 0;
+        kprintf("pmu: not supported\n");
+        return;
+    }
+
+    if (pmu_counters > PMU_MAX_COUNTERS)
+    {
+        pmu_counters = PMU_MAX_COUNTERS;
+    }
+    pmu_counter_mask = width >= 64 ? ~0ULL : (1ULL << width) - 1;
+    // Events past the length of the bit vector are not available either
+    pmu_missing_events = known_events >= 32 ? ebx : ebx | ~((1u << known_events) - 1);
+
+    idt_register_handler(PMU_VECTOR, pmu_interrupt);
+    lapic_set_lvt(LAPIC_REG_LVT_PERF, LAPIC_LVT_MASKED | PMU_VECTOR);
+
+    kprintf("pmu: version %d, %d counters of %d bits\n", pmu_version, pmu_counters, width);
+}
+
+int pmu_available()
+{
+    return pmu_version != 0;
+}
+
+uint32_t pmu_num_counters()
+{
+    return pmu_counters;
+}
+
+int pmu_event_supported(uint32_t event)
+{
+    if (!pmu_available() || event >= PMU_EVENT_COUNT)
+    {
+        return 0;
+    }
+    int bit = pmu_events[event].arch_bit;
+    return bit < 0 || !(pmu_missing_events & (1u << bit));
+}
+
+const char* pmu_event_name(uint32_t event)
+{
+    return event < PMU_EVENT_COUNT ? pmu_events[event].name : "unknown";
+}
+
+/**
+ * @brief Fills in a counter set, such as the one a benchmark measures with.
+ *
+ * @return 0 on success, -1 if an event is unsupported or there are more
+ *         events than counters.
+ */
+int pmu_set_init(pmu_set_t* set, const uint8_t* events, uint32_t count)
+{
+    if (count == 0 || count > pmu_counters)
+    {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!pmu_event_supported(events[i]))
+        {
+            return -1;
+        }
+        set->events[i] = events[i];
+        set->values[i] = 0;
+    }
+    set->count = count;
+    return 0;
+}
+
+/**
+ * @brief Zeroes and starts one counter per event of the set on the current CPU.
+ *
+ * Counter sets and overflow sampling share the counters, so only one of
+ * them runs at a time.
+ */
+void pmu_start(pmu_set_t* set)
+{
+    if (pmu_version >= 2)
+    {
+        wrmsr(MSR_PERF_GLOBAL_CTRL, 0);
+    }
+
+    for (uint32_t i = 0; i < set->count; i++)
+    {
+        wrmsr(MSR_PERFEVTSEL0 + i, 0);
+        wrmsr(MSR_PMC0 + i, 0);
+        wrmsr(MSR_PERFEVTSEL0 + i, pmu_evtsel(set->events[i]) | PERFEVTSEL_EN);
+    }
+
+    if (pmu_version >= 2)
+    {
+        wrmsr(MSR_PERF_GLOBAL_CTRL, (1u << set->count) - 1);
+    }
+}
+
+/**
+ * @brief Stops the set's counters and stores their counts in set->values.
+ */
+void pmu_stop(pmu_set_t* set)
+{
+    if (pmu_version >= 2)
+    {
+        wrmsr(MSR_PERF_GLOBAL_CTRL, 0);
+    }
+
+    for (uint32_t i = 0; i < set->count; i++)
+    {
+        set->values[i] = pmu_read(i);
+        wrmsr(MSR_PERFEVTSEL0 + i, 0);
+    }
+}
+
+/**
+ * @brief Reads a general-purpose counter without stopping it.
+ */
+uint64_t pmu_read(uint32_t counter)
+{
+    return rdpmc(counter) & pmu_counter_mask;
+}
+
+/**
+ * @brief Prints a stopped set as a "pmu <label> event=count ..." line.
+ *
+ * Counts too large for kprintf's %d are printed in thousands with a K
+ * suffix, or in millions with an M suffix.
+ */
+void pmu_print(const pmu_set_t* set, const char* label)
+{
+    kprintf("pmu %s", label);
+    for (uint32_t i = 0; i < set->count; i++)
+    {
+        uint64_t value = set->values[i];
+        const char* suffix = "";
+        if (value >> 31)
+        {
+            value = div64_u32(value, 1000);
+            suffix = "K";
+        }
+        if (value >> 31)
+        {
+            value = div64_u32(value, 1000);
+            suffix = "M";
+        }
+        kprintf(" %s=%d%s", pmu_event_name(set->events[i]), (uint32_t)value, suffix);
+    }
+    kprintf("\n");
+}
+
+/**
+ * @brief Writes the first three counts of a stopped set to the trace, as a TRACE_PMU record.
+ */
+void pmu_trace(const pmu_set_t* set)
+{
+    uint32_t events = set->count;
+    uint32_t values[3] = { 0, 0, 0 };
+    for (uint32_t i = 0; i < set->count && i < 3; i++)
+    {
+        events |= (uint32_t)set->events[i] << (8 * (i + 1));
+        values[i] = (uint32_t)set->values[i];
+    }
+
+    TRACE_EVENT(TRACE_PMU, events, values[0], values[1], values[2]);
+}
+
+/**
+ * @brief Samples the current CPU every `period` occurrences of an event.
+ *
+ * Each counter overflow records a sample into the profiler's buffers,
+ * replacing earlier samples; dump them with profile_dump_serial().
+ *
+ * @return 0 on success, -1 if the event or the overflow interrupt is unavailable.
+ */
+int pmu_sample_start(uint32_t event, uint32_t period)
+{
+    if (!pmu_event_supported(event) || !lapic_present() || period == 0 || period >= 0x80000000)
+    {
+        return -1;
+    }
+
+    profile_reset();
+    pmu_sample_period = period;
+
+    if (pmu_version >= 2)
+    {
+        wrmsr(MSR_PERF_GLOBAL_CTRL, 0);
+    }
+    wrmsr(MSR_PERFEVTSEL0, 0);
+    pmu_write_period(0, period);
+    lapic_set_lvt(LAPIC_REG_LVT_PERF, PMU_VECTOR);
+    wrmsr(MSR_PERFEVTSEL0, pmu_evtsel(event) | PERFEVTSEL_INT | PERFEVTSEL_EN);
+    if (pmu_version >= 2)
+    {
+        wrmsr(MSR_PERF_GLOBAL_CTRL, 1);
+    }
+
+    return 0;
+}
+
+void pmu_sample_stop()
+{
+    if (!pmu_available())
+    {
+        return;
+    }
+
+    wrmsr(MSR_PERFEVTSEL0, 0);
+    if (pmu_version >= 2)
+    {
+        wrmsr(MSR_PERF_GLOBAL_CTRL, 0);
+        wrmsr(MSR_PERF_GLOBAL_OVF_CTRL, 1);
+    }
+    lapic_set_lvt(LAPIC_REG_LVT_PERF, LAPIC_LVT_MASKED | PMU_VECTOR);
+}
@@ -0,0 +1,62 @@
+#include <kernel/cpu/smp.h>
+
+// Bit n is set once CPU n is running kernel code
+volatile uint32_t cpu_online_mask = 0;
+// Local APIC ID of each logical CPU, used to address IPIs
+uint32_t cpu_apic_ids[MAX_CPUS];
+
+/**
+ * @brief Brings up the SMP bookkeeping for the boot processor.
+ *
+ * The BSP is always logical CPU 0. Application processors register
+ * themselves with smp_cpu_online() once they are started.
+ */
+void smp_init()
+{
+    lapic_init();
+    smp_cpu_online(0, lapic_id());
+}
+
+/**
+ * @brief Marks a logical CPU as online.
+ *
+ * @param cpu The logical CPU number.
+ * @param apic_id The local APIC ID of that CPU.
+ */
+void smp_cpu_online(uint32_t cpu, uint32_t apic_id)
+{
+    cpu_apic_ids[cpu] = apic_id;
+    __atomic_or_fetch(&cpu_online_mask, 1 << cpu, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Returns the logical number of the executing CPU.
+ */
+uint32_t smp_processor_id()
+{
+    // With only the BSP online there is no need to touch the APIC
+    if (cpu_online_mask <= 1)
+    {
+        return 0;
+    }
+
+    uint32_t apic_id = lapic_id();
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        if ((cpu_online_mask & (1 << cpu)) && cpu_apic_ids[cpu] == apic_id)
+        {
+            return cpu;
+        }
+    }
+    return 0;
+}
+
+uint32_t smp_num_online()
+{
+    uint32_t count = 0;
+    for (uint32_t mask = cpu_online_mask; mask; mask &= mask - 1)
+    {
+        count++;
+    }
+    return count;
+}
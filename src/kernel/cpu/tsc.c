@@ -0,0 +1,90 @@
+#include <kernel/cpu/tsc.h>
+
+// TSC ticks per millisecond, 0 if the TSC is missing or calibration failed
+uint32_t tsc_khz = 0;
+
+// TSC when the PIT countdown of tsc_calibrate_start() began, 0 before that
+static uint64_t tsc_calibrate_tsc = 0;
+
+/**
+ * @brief Starts the calibration window: a full countdown of PIT channel 2.
+ *
+ * Called first thing at boot, so the window runs while the rest of early
+ * boot does; tsc_init() then only waits if less than TSC_CALIBRATE_MS
+ * have passed.
+ */
+void tsc_calibrate_start()
+{
+    if (!(cpuid_features_edx() & CPUID_FEAT_EDX_TSC))
+    {
+        return;
+    }
+
+    // Gate channel 2 on with the speaker off, then start mode 0 (interrupt on terminal count) from 65536
+    outb(PIT_GATE_PORT, (inb(PIT_GATE_PORT) & ~PIT_SPEAKER_ENABLE) | PIT_GATE_ENABLE);
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CHANNEL2, 0);
+    outb(PIT_CHANNEL2, 0);
+    tsc_calibrate_tsc = rdtsc();
+}
+
+/**
+ * @brief Returns the PIT ticks since tsc_calibrate_start(), or -1 once the countdown ran out.
+ */
+static int32_t tsc_calibrate_ticks()
+{
+    // Once the output is high the count has wrapped around and no longer tells the time
+    outb(PIT_COMMAND, 0x80);
+    uint8_t low = inb(PIT_CHANNEL2);
+    uint8_t high = inb(PIT_CHANNEL2);
+    if (inb(PIT_GATE_PORT) & PIT_GATE_OUTPUT)
+    {
+        return -1;
+    }
+    return (0x10000 - ((uint32_t)high << 8 | low)) & 0xFFFF;
+}
+
+/**
+ * @brief Measures the TSC frequency against the PIT countdown started by tsc_calibrate_start().
+ *
+ * Starts the countdown itself if nobody did, and again if it already ran
+ * out, which takes 55 ms.
+ */
+void tsc_init()
+{
+    if (!(cpuid_features_edx() & CPUID_FEAT_EDX_TSC))
+    {
+        kprintf("tsc: not supported\n");
+        return;
+    }
+    if (tsc_calibrate_tsc == 0)
+    {
+        tsc_calibrate_start();
+    }
+
+    uint32_t min_ticks = PIT_FREQUENCY / (1000 / TSC_CALIBRATE_MS);
+    uint32_t polls = 0;
+    for (;;)
+    {
+        uint64_t end = rdtsc();
+        int32_t ticks = tsc_calibrate_ticks();
+        if (ticks < 0)
+        {
+            tsc_calibrate_start();
+        }
+        else if ((uint32_t)ticks >= min_ticks)
+        {
+            // At most 55 ms of cycles times the PIT frequency, well inside 64 bits
+            tsc_khz = (uint32_t)div64_u32((end - tsc_calibrate_tsc) * PIT_FREQUENCY, (uint32_t)ticks * 1000);
+            break;
+        }
+
+        // No PIT: give up rather than spin forever
+        if (++polls == 0x10000000)
+        {
+            kprintf("tsc: calibration timed out\n");
+            return;
+        }
+    }
+    kprintf("tsc: %d kHz\n", tsc_khz);
+}
@@ -0,0 +1,249 @@
+#include <kernel/drivers/ata.h>
+#include <kernel/init.h>
+
+static int ata_submit(block_device_t* dev, blk_request_t* req);
+static blk_request_t* ata_poll(block_device_t* dev);
+
+static const block_device_ops_t ata_ops = {
+    .submit = ata_submit,
+    .poll = ata_poll,
+};
+
+/**
+ * @brief Waits for BSY to clear and, if asked, for DRQ to be set.
+ *
+ * @return 0 when the drive is ready, -1 on an error or a timeout.
+ */
+static int ata_wait(ata_drive_t* drive, int need_drq)
+{
+    for (uint32_t i = 0; i < ATA_TIMEOUT; i++)
+    {
+        uint8_t status = inb(drive->io_base + ATA_REG_STATUS);
+        if (status & ATA_SR_BSY)
+        {
+            continue;
+        }
+        if (status & (ATA_SR_ERR | ATA_SR_DF))
+        {
+            return -1;
+        }
+        if (!need_drq || (status & ATA_SR_DRQ))
+        {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Loads the task file with the address and sector count, and issues a command.
+ */
+static void ata_issue(ata_drive_t* drive, uint64_t lba, uint32_t count, uint8_t command, uint8_t command_ext)
+{
+    uint16_t io = drive->io_base;
+
+    if (drive->lba48)
+    {
+        outb(io + ATA_REG_DRIVE, 0x40);
+        // High order bytes first, then the low order bytes
+        outb(io + ATA_REG_SECCOUNT, count >> 8);
+        outb(io + ATA_REG_LBA0, lba >> 24);
+        outb(io + ATA_REG_LBA1, lba >> 32);
+        outb(io + ATA_REG_LBA2, lba >> 40);
+        outb(io + ATA_REG_SECCOUNT, count);
+        outb(io + ATA_REG_LBA0, lba);
+        outb(io + ATA_REG_LBA1, lba >> 8);
+        outb(io + ATA_REG_LBA2, lba >> 16);
+        outb(io + ATA_REG_COMMAND, command_ext);
+    }
+    else
+    {
+        outb(io + ATA_REG_DRIVE, 0xE0 | ((lba >> 24) & 0x0F));
+        // A count of 0 means 256 sectors
+        outb(io + ATA_REG_SECCOUNT, count);
+        outb(io + ATA_REG_LBA0, lba);
+        outb(io + ATA_REG_LBA1, lba >> 8);
+        outb(io + ATA_REG_LBA2, lba >> 16);
+        outb(io + ATA_REG_COMMAND, command);
+    }
+}
+
+/**
+ * @brief Moves the sectors of one bio through the data port.
+ */
+static int ata_transfer_bio(ata_drive_t* drive, bio_t* bio, int write)
+{
+    uint32_t offset = bio->phys & (PAGE_SIZE - 1);
+    uint8_t* page = (uint8_t*)kmap_atomic(bio->phys - offset);
+    if (page == NULL)
+    {
+        return -1;
+    }
+
+    int result = 0;
+    for (uint32_t done = 0; done < bio->size; done += SECTOR_SIZE)
+    {
+        if (ata_wait(drive, 1) != 0)
+        {
+            result = -1;
+            break;
+        }
+
+        if (write)
+        {
+            outsw(drive->io_base + ATA_REG_DATA, page + offset + done, SECTOR_SIZE / 2);
+        }
+        else
+        {
+            insw(drive->io_base + ATA_REG_DATA, page + offset + done, SECTOR_SIZE / 2);
+        }
+    }
+
+    kunmap_atomic(page);
+    return result;
+}
+
+/**
+ * @brief Runs a whole request with programmed I/O.
+ *
+ * The transfer finishes before this returns; the request is handed back on
+ * the next poll so completion looks the same as on queued hardware.
+ */
+static int ata_submit(block_device_t* dev, blk_request_t* req)
+{
+    ata_drive_t* drive = (ata_drive_t*)dev->private;
+    int result = 0;
+
+    ata_issue(drive, req->sector, req->sectors, req->write ? ATA_CMD_WRITE_PIO : ATA_CMD_READ_PIO,
+        req->write ? ATA_CMD_WRITE_PIO_EXT : ATA_CMD_READ_PIO_EXT);
+
+    for (bio_t* bio = req->bios; bio != NULL && result == 0; bio = bio->next)
+    {
+        result = ata_transfer_bio(drive, bio, req->write);
+    }
+
+    if (result == 0 && req->write)
+    {
+        outb(drive->io_base + ATA_REG_COMMAND, drive->lba48 ? ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH);
+        result = ata_wait(drive, 0);
+    }
+
+    req->status = result == 0 ? BIO_OK : BIO_ERROR;
+    req->next = drive->done;
+    drive->done = req;
+    return 0;
+}
+
+static blk_request_t* ata_poll(block_device_t* dev)
+{
+    ata_drive_t* drive = (ata_drive_t*)dev->private;
+
+    blk_request_t* req = drive->done;
+    if (req != NULL)
+    {
+        drive->done = req->next;
+    }
+    return req;
+}
+
+/**
+ * @brief Identifies the master drive on the primary channel.
+ *
+ * @return 0 if an ATA disk answered, -1 for no drive, a floating bus or an ATAPI device.
+ */
+static int ata_identify(ata_drive_t* drive, uint16_t* identify)
+{
+    uint16_t io = drive->io_base;
+
+    if (inb(io + ATA_REG_STATUS) == 0xFF)
+    {
+        return -1;
+    }
+
+    outb(io + ATA_REG_DRIVE, 0xA0);
+    outb(io + ATA_REG_SECCOUNT, 0);
+    outb(io + ATA_REG_LBA0, 0);
+    outb(io + ATA_REG_LBA1, 0);
+    outb(io + ATA_REG_LBA2, 0);
+    outb(io + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+
+    if (inb(io + ATA_REG_STATUS) == 0)
+    {
+        return -1;
+    }
+
+    // ATAPI and SATA devices abort IDENTIFY and leave a signature in the LBA registers
+    for (uint32_t i = 0; i < ATA_TIMEOUT && (inb(io + ATA_REG_STATUS) & ATA_SR_BSY); i++)
+    {
+    }
+    if (inb(io + ATA_REG_LBA1) != 0 || inb(io + ATA_REG_LBA2) != 0)
+    {
+        return -1;
+    }
+
+    if (ata_wait(drive, 1) != 0)
+    {
+        return -1;
+    }
+    insw(io + ATA_REG_DATA, identify, 256);
+    return 0;
+}
+
+/**
+ * @brief Registers the primary master disk, used when there is no virtio-blk device.
+ *
+ * Transfers use polled PIO, one command per merged request.
+ */
+void ata_init()
+{
+    ata_drive_t* drive = (ata_drive_t*)kmalloc(sizeof(ata_drive_t));
+    if (drive == NULL)
+    {
+        return;
+    }
+
+    drive->io_base = ATA_PRIMARY_IO;
+    drive->ctrl_base = ATA_PRIMARY_CTRL;
+    drive->done = NULL;
+
+    // Disable the drive interrupt; completion is polled
+    outb(drive->ctrl_base, 0x02);
+
+    uint16_t identify[256];
+    if (ata_identify(drive, identify) != 0)
+    {
+        kfree(drive);
+        return;
+    }
+
+    // Word 83 bit 10: 48-bit addressing; words 100-103 and 60-61 hold the sector counts
+    drive->lba48 = (identify[83] & (1 << 10)) != 0;
+    if (drive->lba48)
+    {
+        drive->dev.sectors = (uint64_t)identify[100] | ((uint64_t)identify[101] << 16) |
+            ((uint64_t)identify[102] << 32) | ((uint64_t)identify[103] << 48);
+    }
+    else
+    {
+        drive->dev.sectors = (uint32_t)identify[60] | ((uint32_t)identify[61] << 16);
+    }
+
+    drive->dev.name = "ata0";
+    drive->dev.max_in_flight = 1;
+    drive->dev.ops = &ata_ops;
+    drive->dev.private = drive;
+
+    blk_register_device(&drive->dev);
+}
+
+/**
+ * @brief Falls back to the legacy disk when no virtio-blk device was found.
+ */
+static void ata_probe()
+{
+    if (blk_device_count() == 0)
+    {
+        ata_init();
+    }
+}
+INITCALL(INIT_DEVICE, ata_probe, "virtio_blk_init");
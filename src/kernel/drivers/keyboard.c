@@ -0,0 +1,287 @@
+#include <kernel/drivers/keyboard.h>
+#include <kernel/init.h>
+
+static int keyboard_ready = 0;
+
+// Written only by the interrupt (head) and only by the reader (tail), so
+// neither side takes a lock; the indexes run freely and wrap on overflow
+static uint8_t keyboard_ring[KEYBOARD_RING_SIZE];
+static uint32_t keyboard_head = 0;
+static uint32_t keyboard_tail = 0;
+static keyboard_stats_t keyboard_stats;
+
+// Decoder state, only touched by the reader
+static int keyboard_shift = 0;
+static int keyboard_ctrl = 0;
+static int keyboard_caps = 0;
+static int keyboard_extended = 0;
+
+// Scancode set 1 to ASCII on a US layout, up to the space bar; 0 for keys without a character
+static const char keyboard_keymap[] =
+    "\0\033" "1234567890-=\b"
+    "\tqwertyuiop[]\n"
+    "\0" "asdfghjkl;'`"
+    "\0" "\\zxcvbnm,./\0"
+    "*\0 ";
+
+static const char keyboard_keymap_shift[] =
+    "\0\033" "!@#$%^&*()_+\b"
+    "\tQWERTYUIOP{}\n"
+    "\0" "ASDFGHJKL:\"~"
+    "\0" "|ZXCVBNM<>?\0"
+    "*\0 ";
+
+// From KEYBOARD_SC_KEYPAD on, read as digits whatever the num lock state
+static const char keyboard_keypad[] = "789-456+1230.";
+
+/**
+ * @brief Waits until the controller has a byte for us (`mask` OUTPUT) or
+ *        takes one from us (`mask` INPUT, `set` 0).
+ *
+ * @return 0 once ready, -1 on timeout.
+ */
+static int keyboard_wait(uint8_t mask, int set)
+{
+    for (uint32_t i = 0; i < KEYBOARD_TIMEOUT; i++)
+    {
+        if (((inb(KEYBOARD_STATUS) & mask) != 0) == set)
+        {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int keyboard_command(uint8_t command)
+{
+    if (keyboard_wait(KEYBOARD_STATUS_INPUT, 0) != 0)
+    {
+        return -1;
+    }
+    outb(KEYBOARD_STATUS, command);
+    return 0;
+}
+
+/**
+ * @brief Queues a scancode for keyboard_getc(). Called from the interrupt.
+ *
+ * When the reader falls behind, new scancodes are dropped rather than old
+ * ones overwritten, so the ring never holds half of a key sequence.
+ */
+void keyboard_push(uint8_t scancode)
+{
+    uint32_t head = __atomic_load_n(&keyboard_head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&keyboard_tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail == KEYBOARD_RING_SIZE)
+    {
+        keyboard_stats.dropped++;
+        return;
+    }
+
+    keyboard_ring[head & (KEYBOARD_RING_SIZE - 1)] = scancode;
+    __atomic_store_n(&keyboard_head, head + 1, __ATOMIC_RELEASE);
+    keyboard_stats.scancodes++;
+}
+
+/**
+ * @brief Takes the oldest queued scancode.
+ *
+ * @return The scancode, or -1 if the ring is empty.
+ */
+static int keyboard_pop()
+{
+    uint32_t tail = __atomic_load_n(&keyboard_tail, __ATOMIC_RELAXED);
+    if (tail == __atomic_load_n(&keyboard_head, __ATOMIC_ACQUIRE))
+    {
+        return -1;
+    }
+
+    uint8_t scancode = keyboard_ring[tail & (KEYBOARD_RING_SIZE - 1)];
+    __atomic_store_n(&keyboard_tail, tail + 1, __ATOMIC_RELEASE);
+    return scancode;
+}
+
+static void keyboard_interrupt(interrupt_frame_t* frame)
+{
+    (void)frame;
+    // Only the byte is taken here; translating it is left to the reader
+    if (inb(KEYBOARD_STATUS) & KEYBOARD_STATUS_OUTPUT)
+    {
+        keyboard_push(inb(KEYBOARD_DATA));
+    }
+}
+
+/**
+ * @brief Turns a scancode into a character, tracking shift, ctrl and caps lock.
+ *
+ * Of the extended keys only the keypad enter and slash produce a
+ * character; the others, and every release, are consumed silently.
+ *
+ * @return The character, or -1 if the scancode does not complete one.
+ */
+static int keyboard_decode(uint8_t scancode)
+{
+    if (scancode == KEYBOARD_SC_EXTENDED)
+    {
+        keyboard_extended = 1;
+        return -1;
+    }
+
+    int extended = keyboard_extended;
+    int release = (scancode & KEYBOARD_SC_RELEASE) != 0;
+    uint8_t code = scancode & ~KEYBOARD_SC_RELEASE;
+    keyboard_extended = 0;
+
+    switch (code)
+    {
+    case KEYBOARD_SC_LSHIFT:
+    case KEYBOARD_SC_RSHIFT:
+        // Extended shifts are fake ones sent around print screen and the arrows
+        if (!extended)
+        {
+            keyboard_shift = !release;
+        }
+        return -1;
+    case KEYBOARD_SC_LCTRL:
+        keyboard_ctrl = !release;
+        return -1;
+    case KEYBOARD_SC_CAPSLOCK:
+        if (!release)
+        {
+            keyboard_caps = !keyboard_caps;
+        }
+        return -1;
+    }
+
+    if (release)
+    {
+        return -1;
+    }
+    if (extended)
+    {
+        return code == KEYBOARD_SC_ENTER ? '\n' : code == KEYBOARD_SC_SLASH ? '/' : -1;
+    }
+    if (code >= KEYBOARD_SC_KEYPAD && code < KEYBOARD_SC_KEYPAD + sizeof(keyboard_keypad) - 1)
+    {
+        return keyboard_keypad[code - KEYBOARD_SC_KEYPAD];
+    }
+    if (code >= sizeof(keyboard_keymap) - 1)
+    {
+        return -1;
+    }
+
+    char c = keyboard_shift ? keyboard_keymap_shift[code] : keyboard_keymap[code];
+    int letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    if (c == '\0')
+    {
+        return -1;
+    }
+    if (letter && keyboard_caps)
+    {
+        c ^= 'a' - 'A';
+    }
+    if (letter && keyboard_ctrl)
+    {
+        c &= 0x1F;
+    }
+    return c;
+}
+
+/**
+ * @brief Reads a typed character without waiting.
+ *
+ * Decodes queued scancodes until one completes a character; must only be
+ * called from one thread at a time.
+ *
+ * @return The character, or -1 if none is pending.
+ */
+int keyboard_getc()
+{
+    int scancode;
+    while ((scancode = keyboard_pop()) != -1)
+    {
+        int c = keyboard_decode((uint8_t)scancode);
+        if (c != -1)
+        {
+            return c;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Returns nonzero if scancodes are waiting to be decoded.
+ */
+int keyboard_pending()
+{
+    return __atomic_load_n(&keyboard_tail, __ATOMIC_RELAXED) != __atomic_load_n(&keyboard_head, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Drops queued scancodes and forgets held modifiers.
+ */
+void keyboard_reset()
+{
+    while (keyboard_pop() != -1)
+    {
+    }
+    keyboard_shift = 0;
+    keyboard_ctrl = 0;
+    keyboard_caps = 0;
+    keyboard_extended = 0;
+}
+
+int keyboard_present()
+{
+    return keyboard_ready;
+}
+
+void keyboard_get_stats(keyboard_stats_t* stats)
+{
+    *stats = keyboard_stats;
+}
+
+/**
+ * @brief Enables the first PS/2 port with translation to set 1 and IRQ 1.
+ *
+ * Without an 8042 the status port reads as all ones, and the keyboard
+ * stays off; input then only comes from the serial port.
+ */
+void keyboard_init()
+{
+    if (inb(KEYBOARD_STATUS) == 0xFF)
+    {
+        pr_info("keyboard: no PS/2 controller\n");
+        return;
+    }
+
+    // Whatever the firmware left in the output buffer would be read as a key
+    for (uint32_t i = 0; i < KEYBOARD_RING_SIZE && (inb(KEYBOARD_STATUS) & KEYBOARD_STATUS_OUTPUT); i++)
+    {
+        inb(KEYBOARD_DATA);
+    }
+
+    if (keyboard_command(KEYBOARD_CMD_READ_CONFIG) != 0 || keyboard_wait(KEYBOARD_STATUS_OUTPUT, 1) != 0)
+    {
+        pr_warn("keyboard: the controller does not answer\n");
+        return;
+    }
+    uint8_t config = inb(KEYBOARD_DATA);
+    config |= KEYBOARD_CONFIG_IRQ1 | KEYBOARD_CONFIG_TRANSLATE;
+    config &= ~KEYBOARD_CONFIG_CLOCK_OFF;
+
+    if (keyboard_command(KEYBOARD_CMD_WRITE_CONFIG) != 0 || keyboard_wait(KEYBOARD_STATUS_INPUT, 0) != 0)
+    {
+        pr_warn("keyboard: the controller does not answer\n");
+        return;
+    }
+    outb(KEYBOARD_DATA, config);
+    keyboard_command(KEYBOARD_CMD_ENABLE_PORT1);
+
+    idt_register_handler(IRQ_VECTOR(KEYBOARD_IRQ), keyboard_interrupt);
+    irq_unmask(KEYBOARD_IRQ);
+    keyboard_ready = 1;
+    pr_info("keyboard: PS/2 on IRQ %d\n", KEYBOARD_IRQ);
+}
+INITCALL(INIT_DEVICE, keyboard_init, NULL);
@@ -0,0 +1,196 @@
+#include <kernel/drivers/pci.h>
+#include <kernel/init.h>
+
+static pci_device_t pci_devices[PCI_MAX_DEVICES];
+static size_t pci_device_count = 0;
+
+static uint32_t pci_address(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset)
+{
+    return (1u << 31) | ((uint32_t)bus << 16) | ((uint32_t)slot << 11) | ((uint32_t)func << 8) | (offset & 0xFC);
+}
+
+static uint32_t pci_read(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset)
+{
+    outl(PCI_CONFIG_ADDRESS, pci_address(bus, slot, func, offset));
+    return inl(PCI_CONFIG_DATA);
+}
+
+uint32_t pci_config_read32(const pci_device_t* dev, uint8_t offset)
+{
+    return pci_read(dev->bus, dev->slot, dev->func, offset);
+}
+
+uint16_t pci_config_read16(const pci_device_t* dev, uint8_t offset)
+{
+    return pci_config_read32(dev, offset) >> ((offset & 2) * 8);
+}
+
+void pci_config_write32(const pci_device_t* dev, uint8_t offset, uint32_t value)
+{
+    outl(PCI_CONFIG_ADDRESS, pci_address(dev->bus, dev->slot, dev->func, offset));
+    outl(PCI_CONFIG_DATA, value);
+}
+
+void pci_config_write16(const pci_device_t* dev, uint8_t offset, uint16_t value)
+{
+    uint32_t shift = (offset & 2) * 8;
+    uint32_t dword = pci_config_read32(dev, offset);
+    dword = (dword & ~(0xFFFFu << shift)) | ((uint32_t)value << shift);
+    pci_config_write32(dev, offset, dword);
+}
+
+/**
+ * @brief Records the function at bus/slot/func if it exists.
+ *
+ * @return 1 if a function responded, 0 otherwise.
+ */
+static int pci_probe_function(uint8_t bus, uint8_t slot, uint8_t func)
+{
+    uint32_t id = pci_read(bus, slot, func, PCI_VENDOR_ID);
+    if ((id & 0xFFFF) == 0xFFFF)
+    {
+        return 0;
+    }
+
+    if (pci_device_count == PCI_MAX_DEVICES)
+    {
+        return 1;
+    }
+
+    pci_device_t* dev = &pci_devices[pci_device_count++];
+    dev->bus = bus;
+    dev->slot = slot;
+    dev->func = func;
+    dev->vendor_id = id & 0xFFFF;
+    dev->device_id = id >> 16;
+
+    uint32_t class_reg = pci_config_read32(dev, PCI_REVISION);
+    dev->class_code = class_reg >> 24;
+    dev->subclass = class_reg >> 16;
+    dev->prog_if = class_reg >> 8;
+    dev->subsystem_id = pci_config_read16(dev, PCI_SUBSYSTEM_ID);
+    dev->irq_line = pci_config_read32(dev, PCI_INTERRUPT_LINE) & 0xFF;
+
+    for (int i = 0; i < 6; i++)
+    {
+        dev->bar[i] = pci_config_read32(dev, PCI_BAR0 + i * 4);
+    }
+
+    kprintf("pci: %d:%d.%d %x:%x class %x:%x\n", bus, slot, func, dev->vendor_id, dev->device_id, dev->class_code, dev->subclass);
+    return 1;
+}
+
+static void pci_scan_bus(uint8_t bus);
+
+/**
+ * @brief Records a function, and scans the bus behind it if it is a PCI-to-PCI bridge.
+ *
+ * @return 1 if a function responded, 0 otherwise.
+ */
+static int pci_scan_function(uint8_t bus, uint8_t slot, uint8_t func)
+{
+    if (!pci_probe_function(bus, slot, func))
+    {
+        return 0;
+    }
+
+    uint8_t header_type = pci_read(bus, slot, func, PCI_HEADER_TYPE & 0xFC) >> 16;
+    if ((header_type & ~PCI_HEADER_MULTIFUNCTION) == PCI_HEADER_BRIDGE)
+    {
+        uint8_t secondary = pci_read(bus, slot, func, PCI_SECONDARY_BUS & 0xFC) >> 8;
+        if (secondary > bus)
+        {
+            pci_scan_bus(secondary);
+        }
+    }
+    return 1;
+}
+
+static void pci_scan_bus(uint8_t bus)
+{
+    for (uint8_t slot = 0; slot < 32; slot++)
+    {
+        if (!pci_scan_function(bus, slot, 0))
+        {
+            continue;
+        }
+
+        uint8_t header_type = pci_read(bus, slot, 0, PCI_HEADER_TYPE & 0xFC) >> 16;
+        if (header_type & PCI_HEADER_MULTIFUNCTION)
+        {
+            for (uint8_t func = 1; func < 8; func++)
+            {
+                pci_scan_function(bus, slot, func);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Enumerates the functions on every bus reachable from the host bridges
+ *        through configuration mechanism #1.
+ *
+ * Only buses behind bridges are scanned, instead of probing all 256, each
+ * probe being a port access the hypervisor traps. A multi-function host
+ * bridge at 0:0 means one root bus per function.
+ */
+void pci_init()
+{
+    uint8_t header_type = pci_read(0, 0, 0, PCI_HEADER_TYPE & 0xFC) >> 16;
+    if (!(header_type & PCI_HEADER_MULTIFUNCTION))
+    {
+        pci_scan_bus(0);
+        return;
+    }
+
+    for (uint8_t func = 0; func < 8; func++)
+    {
+        if ((pci_read(0, 0, func, PCI_VENDOR_ID) & 0xFFFF) != 0xFFFF)
+        {
+            pci_scan_bus(func);
+        }
+    }
+}
+INITCALL(INIT_DEVICE, pci_init, NULL);
+
+/**
+ * @brief Finds a device by vendor and device id.
+ *
+ * @param from The previous match to continue after, or NULL to start from the beginning.
+ *
+ * @return The next matching device, or NULL.
+ */
+const pci_device_t* pci_find_device(uint16_t vendor_id, uint16_t device_id, const pci_device_t* from)
+{
+    size_t start = from ? (size_t)(from - pci_devices) + 1 : 0;
+
+    for (size_t i = start; i < pci_device_count; i++)
+    {
+        if (pci_devices[i].vendor_id == vendor_id && pci_devices[i].device_id == device_id)
+        {
+            return &pci_devices[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Enables I/O and memory decoding and lets the device master the bus for DMA.
+ */
+void pci_enable_bus_master(const pci_device_t* dev)
+{
+    uint16_t command = pci_config_read16(dev, PCI_COMMAND);
+    pci_config_write16(dev, PCI_COMMAND, command | PCI_COMMAND_IO | PCI_COMMAND_MEMORY | PCI_COMMAND_BUS_MASTER);
+}
+
+/**
+ * @brief Returns the I/O port base of an I/O space BAR, or 0 for a memory BAR.
+ */
+uint16_t pci_io_base(const pci_device_t* dev, int bar)
+{
+    if (!(dev->bar[bar] & PCI_BAR_IO))
+    {
+        return 0;
+    }
+    return dev->bar[bar] & 0xFFFC;
+}
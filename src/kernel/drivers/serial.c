@@ -0,0 +1,118 @@
+#include <kernel/drivers/serial.h>
+
+static int serial_ready = 0;
+
+/**
+ * @brief Sets COM1 to 115200 baud, 8N1, FIFOs on, no interrupts.
+ *
+ * The port is checked in loopback mode first; without a working UART the
+ * other serial functions do nothing.
+ *
+ * @return 0 if the port works, -1 otherwise.
+ */
+int serial_init()
+{
+    uint16_t io = SERIAL_COM1;
+    uint16_t divisor = SERIAL_BAUD_BASE / SERIAL_BAUD;
+
+    outb(io + SERIAL_REG_INT_ENABLE, 0x00);
+    outb(io + SERIAL_REG_LINE_CTRL, SERIAL_LCR_DLAB);
+    outb(io + SERIAL_REG_DATA, divisor & 0xFF);
+    outb(io + SERIAL_REG_INT_ENABLE, divisor >> 8);
+    outb(io + SERIAL_REG_LINE_CTRL, SERIAL_LCR_8N1);
+    outb(io + SERIAL_REG_FIFO_CTRL, 0xC7);
+
+    // Loopback: a byte written must come back unchanged
+    outb(io + SERIAL_REG_MODEM_CTRL, 0x1E);
+    outb(io + SERIAL_REG_DATA, 0xAE);
+    if (inb(io + SERIAL_REG_DATA) != 0xAE)
+    {
+        return -1;
+    }
+
+    // Normal operation: DTR, RTS and OUT2 set, loopback off
+    outb(io + SERIAL_REG_MODEM_CTRL, 0x0F);
+    serial_ready = 1;
+    return 0;
+}
+
+int serial_present()
+{
+    return serial_ready;
+}
+
+void serial_putc(char c)
+{
+    if (!serial_ready)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < SERIAL_TIMEOUT; i++)
+    {
+        if (inb(SERIAL_COM1 + SERIAL_REG_LINE_STATUS) & SERIAL_LSR_THR_EMPTY)
+        {
+            outb(SERIAL_COM1 + SERIAL_REG_DATA, c);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Writes raw bytes, with no newline translation, for binary dumps.
+ */
+void serial_write(const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        serial_putc(bytes[i]);
+    }
+}
+
+/**
+ * @brief Reads a received byte without waiting.
+ *
+ * @return The byte, or -1 if none is pending.
+ */
+int serial_getc()
+{
+    if (!serial_ready || !(inb(SERIAL_COM1 + SERIAL_REG_LINE_STATUS) & SERIAL_LSR_DATA_READY))
+    {
+        return -1;
+    }
+    return inb(SERIAL_COM1 + SERIAL_REG_DATA);
+}
+
+/**
+ * @brief Returns nonzero if a received byte is waiting.
+ */
+int serial_rx_ready()
+{
+    return serial_ready && (inb(SERIAL_COM1 + SERIAL_REG_LINE_STATUS) & SERIAL_LSR_DATA_READY);
+}
+
+static void serial_interrupt(interrupt_frame_t* frame)
+{
+    (void)frame;
+    // Received bytes stay in the UART for serial_getc(); the interrupt only ends a halt
+    inb(SERIAL_COM1 + SERIAL_REG_FIFO_CTRL);
+}
+
+/**
+ * @brief Raises IRQ 4 when a byte arrives, so an idle CPU can halt instead of polling.
+ *
+ * The line stays asserted until the byte is read, so readers must drain
+ * every pending byte before halting again.
+ */
+void serial_enable_rx_interrupt()
+{
+    if (!serial_ready)
+    {
+        return;
+    }
+
+    idt_register_handler(IRQ_VECTOR(SERIAL_COM1_IRQ), serial_interrupt);
+    outb(SERIAL_COM1 + SERIAL_REG_INT_ENABLE, SERIAL_IER_RX);
+    irq_unmask(SERIAL_COM1_IRQ);
+}
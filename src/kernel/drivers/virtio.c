@@ -0,0 +1,224 @@
+#include <kernel/drivers/virtio.h>
+
+static inline void virtio_mb()
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void virtio_reset(uint16_t io_base)
+{
+    outb(io_base + VIRTIO_REG_DEVICE_STATUS, 0);
+}
+
+/**
+ * @brief Adds bits to the device status; the sequence is ACKNOWLEDGE, DRIVER, then DRIVER_OK.
+ */
+void virtio_set_status(uint16_t io_base, uint8_t status)
+{
+    uint8_t current = inb(io_base + VIRTIO_REG_DEVICE_STATUS);
+    outb(io_base + VIRTIO_REG_DEVICE_STATUS, current | status);
+}
+
+/**
+ * @brief Sets up virtqueue `index` with the size the device asks for.
+ *
+ * The legacy layout puts the descriptor table and the available ring in one
+ * page aligned block and the used ring in the next, all physically contiguous.
+ *
+ * @return 0 on success, -1 if the queue does not exist or memory ran out.
+ */
+int virtqueue_init(virtqueue_t* vq, uint16_t io_base, uint16_t index)
+{
+    outw(io_base + VIRTIO_REG_QUEUE_SELECT, index);
+    uint16_t size = inw(io_base + VIRTIO_REG_QUEUE_SIZE);
+    if (size == 0)
+    {
+        return -1;
+    }
+
+    size_t driver_area = sizeof(virtq_desc_t) * size + sizeof(uint16_t) * (3 + size);
+    driver_area = (driver_area + VIRTQ_ALIGN - 1) & ~(VIRTQ_ALIGN - 1);
+    size_t device_area = sizeof(uint16_t) * 3 + sizeof(virtq_used_elem_t) * size;
+
+    phys_addr_t phys;
+    uint8_t* ring = (uint8_t*)dma_alloc(driver_area + device_area, &phys);
+    vq->tokens = (void**)kmalloc(size * sizeof(void*));
+    if (ring == NULL || vq->tokens == NULL)
+    {
+        kprintf("virtio: out of memory for queue %d\n", index);
+        if (ring != NULL)
+        {
+            dma_free(ring);
+        }
+        kfree(vq->tokens);
+        vq->tokens = NULL;
+        return -1;
+    }
+
+    vq->io_base = io_base;
+    vq->index = index;
+    vq->size = size;
+    vq->desc = (virtq_desc_t*)ring;
+    vq->avail = (virtq_avail_t*)(ring + sizeof(virtq_desc_t) * size);
+    vq->used = (virtq_used_t*)(ring + driver_area);
+    vq->last_used = 0;
+
+    // Chain every descriptor into the free list
+    for (uint16_t i = 0; i < size; i++)
+    {
+        vq->desc[i].next = i + 1;
+    }
+    vq->free_head = 0;
+    vq->num_free = size;
+
+    outl(io_base + VIRTIO_REG_QUEUE_ADDRESS, (uint32_t)(phys >> 12));
+    return 0;
+}
+
+/**
+ * @brief Exposes a chain of buffers to the device; nothing happens until virtqueue_kick().
+ *
+ * Device-readable buffers must come before device-writable ones.
+ *
+ * @param token Returned by virtqueue_get() once the device is done with the chain.
+ *
+ * @return 0 on success, -1 if there are not enough free descriptors.
+ */
+int virtqueue_add(virtqueue_t* vq, const virtq_buf_t* bufs, size_t count, void* token)
+{
+    if (count == 0 || count > vq->num_free)
+    {
+        return -1;
+    }
+
+    uint16_t head = vq->free_head;
+    uint16_t idx = head;
+    uint16_t last = head;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        volatile virtq_desc_t* desc = &vq->desc[idx];
+        desc->addr = bufs[i].phys;
+        desc->len = bufs[i].len;
+        desc->flags = (bufs[i].write ? VIRTQ_DESC_F_WRITE : 0) | (i + 1 < count ? VIRTQ_DESC_F_NEXT : 0);
+        last = idx;
+        idx = desc->next;
+    }
+
+    vq->free_head = vq->desc[last].next;
+    vq->num_free -= count;
+    vq->tokens[head] = token;
+
+    uint16_t avail_idx = vq->avail->idx;
+    vq->avail->ring[avail_idx % vq->size] = head;
+    // The ring entry must be visible before the index that publishes it
+    virtio_mb();
+    vq->avail->idx = avail_idx + 1;
+
+    return 0;
+}
+
+/**
+ * @brief Tells the device there are new buffers, unless it asked not to be notified.
+ */
+void virtqueue_kick(virtqueue_t* vq)
+{
+    virtio_mb();
+    if (!(vq->used->flags & VIRTQ_USED_F_NO_NOTIFY))
+    {
+        outw(vq->io_base + VIRTIO_REG_QUEUE_NOTIFY, vq->index);
+    }
+}
+
+/**
+ * @brief Takes one chain the device has finished with and frees its descriptors.
+ *
+ * @param len Receives the number of bytes the device wrote; may be NULL.
+ *
+ * @return The chain's token, or NULL if the device has not finished any chain.
+ */
+void* virtqueue_get(virtqueue_t* vq, uint32_t* len)
+{
+    if (vq->last_used == vq->used->idx)
+    {
+        return NULL;
+    }
+    virtio_mb();
+
+    volatile virtq_used_elem_t* elem = &vq->used->ring[vq->last_used % vq->size];
+    uint16_t head = elem->id;
+    if (len != NULL)
+    {
+        *len = elem->len;
+    }
+    vq->last_used++;
+
+    // Return the chain to the free list
+    uint16_t idx = head;
+    uint16_t count = 1;
+    while (vq->desc[idx].flags & VIRTQ_DESC_F_NEXT)
+    {
+        idx = vq->desc[idx].next;
+        count++;
+    }
+    vq->desc[idx].next = vq->free_head;
+    vq->free_head = head;
+    vq->num_free += count;
+
+    return vq->tokens[head];
+}
+
+/**
+ * @brief Detaches a queue from the device and frees its rings.
+ *
+ * The buffers still posted are the caller's. Does nothing for a queue
+ * that virtqueue_init() did not set up.
+ */
+void virtqueue_free(virtqueue_t* vq)
+{
+    if (vq->desc == NULL)
+    {
+        return;
+    }
+
+    outw(vq->io_base + VIRTIO_REG_QUEUE_SELECT, vq->index);
+    outl(vq->io_base + VIRTIO_REG_QUEUE_ADDRESS, 0);
+    dma_free((void*)vq->desc);
+    kfree(vq->tokens);
+    memset(vq, 0, sizeof(virtqueue_t));
+}
+
+/**
+ * @brief Returns nonzero if the device finished chains virtqueue_get() has not taken yet.
+ */
+int virtqueue_has_used(virtqueue_t* vq)
+{
+    return vq->last_used != vq->used->idx;
+}
+
+/**
+ * @brief Asks the device not to interrupt when it finishes chains.
+ *
+ * Only a hint: the device may still interrupt, and other queues of the
+ * device share the line.
+ */
+void virtqueue_disable_cb(virtqueue_t* vq)
+{
+    vq->avail->flags |= VIRTQ_AVAIL_F_NO_INTERRUPT;
+}
+
+/**
+ * @brief Lets the device interrupt again when it finishes chains.
+ *
+ * A chain finished before the flag reached the device raises no
+ * interrupt, so the used ring is checked once more afterwards.
+ *
+ * @return 0 if the used ring is empty, nonzero if chains are waiting and
+ *         the caller must poll again rather than wait for an interrupt.
+ */
+int virtqueue_enable_cb(virtqueue_t* vq)
+{
+    vq->avail->flags &= ~VIRTQ_AVAIL_F_NO_INTERRUPT;
+    virtio_mb();
+    return virtqueue_has_used(vq);
+}
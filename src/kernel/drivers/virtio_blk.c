@@ -0,0 +1,180 @@
+#include <kernel/drivers/virtio_blk.h>
+#include <kernel/init.h>
+
+static int virtio_blk_submit(block_device_t* dev, blk_request_t* req);
+static blk_request_t* virtio_blk_poll(block_device_t* dev);
+
+static const block_device_ops_t virtio_blk_ops = {
+    .submit = virtio_blk_submit,
+    .poll = virtio_blk_poll,
+};
+
+static virtio_blk_t* virtio_blk_devices[BLK_MAX_DEVICES];
+static size_t virtio_blk_count = 0;
+
+/**
+ * @brief Places a request on the virtqueue as one descriptor chain:
+ *        header, one descriptor per bio, then the status byte.
+ */
+static int virtio_blk_submit(block_device_t* dev, blk_request_t* req)
+{
+    virtio_blk_t* blk = (virtio_blk_t*)dev->private;
+    if (blk->free_slots == 0)
+    {
+        return -1;
+    }
+
+    uint32_t slot = __builtin_ctz(blk->free_slots);
+
+    virtio_blk_header_t* header = &blk->headers[slot];
+    header->type = req->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    header->reserved = 0;
+    header->sector = req->sector;
+    blk->status[slot] = 0xFF;
+
+    virtq_buf_t bufs[BLK_MAX_SEGMENTS + 2];
+    size_t count = 0;
+
+    bufs[count].phys = blk->headers_phys + slot * sizeof(virtio_blk_header_t);
+    bufs[count].len = sizeof(virtio_blk_header_t);
+    bufs[count].write = 0;
+    count++;
+
+    for (bio_t* bio = req->bios; bio != NULL; bio = bio->next)
+    {
+        bufs[count].phys = bio->phys;
+        bufs[count].len = bio->size;
+        bufs[count].write = !req->write;
+        count++;
+    }
+
+    bufs[count].phys = blk->status_phys + slot;
+    bufs[count].len = 1;
+    bufs[count].write = 1;
+    count++;
+
+    if (virtqueue_add(&blk->vq, bufs, count, (void*)(uintptr_t)(slot + 1)) != 0)
+    {
+        return -1;
+    }
+
+    blk->free_slots &= ~(1u << slot);
+    blk->slots[slot] = req;
+    virtqueue_kick(&blk->vq);
+    return 0;
+}
+
+static blk_request_t* virtio_blk_poll(block_device_t* dev)
+{
+    virtio_blk_t* blk = (virtio_blk_t*)dev->private;
+
+    void* token = virtqueue_get(&blk->vq, NULL);
+    if (token == NULL)
+    {
+        return NULL;
+    }
+
+    uint32_t slot = (uintptr_t)token - 1;
+    blk_request_t* req = blk->slots[slot];
+    req->status = blk->status[slot] == VIRTIO_BLK_S_OK ? BIO_OK : BIO_ERROR;
+
+    blk->slots[slot] = NULL;
+    blk->free_slots |= 1u << slot;
+    return req;
+}
+
+/**
+ * @brief Acknowledges the interrupt of every device on the line and defers reaping to the block layer.
+ */
+static void virtio_blk_interrupt(interrupt_frame_t* frame)
+{
+    uint32_t irq = frame->vector - PIC_VECTOR_BASE;
+
+    for (size_t i = 0; i < virtio_blk_count; i++)
+    {
+        virtio_blk_t* blk = virtio_blk_devices[i];
+        if (blk->irq == irq && (inb(blk->io_base + VIRTIO_REG_ISR_STATUS) & VIRTIO_ISR_QUEUE))
+        {
+            blk_complete_irq(&blk->dev);
+        }
+    }
+}
+
+static void virtio_blk_probe(const pci_device_t* pci)
+{
+    uint16_t io_base = pci_io_base(pci, 0);
+    if (io_base == 0)
+    {
+        return;
+    }
+
+    pci_enable_bus_master(pci);
+    virtio_reset(io_base);
+    virtio_set_status(io_base, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    // No optional features: one request per descriptor chain is all the driver needs
+    inl(io_base + VIRTIO_REG_DEVICE_FEATURES);
+    outl(io_base + VIRTIO_REG_GUEST_FEATURES, 0);
+
+    virtio_blk_t* blk = (virtio_blk_t*)kmalloc(sizeof(virtio_blk_t));
+    if (blk == NULL || virtqueue_init(&blk->vq, io_base, 0) != 0)
+    {
+        virtio_set_status(io_base, VIRTIO_STATUS_FAILED);
+        return;
+    }
+
+    phys_addr_t phys;
+    uint8_t* dma = (uint8_t*)dma_alloc(VIRTIO_BLK_SLOTS * (sizeof(virtio_blk_header_t) + 1), &phys);
+    if (dma == NULL)
+    {
+        virtio_set_status(io_base, VIRTIO_STATUS_FAILED);
+        return;
+    }
+
+    blk->io_base = io_base;
+    blk->headers = (virtio_blk_header_t*)dma;
+    blk->headers_phys = phys;
+    blk->status = dma + VIRTIO_BLK_SLOTS * sizeof(virtio_blk_header_t);
+    blk->status_phys = phys + VIRTIO_BLK_SLOTS * sizeof(virtio_blk_header_t);
+    blk->free_slots = VIRTIO_BLK_SLOTS == 32 ? 0xFFFFFFFF : (1u << VIRTIO_BLK_SLOTS) - 1;
+
+    // The capacity in 512-byte sectors is the first field of the device configuration
+    uint32_t capacity_low = inl(io_base + VIRTIO_REG_DEVICE_CONFIG);
+    uint32_t capacity_high = inl(io_base + VIRTIO_REG_DEVICE_CONFIG + 4);
+
+    blk->dev.name = "virtio-blk";
+    blk->dev.sectors = ((uint64_t)capacity_high << 32) | capacity_low;
+    blk->dev.max_in_flight = VIRTIO_BLK_SLOTS;
+    blk->dev.ops = &virtio_blk_ops;
+    blk->dev.private = blk;
+
+    virtio_set_status(io_base, VIRTIO_STATUS_DRIVER_OK);
+    if (blk_register_device(&blk->dev) < 0)
+    {
+        return;
+    }
+
+    blk->irq = pci->irq_line < PIC_IRQS ? pci->irq_line : PIC_IRQS;
+    virtio_blk_devices[virtio_blk_count++] = blk;
+    if (blk->irq < PIC_IRQS)
+    {
+        idt_register_handler(IRQ_VECTOR(blk->irq), virtio_blk_interrupt);
+        irq_unmask(blk->irq);
+    }
+}
+
+/**
+ * @brief Registers every virtio-blk device on the PCI bus.
+ *
+ * Waiters poll the used ring; the device interrupt additionally reaps
+ * completions for bios nobody waits on, such as read-ahead.
+ */
+void virtio_blk_init()
+{
+    const pci_device_t* pci = NULL;
+    while ((pci = pci_find_device(VIRTIO_VENDOR_ID, VIRTIO_BLK_DEVICE_ID, pci)) != NULL)
+    {
+        virtio_blk_probe(pci);
+    }
+}
+INITCALL(INIT_DEVICE, virtio_blk_init, "pci_init");
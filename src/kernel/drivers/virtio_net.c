@@ -0,0 +1,281 @@
+#include <kernel/drivers/virtio_net.h>
+#include <kernel/init.h>
+
+static int virtio_net_transmit(net_device_t* dev, netbuf_t* nb);
+static int virtio_net_poll(net_device_t* dev, int budget);
+static int virtio_net_irq_enable(net_device_t* dev);
+
+static const net_device_ops_t virtio_net_ops = {
+    .transmit = virtio_net_transmit,
+    .poll = virtio_net_poll,
+    .irq_enable = virtio_net_irq_enable,
+};
+
+static virtio_net_t* virtio_net_devices[NET_MAX_DEVICES];
+static size_t virtio_net_count = 0;
+
+// Handlers that were on a line before ours, such as virtio-blk's; PCI lines are shared
+static interrupt_handler_t virtio_net_chained[PIC_IRQS];
+
+/**
+ * @brief Posts free buffers to the receive ring until VIRTIO_NET_RX_BUFS
+ *        are posted, with one notification for the batch.
+ *
+ * Each buffer is a page: the header descriptor ends where the frame
+ * descriptor starts, at the buffer's headroom.
+ */
+static void virtio_net_refill(virtio_net_t* net)
+{
+    uint32_t added = 0;
+
+    while (net->rx_posted < VIRTIO_NET_RX_BUFS)
+    {
+        netbuf_t* nb = netbuf_alloc();
+        if (nb == NULL)
+        {
+            break;
+        }
+
+        virtq_buf_t bufs[2] = {
+            {netbuf_data_phys(nb) - sizeof(virtio_net_hdr_t), sizeof(virtio_net_hdr_t), 1},
+            {netbuf_data_phys(nb), NETBUF_DATA_MAX, 1},
+        };
+        if (virtqueue_add(&net->rx, bufs, 2, nb) != 0)
+        {
+            netbuf_free(nb);
+            break;
+        }
+        net->rx_posted++;
+        added++;
+    }
+
+    if (added != 0)
+    {
+        virtqueue_kick(&net->rx);
+    }
+}
+
+/**
+ * @brief Returns the buffers of frames the device has sent to the pool.
+ *        Called with the transmit lock held.
+ */
+static void virtio_net_tx_reap(virtio_net_t* net)
+{
+    netbuf_t* nb;
+    while ((nb = (netbuf_t*)virtqueue_get(&net->tx, NULL)) != NULL)
+    {
+        netbuf_free(nb);
+    }
+}
+
+/**
+ * @brief Places a frame on the transmit ring, straight from its buffer.
+ *
+ * The transmit interrupt stays off: sent buffers are reaped here and after
+ * each poll. Frames sent while polling, such as replies, are kicked
+ * together when the poll ends.
+ */
+static int virtio_net_transmit(net_device_t* dev, netbuf_t* nb)
+{
+    virtio_net_t* net = (virtio_net_t*)dev->private;
+
+    memset(netbuf_data(nb) - sizeof(virtio_net_hdr_t), 0, sizeof(virtio_net_hdr_t));
+    virtq_buf_t bufs[2] = {
+        {netbuf_data_phys(nb) - sizeof(virtio_net_hdr_t), sizeof(virtio_net_hdr_t), 0},
+        {netbuf_data_phys(nb), nb->len, 0},
+    };
+
+    spin_lock(&net->tx_lock);
+    virtio_net_tx_reap(net);
+    int result = virtqueue_add(&net->tx, bufs, 2, nb);
+    if (result == 0)
+    {
+        net->tx_unkicked++;
+        if (!net->in_poll)
+        {
+            virtqueue_kick(&net->tx);
+            net->tx_unkicked = 0;
+        }
+    }
+    spin_unlock(&net->tx_lock);
+
+    if (result != 0)
+    {
+        netbuf_free(nb);
+    }
+    return result;
+}
+
+static int virtio_net_poll(net_device_t* dev, int budget)
+{
+    virtio_net_t* net = (virtio_net_t*)dev->private;
+    int done = 0;
+
+    net->in_poll = 1;
+    while (done < budget)
+    {
+        uint32_t len;
+        netbuf_t* nb = (netbuf_t*)virtqueue_get(&net->rx, &len);
+        if (nb == NULL)
+        {
+            break;
+        }
+        net->rx_posted--;
+        done++;
+
+        if (len <= sizeof(virtio_net_hdr_t))
+        {
+            dev->stats.rx_dropped++;
+            netbuf_free(nb);
+            continue;
+        }
+        nb->offset = NETBUF_HEADROOM;
+        nb->len = len - sizeof(virtio_net_hdr_t);
+        net_receive(dev, nb);
+    }
+    net->in_poll = 0;
+
+    spin_lock(&net->tx_lock);
+    virtio_net_tx_reap(net);
+    if (net->tx_unkicked != 0)
+    {
+        virtqueue_kick(&net->tx);
+        net->tx_unkicked = 0;
+    }
+    spin_unlock(&net->tx_lock);
+
+    virtio_net_refill(net);
+    return done;
+}
+
+static int virtio_net_irq_enable(net_device_t* dev)
+{
+    virtio_net_t* net = (virtio_net_t*)dev->private;
+    if (!virtqueue_enable_cb(&net->rx))
+    {
+        return 0;
+    }
+    virtqueue_disable_cb(&net->rx);
+    return 1;
+}
+
+/**
+ * @brief Switches every device on the line that received frames to polling,
+ *        then runs the handler that was on the line before.
+ */
+static void virtio_net_interrupt(interrupt_frame_t* frame)
+{
+    uint32_t irq = frame->vector - PIC_VECTOR_BASE;
+
+    for (size_t i = 0; i < virtio_net_count; i++)
+    {
+        virtio_net_t* net = virtio_net_devices[i];
+        if (net->irq == irq && (inb(net->io_base + VIRTIO_REG_ISR_STATUS) & VIRTIO_ISR_QUEUE))
+        {
+            virtqueue_disable_cb(&net->rx);
+            net->dev.stats.interrupts++;
+            net_schedule(&net->dev);
+        }
+    }
+
+    if (virtio_net_chained[irq] != NULL)
+    {
+        virtio_net_chained[irq](frame);
+    }
+}
+
+static void virtio_net_probe(const pci_device_t* pci)
+{
+    uint16_t io_base = pci_io_base(pci, 0);
+    if (io_base == 0)
+    {
+        return;
+    }
+
+    pci_enable_bus_master(pci);
+    virtio_reset(io_base);
+    virtio_set_status(io_base, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    // Only the address: without checksum offload or merged buffers every frame is one buffer
+    uint32_t features = inl(io_base + VIRTIO_REG_DEVICE_FEATURES) & VIRTIO_NET_F_MAC;
+    outl(io_base + VIRTIO_REG_GUEST_FEATURES, features);
+
+    virtio_net_t* net = (virtio_net_t*)kmalloc(sizeof(virtio_net_t));
+    if (net == NULL)
+    {
+        virtio_set_status(io_base, VIRTIO_STATUS_FAILED);
+        return;
+    }
+    memset(net, 0, sizeof(virtio_net_t));
+    if (virtqueue_init(&net->rx, io_base, VIRTIO_NET_RX_QUEUE) != 0 ||
+        virtqueue_init(&net->tx, io_base, VIRTIO_NET_TX_QUEUE) != 0)
+    {
+        goto fail;
+    }
+
+    net->io_base = io_base;
+    net->tx_lock = (spinlock_t)SPINLOCK_INIT;
+    if (features & VIRTIO_NET_F_MAC)
+    {
+        for (size_t i = 0; i < ETH_ALEN; i++)
+        {
+            net->dev.mac[i] = inb(io_base + VIRTIO_REG_DEVICE_CONFIG + i);
+        }
+    }
+    else
+    {
+        const uint8_t mac[ETH_ALEN] = VIRTIO_NET_DEFAULT_MAC;
+        memcpy(net->dev.mac, mac, ETH_ALEN);
+    }
+
+    net->dev.name = "virtio-net";
+    net->dev.ip = NET_LOCAL_IP;
+    net->dev.ops = &virtio_net_ops;
+    net->dev.private = net;
+    virtqueue_disable_cb(&net->tx);
+
+    // Registered first, so a full device table leaves the device stopped
+    if (net_register_device(&net->dev) < 0)
+    {
+        goto fail;
+    }
+    virtio_set_status(io_base, VIRTIO_STATUS_DRIVER_OK);
+    virtio_net_refill(net);
+
+    net->irq = pci->irq_line < PIC_IRQS ? pci->irq_line : PIC_IRQS;
+    virtio_net_devices[virtio_net_count++] = net;
+    if (net->irq < PIC_IRQS && idt_get_handler(IRQ_VECTOR(net->irq)) != virtio_net_interrupt)
+    {
+        virtio_net_chained[net->irq] = idt_get_handler(IRQ_VECTOR(net->irq));
+        idt_register_handler(IRQ_VECTOR(net->irq), virtio_net_interrupt);
+        irq_unmask(net->irq);
+    }
+    return;
+
+fail:
+    virtio_set_status(io_base, VIRTIO_STATUS_FAILED);
+    virtqueue_free(&net->rx);
+    virtqueue_free(&net->tx);
+    kfree(net);
+}
+
+/**
+ * @brief Registers every virtio-net device on the PCI bus.
+ *
+ * Runs after virtio-blk, so its handler is chained when both share a line.
+ */
+void virtio_net_init()
+{
+    if (netbuf_count() == 0)
+    {
+        return;
+    }
+
+    const pci_device_t* pci = NULL;
+    while ((pci = pci_find_device(VIRTIO_VENDOR_ID, VIRTIO_NET_DEVICE_ID, pci)) != NULL &&
+           virtio_net_count < NET_MAX_DEVICES)
+    {
+        virtio_net_probe(pci);
+    }
+}
+INITCALL(INIT_DEVICE, virtio_net_init, "virtio_blk_init");
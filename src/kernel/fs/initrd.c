@@ -0,0 +1,312 @@
+#include <kernel/fs/initrd.h>
+#include <kernel/init.h>
+
+// A multiboot module as recorded at boot, before its frames are mapped
+typedef struct initrd_module
+{
+    phys_addr_t start;
+    size_t size;
+    const uint8_t* base;        // Read-only mapping in the vmalloc range
+    char cmdline[INITRD_CMDLINE_MAX];
+} initrd_module_t;
+
+static initrd_module_t initrd_modules[INITRD_MAX_MODULES];
+static size_t initrd_module_count = 0;
+
+static initrd_file_t* initrd_files = NULL;
+static size_t initrd_files_count = 0;
+
+// Open hash of file paths, sized to a power of two at least twice the file count
+static initrd_file_t** initrd_buckets = NULL;
+static uint32_t initrd_bucket_mask = 0;
+
+/**
+ * @brief Walks the ustar archive in a module.
+ *
+ * Only regular files are recorded; directories, links and pax headers are
+ * skipped. The walk stops at the end-of-archive block or at the first
+ * header that fails validation.
+ *
+ * @param module The mapped module.
+ * @param files Where to record the files, or NULL to only count them.
+ *
+ * @return The number of regular files in the archive.
+ */
+static size_t initrd_scan(const initrd_module_t* module, initrd_file_t* files)
+{
+    size_t count = 0;
+    size_t offset = 0;
+
+    while (offset + TAR_BLOCK_SIZE <= module->size)
+    {
+        const tar_header_t* header = (const tar_header_t*)(module->base + offset);
+        if (header->name[0] == '\0' || !tar_header_valid(header))
+        {
+            break;
+        }
+
+        size_t size = tar_entry_size(header);
+        size_t data_offset = offset + TAR_BLOCK_SIZE;
+        if (size > module->size - data_offset)
+        {
+            kprintf("initrd: truncated entry at offset %d\n", offset);
+            break;
+        }
+
+        if (tar_entry_is_file(header))
+        {
+            if (files != NULL)
+            {
+                initrd_file_t* file = &files[count];
+                file->name = tar_entry_path(header);
+                file->data = module->base + data_offset;
+                file->phys = module->start + data_offset;
+                file->size = size;
+            }
+            count++;
+        }
+
+        offset = tar_next_header(offset, size);
+    }
+
+    return count;
+}
+
+static initrd_file_t* initrd_find(const char* path)
+{
+    if (initrd_buckets == NULL)
+    {
+        return NULL;
+    }
+
+    path = vfs_skip_root(path);
+    uint32_t hash = vfs_path_hash(path);
+
+    for (initrd_file_t* file = initrd_buckets[hash & initrd_bucket_mask]; file != NULL; file = file->next)
+    {
+        if (file->hash == hash && strcmp(file->name, path) == 0)
+        {
+            return file;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Copies part of a file into a buffer.
+ *
+ * Callers that can work on the contents in place should use `file->data`
+ * instead, which needs no copy at all.
+ *
+ * @return The number of bytes copied, 0 at or beyond the end of the file.
+ */
+size_t initrd_read(const initrd_file_t* file, size_t offset, void* buffer, size_t size)
+{
+    if (offset >= file->size)
+    {
+        return 0;
+    }
+
+    if (size > file->size - offset)
+    {
+        size = file->size - offset;
+    }
+    memcpy(buffer, file->data + offset, size);
+
+    return size;
+}
+
+/**
+ * @brief Finds a file by path in constant expected time.
+ *
+ * @param path The path; a leading "/" or "./" is ignored.
+ *
+ * @return The file, or NULL if there is none.
+ */
+const initrd_file_t* initrd_lookup(const char* path)
+{
+    return initrd_find(path);
+}
+
+static inode_t* initrd_fs_lookup(filesystem_t* fs, const char* path)
+{
+    (void)fs;
+    initrd_file_t* file = initrd_find(path);
+    return file ? &file->inode : NULL;
+}
+
+/**
+ * @brief Lets the page cache use the module's own frame for page-aligned file pages.
+ *
+ * Files packed by tools/mkinitrd.py start on a page boundary. Only whole
+ * pages are shared, so a mapping never shows the bytes after the end of the file.
+ */
+static phys_addr_t initrd_share_page(inode_t* inode, uint32_t index)
+{
+    initrd_file_t* file = (initrd_file_t*)inode->private;
+    uint64_t end = ((uint64_t)index + 1) * PAGE_SIZE;
+
+    if ((file->phys & (PAGE_SIZE - 1)) != 0 || end > file->size)
+    {
+        return 0;
+    }
+    return file->phys + (uint64_t)index * PAGE_SIZE;
+}
+
+/**
+ * @brief Copies a page of an unaligned file, or the tail of an aligned one, into a cache page.
+ */
+static int initrd_readpage(inode_t* inode, page_t* page)
+{
+    initrd_file_t* file = (initrd_file_t*)inode->private;
+    size_t offset = (size_t)page->index * PAGE_SIZE;
+
+    uint8_t* dest = (uint8_t*)kmap_atomic(page->phys);
+    if (dest == NULL)
+    {
+        page_end_read(page, 0);
+        return -1;
+    }
+    memset(dest, 0, PAGE_SIZE);
+    initrd_read(file, offset, dest, PAGE_SIZE);
+    kunmap_atomic(dest);
+
+    page_end_read(page, 1);
+    return 0;
+}
+
+static const inode_ops_t initrd_inode_ops = {
+    .readpage = initrd_readpage,
+    .share_page = initrd_share_page,
+};
+
+static filesystem_t initrd_fs = {
+    .name = "initrd",
+    .mount_point = "/",
+    .lookup = initrd_fs_lookup,
+};
+
+/**
+ * @brief Records the multiboot modules.
+ *
+ * The multiboot information structure may sit in memory the allocator hands
+ * out, so the module list and command lines are copied before anything is
+ * allocated. The module frames themselves are reserved by the physical
+ * memory manager.
+ *
+ * @param mbi The multiboot information structure.
+ */
+void initrd_probe(multiboot_info_t* mbi)
+{
+    if (!(mbi->flags & MULTIBOOT_INFO_MODS))
+    {
+        return;
+    }
+
+    multiboot_module_t* modules = (multiboot_module_t*)mbi->mods_addr;
+    for (size_t i = 0; i < mbi->mods_count && initrd_module_count < INITRD_MAX_MODULES; i++)
+    {
+        initrd_module_t* module = &initrd_modules[initrd_module_count++];
+        module->start = modules[i].mod_start;
+        module->size = modules[i].mod_end - modules[i].mod_start;
+
+        const char* cmdline = (const char*)modules[i].cmdline;
+        size_t len = cmdline ? tar_field_length(cmdline, INITRD_CMDLINE_MAX - 1) : 0;
+        memcpy(module->cmdline, cmdline, len);
+        module->cmdline[len] = '\0';
+    }
+}
+
+/**
+ * @brief Maps the recorded modules and indexes the files they contain.
+ *
+ * Each module is mapped read-only into the vmalloc range straight from its
+ * frames; file contents are served from that mapping. Files in later
+ * modules shadow files with the same path in earlier ones. Needs paging and
+ * the heap.
+ */
+void initrd_init()
+{
+    size_t count = 0;
+    for (size_t i = 0; i < initrd_module_count; i++)
+    {
+        initrd_module_t* module = &initrd_modules[i];
+        module->base = (const uint8_t*)vmap_range(module->start, module->size, PG_PRESENT | PG_NX);
+        if (module->base == NULL)
+        {
+            kprintf("initrd: could not map module %s\n", module->cmdline);
+            continue;
+        }
+        count += initrd_scan(module, NULL);
+    }
+
+    if (count == 0)
+    {
+        return;
+    }
+
+    size_t buckets = 16;
+    while (buckets < count * 2)
+    {
+        buckets <<= 1;
+    }
+
+    initrd_files = (initrd_file_t*)kmalloc(count * sizeof(initrd_file_t));
+    initrd_buckets = (initrd_file_t**)kmalloc(buckets * sizeof(initrd_file_t*));
+    if (initrd_files == NULL || initrd_buckets == NULL)
+    {
+        kprintf("initrd: out of memory for %d files\n", count);
+        return;
+    }
+    memset(initrd_buckets, 0, buckets * sizeof(initrd_file_t*));
+    initrd_bucket_mask = buckets - 1;
+
+    for (size_t i = 0; i < initrd_module_count; i++)
+    {
+        if (initrd_modules[i].base != NULL)
+        {
+            initrd_files_count += initrd_scan(&initrd_modules[i], initrd_files + initrd_files_count);
+        }
+    }
+
+    for (size_t i = 0; i < initrd_files_count; i++)
+    {
+        initrd_file_t* file = &initrd_files[i];
+        if (file->name == NULL)
+        {
+            continue;
+        }
+
+        const char* name = vfs_skip_root(file->name);
+        file->name = name;
+        file->hash = vfs_path_hash(name);
+
+        initrd_file_t** bucket = &initrd_buckets[file->hash & initrd_bucket_mask];
+        file->next = *bucket;
+        *bucket = file;
+
+        inode_init(&file->inode, file->size, &initrd_inode_ops, NULL, file);
+    }
+
+    kprintf("initrd: %d files in %d modules\n", initrd_files_count, initrd_module_count);
+    vfs_mount(&initrd_fs);
+}
+INITCALL(INIT_SUBSYS, initrd_init, NULL);
+
+size_t initrd_file_count()
+{
+    return initrd_files_count;
+}
+
+/**
+ * @brief Returns the file with the given index, for enumerating the archive.
+ */
+const initrd_file_t* initrd_file_at(size_t index)
+{
+    if (index >= initrd_files_count || initrd_files[index].name == NULL)
+    {
+        return NULL;
+    }
+    return &initrd_files[index];
+}
@@ -0,0 +1,94 @@
+#include <kernel/fs/tar.h>
+
+/**
+ * @brief Returns the length of a tar header field, which is not always NUL terminated.
+ */
+size_t tar_field_length(const char* field, size_t max)
+{
+    size_t len = 0;
+    while (len < max && field[len])
+    {
+        len++;
+    }
+    return len;
+}
+
+/**
+ * @brief Parses an octal number from a tar header field.
+ */
+size_t tar_parse_octal(const char* field, size_t max)
+{
+    size_t value = 0;
+    for (size_t i = 0; i < max && field[i]; i++)
+    {
+        if (field[i] >= '0' && field[i] <= '7')
+        {
+            value = (value << 3) | (field[i] - '0');
+        }
+    }
+    return value;
+}
+
+/**
+ * @brief Checks the ustar magic and the header checksum.
+ */
+int tar_header_valid(const tar_header_t* header)
+{
+    if (memcmp(header->magic, "ustar", 5) != 0)
+    {
+        return 0;
+    }
+
+    // The checksum is computed with the checksum field itself read as spaces
+    const uint8_t* bytes = (const uint8_t*)header;
+    uint32_t sum = 0;
+    for (size_t i = 0; i < TAR_BLOCK_SIZE; i++)
+    {
+        size_t field = (uintptr_t)header->checksum - (uintptr_t)header;
+        sum += (i >= field && i < field + sizeof(header->checksum)) ? ' ' : bytes[i];
+    }
+
+    return sum == tar_parse_octal(header->checksum, sizeof(header->checksum));
+}
+
+/**
+ * @brief Builds the normalized path of a tar entry from its prefix and name fields.
+ *
+ * @return A heap allocated string, or NULL if out of memory.
+ */
+char* tar_entry_path(const tar_header_t* header)
+{
+    size_t prefix_len = tar_field_length(header->prefix, sizeof(header->prefix));
+    size_t name_len = tar_field_length(header->name, sizeof(header->name));
+
+    char* path = (char*)kmalloc(prefix_len + name_len + 2);
+    if (path == NULL)
+    {
+        return NULL;
+    }
+
+    size_t len = 0;
+    if (prefix_len)
+    {
+        memcpy(path, header->prefix, prefix_len);
+        path[prefix_len] = '/';
+        len = prefix_len + 1;
+    }
+    memcpy(path + len, header->name, name_len);
+    path[len + name_len] = '\0';
+
+    return path;
+}
+
+/**
+ * @brief Returns whether the entry is a regular file; directories, links and pax headers are not.
+ */
+int tar_entry_is_file(const tar_header_t* header)
+{
+    return header->typeflag == TAR_TYPE_FILE || header->typeflag == TAR_TYPE_AFILE;
+}
+
+size_t tar_entry_size(const tar_header_t* header)
+{
+    return tar_parse_octal(header->size, sizeof(header->size));
+}
@@ -0,0 +1,180 @@
+#include <kernel/fs/tarfs.h>
+
+/**
+ * @brief Reads file data straight into the page-cache frame.
+ *
+ * Only the archive headers go through the buffer cache; file contents are
+ * cached once, in the page cache. The final partial page is zeroed first,
+ * and the read is rounded up to whole sectors, which tar pads with zeros.
+ */
+static int tarfs_readpage(inode_t* inode, page_t* page)
+{
+    tarfs_file_t* file = (tarfs_file_t*)inode->private;
+    uint64_t offset = (uint64_t)page->index * PAGE_SIZE;
+    uint64_t remaining = inode->size - offset;
+    uint32_t size = remaining < PAGE_SIZE ? (uint32_t)remaining : PAGE_SIZE;
+
+    if (size < PAGE_SIZE)
+    {
+        uint8_t* data = (uint8_t*)kmap_atomic(page->phys);
+        if (data == NULL)
+        {
+            page_end_read(page, 0);
+            return -1;
+        }
+        memset(data, 0, PAGE_SIZE);
+        kunmap_atomic(data);
+    }
+
+    bio_t* bio = &page->bio;
+    bio->sector = file->data_sector + (uint64_t)page->index * (PAGE_SIZE / SECTOR_SIZE);
+    bio->phys = page->phys;
+    bio->size = (size + SECTOR_SIZE - 1) & ~(SECTOR_SIZE - 1);
+    bio->write = 0;
+    bio->end_io = page_end_io;
+    bio->private = page;
+    submit_bio(inode->bdev, bio);
+    return 0;
+}
+
+static const inode_ops_t tarfs_inode_ops = {
+    .readpage = tarfs_readpage,
+    .share_page = NULL,
+};
+
+static inode_t* tarfs_lookup(filesystem_t* fs, const char* path)
+{
+    tarfs_t* tarfs = (tarfs_t*)fs->private;
+
+    path = vfs_skip_root(path);
+    uint32_t hash = vfs_path_hash(path);
+
+    for (tarfs_file_t* file = tarfs->buckets[hash & tarfs->bucket_mask]; file != NULL; file = file->next)
+    {
+        if (file->hash == hash && strcmp(file->name, path) == 0)
+        {
+            return &file->inode;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Reads the header at a byte offset of the archive through the buffer cache.
+ *
+ * Headers are sector aligned, so one never straddles two blocks.
+ *
+ * @return 0 with the header copied out, or -1 past the end of the device or on an I/O error.
+ */
+static int tarfs_read_header(block_device_t* dev, uint64_t offset, tar_header_t* header)
+{
+    buffer_t* buf = bread(dev, offset / BCACHE_BLOCK_SIZE);
+    if (buf == NULL)
+    {
+        return -1;
+    }
+    memcpy(header, buf->data + (offset & (BCACHE_BLOCK_SIZE - 1)), sizeof(tar_header_t));
+    brelse(buf);
+    return 0;
+}
+
+/**
+ * @brief Indexes the ustar archive on a block device and mounts it.
+ *
+ * @return 0 on success, -1 if the device holds no archive or memory ran out.
+ */
+int tarfs_mount(block_device_t* dev, const char* mount_point)
+{
+    tarfs_t* tarfs = (tarfs_t*)kmalloc(sizeof(tarfs_t));
+    if (tarfs == NULL)
+    {
+        return -1;
+    }
+
+    // Collect the files first; the hash table is sized once the count is known
+    tarfs_file_t* files = NULL;
+    size_t count = 0;
+    uint64_t device_size = dev->sectors * SECTOR_SIZE;
+    uint64_t offset = 0;
+    tar_header_t header;
+
+    while (offset + TAR_BLOCK_SIZE <= device_size && tarfs_read_header(dev, offset, &header) == 0)
+    {
+        if (header.name[0] == '\0' || !tar_header_valid(&header))
+        {
+            break;
+        }
+
+        size_t size = tar_entry_size(&header);
+        if (tar_entry_is_file(&header))
+        {
+            tarfs_file_t* file = (tarfs_file_t*)kmalloc(sizeof(tarfs_file_t));
+            char* path = tar_entry_path(&header);
+            if (file == NULL || path == NULL)
+            {
+                break;
+            }
+
+            file->name = vfs_skip_root(path);
+            file->hash = vfs_path_hash(file->name);
+            file->data_sector = (offset + TAR_BLOCK_SIZE) / SECTOR_SIZE;
+            inode_init(&file->inode, size, &tarfs_inode_ops, dev, file);
+
+            file->next = files;
+            files = file;
+            count++;
+        }
+
+        offset = tar_next_header(offset, size);
+    }
+
+    if (count == 0)
+    {
+        kprintf("tarfs: no archive on %s\n", dev->name);
+        kfree(tarfs);
+        return -1;
+    }
+
+    size_t buckets = 16;
+    while (buckets < count * 2)
+    {
+        buckets <<= 1;
+    }
+    tarfs->buckets = (tarfs_file_t**)kmalloc(buckets * sizeof(tarfs_file_t*));
+    if (tarfs->buckets == NULL)
+    {
+        kfree(tarfs);
+        return -1;
+    }
+    memset(tarfs->buckets, 0, buckets * sizeof(tarfs_file_t*));
+    tarfs->bucket_mask = buckets - 1;
+
+    // Files were collected newest first; insert oldest first so later entries shadow earlier ones
+    tarfs_file_t* reversed = NULL;
+    while (files != NULL)
+    {
+        tarfs_file_t* next = files->next;
+        files->next = reversed;
+        reversed = files;
+        files = next;
+    }
+    while (reversed != NULL)
+    {
+        tarfs_file_t* file = reversed;
+        reversed = file->next;
+
+        tarfs_file_t** bucket = &tarfs->buckets[file->hash & tarfs->bucket_mask];
+        file->next = *bucket;
+        *bucket = file;
+    }
+
+    tarfs->dev = dev;
+    tarfs->file_count = count;
+    tarfs->fs.name = "tarfs";
+    tarfs->fs.mount_point = mount_point;
+    tarfs->fs.lookup = tarfs_lookup;
+    tarfs->fs.private = tarfs;
+
+    kprintf("tarfs: %d files on %s\n", count, dev->name);
+    return vfs_mount(&tarfs->fs);
+}
@@ -0,0 +1,122 @@
+#include <kernel/fs/vfs.h>
+
+static filesystem_t* vfs_mounts[VFS_MAX_MOUNTS];
+static size_t vfs_mount_count = 0;
+static uint32_t vfs_next_ino = 1;
+
+void inode_init(inode_t* inode, uint64_t size, const inode_ops_t* ops, block_device_t* bdev, void* private)
+{
+    inode->ino = __atomic_fetch_add(&vfs_next_ino, 1, __ATOMIC_RELAXED);
+    inode->size = size;
+    inode->ops = ops;
+    inode->bdev = bdev;
+    inode->private = private;
+
+    inode->lock = (spinlock_t)SPINLOCK_INIT;
+    inode->pages = (radix_tree_root_t)RADIX_TREE_INIT;
+    inode->nr_pages = 0;
+    inode->ra_next = 0;
+    inode->ra_end = 0;
+    inode->ra_window = 0;
+}
+
+/**
+ * @brief Attaches a filesystem at its mount point.
+ *
+ * @return 0 on success, -1 if the mount table is full.
+ */
+int vfs_mount(filesystem_t* fs)
+{
+    if (vfs_mount_count == VFS_MAX_MOUNTS)
+    {
+        kprintf("vfs: cannot mount %s at %s\n", fs->name, fs->mount_point);
+        return -1;
+    }
+
+    vfs_mounts[vfs_mount_count++] = fs;
+    kprintf("vfs: mounted %s at %s\n", fs->name, fs->mount_point);
+    return 0;
+}
+
+/**
+ * @brief Returns how much of `path` the mount point covers, or -1 if it does not apply.
+ */
+static int vfs_mount_match(const char* mount_point, const char* path)
+{
+    mount_point = vfs_skip_root(mount_point);
+    path = vfs_skip_root(path);
+
+    size_t len = strlen(mount_point);
+    if (len == 0)
+    {
+        return 0;
+    }
+    if (memcmp(mount_point, path, len) != 0 || (path[len] != '/' && path[len] != '\0'))
+    {
+        return -1;
+    }
+    return len;
+}
+
+/**
+ * @brief Resolves an absolute path through the filesystem with the longest matching mount point.
+ *
+ * @return The inode, or NULL if no filesystem has the file.
+ */
+inode_t* vfs_lookup(const char* path)
+{
+    filesystem_t* best = NULL;
+    int best_len = -1;
+
+    for (size_t i = 0; i < vfs_mount_count; i++)
+    {
+        int len = vfs_mount_match(vfs_mounts[i]->mount_point, path);
+        if (len > best_len)
+        {
+            best = vfs_mounts[i];
+            best_len = len;
+        }
+    }
+
+    if (best == NULL)
+    {
+        return NULL;
+    }
+    return best->lookup(best, vfs_skip_root(path) + best_len);
+}
+
+/**
+ * @brief Hashes a path with 32-bit FNV-1a.
+ */
+uint32_t vfs_path_hash(const char* path)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; path[i]; i++)
+    {
+        hash ^= (uint8_t)path[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Strips leading "/" and "./" components so "/a", "./a" and "a" name the same file.
+ */
+const char* vfs_skip_root(const char* path)
+{
+    for (;;)
+    {
+        if (path[0] == '/')
+        {
+            path++;
+        }
+        else if (path[0] == '.' && path[1] == '/')
+        {
+            path += 2;
+        }
+        else
+        {
+            return path;
+        }
+    }
+}
@@ -0,0 +1,188 @@
+#include <kernel/init.h>
+#include <string.h>
+
+typedef struct boot_phase_record
+{
+    const char* name;
+    uint64_t end;
+} boot_phase_record_t;
+
+uint64_t boot_tsc_start = 0;
+
+static boot_phase_record_t boot_phases[BOOT_PHASES_MAX];
+static size_t boot_phase_count = 0;
+static uint32_t initcalls_run = 0;
+
+/**
+ * @brief Ends the current boot phase; it started where the previous one ended,
+ *        or at the boot loader handoff.
+ */
+void boot_phase(const char* name)
+{
+    if (boot_phase_count < BOOT_PHASES_MAX)
+    {
+        boot_phases[boot_phase_count].name = name;
+        boot_phases[boot_phase_count].end = rdtsc();
+        boot_phase_count++;
+    }
+}
+
+/**
+ * @brief Looks up an initcall by a name that is not NUL terminated.
+ */
+static initcall_t* initcall_find(const char* name, size_t len)
+{
+    for (initcall_t* call = __initcall_start; call < __initcall_end; call++)
+    {
+        size_t i = 0;
+        while (i < len && call->name[i] == name[i])
+        {
+            i++;
+        }
+        if (i == len && call->name[len] == '\0')
+        {
+            return call;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Looks up an initcall by name.
+ *
+ * @return The initcall, or NULL if none is registered under that name.
+ */
+const initcall_t* initcall_lookup(const char* name)
+{
+    return initcall_find(name, strlen(name));
+}
+
+/**
+ * @brief Returns 1 if every initcall `call` runs after has run.
+ *
+ * Names that match no initcall are reported and ignored.
+ */
+static int initcall_ready(initcall_t* call)
+{
+    const char* name = call->after;
+    if (name == NULL)
+    {
+        return 1;
+    }
+
+    while (*name != '\0')
+    {
+        while (*name == ' ')
+        {
+            name++;
+        }
+        size_t len = 0;
+        while (name[len] != '\0' && name[len] != ' ')
+        {
+            len++;
+        }
+        if (len == 0)
+        {
+            break;
+        }
+
+        initcall_t* dep = initcall_find(name, len);
+        if (dep == NULL)
+        {
+            pr_warn("init: %s runs after an unknown initcall\n", call->name);
+        }
+        else if (dep->order == 0)
+        {
+            return 0;
+        }
+        name += len;
+    }
+    return 1;
+}
+
+static void initcall_run(initcall_t* call)
+{
+    call->fn();
+    call->order = ++initcalls_run;
+    boot_phase(call->name);
+}
+
+/**
+ * @brief Runs every registered initcall, level by level.
+ *
+ * Within a level an initcall waits for the ones it names in `after`, and
+ * otherwise runs in link order. If none of the remaining ones can run, the
+ * dependencies form a cycle or name a later level; that is reported and
+ * they run in link order.
+ */
+void do_initcalls()
+{
+    initcall_t* level_start = __initcall_start;
+    while (level_start < __initcall_end)
+    {
+        initcall_t* level_end = level_start;
+        while (level_end < __initcall_end && level_end->level == level_start->level)
+        {
+            level_end++;
+        }
+
+        size_t pending = level_end - level_start;
+        while (pending > 0)
+        {
+            size_t ran = 0;
+            for (initcall_t* call = level_start; call < level_end; call++)
+            {
+                if (call->order == 0 && initcall_ready(call))
+                {
+                    initcall_run(call);
+                    ran++;
+                }
+            }
+
+            if (ran == 0)
+            {
+                initcall_t* call = level_start;
+                while (call->order != 0)
+                {
+                    call++;
+                }
+                pr_err("init: the dependencies of %s cannot be met at level %d\n", call->name, call->level);
+                initcall_run(call);
+                ran = 1;
+            }
+            pending -= ran;
+        }
+        level_start = level_end;
+    }
+}
+
+/**
+ * @brief Converts TSC cycles to microseconds, or returns the cycles if the TSC is not calibrated.
+ */
+static uint32_t boot_cycles_to_us(uint64_t cycles)
+{
+    if (tsc_khz == 0)
+    {
+        return (uint32_t)cycles;
+    }
+    return (uint32_t)div64_u32(cycles * 1000, tsc_khz);
+}
+
+/**
+ * @brief Prints how long each boot phase took, and the time from the boot
+ *        loader handoff to the end of the last one.
+ */
+void boot_report()
+{
+    const char* unit = tsc_khz != 0 ? "us" : "cycles";
+    uint64_t start = boot_tsc_start;
+
+    for (size_t i = 0; i < boot_phase_count; i++)
+    {
+        pr_info("boot: %s %d %s\n", boot_phases[i].name, boot_cycles_to_us(boot_phases[i].end - start), unit);
+        start = boot_phases[i].end;
+    }
+
+    uint64_t end = boot_phase_count != 0 ? boot_phases[boot_phase_count - 1].end : rdtsc();
+    kprintf("boot: ready in %d %s\n", boot_cycles_to_us(end - boot_tsc_start), unit);
+}
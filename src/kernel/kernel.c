@@ -1,19 +1,93 @@
 #include <kernel/kernel.h>
 
+/**
+ * @brief Mounts the first disk, whichever driver found it.
+ */
+static void mount_disk()
+{
+    if (blk_get_device(0) != NULL)
+    {
+        tarfs_mount(blk_get_device(0), "/disk");
+    }
+}
+INITCALL(INIT_LATE, mount_disk, NULL);
 
+#ifdef CONFIG_BOOT_TESTS
+/**
+ * @brief Runs the unit tests, after the boot report so they do not count towards boot time.
+ */
+static void run_boot_tests()
+{
+    run_init_tests();
+    verify_physical_memory();
+    test_highmem_mapping();
+    test_physical_pages_aligned();
+    run_paging_tests();
+    run_heap_tests();
+    run_vmalloc_tests();
+    run_initrd_tests();
+    run_bcache_tests();
+    run_page_cache_tests();
+    run_reclaim_tests();
+    run_memstat_tests();
+    run_trace_tests();
+    run_profile_tests();
+    run_pmu_tests();
+    run_softirq_tests();
+    run_workqueue_tests();
+    run_futex_tests();
+    run_timer_tests();
+    run_user_tests();
+    run_shell_tests();
+    run_net_tests();
+}
+#endif
 
 void kernel_main(multiboot_info_t* mbi)
 {
+    // The calibration window runs through early boot, see tsc_init()
+    tsc_calibrate_start();
 
     tty_init();
+    serial_init();
+#ifdef CONFIG_GCOV
+    gcov_init();
+#endif
+    boot_phase("console");
 
-    physical_memory_init(mbi->mem_upper * 1024);
+    physical_memory_init_mmap(mbi);
+    initrd_probe(mbi);
+    boot_phase("physical memory");
 
     paging_init();
-    kprintf("paging init.\n");
-    run_heap_tests();
+    pr_info("paging init.\n");
+    boot_phase("paging");
+
+    gdt_init();
+    idt_init();
+    smp_init();
+    tlb_cpu_init();
+    boot_phase("cpu");
+
+    tsc_init();
+    pmu_init();
+    boot_phase("tsc");
+    local_irq_enable();
+
+    do_initcalls();
+    boot_report();
+
+#ifdef CONFIG_BOOT_TESTS
+    run_boot_tests();
+#endif
+    memstat_dump_machine("boot");
+#ifdef CONFIG_GCOV
+    gcov_dump_serial();
+#endif
+
+    shell_run();
     /*
     heap_init();
-    kprintf("heap init.\n");
+    pr_info("heap init.\n");
 */
 }
\ No newline at end of file
@@ -1,15 +1,31 @@
 #include <kernel/tty/tty.h>
+#include <kernel/drivers/serial.h>
 #include <kprintf.h>
 #include <stdint.h>
 
+// Everything printed also goes to the serial port, if there is one, for logs on the host
+static void serial_console_putc(char c)
+{
+    if (c == '\n')
+    {
+        serial_putc('\r');
+    }
+    serial_putc(c);
+}
+
 static void print_string(const char* str)
 {
     tty_put_str(str);
+    for (size_t i = 0; str[i] != '\0'; i++)
+    {
+        serial_console_putc(str[i]);
+    }
 }
 
 static void print_char(char c)
 {
     tty_put_char(c);
+    serial_console_putc(c);
 }
 
 static void print_int(int num)
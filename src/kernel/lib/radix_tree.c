@@ -0,0 +1,229 @@
+#include <kernel/lib/radix_tree.h>
+
+/**
+ * @brief Returns the largest index a tree of the given height can hold.
+ */
+static uint32_t radix_tree_max_index(uint32_t height)
+{
+    if (height == 0)
+    {
+        return 0;
+    }
+    if (height * RADIX_TREE_MAP_SHIFT >= 32)
+    {
+        return 0xFFFFFFFF;
+    }
+    return (1u << (height * RADIX_TREE_MAP_SHIFT)) - 1;
+}
+
+static radix_tree_node_t* radix_tree_node_alloc()
+{
+    radix_tree_node_t* node = (radix_tree_node_t*)kmalloc(sizeof(radix_tree_node_t));
+    if (node != NULL)
+    {
+        memset(node, 0, sizeof(radix_tree_node_t));
+    }
+    return node;
+}
+
+void* radix_tree_lookup(const radix_tree_root_t* root, uint32_t index)
+{
+    if (root->node == NULL || index > radix_tree_max_index(root->height))
+    {
+        return NULL;
+    }
+
+    radix_tree_node_t* node = root->node;
+    for (uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT; shift > 0; shift -= RADIX_TREE_MAP_SHIFT)
+    {
+        node = (radix_tree_node_t*)node->slots[(index >> shift) & RADIX_TREE_MAP_MASK];
+        if (node == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    return node->slots[index & RADIX_TREE_MAP_MASK];
+}
+
+/**
+ * @brief Adds levels on top of the tree until it can hold `index`.
+ */
+static int radix_tree_extend(radix_tree_root_t* root, uint32_t index)
+{
+    uint32_t height = root->height ? root->height : 1;
+    while (index > radix_tree_max_index(height))
+    {
+        height++;
+    }
+
+    if (root->node == NULL)
+    {
+        root->height = height;
+        return 0;
+    }
+
+    while (root->height < height)
+    {
+        radix_tree_node_t* node = radix_tree_node_alloc();
+        if (node == NULL)
+        {
+            return -1;
+        }
+        node->slots[0] = root->node;
+        node->count = 1;
+        root->node = node;
+        root->height++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Stores `item` at `index`.
+ *
+ * @return 0 on success, -1 if the slot is taken or memory ran out.
+ */
+int radix_tree_insert(radix_tree_root_t* root, uint32_t index, void* item)
+{
+    if (radix_tree_extend(root, index) != 0)
+    {
+        return -1;
+    }
+
+    if (root->node == NULL)
+    {
+        root->node = radix_tree_node_alloc();
+        if (root->node == NULL)
+        {
+            return -1;
+        }
+    }
+
+    radix_tree_node_t* node = root->node;
+    for (uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT; shift > 0; shift -= RADIX_TREE_MAP_SHIFT)
+    {
+        void** slot = &node->slots[(index >> shift) & RADIX_TREE_MAP_MASK];
+        if (*slot == NULL)
+        {
+            *slot = radix_tree_node_alloc();
+            if (*slot == NULL)
+            {
+                return -1;
+            }
+            node->count++;
+        }
+        node = (radix_tree_node_t*)*slot;
+    }
+
+    void** slot = &node->slots[index & RADIX_TREE_MAP_MASK];
+    if (*slot != NULL)
+    {
+        return -1;
+    }
+    *slot = item;
+    node->count++;
+    return 0;
+}
+
+/**
+ * @brief Removes the item at `index`, freeing nodes that become empty.
+ *
+ * @return The removed item, or NULL if there was none.
+ */
+void* radix_tree_delete(radix_tree_root_t* root, uint32_t index)
+{
+    if (root->node == NULL || index > radix_tree_max_index(root->height))
+    {
+        return NULL;
+    }
+
+    radix_tree_node_t* path[RADIX_TREE_MAX_HEIGHT];
+    radix_tree_node_t* node = root->node;
+    uint32_t level = 0;
+
+    for (uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT; shift > 0; shift -= RADIX_TREE_MAP_SHIFT)
+    {
+        path[level++] = node;
+        node = (radix_tree_node_t*)node->slots[(index >> shift) & RADIX_TREE_MAP_MASK];
+        if (node == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    void* item = node->slots[index & RADIX_TREE_MAP_MASK];
+    if (item == NULL)
+    {
+        return NULL;
+    }
+    node->slots[index & RADIX_TREE_MAP_MASK] = NULL;
+    node->count--;
+
+    // Free empty nodes bottom up, clearing the parent's slot each time
+    uint32_t shift = 0;
+    while (node->count == 0)
+    {
+        kfree(node);
+        if (level == 0)
+        {
+            root->node = NULL;
+            root->height = 0;
+            break;
+        }
+
+        shift += RADIX_TREE_MAP_SHIFT;
+        node = path[--level];
+        node->slots[(index >> shift) & RADIX_TREE_MAP_MASK] = NULL;
+        node->count--;
+    }
+
+    return item;
+}
+
+/**
+ * @brief Collects up to `max` items in index order, starting at `start`.
+ *
+ * @return The number of items stored in `results`.
+ */
+size_t radix_tree_gang_lookup(const radix_tree_root_t* root, uint32_t start, void** results, size_t max)
+{
+    size_t found = 0;
+    uint32_t max_index = radix_tree_max_index(root->height);
+    if (root->node == NULL)
+    {
+        return 0;
+    }
+
+    uint32_t index = start;
+    while (found < max && index <= max_index)
+    {
+        // Descend as far as the path exists; skip a whole missing subtree at once
+        radix_tree_node_t* node = root->node;
+        uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT;
+        while (shift > 0)
+        {
+            radix_tree_node_t* child = (radix_tree_node_t*)node->slots[(index >> shift) & RADIX_TREE_MAP_MASK];
+            if (child == NULL)
+            {
+                break;
+            }
+            node = child;
+            shift -= RADIX_TREE_MAP_SHIFT;
+        }
+
+        uint32_t span = 1u << shift;
+        if (shift == 0 && node->slots[index & RADIX_TREE_MAP_MASK] != NULL)
+        {
+            results[found++] = node->slots[index & RADIX_TREE_MAP_MASK];
+        }
+
+        uint32_t next = (index & ~(span - 1)) + span;
+        if (next <= index)
+        {
+            break;
+        }
+        index = next;
+    }
+
+    return found;
+}
@@ -1,60 +1,214 @@
 #include <kernel/mm/heap.h>
+#include <kernel/trace/trace.h>
+#include <kernel/assert.h>
+#include <string.h>
 
-// 堆的起始地址和结束地址
+// 堆的起始地址和结束地址，堆在第一次分配时按需扩展
 static uintptr_t heap_start = HEAP_START;
-static uintptr_t heap_end = HEAP_START + HEAP_INIT_SIZE;
+static uintptr_t heap_end = HEAP_START;
 
-// 空闲块结构体
+// 空闲块结构体。已分配的块保留 size 作为头部，用户数据紧随其后
 typedef struct freeblock
 {
-    uint32_t size;        // 块大小
-    struct freeblock* next; // 指向下一个空闲块
+    uint32_t size;        // 块大小，包括头部
+    struct freeblock* next; // 指向下一个空闲块；已分配的块中记录调用点，kmalloc_a 的块中指向实际分配的块
 } freeblock_t;
 
-// 空闲块链表头
+// 块大小和地址按 8 字节对齐，最小的块要能放下一个头部和一点数据
+#define HEAP_ALIGN 8
+#define HEAP_MIN_BLOCK (2 * sizeof(freeblock_t))
+// kmalloc_a 返回的块在 size 中设置该位，next 指向实际分配的块
+#define HEAP_BLOCK_ALIGNED 0x80000000
+
+#ifdef CONFIG_DEBUG
+// 调试版本中新分配的内存和释放的内存分别用这两个字节填充，
+// 读到未初始化或已释放的内存时容易认出来
+#define HEAP_POISON_ALLOC 0xA5
+#define HEAP_POISON_FREE 0x6B
+#endif
+
+// 空闲块链表头，按地址排序，相邻的空闲块会被合并
 static freeblock_t* free_list = NULL;
 
-// 初始化堆
-void heap_init()
+#if HEAP_QUICK_CLASSES > 0
+// 快速分级的空闲块栈，块的数据大小正好是分级的大小
+static freeblock_t* quick_lists[HEAP_QUICK_CLASSES];
+#endif
+
+// 分配统计，空闲部分在 heap_get_stats 中计算
+static heap_stats_t heap_stats;
+
+#ifdef CONFIG_ALLOC_TRACK
+// 按调用点统计的分配，开放寻址
+static alloc_site_t alloc_sites[ALLOC_TRACK_SLOTS];
+#endif
+
+// 扩展堆时每批映射的页面数
+#define HEAP_EXPAND_BATCH 64
+
+// 扩展堆时分配页面可能触发内存回收，回收期间不能收缩正在扩展的堆
+static volatile int heap_expanding = 0;
+
+/**
+ * @brief 将一块内存放回空闲链表，并与相邻的空闲块合并。
+ */
+static void heap_insert_free(freeblock_t* block)
 {
-    // 将第一个空闲块设置为整个堆空间
-    free_list = (freeblock_t*)heap_start;
-    free_list->size = heap_end - heap_start;
-    free_list->next = NULL;
+    freeblock_t* prev = NULL;
+    freeblock_t* curr = free_list;
+
+    // 找到按地址排序的插入位置
+    while (curr != NULL && curr < block)
+    {
+        prev = curr;
+        curr = curr->next;
+    }
+
+    // 重复释放的块已经在空闲链表中，或者落在前一个空闲块里
+    ASSERT(curr != block);
+    ASSERT(prev == NULL || (uintptr_t)prev + prev->size <= (uintptr_t)block);
+
+    // 与后一个空闲块合并
+    if (curr != NULL && (uintptr_t)block + block->size == (uintptr_t)curr)
+    {
+        block->size += curr->size;
+        block->next = curr->next;
+    }
+    else
+    {
+        block->next = curr;
+    }
+
+    // 与前一个空闲块合并
+    if (prev != NULL && (uintptr_t)prev + prev->size == (uintptr_t)block)
+    {
+        prev->size += block->size;
+        prev->next = block->next;
+    }
+    else if (prev != NULL)
+    {
+        prev->next = block;
+    }
+    else
+    {
+        free_list = block;
+    }
 }
 
-// 扩展堆大小
-void* expand_heap(size_t size)
+// 尝试用一个大页映射 heap_end 处的虚拟地址，成功返回 1
+static int expand_heap_large_page()
 {
+    size_t pages = LARGE_PAGE_SIZE / PAGE_SIZE;
+    phys_addr_t frame = alloc_physical_pages_aligned(pages, pages);
+
+    if (frame == 0)
+    {
+        return 0;
+    }
+    if (map_large_page(heap_end, frame, PG_PRESENT | PG_WRITE | PG_NX) != 0)
+    {
+        free_physical_pages(frame, pages);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief 扩展堆，新映射的空间放入空闲链表。
+ *
+ * 物理内存不足时，已经映射的部分仍然放入空闲链表，不会映射无效的页面。
+ *
+ * @param size 至少需要扩展的字节数。
+ *
+ * @return 成功返回 0，物理内存不足返回 -1。
+ */
+static int expand_heap(size_t size)
+{
+    uintptr_t old_end = heap_end;
     // 计算新的堆结束地址
-    uintptr_t new_end = heap_end + size;
+    uintptr_t new_end = (heap_end + size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    phys_addr_t frames[HEAP_EXPAND_BATCH];
+    int failed = 0;
+
+    // 堆已经超过一个大页时按大页边界扩展，多出的部分留在空闲链表中，
+    // 这样之后的扩展都从对齐的地址开始，可以使用大页映射
+    if (paging_large_pages_supported() && new_end - heap_start >= LARGE_PAGE_SIZE)
+    {
+        new_end = (new_end + LARGE_PAGE_SIZE - 1) & ~(LARGE_PAGE_SIZE - 1);
+    }
+
+    heap_expanding = 1;
 
     // 循环分配物理页面，直到堆大小满足要求
-    while (heap_end < new_end)
+    while (heap_end < new_end && !failed)
     {
-        // 分配一个物理页面
-        void* page = alloc_physical_page();
-        kprintf("Allocated address: %x\n", page);
-        // 将物理页面映射到虚拟地址空间
-        map_page(heap_end, (uintptr_t)page, PG_PRESENT | PG_WRITE);
+        // 对齐且剩余空间足够一个大页时，优先使用大页，减少 TLB 项的占用
+        if ((heap_end & (LARGE_PAGE_SIZE - 1)) == 0 && new_end - heap_end >= LARGE_PAGE_SIZE &&
+            paging_large_pages_supported() && expand_heap_large_page())
+        {
+            heap_end += LARGE_PAGE_SIZE;
+            continue;
+        }
+
+        // 否则收集一批物理页面再一次性映射，避免每 4KB 遍历一次页表并刷新一次 TLB。
+        // 一批不跨越下一个大页边界，以便边界之后还能使用大页
+        uintptr_t batch_end = (heap_end + LARGE_PAGE_SIZE) & ~(LARGE_PAGE_SIZE - 1);
+        if (batch_end > new_end)
+        {
+            batch_end = new_end;
+        }
+
+        size_t count = 0;
+        while (count < HEAP_EXPAND_BATCH && heap_end + count * PAGE_SIZE < batch_end)
+        {
+            // 堆只通过页表访问，可以使用高端内存
+            phys_addr_t frame = alloc_highmem_page();
+            if (frame == 0)
+            {
+                failed = 1;
+                break;
+            }
+            frames[count++] = frame;
+        }
+
+        // 将这批物理页面映射到虚拟地址空间
+        map_pages(heap_end, frames, count, PG_PRESENT | PG_WRITE | PG_NX);
 
         // 更新堆结束地址
-        heap_end += PAGE_SIZE;
+        heap_end += count * PAGE_SIZE;
     }
-    // 返回扩展后的堆空间起始地址
-    return (void*)(heap_end - size);
 
+    heap_expanding = 0;
+
+    // 新映射的空间作为空闲块放入空闲链表
+    if (heap_end > old_end)
+    {
+        freeblock_t* block = (freeblock_t*)old_end;
+        block->size = heap_end - old_end;
+        heap_insert_free(block);
+    }
+
+    return heap_end - old_end >= size ? 0 : -1;
 }
 
-// 分配内存
-void* kmalloc(size_t size)
+// 初始化堆，预先映射 HEAP_INIT_SIZE 字节
+void heap_init()
 {
-    // 如果请求大小为0，则返回NULL
-    if (size == 0)
+    if (heap_end == heap_start)
     {
-        return NULL;
+        expand_heap(HEAP_INIT_SIZE);
     }
+}
 
+/**
+ * @brief 在空闲链表中查找并取出一个至少 size 字节的块。
+ *
+ * 默认使用首次适配；CONFIG_HEAP_BEST_FIT 时取最小的足够大的块，遇到大小正好的块就停止查找。
+ *
+ * @return 取出的块，如果没有足够大的空闲块则返回 NULL。
+ */
+static freeblock_t* heap_take_free(size_t size)
+{
     // 前一个空闲块和当前空闲块
     freeblock_t* prev = NULL;
     freeblock_t* curr = free_list;
@@ -65,77 +219,499 @@ void* kmalloc(size_t size)
         prev = curr;
         curr = curr->next;
     }
-
-    // 如果没有找到合适的空闲块，则扩展堆
     if (curr == NULL)
     {
-        curr = (freeblock_t*)expand_heap(size);
-        curr->size = size;
-        curr->next = NULL;
+        return NULL;
     }
 
-    // 如果当前空闲块大小足够，则将其分割
-    if (curr->size > size + sizeof(freeblock_t))
+#ifdef CONFIG_HEAP_BEST_FIT
+    for (freeblock_t* scan_prev = curr, *scan = curr->next; scan != NULL && curr->size != size; scan_prev = scan, scan = scan->next)
     {
-        // 创建新的空闲块
-        freeblock_t* new_block = (freeblock_t*)((uintptr_t)curr + size);
-        new_block->size = curr->size - size;
-        new_block->next = curr->next;
+        if (scan->size >= size && scan->size < curr->size)
+        {
+            prev = scan_prev;
+            curr = scan;
+        }
+    }
+#endif
 
-        // 更新当前空闲块大小
+    // 剩余部分足够一个最小块时将其分割，剩余部分留在链表中原来的位置
+    freeblock_t* rest = curr->next;
+    if (curr->size >= size + HEAP_MIN_BLOCK)
+    {
+        rest = (freeblock_t*)((uintptr_t)curr + size);
+        rest->size = curr->size - size;
+        rest->next = curr->next;
         curr->size = size;
-        curr->next = new_block;
     }
 
     // 从空闲链表中移除当前空闲块
     if (prev == NULL)
     {
-        free_list = curr->next;
+        free_list = rest;
     }
     else
     {
-        prev->next = curr->next;
+        prev->next = rest;
+    }
+
+    return curr;
+}
+
+/**
+ * @brief 返回数据大小对应的分级：2^HEAP_CLASS_MIN_SHIFT 字节及以下为 0，之后每级翻倍。
+ */
+static int heap_size_class(size_t size)
+{
+    int index = 0;
+    size_t class_size = (size_t)1 << HEAP_CLASS_MIN_SHIFT;
+
+    while (class_size < size && index < HEAP_CLASS_LARGE - 1)
+    {
+        class_size <<= 1;
+        index++;
+    }
+    return index;
+}
+
+#if HEAP_QUICK_CLASSES > 0
+/**
+ * @brief 返回数据大小为 data_size 的块所属的快速分级，不属于任何快速分级时返回 -1。
+ *
+ * 只有数据大小正好等于分级大小的块才放进快速分级，从栈中取出的块因此总是够大。
+ */
+static int heap_quick_class(size_t data_size)
+{
+    for (int class = 0; class < HEAP_QUICK_CLASSES; class++)
+    {
+        if (data_size == (size_t)1 << (HEAP_CLASS_MIN_SHIFT + class))
+        {
+            return class;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 把快速分级中的块全部放回空闲链表，与相邻的空闲块合并。
+ */
+static void heap_quick_drain()
+{
+    for (int class = 0; class < HEAP_QUICK_CLASSES; class++)
+    {
+        while (quick_lists[class] != NULL)
+        {
+            freeblock_t* block = quick_lists[class];
+            quick_lists[class] = block->next;
+            heap_insert_free(block);
+        }
     }
+}
+#endif
+
+#ifdef CONFIG_ALLOC_TRACK
+/**
+ * @brief 找到调用点在统计表中的位置，表满时返回 NULL，该调用点不被统计。
+ */
+static alloc_site_t* alloc_site_find(uintptr_t caller)
+{
+    uint32_t index = ((uint32_t)caller * 2654435761u) >> (32 - ALLOC_TRACK_BITS);
 
-    // 返回分配的内存地址
-    return (void*)curr;
+    for (size_t probe = 0; probe < ALLOC_TRACK_SLOTS; probe++)
+    {
+        alloc_site_t* site = &alloc_sites[(index + probe) & (ALLOC_TRACK_SLOTS - 1)];
+        if (site->caller == caller)
+        {
+            return site;
+        }
+        if (site->caller == 0)
+        {
+            site->caller = caller;
+            return site;
+        }
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * @brief 记录一次分配或释放。
+ *
+ * @param block 堆中的块，大块内存为 NULL。
+ * @param delta 分配为 1，释放为 -1。
+ */
+static void heap_account(freeblock_t* block, int delta)
+{
+    if (block == NULL)
+    {
+        if (delta > 0)
+        {
+            heap_stats.classes[HEAP_CLASS_LARGE].allocs++;
+        }
+        else
+        {
+            heap_stats.classes[HEAP_CLASS_LARGE].frees++;
+        }
+        return;
+    }
+
+    heap_class_stats_t* class = &heap_stats.classes[heap_size_class(block->size - sizeof(freeblock_t))];
+    if (delta > 0)
+    {
+        class->allocs++;
+        heap_stats.in_use += block->size;
+    }
+    else
+    {
+        class->frees++;
+        heap_stats.in_use -= block->size;
+    }
+
+#ifdef CONFIG_ALLOC_TRACK
+    // 已分配的块不使用 next，里面记录的是分配它的调用点
+    alloc_site_t* site = alloc_site_find((uintptr_t)block->next);
+    if (site != NULL)
+    {
+        if (delta > 0)
+        {
+            site->allocs++;
+            site->live_count++;
+            site->live_bytes += block->size;
+        }
+        else
+        {
+            site->live_count--;
+            site->live_bytes -= block->size;
+        }
+    }
+#endif
+}
+
+/**
+ * @brief kmalloc 和 kmalloc_a 的实现。
+ *
+ * @param caller 调用点，开启 CONFIG_ALLOC_TRACK 时按调用点统计。
+ */
+static void* heap_alloc(size_t size, uintptr_t caller)
+{
+    // 如果请求大小为0，则返回NULL
+    if (size == 0)
+    {
+        return NULL;
+    }
+
+    // 大块内存不需要物理连续，由 vmalloc 分配，释放后立即归还页面和虚拟地址
+    if (size >= HEAP_VMALLOC_THRESHOLD)
+    {
+        void* ptr = vmalloc(size);
+        if (ptr == NULL)
+        {
+            heap_stats.failures++;
+            return NULL;
+        }
+        heap_account(NULL, 1);
+        TRACE_EVENT(TRACE_KMALLOC, ptr, size, caller, 0);
+        return ptr;
+    }
+
+    // 块大小包括头部，并按 HEAP_ALIGN 对齐
+    size_t block_size = ((size + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1)) + sizeof(freeblock_t);
+    freeblock_t* block = NULL;
+
+#if HEAP_QUICK_CLASSES > 0
+    // 快速分级的请求向上取整到分级大小，优先复用同一分级释放的块
+    int class = heap_size_class(size);
+    if (class < HEAP_QUICK_CLASSES)
+    {
+        block_size = ((size_t)1 << (HEAP_CLASS_MIN_SHIFT + class)) + sizeof(freeblock_t);
+        block = quick_lists[class];
+        if (block != NULL)
+        {
+            quick_lists[class] = block->next;
+        }
+    }
+    if (block == NULL)
+    {
+        block = heap_take_free(block_size);
+    }
+#else
+    block = heap_take_free(block_size);
+#endif
+
+    // 如果没有找到合适的空闲块，则扩展堆后再找一次
+    if (block == NULL && expand_heap(block_size) == 0)
+    {
+        block = heap_take_free(block_size);
+    }
+    if (block == NULL)
+    {
+        heap_stats.failures++;
+        return NULL;
+    }
+
+#ifdef CONFIG_DEBUG
+    memset(block + 1, HEAP_POISON_ALLOC, block->size - sizeof(freeblock_t));
+#endif
+    block->next = (freeblock_t*)caller;
+    heap_account(block, 1);
+    TRACE_EVENT(TRACE_KMALLOC, block + 1, size, caller, 0);
+    return (void*)(block + 1);
+}
+
+// 分配内存
+void* kmalloc(size_t size)
+{
+#ifdef CONFIG_ALLOC_TRACK
+    return heap_alloc(size, (uintptr_t)__builtin_return_address(0));
+#else
+    return heap_alloc(size, 0);
+#endif
 }
 
 // 释放内存
 void kfree(void* ptr)
 {
-    // 将释放的块添加到空闲链表头部
-    freeblock_t* block = (freeblock_t*)ptr;
-    block->next = free_list;
-    free_list = block;
+    if (ptr == NULL)
+    {
+        return;
+    }
+    TRACE_EVENT(TRACE_KFREE, ptr, 0, 0, 0);
+
+    // vmalloc 分配的大块内存直接归还
+    if (is_vmalloc_addr(ptr))
+    {
+        heap_account(NULL, -1);
+        vfree(ptr);
+        return;
+    }
+
+    freeblock_t* block = (freeblock_t*)ptr - 1;
+
+    // kmalloc_a 返回的地址，释放实际分配的块
+    if (block->size & HEAP_BLOCK_ALIGNED)
+    {
+        kfree(block->next);
+        return;
+    }
+
+    ASSERT(block->size >= HEAP_MIN_BLOCK && (block->size & (HEAP_ALIGN - 1)) == 0);
+    heap_account(block, -1);
+#ifdef CONFIG_DEBUG
+    memset(block + 1, HEAP_POISON_FREE, block->size - sizeof(freeblock_t));
+#endif
+
+#if HEAP_QUICK_CLASSES > 0
+    int class = heap_quick_class(block->size - sizeof(freeblock_t));
+    if (class != -1)
+    {
+        block->next = quick_lists[class];
+        quick_lists[class] = block;
+        return;
+    }
+#endif
+
+    // 将释放的块按地址插回空闲链表并与相邻块合并
+    heap_insert_free(block);
 }
 
 // 分配页对齐的内存
 void* kmalloc_a(size_t size)
 {
-    // 计算总共需要的内存大小，包括头部和填充
-    size_t total_size = size + sizeof(freeblock_t);
-    uint32_t padding = (PAGE_SIZE - (total_size % PAGE_SIZE)) % PAGE_SIZE;
-    total_size += padding;
-
-    // 分配内存
-    void* ptr = kmalloc(total_size);
+    // 多分配一页和一个头部，保证对齐后的地址之前有放头部的空间
+#ifdef CONFIG_ALLOC_TRACK
+    void* ptr = heap_alloc(size + PAGE_SIZE + sizeof(freeblock_t), (uintptr_t)__builtin_return_address(0));
+#else
+    void* ptr = heap_alloc(size + PAGE_SIZE + sizeof(freeblock_t), 0);
+#endif
     if (ptr == NULL)
     {
         return NULL;
     }
 
+    // vmalloc 返回的地址本身就是页对齐的
+    if (((uintptr_t)ptr & (PAGE_SIZE - 1)) == 0)
+    {
+        return ptr;
+    }
+
     // 计算对齐的地址
-    uintptr_t aligned_ptr = ((uintptr_t)ptr + sizeof(freeblock_t) + padding) & ~(PAGE_SIZE - 1);
+    uintptr_t aligned_ptr = ((uintptr_t)ptr + sizeof(freeblock_t) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
 
-    // 设置空闲块头部信息
+    // 在对齐地址之前放一个头部，记录实际分配的块，供 kfree 使用
     freeblock_t* block = (freeblock_t*)aligned_ptr - 1;
-    block->size = total_size;
+    block->size = HEAP_BLOCK_ALIGNED;
+    block->next = (freeblock_t*)ptr;
 
     // 返回对齐后的内存地址
     return (void*)aligned_ptr;
 }
 
+/**
+ * @brief 获取堆的统计信息。
+ *
+ * 空闲部分的统计需要遍历空闲链表，快速分级中的块也算作空闲块。
+ */
+void heap_get_stats(heap_stats_t* stats)
+{
+    *stats = heap_stats;
+    stats->mapped = heap_end - heap_start;
+    stats->free = 0;
+    stats->free_blocks = 0;
+    stats->largest_free = 0;
+
+    for (freeblock_t* block = free_list; block != NULL; block = block->next)
+    {
+        stats->free += block->size;
+        stats->free_blocks++;
+        if (block->size > stats->largest_free)
+        {
+            stats->largest_free = block->size;
+        }
+    }
+
+#if HEAP_QUICK_CLASSES > 0
+    for (int class = 0; class < HEAP_QUICK_CLASSES; class++)
+    {
+        for (freeblock_t* block = quick_lists[class]; block != NULL; block = block->next)
+        {
+            stats->free += block->size;
+            stats->free_blocks++;
+        }
+    }
+#endif
+}
+
+#ifdef CONFIG_ALLOC_TRACK
+/**
+ * @brief 复制调用点统计表，没有使用的项的 caller 为 0。
+ *
+ * @return 复制的项数，最多 ALLOC_TRACK_SLOTS。
+ */
+size_t heap_get_alloc_sites(alloc_site_t* sites, size_t max)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < ALLOC_TRACK_SLOTS && count < max; i++)
+    {
+        if (alloc_sites[i].caller != 0)
+        {
+            sites[count++] = alloc_sites[i];
+        }
+    }
+    return count;
+}
+#endif
+
+/**
+ * @brief 将堆末尾空闲的页面归还给物理内存管理器。
+ *
+ * 堆至少保留 HEAP_MIN_SIZE 字节。快速分级中的块会先被放回空闲链表。用大页映射的部分只有整个大页都空闲时才归还。
+ *
+ * @param count 最多归还的页面数。
+ *
+ * @return 实际归还的页面数。
+ */
+size_t heap_trim(size_t count)
+{
+    if (heap_expanding)
+    {
+        return 0;
+    }
+
+#if HEAP_QUICK_CLASSES > 0
+    // 快速分级中的块先合并回空闲链表，堆末尾才可能空出来
+    heap_quick_drain();
+#endif
+
+    // 空闲链表按地址排序，最后一个块是唯一可能位于堆末尾的空闲块
+    freeblock_t* prev = NULL;
+    freeblock_t* last = free_list;
+    while (last != NULL && last->next != NULL)
+    {
+        prev = last;
+        last = last->next;
+    }
+    if (last == NULL || (uintptr_t)last + last->size != heap_end)
+    {
+        return 0;
+    }
+
+    // 该块所在的第一个完整页面之前的部分保留在链表中
+    uintptr_t floor = ((uintptr_t)last + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (floor < heap_start + HEAP_MIN_SIZE)
+    {
+        floor = heap_start + HEAP_MIN_SIZE;
+    }
+    if (heap_end > floor && (heap_end - floor) / PAGE_SIZE > count)
+    {
+        floor = heap_end - count * PAGE_SIZE;
+    }
+
+    size_t freed = 0;
+    phys_addr_t frames[HEAP_EXPAND_BATCH];
+
+    while (heap_end > floor)
+    {
+        uintptr_t addr = heap_end - PAGE_SIZE;
+
+        // 没有页表说明该地址由大页映射
+        if (get_pte(addr, 0) == NULL)
+        {
+            uintptr_t base = addr & ~(LARGE_PAGE_SIZE - 1);
+            if (base < floor)
+            {
+                break;
+            }
+
+            phys_addr_t frame = virt_to_phys(base);
+            unmap_range(base, LARGE_PAGE_SIZE);
+            free_physical_pages(frame, LARGE_PAGE_SIZE / PAGE_SIZE);
+            heap_end = base;
+            freed += LARGE_PAGE_SIZE / PAGE_SIZE;
+            continue;
+        }
+
+        // 收集一批 4KB 页面后一次性解除映射，只刷新一次 TLB
+        size_t batch = 0;
+        while (batch < HEAP_EXPAND_BATCH && heap_end - batch * PAGE_SIZE > floor)
+        {
+            uintptr_t page = heap_end - (batch + 1) * PAGE_SIZE;
+            pte_t* pte = get_pte(page, 0);
+            if (pte == NULL)
+            {
+                break;
+            }
+            frames[batch++] = *pte & PTE_ADDR_MASK;
+        }
+
+        heap_end -= batch * PAGE_SIZE;
+        unmap_range(heap_end, batch * PAGE_SIZE);
+        for (size_t i = 0; i < batch; i++)
+        {
+            free_highmem_page(frames[i]);
+        }
+        freed += batch;
+    }
+
+    // 缩小或移除末尾的空闲块
+    if (heap_end <= (uintptr_t)last)
+    {
+        if (prev == NULL)
+        {
+            free_list = NULL;
+        }
+        else
+        {
+            prev->next = NULL;
+        }
+    }
+    else
+    {
+        last->size = heap_end - (uintptr_t)last;
+    }
+
+    return freed;
+}
+
 // 测试用例：分配小块内存
 void test_small_allocation()
 {
@@ -0,0 +1,59 @@
+#include <kernel/mm/highmem.h>
+
+// Number of kmap_atomic slots in use on each CPU; slots are released in LIFO order
+static uint32_t kmap_depth[MAX_CPUS];
+
+/**
+ * @brief Temporarily maps a physical frame into the kernel.
+ *
+ * The mapping lives in a slot private to the executing CPU, so installing it
+ * only needs a local invlpg and never a shootdown. Mappings must be released
+ * with kunmap_atomic() in reverse order, and must not be held across a
+ * context switch.
+ *
+ * @param frame The physical address of the frame; may be above 4GB under PAE.
+ *
+ * @return The virtual address of the frame, or NULL if every slot is in use.
+ */
+void* kmap_atomic(phys_addr_t frame)
+{
+    uint32_t cpu = smp_processor_id();
+
+    // Claimed before the PTE is written: an interrupt, or get_pte() creating
+    // the page table, may nest another kmap_atomic() and must take the next slot
+    uint32_t slot = __atomic_fetch_add(&kmap_depth[cpu], 1, __ATOMIC_RELAXED);
+    if (slot >= KMAP_SLOTS_PER_CPU)
+    {
+        __atomic_fetch_sub(&kmap_depth[cpu], 1, __ATOMIC_RELAXED);
+        kprintf("kmap_atomic: out of slots on cpu %d\n", cpu);
+        return NULL;
+    }
+
+    uintptr_t virtual_addr = KMAP_BASE + (cpu * KMAP_SLOTS_PER_CPU + slot) * PAGE_SIZE;
+    pte_t* pte = get_pte(virtual_addr, 1);
+    if (pte == NULL)
+    {
+        __atomic_fetch_sub(&kmap_depth[cpu], 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    *pte = (frame & PTE_ADDR_MASK) | PG_PRESENT | PG_WRITE;
+    tlb_invalidate_page(virtual_addr);
+
+    return (void*)virtual_addr;
+}
+
+/**
+ * @brief Releases the most recent kmap_atomic() mapping of the executing CPU.
+ *
+ * @param addr The address returned by kmap_atomic().
+ */
+void kunmap_atomic(void* addr)
+{
+    uint32_t cpu = smp_processor_id();
+    uintptr_t virtual_addr = (uintptr_t)addr & ~(PAGE_SIZE - 1);
+
+    *get_pte(virtual_addr, 0) = 0;
+    tlb_invalidate_page(virtual_addr);
+    __atomic_fetch_sub(&kmap_depth[cpu], 1, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,212 @@
+#include <kernel/mm/memstat.h>
+
+static const char* zone_names[NR_ZONES] = { "lowmem", "highmem" };
+
+static inline uint32_t pages_to_kb(size_t pages)
+{
+    return pages * (PAGE_SIZE / 1024);
+}
+
+/**
+ * @brief Percentage of free heap bytes outside the largest free block.
+ *
+ * 0 means all free space is one block; close to 100 means it is scattered
+ * in pieces too small for larger requests.
+ */
+static uint32_t heap_fragmentation(const heap_stats_t* heap)
+{
+    size_t free = heap->free;
+    size_t largest = heap->largest_free;
+
+    // Scale down so the multiplication fits in 32 bits
+    while (free >= 0x1000000)
+    {
+        free >>= 4;
+        largest >>= 4;
+    }
+    if (free == 0)
+    {
+        return 0;
+    }
+    return 100 - largest * 100 / free;
+}
+
+/**
+ * @brief Prints a /proc/meminfo style summary.
+ */
+void memstat_dump_meminfo()
+{
+    zone_stats_t zones[NR_ZONES];
+    heap_stats_t heap;
+    bcache_stats_t bcache;
+    reclaim_stats_t reclaim;
+    size_t min, low, high;
+
+    for (int zone = 0; zone < NR_ZONES; zone++)
+    {
+        physical_memory_zone_stats(zone, &zones[zone]);
+    }
+    heap_get_stats(&heap);
+    bcache_get_stats(&bcache);
+    reclaim_get_stats(&reclaim);
+    reclaim_get_watermarks(&min, &low, &high);
+
+    kprintf("MemTotal:        %d kB\n", pages_to_kb(get_total_page_count()));
+    kprintf("MemFree:         %d kB\n", pages_to_kb(get_free_page_count()));
+    for (int zone = 0; zone < NR_ZONES; zone++)
+    {
+        kprintf("%s: total %d kB, free %d kB, used %d kB, reserved %d kB\n", zone_names[zone],
+            pages_to_kb(zones[zone].total), pages_to_kb(zones[zone].free),
+            pages_to_kb(zones[zone].used), pages_to_kb(zones[zone].reserved));
+    }
+    kprintf("Watermarks:      min %d low %d high %d kB\n", pages_to_kb(min), pages_to_kb(low), pages_to_kb(high));
+    kprintf("HeapMapped:      %d kB\n", heap.mapped / 1024);
+    kprintf("HeapInUse:       %d bytes\n", heap.in_use);
+    kprintf("HeapFree:        %d bytes in %d blocks, largest %d, fragmentation %d percent\n",
+        heap.free, heap.free_blocks, heap.largest_free, heap_fragmentation(&heap));
+    kprintf("HeapFailures:    %d\n", heap.failures);
+    kprintf("Vmalloc:         %d kB\n", pages_to_kb(vmalloc_used_pages()));
+    kprintf("PageCache:       %d kB\n", pages_to_kb(page_cache_pages()));
+    kprintf("Buffers:         %d kB, %d dirty\n", bcache.buffers * (BCACHE_BLOCK_SIZE / 1024), bcache.dirty);
+    kprintf("Reclaimed:       %d pages, %d background, %d direct, %d failed allocations\n",
+        reclaim.pages_reclaimed, reclaim.background_runs, reclaim.direct_runs, reclaim.failures);
+}
+
+/**
+ * @brief Prints kmalloc activity per size class, in the spirit of /proc/slabinfo.
+ */
+void memstat_dump_slabinfo()
+{
+    heap_stats_t heap;
+    heap_get_stats(&heap);
+
+    kprintf("class           active    allocs     frees\n");
+    for (int i = 0; i < HEAP_CLASS_COUNT; i++)
+    {
+        heap_class_stats_t* class = &heap.classes[i];
+        if (class->allocs == 0)
+        {
+            continue;
+        }
+
+        if (i == HEAP_CLASS_LARGE)
+        {
+            kprintf("kmalloc-large ");
+        }
+        else
+        {
+            kprintf("kmalloc-%d ", 1 << (HEAP_CLASS_MIN_SHIFT + i));
+        }
+        kprintf("%d %d %d\n", class->allocs - class->frees, class->allocs, class->frees);
+    }
+}
+
+/**
+ * @brief Prints the call sites holding the most heap memory.
+ *
+ * Only available in builds made with ALLOC_TRACK=1. Allocations served by
+ * vmalloc are not attributed to call sites.
+ */
+void memstat_dump_callers()
+{
+#ifdef CONFIG_ALLOC_TRACK
+    static alloc_site_t sites[ALLOC_TRACK_SLOTS];
+    size_t count = heap_get_alloc_sites(sites, ALLOC_TRACK_SLOTS);
+
+    kprintf("caller      live bytes  live count  allocs\n");
+    for (size_t shown = 0; shown < MEMSTAT_TOP_CALLERS && shown < count; shown++)
+    {
+        // Selection sort of the head of the array; the table is small
+        size_t best = shown;
+        for (size_t i = shown + 1; i < count; i++)
+        {
+            if (sites[i].live_bytes > sites[best].live_bytes)
+            {
+                best = i;
+            }
+        }
+        alloc_site_t site = sites[best];
+        sites[best] = sites[shown];
+        sites[shown] = site;
+
+        kprintf("%x %d %d %d\n", site.caller, site.live_bytes, site.live_count, site.allocs);
+    }
+#else
+    kprintf("memstat: call site tracking is off, build with ALLOC_TRACK=1\n");
+#endif
+}
+
+/**
+ * @brief Prints every counter as one `memstat <tag> key=value ...` line per
+ *        group, for scripts collecting results at the end of a run.
+ */
+void memstat_dump_machine(const char* tag)
+{
+    zone_stats_t zone;
+    heap_stats_t heap;
+    reclaim_stats_t reclaim;
+
+    heap_get_stats(&heap);
+    reclaim_get_stats(&reclaim);
+
+    for (int i = 0; i < NR_ZONES; i++)
+    {
+        physical_memory_zone_stats(i, &zone);
+        kprintf("memstat %s zone=%s total=%d free=%d used=%d reserved=%d\n", tag, zone_names[i],
+            zone.total, zone.free, zone.used, zone.reserved);
+    }
+
+    kprintf("memstat %s heap mapped=%d in_use=%d free=%d free_blocks=%d largest_free=%d fragmentation=%d failures=%d\n",
+        tag, heap.mapped, heap.in_use, heap.free, heap.free_blocks, heap.largest_free,
+        heap_fragmentation(&heap), heap.failures);
+
+    for (int i = 0; i < HEAP_CLASS_COUNT; i++)
+    {
+        if (heap.classes[i].allocs != 0)
+        {
+            kprintf("memstat %s class=%d size=%d allocs=%d frees=%d\n", tag, i,
+                i == HEAP_CLASS_LARGE ? 0 : 1 << (HEAP_CLASS_MIN_SHIFT + i),
+                heap.classes[i].allocs, heap.classes[i].frees);
+        }
+    }
+
+    kprintf("memstat %s caches vmalloc=%d page_cache=%d\n", tag, vmalloc_used_pages(), page_cache_pages());
+    kprintf("memstat %s reclaim pages=%d background=%d direct=%d failures=%d\n", tag,
+        reclaim.pages_reclaimed, reclaim.background_runs, reclaim.direct_runs, reclaim.failures);
+
+#ifdef CONFIG_ALLOC_TRACK
+    static alloc_site_t sites[ALLOC_TRACK_SLOTS];
+    size_t count = heap_get_alloc_sites(sites, ALLOC_TRACK_SLOTS);
+    for (size_t i = 0; i < count; i++)
+    {
+        kprintf("memstat %s site=%x live_bytes=%d live_count=%d allocs=%d\n", tag,
+            sites[i].caller, sites[i].live_bytes, sites[i].live_count, sites[i].allocs);
+    }
+#endif
+}
+
+/**
+ * @brief Runs a single-key memory statistics command.
+ *
+ * @return 1 if the key was a command, 0 otherwise.
+ */
+int memstat_command(int command)
+{
+    switch (command)
+    {
+    case MEMSTAT_CMD_MEMINFO:
+        memstat_dump_meminfo();
+        return 1;
+    case MEMSTAT_CMD_SLABINFO:
+        memstat_dump_slabinfo();
+        return 1;
+    case MEMSTAT_CMD_CALLERS:
+        memstat_dump_callers();
+        return 1;
+    case MEMSTAT_CMD_MACHINE:
+        memstat_dump_machine("now");
+        return 1;
+    default:
+        return 0;
+    }
+}
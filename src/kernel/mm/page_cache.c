@@ -0,0 +1,494 @@
+#include <kernel/mm/page_cache.h>
+
+// A file range mapped by file_mmap(); the mapping holds a reference on each page
+typedef struct file_mapping
+{
+    void* addr;
+    size_t count;
+    page_t** pages;
+    struct file_mapping* next;
+} file_mapping_t;
+
+// Every cached page, most recently used first. Lock order: an inode's lock is
+// never held while taking this one, while reclaim takes an inode lock under it.
+static spinlock_t page_lru_lock = SPINLOCK_INIT;
+static page_t* page_lru_head = NULL;
+static page_t* page_lru_tail = NULL;
+static size_t page_count = 0;
+
+static spinlock_t file_mappings_lock = SPINLOCK_INIT;
+static file_mapping_t* file_mappings = NULL;
+
+static inline uint32_t inode_page_count(inode_t* inode)
+{
+    return (inode->size + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+static void page_lru_remove(page_t* page)
+{
+    if (page->lru_prev)
+    {
+        page->lru_prev->lru_next = page->lru_next;
+    }
+    else
+    {
+        page_lru_head = page->lru_next;
+    }
+
+    if (page->lru_next)
+    {
+        page->lru_next->lru_prev = page->lru_prev;
+    }
+    else
+    {
+        page_lru_tail = page->lru_prev;
+    }
+}
+
+static void page_lru_push_front(page_t* page)
+{
+    page->lru_prev = NULL;
+    page->lru_next = page_lru_head;
+    if (page_lru_head)
+    {
+        page_lru_head->lru_prev = page;
+    }
+    else
+    {
+        page_lru_tail = page;
+    }
+    page_lru_head = page;
+}
+
+static void page_free(page_t* page)
+{
+    if (!(page->flags & PAGE_SHARED_FRAME))
+    {
+        free_highmem_page(page->phys);
+    }
+    kfree(page);
+}
+
+/**
+ * @brief Looks a page up and takes a reference on it.
+ */
+static page_t* page_cache_find(inode_t* inode, uint32_t index)
+{
+    spin_lock(&inode->lock);
+    page_t* page = (page_t*)radix_tree_lookup(&inode->pages, index);
+    if (page != NULL)
+    {
+        __atomic_fetch_add(&page->refcount, 1, __ATOMIC_ACQUIRE);
+    }
+    spin_unlock(&inode->lock);
+
+    if (page != NULL)
+    {
+        spin_lock(&page_lru_lock);
+        page_lru_remove(page);
+        page_lru_push_front(page);
+        spin_unlock(&page_lru_lock);
+    }
+    return page;
+}
+
+/**
+ * @brief Inserts a new page for `index` and starts filling it.
+ *
+ * Pages the filesystem can share are up to date at once; the others get a
+ * fresh frame and a read through the filesystem's readpage.
+ *
+ * @return 1 if a page was added, 0 if one already existed or memory ran out.
+ */
+static int page_cache_add(inode_t* inode, uint32_t index)
+{
+    page_t* page = (page_t*)kmalloc(sizeof(page_t));
+    if (page == NULL)
+    {
+        return 0;
+    }
+
+    page->inode = inode;
+    page->index = index;
+    page->refcount = 1;
+    page->phys = inode->ops->share_page ? inode->ops->share_page(inode, index) : 0;
+    if (page->phys != 0)
+    {
+        page->flags = PAGE_UPTODATE | PAGE_SHARED_FRAME;
+    }
+    else
+    {
+        page->phys = alloc_highmem_page();
+        page->flags = PAGE_IO;
+        if (page->phys == 0)
+        {
+            kfree(page);
+            return 0;
+        }
+    }
+
+    spin_lock(&inode->lock);
+    if (radix_tree_insert(&inode->pages, index, page) != 0)
+    {
+        spin_unlock(&inode->lock);
+        page_free(page);
+        return 0;
+    }
+    inode->nr_pages++;
+    spin_unlock(&inode->lock);
+
+    spin_lock(&page_lru_lock);
+    page_lru_push_front(page);
+    page_count++;
+    spin_unlock(&page_lru_lock);
+
+    if (page->flags & PAGE_IO)
+    {
+        inode->ops->readpage(inode, page);
+    }
+
+    page_cache_release(page);
+    return 1;
+}
+
+/**
+ * @brief Adds and starts reading pages [start, end) that are not cached yet.
+ *
+ * Block-backed reads are queued together and dispatched once, so adjacent
+ * pages go to the device as merged requests.
+ */
+static void page_cache_read_range(inode_t* inode, uint32_t start, uint32_t end)
+{
+    uint32_t pages = inode_page_count(inode);
+    if (end > pages)
+    {
+        end = pages;
+    }
+
+    for (uint32_t index = start; index < end; index++)
+    {
+        spin_lock(&inode->lock);
+        int cached = radix_tree_lookup(&inode->pages, index) != NULL;
+        spin_unlock(&inode->lock);
+
+        if (!cached && !page_cache_add(inode, index) && index == start)
+        {
+            break;
+        }
+    }
+
+    if (inode->bdev != NULL)
+    {
+        blk_run_queue(inode->bdev);
+    }
+}
+
+/**
+ * @brief Keeps a window of pages ahead of a sequential reader.
+ *
+ * The window doubles on each sequential access up to the maximum; a random
+ * access resets it. Races between CPUs only make the window less accurate.
+ */
+static void page_cache_readahead(inode_t* inode, uint32_t index)
+{
+    if (index != inode->ra_next)
+    {
+        inode->ra_window = 0;
+        inode->ra_next = index + 1;
+        inode->ra_end = index + 1;
+        return;
+    }
+
+    inode->ra_next = index + 1;
+    inode->ra_window = inode->ra_window ? inode->ra_window * 2 : PAGE_CACHE_READAHEAD_MIN;
+    if (inode->ra_window > PAGE_CACHE_READAHEAD_MAX)
+    {
+        inode->ra_window = PAGE_CACHE_READAHEAD_MAX;
+    }
+
+    // Refill once the reader has consumed half of what is already in flight
+    if (inode->ra_end > index + inode->ra_window / 2)
+    {
+        return;
+    }
+
+    uint32_t start = inode->ra_end > index + 1 ? inode->ra_end : index + 1;
+    uint32_t end = index + 1 + inode->ra_window;
+    page_cache_read_range(inode, start, end);
+    inode->ra_end = end;
+}
+
+/**
+ * @brief Returns a referenced, up-to-date page of a file.
+ *
+ * A missing page is read together with the following ones; sequential
+ * access keeps read-ahead running. Release the page with page_cache_release().
+ *
+ * @return The page, or NULL past the end of the file or on an I/O error.
+ */
+page_t* page_cache_get(inode_t* inode, uint32_t index)
+{
+    if (index >= inode_page_count(inode))
+    {
+        return NULL;
+    }
+
+    page_t* page = page_cache_find(inode, index);
+    if (page == NULL)
+    {
+        page_cache_read_range(inode, index, index + PAGE_CACHE_READAHEAD_MIN);
+        page = page_cache_find(inode, index);
+        if (page == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    page_cache_readahead(inode, index);
+
+    while (__atomic_load_n(&page->flags, __ATOMIC_ACQUIRE) & PAGE_IO)
+    {
+        if (inode->bdev != NULL)
+        {
+            blk_poll(inode->bdev);
+        }
+        cpu_relax();
+    }
+
+    if (!(page->flags & PAGE_UPTODATE))
+    {
+        page_cache_release(page);
+        return NULL;
+    }
+    return page;
+}
+
+void page_cache_release(page_t* page)
+{
+    __atomic_fetch_sub(&page->refcount, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Completes a read started by a filesystem's readpage.
+ */
+void page_end_read(page_t* page, int uptodate)
+{
+    __atomic_or_fetch(&page->flags, uptodate ? PAGE_UPTODATE : PAGE_ERROR, __ATOMIC_RELAXED);
+    __atomic_and_fetch(&page->flags, ~PAGE_IO, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Bio completion for filesystems that read into `page->bio`.
+ */
+void page_end_io(bio_t* bio)
+{
+    page_end_read((page_t*)bio->private, bio->status == BIO_OK);
+}
+
+/**
+ * @brief Drops up to `count` unreferenced pages, least recently used first.
+ *
+ * Pages are clean, since file data is read-only, so nothing needs writing back.
+ * Inodes whose lock is busy are skipped: reclaim can run from an allocation
+ * made under that lock.
+ *
+ * @return The number of pages dropped.
+ */
+size_t page_cache_shrink(size_t count)
+{
+    size_t freed = 0;
+
+    spin_lock(&page_lru_lock);
+
+    page_t* page = page_lru_tail;
+    while (page != NULL && freed < count)
+    {
+        page_t* prev = page->lru_prev;
+
+        if (page->refcount == 0 && !(page->flags & PAGE_IO))
+        {
+            // Check again under the inode lock, which lookups take a reference under
+            inode_t* inode = page->inode;
+            int idle = 0;
+            if (spin_trylock(&inode->lock))
+            {
+                idle = page->refcount == 0;
+                if (idle)
+                {
+                    radix_tree_delete(&inode->pages, page->index);
+                    inode->nr_pages--;
+                }
+                spin_unlock(&inode->lock);
+            }
+
+            if (idle)
+            {
+                page_lru_remove(page);
+                page_count--;
+                page_free(page);
+                freed++;
+            }
+        }
+
+        page = prev;
+    }
+
+    spin_unlock(&page_lru_lock);
+    return freed;
+}
+
+size_t page_cache_pages()
+{
+    return page_count;
+}
+
+/**
+ * @brief Copies file data through the page cache.
+ *
+ * @return The number of bytes copied; short at the end of the file or on an I/O error.
+ */
+size_t file_read(inode_t* inode, uint64_t offset, void* buffer, size_t size)
+{
+    if (offset >= inode->size)
+    {
+        return 0;
+    }
+    if (size > inode->size - offset)
+    {
+        size = inode->size - offset;
+    }
+
+    size_t done = 0;
+    while (done < size)
+    {
+        uint64_t position = offset + done;
+        uint32_t in_page = position & (PAGE_SIZE - 1);
+        size_t chunk = PAGE_SIZE - in_page;
+        if (chunk > size - done)
+        {
+            chunk = size - done;
+        }
+
+        page_t* page = page_cache_get(inode, position / PAGE_SIZE);
+        if (page == NULL)
+        {
+            break;
+        }
+
+        uint8_t* data = (uint8_t*)kmap_atomic(page->phys);
+        memcpy((uint8_t*)buffer + done, data + in_page, chunk);
+        kunmap_atomic(data);
+        page_cache_release(page);
+
+        done += chunk;
+    }
+
+    return done;
+}
+
+/**
+ * @brief Maps a range of a file read-only into the kernel.
+ *
+ * The page tables point straight at the cached frames, so no data is
+ * copied. The pages stay referenced, and cannot be reclaimed, until
+ * file_munmap().
+ *
+ * @param offset Start of the range; must be page aligned.
+ * @param length Length of the range, clipped to the end of the file.
+ *
+ * @return The address of the mapping, or NULL.
+ */
+void* file_mmap(inode_t* inode, uint64_t offset, size_t length)
+{
+    if ((offset & (PAGE_SIZE - 1)) != 0 || offset >= inode->size)
+    {
+        return NULL;
+    }
+    if (length > inode->size - offset)
+    {
+        length = inode->size - offset;
+    }
+
+    uint32_t first = offset / PAGE_SIZE;
+    size_t count = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    file_mapping_t* mapping = (file_mapping_t*)kmalloc(sizeof(file_mapping_t));
+    page_t** pages = (page_t**)kmalloc(count * sizeof(page_t*));
+    phys_addr_t* frames = (phys_addr_t*)kmalloc(count * sizeof(phys_addr_t));
+    if (mapping == NULL || pages == NULL || frames == NULL)
+    {
+        kfree(mapping);
+        kfree(pages);
+        kfree(frames);
+        return NULL;
+    }
+
+    size_t got = 0;
+    for (; got < count; got++)
+    {
+        pages[got] = page_cache_get(inode, first + got);
+        if (pages[got] == NULL)
+        {
+            break;
+        }
+        frames[got] = pages[got]->phys;
+    }
+
+    void* addr = got == count ? vmap_pages(frames, count, PG_NX) : NULL;
+    kfree(frames);
+
+    if (addr == NULL)
+    {
+        for (size_t i = 0; i < got; i++)
+        {
+            page_cache_release(pages[i]);
+        }
+        kfree(pages);
+        kfree(mapping);
+        return NULL;
+    }
+
+    mapping->addr = addr;
+    mapping->count = count;
+    mapping->pages = pages;
+
+    spin_lock(&file_mappings_lock);
+    mapping->next = file_mappings;
+    file_mappings = mapping;
+    spin_unlock(&file_mappings_lock);
+
+    return addr;
+}
+
+/**
+ * @brief Removes a mapping made by file_mmap() and drops its page references.
+ */
+void file_munmap(void* addr)
+{
+    spin_lock(&file_mappings_lock);
+    file_mapping_t** link = &file_mappings;
+    while (*link != NULL && (*link)->addr != addr)
+    {
+        link = &(*link)->next;
+    }
+    file_mapping_t* mapping = *link;
+    if (mapping != NULL)
+    {
+        *link = mapping->next;
+    }
+    spin_unlock(&file_mappings_lock);
+
+    if (mapping == NULL)
+    {
+        kprintf("file_munmap: no mapping at %x\n", addr);
+        return;
+    }
+
+    vunmap(addr);
+    for (size_t i = 0; i < mapping->count; i++)
+    {
+        page_cache_release(mapping->pages[i]);
+    }
+    kfree(mapping->pages);
+    kfree(mapping);
+}
@@ -1,131 +1,694 @@
 #include <kernel/mm/paging.h>
+#include <kernel/mm/highmem.h>
+#include <kernel/mm/heap.h>
+#include <kernel/trace/trace.h>
 
-// Page directory, covering 4GB of virtual memory (1024 entries * 4MB per entry)
-uint32_t page_directory[PAGE_DIRECTORY_SIZE]__attribute__((aligned(PAGE_SIZE)));
+// Page directory, covering 4GB of virtual memory (1024 entries * 4MB per entry,
+// or under PAE four consecutive directories of 512 entries * 2MB per entry)
+pte_t page_directory[PAGE_DIRECTORY_SIZE]__attribute__((aligned(PAGE_SIZE)));
 
-// Page tables, one for each entry in the page directory
-// Each page table covers 4MB of virtual memory (1024 entries * 4KB per entry)
-uint32_t page_tables[PAGE_DIRECTORY_SIZE][PAGE_TABLE_SIZE]__attribute__((aligned(PAGE_SIZE)));
+#ifdef CONFIG_PAE
+// Page directory pointer table, one entry per directory in page_directory
+static uint64_t page_directory_pointer_table[4]__attribute__((aligned(32)));
+#endif
+
+// Page table(s) identity mapping the first 4MB, which holds the kernel image, the VGA buffer and the bitmap
+// Every other page table is allocated on demand and reached through the recursive slot
+pte_t low_page_table[LOW_IDENTITY_SIZE / PAGE_SIZE]__attribute__((aligned(PAGE_SIZE)));
+
+// Entry bits the processor accepts; PG_NX is cleared when the CPU does not support it
+static pte_t pte_supported_mask = ~(pte_t)PG_NX;
+
+// Set once CR0.PG is on; from then on page tables are only reachable through the recursive slot
+static int paging_enabled = 0;
+
+// Set when directory entries may map LARGE_PAGE_SIZE pages (PSE, or always under PAE)
+static int large_pages_enabled = 0;
+
+// User address spaces; page_directory above serves kernel threads and holds
+// the master copy of the kernel entries
+static address_space_t* address_spaces = NULL;
+static size_t address_spaces_count = 0;
+static spinlock_t address_spaces_lock = SPINLOCK_INIT;
+
+/**
+ * @brief Returns the page directory of the running address space.
+ *
+ * Before paging is enabled the directory is addressed physically, afterwards
+ * through the recursive slot, which always maps the directory loaded in CR3.
+ */
+static inline pte_t* current_page_directory()
+{
+    return paging_enabled ? (pte_t*)RECURSIVE_PD_ADDR : page_directory;
+}
+
+/**
+ * @brief Returns non-zero if a directory entry is shared by every address space.
+ *
+ * Everything outside the user range is kernel memory, except for the
+ * recursive slots, which each directory points back at itself.
+ */
+static inline int page_dir_shared(uint32_t page_dir_idx)
+{
+    return (page_dir_idx < PAGE_DIR_INDEX(USER_SPACE_START) || page_dir_idx >= PAGE_DIR_INDEX(USER_SPACE_END)) &&
+        page_dir_idx < RECURSIVE_PDE_INDEX;
+}
+
+/**
+ * @brief Returns the entry of an address space's directory with a linear index.
+ *
+ * The directory frames are low memory, so they are reached through the
+ * direct map whether or not the address space is loaded.
+ */
+static inline pte_t* address_space_entry(const address_space_t* space, uint32_t page_dir_idx)
+{
+    pte_t* directory = (pte_t*)phys_to_virt(space->directories[page_dir_idx / PAGE_TABLE_SIZE]);
+    return &directory[page_dir_idx % PAGE_TABLE_SIZE];
+}
+
+/**
+ * @brief Writes a directory entry of the running address space.
+ *
+ * Kernel entries are written to every address space at once, so a page
+ * table the kernel adds or a large page it splits is seen by all of them;
+ * the page tables themselves are shared and need no copying.
+ */
+static void set_page_dir_entry(uint32_t page_dir_idx, pte_t entry)
+{
+    current_page_directory()[page_dir_idx] = entry;
+    if (!paging_enabled || !page_dir_shared(page_dir_idx))
+    {
+        return;
+    }
+
+    spin_lock(&address_spaces_lock);
+    page_directory[page_dir_idx] = entry;
+    for (address_space_t* space = address_spaces; space != NULL; space = space->next)
+    {
+        *address_space_entry(space, page_dir_idx) = entry;
+    }
+    spin_unlock(&address_spaces_lock);
+}
+
+/**
+ * @brief Returns the address at which a page table can be accessed.
+ *
+ * @param page_dir_idx The page directory index the table is installed at.
+ * @param page_dir_entry The directory entry pointing to the table.
+ */
+static inline pte_t* page_table_address(uint32_t page_dir_idx, pte_t page_dir_entry)
+{
+    if (paging_enabled)
+    {
+        return (pte_t*)(RECURSIVE_PT_BASE + page_dir_idx * PAGE_SIZE);
+    }
+    return (pte_t*)(uintptr_t)(page_dir_entry & PTE_ADDR_MASK);
+}
+
+static pte_t* split_large_page(uint32_t page_dir_idx);
+
+/**
+ * @brief Returns the page table covering a page directory entry.
+ *
+ * @param page_dir_idx The page directory index, see PAGE_DIR_INDEX().
+ * @param create Allocate and install an empty page table if none is present.
+ * @param flags The mapping flags; only PG_ALLOW_USER is propagated to the directory entry.
+ *
+ * @return The page table, or NULL if it is absent and could not be created.
+ */
+static pte_t* get_page_table(uint32_t page_dir_idx, int create, pte_t flags)
+{
+    pte_t* page_dir = current_page_directory();
+    pte_t page_dir_entry = page_dir[page_dir_idx];
+
+    // A large page has no table; one is only made up when a caller needs 4KB granularity
+    if ((page_dir_entry & PG_PRESENT) && (page_dir_entry & PG_PDE_4MB))
+    {
+        return create ? split_large_page(page_dir_idx) : NULL;
+    }
+
+    if (page_dir_entry & PG_PRESENT)
+    {
+        // A user mapping inside a supervisor-only table needs the directory entry opened up too
+        if ((flags & PG_ALLOW_USER) && !(page_dir_entry & PG_ALLOW_USER))
+        {
+            set_page_dir_entry(page_dir_idx, page_dir_entry | PG_ALLOW_USER);
+        }
+        return page_table_address(page_dir_idx, page_dir_entry);
+    }
+
+    if (!create)
+    {
+        return NULL;
+    }
+
+    // Page tables are only ever touched through the recursive window, so any frame will do
+    phys_addr_t frame = alloc_highmem_page();
+    if (frame == 0)
+    {
+        return NULL;
+    }
+
+    // The directory entry stays writable; per-page permissions are enforced by the table entries
+    set_page_dir_entry(page_dir_idx, frame | PG_PRESENT | PG_WRITE | (flags & PG_ALLOW_USER));
+
+    pte_t* page_table = page_table_address(page_dir_idx, page_dir[page_dir_idx]);
+    if (paging_enabled)
+    {
+        // The recursive window for this slot may still cache an older table
+        tlb_invalidate_page((uintptr_t)page_table);
+    }
+    memset(page_table, 0, PAGE_SIZE);
+
+    return page_table;
+}
+
+/**
+ * @brief Returns the directory entry for `virtual_address` if it maps a large page.
+ */
+static pte_t* get_large_pde(uintptr_t virtual_address)
+{
+    pte_t* page_dir_entry = &current_page_directory()[PAGE_DIR_INDEX(virtual_address)];
+
+    if ((*page_dir_entry & PG_PRESENT) && (*page_dir_entry & PG_PDE_4MB))
+    {
+        return page_dir_entry;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Replaces a large page by a page table mapping the same frames with 4KB pages.
+ *
+ * The new table is filled through a temporary mapping before it is installed,
+ * so the range stays mapped throughout.
+ *
+ * @param page_dir_idx The page directory index of the large page.
+ *
+ * @return The new page table, or NULL if no frame was available for it.
+ */
+static pte_t* split_large_page(uint32_t page_dir_idx)
+{
+    pte_t* page_dir = current_page_directory();
+    pte_t large_entry = page_dir[page_dir_idx];
+
+    phys_addr_t frame = alloc_highmem_page();
+    if (frame == 0)
+    {
+        return NULL;
+    }
+
+    phys_addr_t base = large_entry & PTE_ADDR_MASK & ~(phys_addr_t)(LARGE_PAGE_SIZE - 1);
+    pte_t flags = large_entry & (PG_PRESENT | PG_PROT_MASK);
+
+    pte_t* table = (pte_t*)kmap_atomic(frame);
+    for (uint32_t i = 0; i < PAGE_TABLE_SIZE; i++)
+    {
+        table[i] = (base + i * PAGE_SIZE) | flags;
+    }
+    kunmap_atomic(table);
+
+    set_page_dir_entry(page_dir_idx, frame | PG_PRESENT | PG_WRITE | (large_entry & PG_ALLOW_USER));
+
+    // One invlpg anywhere inside the large page drops its translation
+    tlb_gather_t tlb;
+    tlb_gather_init(&tlb);
+    tlb_gather_add(&tlb, (uintptr_t)page_dir_idx << PAGE_DIR_SHIFT);
+    tlb_gather_add(&tlb, RECURSIVE_PT_BASE + page_dir_idx * PAGE_SIZE);
+    tlb_gather_flush(&tlb);
+
+    return page_table_address(page_dir_idx, page_dir[page_dir_idx]);
+}
+
+/**
+ * @brief Returns how many of the next `count` pages starting at `virtual_address`
+ * fall inside the same page table.
+ */
+static size_t pages_in_table(uintptr_t virtual_address, size_t count)
+{
+    size_t left = PAGE_TABLE_SIZE - PAGE_TABLE_INDEX(virtual_address);
+    return left < count ? left : count;
+}
 
 /**
  * @brief Maps a virtual page to a physical page.
  *
+ * If the page was already mapped, its stale TLB entry is invalidated.
+ *
  * @param virtual_address The virtual address of the page to map.
  * @param physical_address The physical address of the page to map to.
  * @param flags The flags to set for the page table entry.
  */
-void map_page(uint32_t virtual_address, uint32_t physical_address, uint32_t flags)
+void map_page(uintptr_t virtual_address, phys_addr_t physical_address, pte_t flags)
 {
-    // Calculate the page directory index and page table index from the virtual address
-    uint32_t page_dir_idx = (virtual_address >> 22) & 0x3FF; // High 10 bits
-    uint32_t page_table_idx = (virtual_address >> 12) & 0x3FF; // Middle 10 bits
+    map_range(virtual_address, physical_address, PAGE_SIZE, flags);
+}
 
-    // Get the page table entry from the page directory
-    uint32_t* page_table = (uint32_t*)(page_directory[page_dir_idx] & ~0xFFF);
+/**
+ * @brief Unmaps a virtual page.
+ *
+ * @param virtual_address The virtual address of the page to unmap.
+ */
+void unmap_page(uintptr_t virtual_address)
+{
+    unmap_range(virtual_address, PAGE_SIZE);
+}
 
-    // If the page table is not present, allocate a new page table
-    if (page_table == NULL)
+/**
+ * @brief Maps a physically contiguous range.
+ *
+ * The page tables are walked once per page table span (4MB, or 2MB under PAE) and the TLB is flushed once
+ * for the whole range. Only entries that were already present are invalidated,
+ * since the processor never caches not-present translations.
+ *
+ * @param virtual_address The page aligned virtual start address.
+ * @param physical_address The page aligned physical start address.
+ * @param size The size of the range in bytes, rounded up to whole pages.
+ * @param flags The flags to set for every page table entry.
+ */
+void map_range(uintptr_t virtual_address, phys_addr_t physical_address, size_t size, pte_t flags)
+{
+    flags &= pte_supported_mask;
+    size_t count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    TRACE_EVENT(TRACE_MAP_PAGE, virtual_address, count, physical_address >> 12, flags);
+    tlb_gather_t tlb;
+    tlb_gather_init(&tlb);
+
+    while (count > 0)
     {
-        page_table = (uint32_t*)alloc_physical_page();
-        memset(page_table, 0, PAGE_SIZE);
+        pte_t* page_table = get_page_table(PAGE_DIR_INDEX(virtual_address), 1, flags);
+        if (page_table == NULL)
+        {
+            kprintf("map_range: out of memory for page table at %x\n", virtual_address);
+            break;
+        }
+
+        size_t batch = pages_in_table(virtual_address, count);
+        uint32_t page_table_idx = PAGE_TABLE_INDEX(virtual_address);
 
-        // Set the page directory entry to point to the new page table
-        page_directory[page_dir_idx] = (uint32_t)page_table | flags;
+        for (size_t i = 0; i < batch; i++)
+        {
+            pte_t old_entry = page_table[page_table_idx + i];
+            page_table[page_table_idx + i] = physical_address | flags;
+
+            if (old_entry & PG_PRESENT)
+            {
+                tlb_gather_add(&tlb, virtual_address);
+            }
+
+            virtual_address += PAGE_SIZE;
+            physical_address += PAGE_SIZE;
+        }
+
+        count -= batch;
     }
 
-    // Set the page table entry to map the virtual address to the physical address
-    page_table[page_table_idx] = physical_address | flags;
+    tlb_gather_flush(&tlb);
 }
 
 /**
- * @brief Unmaps a virtual page.
+ * @brief Maps an array of scattered physical frames to consecutive virtual pages.
  *
- * @param virtual_address The virtual address of the page to unmap.
+ * Behaves like map_range() but takes one physical frame per page, so callers
+ * growing a region from individually allocated frames still walk each page
+ * table once and flush once.
+ *
+ * @param virtual_address The page aligned virtual start address.
+ * @param frames The physical frame address for each page.
+ * @param count The number of pages to map.
+ * @param flags The flags to set for every page table entry.
  */
-void unmap_page(uint32_t virtual_address)
+void map_pages(uintptr_t virtual_address, const phys_addr_t* frames, size_t count, pte_t flags)
 {
-    // Calculate the page directory index and page table index from the virtual address
-    uint32_t page_dir_idx = (virtual_address >> 22) & 0x3FF; // High 10 bits
-    uint32_t page_table_idx = (virtual_address >> 12) & 0x3FF; // Middle 10 bits
+    flags &= pte_supported_mask;
+    TRACE_EVENT(TRACE_MAP_PAGE, virtual_address, count, count ? frames[0] >> 12 : 0, flags);
+    tlb_gather_t tlb;
+    tlb_gather_init(&tlb);
+
+    while (count > 0)
+    {
+        pte_t* page_table = get_page_table(PAGE_DIR_INDEX(virtual_address), 1, flags);
+        if (page_table == NULL)
+        {
+            kprintf("map_pages: out of memory for page table at %x\n", virtual_address);
+            break;
+        }
+
+        size_t batch = pages_in_table(virtual_address, count);
+        uint32_t page_table_idx = PAGE_TABLE_INDEX(virtual_address);
 
-    // Get the page directory entry
-    uint32_t* page_dir = (uint32_t*)page_directory;
-    uint32_t page_dir_entry = page_dir[page_dir_idx];
+        for (size_t i = 0; i < batch; i++)
+        {
+            pte_t old_entry = page_table[page_table_idx + i];
+            page_table[page_table_idx + i] = (*frames++ & PTE_ADDR_MASK) | flags;
+
+            if (old_entry & PG_PRESENT)
+            {
+                tlb_gather_add(&tlb, virtual_address);
+            }
+
+            virtual_address += PAGE_SIZE;
+        }
+
+        count -= batch;
+    }
+
+    tlb_gather_flush(&tlb);
+}
+
+/**
+ * @brief Unmaps a virtual range.
+ *
+ * Regions without a page table are skipped a whole table span at a time. The pages
+ * that were actually present are invalidated in one batch at the end.
+ *
+ * @param virtual_address The page aligned virtual start address.
+ * @param size The size of the range in bytes, rounded up to whole pages.
+ */
+void unmap_range(uintptr_t virtual_address, size_t size)
+{
+    size_t count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    TRACE_EVENT(TRACE_UNMAP_PAGE, virtual_address, count, 0, 0);
+    tlb_gather_t tlb;
+    tlb_gather_init(&tlb);
 
-    // If the page directory entry is not present, return
-    if (!(page_dir_entry & 1))
+    while (count > 0)
     {
-        return;
+        size_t batch = pages_in_table(virtual_address, count);
+        pte_t* large_entry = get_large_pde(virtual_address);
+
+        if (large_entry != NULL && batch == PAGE_TABLE_SIZE)
+        {
+            // The range covers the whole large page, drop it in one go
+            set_page_dir_entry(PAGE_DIR_INDEX(virtual_address), 0);
+            tlb_gather_add(&tlb, virtual_address);
+            virtual_address += batch * PAGE_SIZE;
+            count -= batch;
+            continue;
+        }
+
+        // Unmapping part of a large page first breaks it up into 4KB pages
+        pte_t* page_table = get_page_table(PAGE_DIR_INDEX(virtual_address), large_entry != NULL, 0);
+
+        if (page_table != NULL)
+        {
+            uint32_t page_table_idx = PAGE_TABLE_INDEX(virtual_address);
+            for (size_t i = 0; i < batch; i++)
+            {
+                if (page_table[page_table_idx + i] & PG_PRESENT)
+                {
+                    page_table[page_table_idx + i] = 0;
+                    tlb_gather_add(&tlb, virtual_address + i * PAGE_SIZE);
+                }
+            }
+        }
+
+        virtual_address += batch * PAGE_SIZE;
+        count -= batch;
     }
 
-    // Get the page table entry
-    uint32_t* page_table = (uint32_t*)(page_dir_entry & ~0xFFF);
-    uint32_t page_table_entry = page_table[page_table_idx];
+    tlb_gather_flush(&tlb);
+}
+
+/**
+ * @brief Changes the flags of every present page in a virtual range.
+ *
+ * The physical frames are left untouched. Pages that are not mapped stay
+ * unmapped, and only entries whose flags actually changed are invalidated.
+ *
+ * @param virtual_address The page aligned virtual start address.
+ * @param size The size of the range in bytes, rounded up to whole pages.
+ * @param flags The new protection flags, see PG_PROT_MASK.
+ */
+void protect_range(uintptr_t virtual_address, size_t size, pte_t flags)
+{
+    flags &= pte_supported_mask;
+    size_t count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    tlb_gather_t tlb;
+    tlb_gather_init(&tlb);
 
-    // If the page table entry is not present, return
-    if (!(page_table_entry & 1))
+    while (count > 0)
     {
-        return;
+        size_t batch = pages_in_table(virtual_address, count);
+        pte_t* large_entry = get_large_pde(virtual_address);
+
+        if (large_entry != NULL && batch == PAGE_TABLE_SIZE)
+        {
+            pte_t new_entry = (*large_entry & ~PG_PROT_MASK) | (flags & PG_PROT_MASK);
+            if (new_entry != *large_entry)
+            {
+                set_page_dir_entry(PAGE_DIR_INDEX(virtual_address), new_entry);
+                tlb_gather_add(&tlb, virtual_address);
+            }
+            virtual_address += batch * PAGE_SIZE;
+            count -= batch;
+            continue;
+        }
+
+        // Changing part of a large page first breaks it up into 4KB pages
+        pte_t* page_table = get_page_table(PAGE_DIR_INDEX(virtual_address), large_entry != NULL, flags);
+
+        if (page_table != NULL)
+        {
+            uint32_t page_table_idx = PAGE_TABLE_INDEX(virtual_address);
+            for (size_t i = 0; i < batch; i++)
+            {
+                pte_t old_entry = page_table[page_table_idx + i];
+                pte_t new_entry = (old_entry & ~PG_PROT_MASK) | (flags & PG_PROT_MASK);
+
+                if ((old_entry & PG_PRESENT) && old_entry != new_entry)
+                {
+                    page_table[page_table_idx + i] = new_entry;
+                    tlb_gather_add(&tlb, virtual_address + i * PAGE_SIZE);
+                }
+            }
+        }
+
+        virtual_address += batch * PAGE_SIZE;
+        count -= batch;
     }
 
-    // Clear the page table entry
-    page_table[page_table_idx] = 0;
+    tlb_gather_flush(&tlb);
+}
 
-    // Invalidate the TLB entry for the virtual address
-    asm volatile("invlpg (%0)" : : "r"(virtual_address) : "memory");
+/**
+ * @brief Returns the page table entry mapping a virtual address.
+ *
+ * After paging is enabled the entry is reached in O(1) through the recursive
+ * slot, wherever the page table lives in physical memory.
+ *
+ * @param virtual_address The virtual address to look up.
+ * @param create Allocate the page table if it does not exist yet, or split
+ *               the large page covering the address.
+ *
+ * @return A pointer to the entry, or NULL if no page table covers the address
+ *         (including addresses inside a large page when `create` is zero).
+ */
+pte_t* get_pte(uintptr_t virtual_address, int create)
+{
+    pte_t* page_table = get_page_table(PAGE_DIR_INDEX(virtual_address), create, 0);
+    if (page_table == NULL)
+    {
+        return NULL;
+    }
+    return &page_table[PAGE_TABLE_INDEX(virtual_address)];
 }
 
 /**
- * @brief Initializes the page tables.
+ * @brief Translates a virtual address to the physical address it is mapped to.
  *
- * This function sets up the page tables to map the first 4GB of virtual memory
- * to the first 4GB of physical memory. This is a one-to-one mapping, meaning
- * that each virtual address corresponds to the same physical address.
+ * @param virtual_address The virtual address to translate.
  *
- * The function iterates through each entry in the page tables and sets the
- * following flags:
- *  - Present (bit 0): Set to 1, indicating that the page is present in memory.
- *  - Read/Write (bit 1): Set to 1, allowing both read and write access to the page.
- *  - User/Supervisor (bit 2): Set to 1, allowing access from both user and kernel mode.
+ * @return The physical address, or 0 if the address is not mapped.
  */
-void page_table_init()
+phys_addr_t virt_to_phys(uintptr_t virtual_address)
 {
-    // Iterate through each page directory entry
-    for (int i = 0; i < PAGE_DIRECTORY_SIZE; i++)
+    pte_t* large_entry = get_large_pde(virtual_address);
+    if (large_entry != NULL)
     {
-        // Iterate through each page table entry within the current page directory entry
-        for (int j = 0;j < PAGE_DIRECTORY_SIZE;j++)
+        return (*large_entry & PTE_ADDR_MASK & ~(phys_addr_t)(LARGE_PAGE_SIZE - 1)) | (virtual_address & (LARGE_PAGE_SIZE - 1));
+    }
+
+    pte_t* pte = get_pte(virtual_address, 0);
+    if (pte == NULL || !(*pte & PG_PRESENT))
+    {
+        return 0;
+    }
+    return (*pte & PTE_ADDR_MASK) | (virtual_address & 0xFFF);
+}
+
+/**
+ * @brief Calls `fn` for every present page in a virtual range.
+ *
+ * Regions without a page table are skipped a whole table span at a time. A
+ * large page is reported once, with its directory entry (PG_PDE_4MB set) and
+ * the address of its first page. The callback may modify the entry it is
+ * given; the caller is responsible for invalidating the TLB afterwards.
+ *
+ * @param virtual_address The page aligned virtual start address.
+ * @param size The size of the range in bytes, rounded up to whole pages.
+ * @param fn The callback, returning non-zero to stop the walk.
+ * @param ctx Passed through to the callback.
+ */
+void walk(uintptr_t virtual_address, size_t size, page_walk_fn fn, void* ctx)
+{
+    size_t count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    while (count > 0)
+    {
+        size_t batch = pages_in_table(virtual_address, count);
+        pte_t* large_entry = get_large_pde(virtual_address);
+        pte_t* page_table = get_page_table(PAGE_DIR_INDEX(virtual_address), 0, 0);
+
+        if (large_entry != NULL)
+        {
+            uintptr_t large_start = virtual_address & ~(uintptr_t)(LARGE_PAGE_SIZE - 1);
+            if (fn(large_start, large_entry, ctx))
+            {
+                return;
+            }
+        }
+        else if (page_table != NULL)
+        {
+            uint32_t page_table_idx = PAGE_TABLE_INDEX(virtual_address);
+            for (size_t i = 0; i < batch; i++)
+            {
+                if ((page_table[page_table_idx + i] & PG_PRESENT) &&
+                    fn(virtual_address + i * PAGE_SIZE, &page_table[page_table_idx + i], ctx))
+                {
+                    return;
+                }
+            }
+        }
+
+        virtual_address += batch * PAGE_SIZE;
+        count -= batch;
+    }
+}
+
+/**
+ * @brief Returns non-zero if directory entries can map LARGE_PAGE_SIZE pages.
+ */
+int paging_large_pages_supported()
+{
+    return large_pages_enabled;
+}
+
+/**
+ * @brief Maps one large page (4MB, or 2MB under PAE) with a single directory entry.
+ *
+ * A large page costs one TLB entry instead of one per 4KB page. The slot must
+ * be empty: callers fall back to 4KB mappings when this fails.
+ *
+ * @param virtual_address The LARGE_PAGE_SIZE aligned virtual address.
+ * @param physical_address The LARGE_PAGE_SIZE aligned physical address.
+ * @param flags The flags to set for the directory entry.
+ *
+ * @return 0 on success, -1 if large pages are unsupported or the slot is in use.
+ */
+int map_large_page(uintptr_t virtual_address, phys_addr_t physical_address, pte_t flags)
+{
+    pte_t* page_dir_entry = &current_page_directory()[PAGE_DIR_INDEX(virtual_address)];
+
+    if (!large_pages_enabled || (*page_dir_entry & PG_PRESENT) ||
+        (virtual_address & (LARGE_PAGE_SIZE - 1)) || (physical_address & (LARGE_PAGE_SIZE - 1)))
+    {
+        return -1;
+    }
+
+    // Not-present entries are never cached, so no invalidation is needed
+    set_page_dir_entry(PAGE_DIR_INDEX(virtual_address), physical_address | (flags & pte_supported_mask) | PG_PRESENT | PG_PDE_4MB);
+    return 0;
+}
+
+/**
+ * @brief Maps low physical memory at DIRECT_MAP_BASE.
+ *
+ * Every frame below DIRECT_MAP_SIZE becomes reachable through phys_to_virt().
+ * Large pages are used where the processor supports them, which keeps the
+ * whole direct map within a handful of TLB entries.
+ */
+void direct_map_init()
+{
+    uint64_t size = (uint64_t)get_total_page_count() * PAGE_SIZE;
+    if (size > DIRECT_MAP_SIZE)
+    {
+        size = DIRECT_MAP_SIZE;
+    }
+
+    for (uint32_t offset = 0; offset < size; offset += LARGE_PAGE_SIZE)
+    {
+        if (map_large_page(DIRECT_MAP_BASE + offset, offset, PG_PRESENT | PG_WRITE | PG_NX) != 0)
         {
-            // Calculate the physical address corresponding to this page table entry
-            // The address is calculated as:
-            //  - (i * PAGE_DIRECTORY_SIZE * PAGE_SIZE): Base address of the current page directory entry
-            //  - (j * PAGE_SIZE): Offset within the current page directory entry
-            // The result is then bitwise ORed with 3 to set the Present, Read/Write, and User/Supervisor flags.
-            page_tables[i][j] = (((i * PAGE_DIRECTORY_SIZE * PAGE_SIZE) + (j * PAGE_SIZE)) | 3);
+            map_range(DIRECT_MAP_BASE + offset, offset, LARGE_PAGE_SIZE, PG_PRESENT | PG_WRITE | PG_NX);
         }
     }
+
+    pr_info("Direct map: %d MB at %x using %s pages\n", (uint32_t)(size >> 20), DIRECT_MAP_BASE,
+        large_pages_enabled ? "large" : "4KB");
+}
+
+/**
+ * @brief Initializes the page table for the first 4MB.
+ *
+ * This function identity maps the first 4MB of physical memory, which contains
+ * the kernel image, the VGA buffer and the physical memory bitmap. Nothing
+ * else is identity mapped: page tables are accessed through the recursive
+ * slot and other physical memory must be mapped explicitly.
+ *
+ * Each entry is marked Present and Read/Write and is only accessible from
+ * kernel mode.
+ */
+void page_table_init()
+{
+    for (int i = 0; i < LOW_IDENTITY_SIZE / PAGE_SIZE; i++)
+    {
+        low_page_table[i] = (i * PAGE_SIZE) | PG_PRESENT | PG_WRITE;
+    }
+}
+
+/**
+ * @brief Points the directory entries covering `virtual_address` at the low page table(s).
+ */
+static void install_low_page_tables(uintptr_t virtual_address)
+{
+    for (uint32_t i = 0; i < LOW_IDENTITY_SIZE / PAGE_TABLE_SPAN; i++)
+    {
+        page_directory[PAGE_DIR_INDEX(virtual_address) + i] =
+            ((uintptr_t)&low_page_table[i * PAGE_TABLE_SIZE]) | PG_PRESENT | PG_WRITE;
+    }
 }
 
 /**
  * @brief Initializes the page directory.
  *
- * This function sets up the page directory to point to the page tables.
+ * This function clears the page directory, points the first entries at the
+ * identity mapped low page table(s) and installs the recursive slot: the last
+ * entry points back at the directory itself, so the page tables appear as a
+ * linear array at RECURSIVE_PT_BASE and the directory at RECURSIVE_PD_ADDR.
  *
- * The function iterates through each entry in the page directory and sets the
- * following flags:
- *  - Present (bit 0): Set to 1, indicating that the page table is present in memory.
- *  - Read/Write (bit 1): Set to 1, allowing both read and write access to the page table.
- *  - User/Supervisor (bit 2): Set to 1, allowing access from both user and kernel mode.
+ * Under PAE the four directories are also entered into the page directory
+ * pointer table, and the last four directory entries map them in order.
  */
 void page_directory_init()
 {
-    // Iterate through each page directory entry
-    for (int i = 0; i < PAGE_DIRECTORY_SIZE; i++)
+    memset(page_directory, 0, sizeof(page_directory));
+
+    install_low_page_tables(0);
+
+    for (uint32_t i = 0; i < RECURSIVE_PDE_COUNT; i++)
+    {
+        page_directory[RECURSIVE_PDE_INDEX + i] =
+            ((uintptr_t)&page_directory[i * PAGE_TABLE_SIZE]) | PG_PRESENT | PG_WRITE;
+    }
+
+#ifdef CONFIG_PAE
+    for (uint32_t i = 0; i < 4; i++)
     {
-        // Set the page directory entry to point to the corresponding page table
-        // The address of the page table is bitwise ORed with 3 to set the Present, Read/Write, and User/Supervisor flags.
-        page_directory[i] = ((uint32_t)page_tables[i]) | 3;
+        // PDPT entries only accept the Present and cache control bits
+        page_directory_pointer_table[i] = ((uintptr_t)&page_directory[i * PAGE_TABLE_SIZE]) | PG_PRESENT;
     }
+#endif
 }
 
 /**
@@ -133,62 +696,267 @@ void page_directory_init()
  *
  * This function enables paging by loading the address of the page directory
  * into the CR3 register and setting the PG bit in the CR0 register.
+ *
+ * Under PAE, CR4.PAE is set first and CR3 points at the page directory
+ * pointer table. If the processor supports it, EFER.NXE is set so PG_NX
+ * takes effect; otherwise PG_NX is silently dropped from new entries.
+ * Without PAE, CR4.PSE is set when available so 4MB pages can be used.
+ * Large pages stay off if the kernel is built without CONFIG_LARGE_PAGES.
  */
 void enable_paging()
 {
+#ifdef CONFIG_PAE
+    uint32_t cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_PAE;
+    asm volatile("mov %0, %%cr4" : : "r"(cr4));
+
+    if (cpu_has_nx())
+    {
+        wrmsr(MSR_EFER, rdmsr(MSR_EFER) | EFER_NXE);
+        pte_supported_mask = ~(pte_t)0;
+    }
+
+    // Load the address of the page directory pointer table into the CR3 register
+    asm volatile("mov %0, %%cr3" : : "r"(page_directory_pointer_table));
+
+#ifdef CONFIG_LARGE_PAGES
+    // PAE directory entries can always map 2MB pages
+    large_pages_enabled = 1;
+#endif
+#else
+#ifdef CONFIG_LARGE_PAGES
+    if (cpuid_features_edx() & CPUID_FEAT_EDX_PSE)
+    {
+        uint32_t cr4;
+        asm volatile("mov %%cr4, %0" : "=r"(cr4));
+        cr4 |= CR4_PSE;
+        asm volatile("mov %0, %%cr4" : : "r"(cr4));
+        large_pages_enabled = 1;
+    }
+#endif
+
     // Load the address of the page directory into the CR3 register
     asm volatile("mov %0, %%cr3" : : "r"(page_directory));
+#endif
 
     // Set the PG bit in the CR0 register to enable paging
     uint32_t cr0;
     asm volatile("mov %%cr0, %0" : "=r"(cr0));
     cr0 |= 0x80000000;
     asm volatile("mov %0, %%cr0" : : "r"(cr0));
-}
 
-/**
- * @brief Maps the kernel's higher half (3GB-4GB) to the first 4MB of physical memory.
- *
- * This function is necessary because the kernel is loaded at 0xC0000000 (3GB),
- * but it needs to access the lower 4MB of physical memory where the VGA buffer
- * and other important data structures are located.
- */
-void map_kernel_high_half()
-{
-    // The 768th entry in the page directory corresponds to the virtual address range 3GB-3GB+4MB
-    // We set this entry to point to the first page table, which maps the first 4MB of physical memory.
-    page_directory[768] = ((uint32_t)page_tables[0]) | 3;
+    paging_enabled = 1;
 }
 
 /**
  * @brief Initializes paging.
  *
  * This function initializes the page tables, page directory, and enables paging.
+ * The direct map is built once paging is on, so its page tables can come
+ * from any frame.
  */
 void paging_init()
 {
     page_table_init();
     page_directory_init();
-    map_kernel_high_half();
     enable_paging();
+    direct_map_init();
 }
 
-void test_page_table_init()
+/**
+ * @brief Creates an empty user address space.
+ *
+ * The directories are copies of the kernel's: the same kernel entries, an
+ * empty user range and recursive slots of their own. They live in low
+ * memory, so set_page_dir_entry() can reach them while another address
+ * space is loaded.
+ *
+ * @return The address space, or NULL if memory ran out.
+ */
+address_space_t* address_space_create()
 {
-    paging_init();  // Initialize paging system
+    address_space_t* space = (address_space_t*)kmalloc(sizeof(address_space_t));
+    if (space == NULL)
+    {
+        return NULL;
+    }
+    memset(space, 0, sizeof(address_space_t));
 
-    for (int i = 0; i < PAGE_DIRECTORY_SIZE; i++)
+    for (uint32_t i = 0; i < ADDRESS_SPACE_DIRECTORIES; i++)
     {
-        for (int j = 0; j < PAGE_TABLE_SIZE; j++)
+        space->directories[i] = (phys_addr_t)(uintptr_t)alloc_physical_page();
+        if (space->directories[i] == 0)
         {
-            uintptr_t expected_address = (i * PAGE_DIRECTORY_SIZE * PAGE_SIZE) + (j * PAGE_SIZE);
-            if ((page_tables[i][j] & ~0xFFF) != expected_address)
-            {
-                kprintf("Error: Page table entry (%d, %d) points to wrong address 0x%x, expected 0x%x\n", i, j, page_tables[i][j], expected_address);
-                return;
-            }
+            goto fail;
         }
     }
+
+#ifdef CONFIG_PAE
+    // CR3 holds a 32-bit physical address, which low memory always is
+    space->cr3 = (uint32_t)(uintptr_t)alloc_physical_page();
+    if (space->cr3 == 0)
+    {
+        goto fail;
+    }
+    uint64_t* pdpt = (uint64_t*)phys_to_virt(space->cr3);
+    memset(pdpt, 0, PAGE_SIZE);
+    for (uint32_t i = 0; i < ADDRESS_SPACE_DIRECTORIES; i++)
+    {
+        pdpt[i] = space->directories[i] | PG_PRESENT;
+    }
+#else
+    space->cr3 = (uint32_t)space->directories[0];
+#endif
+
+    spin_lock(&address_spaces_lock);
+    for (uint32_t i = 0; i < PAGE_DIRECTORY_SIZE; i++)
+    {
+        *address_space_entry(space, i) = page_dir_shared(i) ? page_directory[i] : 0;
+    }
+    for (uint32_t i = 0; i < RECURSIVE_PDE_COUNT; i++)
+    {
+        *address_space_entry(space, RECURSIVE_PDE_INDEX + i) = space->directories[i] | PG_PRESENT | PG_WRITE;
+    }
+
+    space->next = address_spaces;
+    address_spaces = space;
+    address_spaces_count++;
+    spin_unlock(&address_spaces_lock);
+
+    return space;
+
+fail:
+    for (uint32_t i = 0; i < ADDRESS_SPACE_DIRECTORIES; i++)
+    {
+        if (space->directories[i] != 0)
+        {
+            free_physical_page((void*)(uintptr_t)space->directories[i]);
+        }
+    }
+    kfree(space);
+    return NULL;
+}
+
+/**
+ * @brief Frees an address space's directories and the page tables of its user range.
+ *
+ * The pages mapped in it must already be unmapped and released by their
+ * owner, and it must not be loaded on any CPU.
+ */
+void address_space_destroy(address_space_t* space)
+{
+    spin_lock(&address_spaces_lock);
+    address_space_t** link = &address_spaces;
+    while (*link != space)
+    {
+        link = &(*link)->next;
+    }
+    *link = space->next;
+    address_spaces_count--;
+    spin_unlock(&address_spaces_lock);
+
+    for (uint32_t i = PAGE_DIR_INDEX(USER_SPACE_START); i < PAGE_DIR_INDEX(USER_SPACE_END); i++)
+    {
+        pte_t entry = *address_space_entry(space, i);
+        if ((entry & PG_PRESENT) && !(entry & PG_PDE_4MB))
+        {
+            free_highmem_page(entry & PTE_ADDR_MASK);
+        }
+    }
+
+    for (uint32_t i = 0; i < ADDRESS_SPACE_DIRECTORIES; i++)
+    {
+        free_physical_page((void*)(uintptr_t)space->directories[i]);
+    }
+#ifdef CONFIG_PAE
+    free_physical_page((void*)(uintptr_t)space->cr3);
+#endif
+    kfree(space);
+}
+
+/**
+ * @brief Loads an address space on the executing CPU.
+ *
+ * @param space The address space, or NULL for the kernel's own directory,
+ *              whose user range holds no program.
+ */
+void address_space_switch(address_space_t* space)
+{
+    if (space != NULL)
+    {
+        tlb_switch_address_space(space->cr3, 0);
+        return;
+    }
+
+#ifdef CONFIG_PAE
+    tlb_switch_address_space((uint32_t)page_directory_pointer_table, 0);
+#else
+    tlb_switch_address_space((uint32_t)page_directory, 0);
+#endif
+}
+
+/**
+ * @brief Returns the number of user address spaces in existence.
+ */
+size_t address_space_count()
+{
+    return address_spaces_count;
+}
+
+void test_large_page()
+{
+    if (!large_pages_enabled)
+    {
+        kprintf("Large page test skipped, large pages are not enabled\n");
+        return;
+    }
+
+    size_t pages = LARGE_PAGE_SIZE / PAGE_SIZE;
+    phys_addr_t frame = alloc_physical_pages_aligned(pages, pages);
+    uintptr_t virtual_addr = 0x40000000;
+
+    if (frame == 0 || map_large_page(virtual_addr, frame, PG_PRESENT | PG_WRITE) != 0)
+    {
+        kprintf("Error: Could not map a large page\n");
+        return;
+    }
+
+    if (virt_to_phys(virtual_addr + 0x12345) != frame + 0x12345)
+    {
+        kprintf("Error: Large page translates 0x%x wrongly\n", virtual_addr + 0x12345);
+        return;
+    }
+
+    // Unmapping one 4KB page splits the large page and keeps its neighbours mapped
+    unmap_page(virtual_addr + PAGE_SIZE);
+    if (virt_to_phys(virtual_addr + PAGE_SIZE) != 0 || virt_to_phys(virtual_addr + 2 * PAGE_SIZE) != frame + 2 * PAGE_SIZE)
+    {
+        kprintf("Error: Splitting the large page at 0x%x failed\n", virtual_addr);
+        return;
+    }
+
+    unmap_range(virtual_addr, LARGE_PAGE_SIZE);
+    free_physical_pages(frame, pages);
+    kprintf("Large page test passed: 0x%x\n", virtual_addr);
+}
+
+void test_page_table_init()
+{
+    for (uintptr_t addr = 0; addr < LOW_IDENTITY_SIZE; addr += PAGE_SIZE)
+    {
+        if (virt_to_phys(addr) != addr)
+        {
+            kprintf("Error: Low page 0x%x translates to 0x%x\n", addr, (uint32_t)virt_to_phys(addr));
+            return;
+        }
+    }
+
+    if (virt_to_phys(RECURSIVE_PD_ADDR) != (uintptr_t)page_directory)
+    {
+        kprintf("Error: Recursive slot maps 0x%x instead of the page directory\n", (uint32_t)virt_to_phys(RECURSIVE_PD_ADDR));
+        return;
+    }
     kprintf("Page table initialization test passed!\n");
 }
 
@@ -199,10 +967,7 @@ void test_map_page()
 
     map_page(virtual_addr, physical_addr, 0x3);  // Map with read/write permissions
 
-    uint32_t page_dir_idx = (virtual_addr >> 22) & 0x3FF;
-    uint32_t page_table_idx = (virtual_addr >> 12) & 0x3FF;
-
-    if ((page_tables[page_dir_idx][page_table_idx] & ~0xFFF) != physical_addr)
+    if (virt_to_phys(virtual_addr) != physical_addr)
     {
         kprintf("Error: Virtual address 0x%x not mapped to correct physical address 0x%x\n", virtual_addr, physical_addr);
     }
@@ -218,10 +983,9 @@ void test_unmap_page()
 
     unmap_page(virtual_addr);  // Unmap the page
 
-    uint32_t page_dir_idx = (virtual_addr >> 22) & 0x3FF;
-    uint32_t page_table_idx = (virtual_addr >> 12) & 0x3FF;
+    pte_t* pte = get_pte(virtual_addr, 0);
 
-    if (page_tables[page_dir_idx][page_table_idx] != 0)
+    if (pte != NULL && *pte != 0)
     {
         kprintf("Error: Virtual address 0x%x was not unmapped correctly\n", virtual_addr);
     }
@@ -231,6 +995,43 @@ void test_unmap_page()
     }
 }
 
+void test_map_range()
+{
+    // Straddle a page table boundary so the walk has to move to the next directory entry
+    uintptr_t virtual_addr = 0x7FE000;
+    uintptr_t physical_addr = 0x300000;
+    size_t size = 4 * PAGE_SIZE;
+
+    map_range(virtual_addr, physical_addr, size, PG_PRESENT | PG_WRITE);
+    protect_range(virtual_addr, size, PG_PRESENT);
+
+    for (size_t i = 0; i < size / PAGE_SIZE; i++)
+    {
+        uintptr_t addr = virtual_addr + i * PAGE_SIZE;
+        pte_t entry = *get_pte(addr, 0);
+
+        if ((entry & PTE_ADDR_MASK) != physical_addr + i * PAGE_SIZE || (entry & PG_WRITE))
+        {
+            kprintf("Error: Range page 0x%x has entry 0x%x\n", addr, (uint32_t)entry);
+            return;
+        }
+    }
+
+    unmap_range(virtual_addr, size);
+
+    for (size_t i = 0; i < size / PAGE_SIZE; i++)
+    {
+        uintptr_t addr = virtual_addr + i * PAGE_SIZE;
+        if (*get_pte(addr, 0) != 0)
+        {
+            kprintf("Error: Range page 0x%x was not unmapped\n", addr);
+            return;
+        }
+    }
+
+    kprintf("Range mapping test passed: 0x%x -> 0x%x (%d pages)\n", virtual_addr, physical_addr, size / PAGE_SIZE);
+}
+
 void run_paging_tests()
 {
     kprintf("Running paging tests...\n");
@@ -238,6 +1039,8 @@ void run_paging_tests()
     test_page_table_init();
     test_map_page();
     test_unmap_page();
+    test_map_range();
+    test_large_page();
 
     kprintf("Paging tests complete.\n");
 }
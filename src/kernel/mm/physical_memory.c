@@ -1,23 +1,44 @@
 #include <kernel/mm/physical_memory.h>
-#include <unit_tests/test_phymem.h>
-// 定义最大内存大小为 256MB
-#define MAX_MEMORY_SIZE (256 * 1024 * 1024)
+#include <kernel/mm/reclaim.h>
+#include <kernel/trace/trace.h>
+
+static int find_first_free_page();
+static int find_free_page_from(size_t start);
+static int is_range_free(size_t page_idx, size_t count);
 
 // 内存位图，用于标记每个页面是否空闲
 uint8_t* memory_bitmap;
 // 总内存大小（以字节为单位）
-size_t total_memory_size = 0;
+uint64_t total_memory_size = 0;
 // 总页面数
 size_t total_pages = 0;
 // 空闲页面数
 size_t free_pages = 0;
+// 初始化结束时各区域中不可分配的页面数
+static size_t zone_reserved[NR_ZONES];
+
+static void record_reserved_pages();
+
+#ifdef CONFIG_PHYS_ALLOC_BUDDY
+// 伙伴系统：空闲页面同时记录为按自身大小对齐的 2^k 个页面的块。
+// 第 k 阶位图的第 i 位表示从页面 i << k 开始的块空闲，页面位图仍然记录每个页面的状态
+static uint8_t* buddy_maps[BUDDY_ORDERS];
+// 每一阶的空闲块数，以及该阶位图中可能置位的最低位置
+static size_t buddy_free_blocks[BUDDY_ORDERS];
+static size_t buddy_hint[BUDDY_ORDERS];
+// 伙伴位图建立之前保留的页面只需要记录在页面位图中
+static int buddy_ready = 0;
+
+static void buddy_init();
+static void buddy_reserve_page(size_t page_idx);
+#endif
 
 /**
  * @brief 初始化物理内存管理器。
  *
  * @param mem_size 内存大小（以字节为单位）。
  */
-void physical_memory_init(uint32_t mem_size)
+void physical_memory_init(uint64_t mem_size)
 {
     // 如果内存大小超过最大限制，则设置为最大限制
     if (mem_size > MAX_MEMORY_SIZE)
@@ -30,17 +51,184 @@ void physical_memory_init(uint32_t mem_size)
     total_pages = total_memory_size / PAGE_SIZE;
     memory_bitmap = (uint8_t*)BIT_MAP_ADDR;
 
-    // 将内存位图清零，表示所有页面都空闲
-    memset(memory_bitmap, 0, BIT_MAP);
+    // 将内存位图清零，表示所有页面都空闲。只清理实际内存对应的部分
+    memset(memory_bitmap, 0, (total_pages + 7) / 8);
     free_pages = total_pages;
+#ifdef CONFIG_PHYS_ALLOC_BUDDY
+    buddy_init();
+#endif
 
     // 查找第一个空闲页面
     int first_free_page = find_first_free_page();
 
     // 打印初始化信息
-    kprintf("Physical Memory Initialized with total pages of %d, the first free page is at %d, bitmap %d\n", free_pages, first_free_page, memory_bitmap);
+    pr_info("Physical Memory Initialized with total pages of %d, the first free page is at %d, bitmap %d\n", free_pages, first_free_page, memory_bitmap);
+}
+
+/**
+ * @brief 将一段物理地址范围内的页面标记为空闲。
+ *
+ * @param start 起始物理地址，向上对齐到页面。
+ * @param end 结束物理地址，向下对齐到页面。
+ */
+static void release_range(uint64_t start, uint64_t end)
+{
+    uint64_t limit = (uint64_t)total_pages * PAGE_SIZE;
+    if (end > limit)
+    {
+        end = limit;
+    }
 
-    verify_physical_memory();
+    size_t page_idx = ((start + PAGE_SIZE - 1) & ~(uint64_t)(PAGE_SIZE - 1)) >> 12;
+    size_t end_idx = end >> 12;
+    while (page_idx < end_idx)
+    {
+        // 按字节对齐且整个字节都已使用时一次释放 8 个页面
+        if (page_idx % 8 == 0 && page_idx + 8 <= end_idx && memory_bitmap[page_idx / 8] == 0xff)
+        {
+            memory_bitmap[page_idx / 8] = 0;
+            free_pages += 8;
+            page_idx += 8;
+            continue;
+        }
+        if (memory_bitmap[page_idx / 8] & (1 << (page_idx % 8)))
+        {
+            memory_bitmap[page_idx / 8] &= ~(1 << (page_idx % 8));
+            free_pages++;
+        }
+        page_idx++;
+    }
+}
+
+/**
+ * @brief 将一段物理地址范围内的页面标记为已使用，使其不会被分配出去。
+ *
+ * 用于保留引导加载器放在可用内存中的数据，例如 multiboot 模块。
+ *
+ * @param start 起始物理地址，向下对齐到页面。
+ * @param end 结束物理地址，向上对齐到页面。
+ */
+void physical_memory_reserve_range(uint64_t start, uint64_t end)
+{
+    uint64_t limit = (uint64_t)total_pages * PAGE_SIZE;
+    if (end > limit)
+    {
+        end = limit;
+    }
+
+    for (uint64_t addr = start & ~(uint64_t)(PAGE_SIZE - 1); addr < end; addr += PAGE_SIZE)
+    {
+        size_t page_idx = addr >> 12;
+        if (!(memory_bitmap[page_idx / 8] & (1 << (page_idx % 8))))
+        {
+            memory_bitmap[page_idx / 8] |= 1 << (page_idx % 8);
+            free_pages--;
+#ifdef CONFIG_PHYS_ALLOC_BUDDY
+            if (buddy_ready)
+            {
+                buddy_reserve_page(page_idx);
+            }
+#endif
+        }
+    }
+}
+
+/**
+ * @brief 保留所有 multiboot 模块占用的页面。
+ *
+ * 模块位于可用内存中，必须在第一次分配之前保留，否则会被覆盖。
+ */
+static void reserve_multiboot_modules(multiboot_info_t* mbi)
+{
+    if (!(mbi->flags & MULTIBOOT_INFO_MODS))
+    {
+        return;
+    }
+
+    multiboot_module_t* modules = (multiboot_module_t*)mbi->mods_addr;
+    for (size_t i = 0; i < mbi->mods_count; i++)
+    {
+        physical_memory_reserve_range(modules[i].mod_start, modules[i].mod_end);
+    }
+}
+
+/**
+ * @brief 根据 multiboot 内存映射初始化物理内存管理器。
+ *
+ * 只有内存映射中标记为可用的区域才会被视为空闲，空洞（如 PCI 区域）和
+ * 4GB 以上的内存都能被正确处理。没有内存映射时退回到 mem_upper。
+ *
+ * @param mbi multiboot 信息结构体。
+ */
+void physical_memory_init_mmap(multiboot_info_t* mbi)
+{
+    if (!(mbi->flags & MULTIBOOT_INFO_MEM_MAP))
+    {
+        physical_memory_init(mbi->mem_upper * 1024);
+        reserve_multiboot_modules(mbi);
+        record_reserved_pages();
+        return;
+    }
+
+    uintptr_t mmap_end = mbi->mmap_addr + mbi->mmap_length;
+
+    // 先找出可用内存的最高地址
+    uint64_t mem_end = 0;
+    for (uintptr_t entry_addr = mbi->mmap_addr; entry_addr < mmap_end;)
+    {
+        multiboot_memory_map_t* entry = (multiboot_memory_map_t*)entry_addr;
+        uint64_t base = ((uint64_t)entry->addr_high << 32) | entry->addr_low;
+        uint64_t len = ((uint64_t)entry->len_high << 32) | entry->len_low;
+
+        if (entry->type == MULTIBOOT_MEMORY_AVAILABLE && base + len > mem_end)
+        {
+            mem_end = base + len;
+        }
+        entry_addr += entry->size + sizeof(entry->size);
+    }
+
+    // 如果内存大小超过最大限制，则设置为最大限制
+    if (mem_end > MAX_MEMORY_SIZE)
+    {
+        mem_end = MAX_MEMORY_SIZE;
+    }
+
+    // 初始化全局变量
+    total_memory_size = mem_end;
+    total_pages = mem_end >> 12;
+    memory_bitmap = (uint8_t*)BIT_MAP_ADDR;
+
+    // 先将所有页面标记为已使用，再释放内存映射中的可用区域。只设置实际内存对应的部分
+    memset(memory_bitmap, 0xff, (total_pages + 7) / 8);
+    free_pages = 0;
+
+    for (uintptr_t entry_addr = mbi->mmap_addr; entry_addr < mmap_end;)
+    {
+        multiboot_memory_map_t* entry = (multiboot_memory_map_t*)entry_addr;
+        uint64_t base = ((uint64_t)entry->addr_high << 32) | entry->addr_low;
+        uint64_t len = ((uint64_t)entry->len_high << 32) | entry->len_low;
+
+        if (entry->type == MULTIBOOT_MEMORY_AVAILABLE)
+        {
+            // 内核映像和位图所在的区域不参与分配
+            if (base < KERNEL_RESERVED_END)
+            {
+                len = base + len > KERNEL_RESERVED_END ? base + len - KERNEL_RESERVED_END : 0;
+                base = KERNEL_RESERVED_END;
+            }
+            release_range(base, base + len);
+        }
+        entry_addr += entry->size + sizeof(entry->size);
+    }
+
+#ifdef CONFIG_PHYS_ALLOC_BUDDY
+    buddy_init();
+#endif
+    reserve_multiboot_modules(mbi);
+    record_reserved_pages();
+
+    pr_info("Physical Memory Initialized from memory map: %d free pages of %d, highest address %x%x\n",
+        free_pages, total_pages, (uint32_t)(mem_end >> 32), (uint32_t)mem_end);
 }
 
 /**
@@ -49,9 +237,21 @@ void physical_memory_init(uint32_t mem_size)
  * @return 第一个空闲页面的索引，如果找不到则返回 -1。
  */
 static int find_first_free_page()
+{
+    return find_free_page_from(0);
+}
+
+/**
+ * @brief 从指定页面开始查找第一个空闲页面。
+ *
+ * @param start 开始查找的页面索引。
+ *
+ * @return 空闲页面的索引，如果找不到则返回 -1。
+ */
+static int find_free_page_from(size_t start)
 {
     // 遍历内存位图的每个字节
-    for (size_t i = 0; i < total_pages / 8; i++)
+    for (size_t i = start / 8; i < total_pages / 8; i++)
     {
         // 如果该字节不全是 1，说明该字节中存在空闲页面
         if (memory_bitmap[i] != 0xff)
@@ -60,7 +260,7 @@ static int find_first_free_page()
             for (size_t j = 0; j < 8; j++)
             {
                 // 如果该位为 0，说明该页面空闲
-                if ((memory_bitmap[i] & (1 << j)) == 0)
+                if (i * 8 + j >= start && (memory_bitmap[i] & (1 << j)) == 0)
                 {
                     // 返回该页面的索引
                     return i * 8 + j;
@@ -103,40 +303,481 @@ static void mark_page_as_free(size_t page_index)
     memory_bitmap[byte_idx] &= ~(1 << bit_idx);
 }
 
+#ifdef CONFIG_PHYS_ALLOC_BUDDY
+static void buddy_set(int order, size_t index)
+{
+    buddy_maps[order][index / 8] |= 1 << (index % 8);
+    buddy_free_blocks[order]++;
+    if (index < buddy_hint[order])
+    {
+        buddy_hint[order] = index;
+    }
+}
+
+static void buddy_clear(int order, size_t index)
+{
+    buddy_maps[order][index / 8] &= ~(1 << (index % 8));
+    buddy_free_blocks[order]--;
+}
+
+static int buddy_test(int order, size_t index)
+{
+    return (buddy_maps[order][index / 8] >> (index % 8)) & 1;
+}
+
+/**
+ * @brief 在第 order 阶位图的 [first, last) 范围内查找一个空闲块。
+ *
+ * @return 块在该阶中的索引，如果找不到则返回 -1。
+ */
+static size_t buddy_find(int order, size_t first, size_t last)
+{
+    uint8_t* map = buddy_maps[order];
+    size_t i = first > buddy_hint[order] ? first : buddy_hint[order];
+
+    while (i < last)
+    {
+        // 按字节对齐时跳过全为 0 的字节
+        if (i % 8 == 0 && map[i / 8] == 0)
+        {
+            i += 8;
+            continue;
+        }
+        if (map[i / 8] & (1 << (i % 8)))
+        {
+            break;
+        }
+        i++;
+    }
+
+    // 从提示位置开始的查找说明了提示位置和 i 之间没有空闲块
+    if (first <= buddy_hint[order])
+    {
+        buddy_hint[order] = i < last ? i : last;
+    }
+    return i < last ? i : (size_t)-1;
+}
+
+/**
+ * @brief 把一个空闲块放回伙伴系统，并与空闲的伙伴逐阶合并。
+ *
+ * @param page_idx 块的第一个页面，按 2^order 对齐。
+ */
+static void buddy_free_block(size_t page_idx, int order)
+{
+    while (order < BUDDY_ORDERS - 1)
+    {
+        size_t buddy = page_idx ^ ((size_t)1 << order);
+        if (!buddy_test(order, buddy >> order))
+        {
+            break;
+        }
+        buddy_clear(order, buddy >> order);
+        page_idx &= ~((size_t)1 << order);
+        order++;
+    }
+    buddy_set(order, page_idx >> order);
+}
+
+/**
+ * @brief 把 [page_idx, page_idx + count) 拆成尽可能大的对齐块放回伙伴系统。
+ */
+static void buddy_free_range(size_t page_idx, size_t count)
+{
+    while (count > 0)
+    {
+        int order = 0;
+        while (order < BUDDY_ORDERS - 1 && (page_idx & (((size_t)2 << order) - 1)) == 0 && ((size_t)2 << order) <= count)
+        {
+            order++;
+        }
+        buddy_free_block(page_idx, order);
+        page_idx += (size_t)1 << order;
+        count -= (size_t)1 << order;
+    }
+}
+
+/**
+ * @brief 在 [start, limit) 页面范围内取出一个 2^order 个页面的空闲块，必要时拆分更大的块。
+ *
+ * 拆分剩下的一半依次放回低一阶。页面位图由调用者更新。
+ *
+ * @return 块的第一个页面的索引，如果找不到则返回 -1。
+ */
+static int buddy_take_block(int order, size_t start, size_t limit)
+{
+    for (int o = order; o < BUDDY_ORDERS; o++)
+    {
+        if (buddy_free_blocks[o] == 0)
+        {
+            continue;
+        }
+
+        size_t index = buddy_find(o, (start + ((size_t)1 << o) - 1) >> o, limit >> o);
+        if (index == (size_t)-1)
+        {
+            continue;
+        }
+
+        buddy_clear(o, index);
+        size_t page_idx = index << o;
+        while (o > order)
+        {
+            o--;
+            buddy_set(o, (page_idx >> o) + 1);
+        }
+        return page_idx;
+    }
+    return -1;
+}
+
+/**
+ * @brief 从伙伴系统中移除一个页面，该页面所在的空闲块被拆开，其余部分放回。
+ */
+static void buddy_reserve_page(size_t page_idx)
+{
+    for (int order = 0; order < BUDDY_ORDERS; order++)
+    {
+        size_t base = page_idx & ~(((size_t)1 << order) - 1);
+        if (!buddy_test(order, base >> order))
+        {
+            continue;
+        }
+
+        buddy_clear(order, base >> order);
+        while (order > 0)
+        {
+            order--;
+            size_t half = (size_t)1 << order;
+            if (page_idx < base + half)
+            {
+                buddy_set(order, (base + half) >> order);
+            }
+            else
+            {
+                buddy_set(order, base >> order);
+                base += half;
+            }
+        }
+        return;
+    }
+}
+
+/**
+ * @brief 根据页面位图建立伙伴位图。
+ *
+ * 内核映像和位图所在的区域先被保留，之后每个位置放入对齐允许的、全部空闲的最大块。
+ */
+static void buddy_init()
+{
+    uint8_t* map = (uint8_t*)(BIT_MAP_ADDR + BIT_MAP);
+    for (int order = 0; order < BUDDY_ORDERS; order++)
+    {
+        buddy_maps[order] = map;
+        // 只清理实际内存对应的部分，多留一个字节给最后一个块的伙伴
+        memset(map, 0, (total_pages >> order) / 8 + 1);
+        map += BIT_MAP >> order;
+        buddy_free_blocks[order] = 0;
+        buddy_hint[order] = 0;
+    }
+
+    buddy_ready = 0;
+    physical_memory_reserve_range(0, KERNEL_RESERVED_END);
+
+    size_t page_idx = 0;
+    while (page_idx < total_pages)
+    {
+        int order = BUDDY_ORDERS - 1;
+        while (order > 0 && ((page_idx & (((size_t)1 << order) - 1)) != 0 ||
+                             page_idx + ((size_t)1 << order) > total_pages ||
+                             !is_range_free(page_idx, (size_t)1 << order)))
+        {
+            order--;
+        }
+        if (order > 0 || is_range_free(page_idx, 1))
+        {
+            buddy_set(order, page_idx >> order);
+        }
+        page_idx += (size_t)1 << order;
+    }
+    buddy_ready = 1;
+}
+#endif
+
+/**
+ * @brief 在 [start, limit) 范围内取出一个空闲页面并标记为已使用。
+ *
+ * @return 页面索引，如果范围内没有空闲页面则返回 -1。
+ */
+static int take_free_page(size_t start, size_t limit)
+{
+#ifdef CONFIG_PHYS_ALLOC_BUDDY
+    // 伙伴系统中没有内核和位图所在区域的页面
+    int buddy_idx = buddy_take_block(0, start, limit);
+    if (buddy_idx != -1)
+    {
+        mark_page_as_used(buddy_idx);
+        free_pages--;
+    }
+    return buddy_idx;
+#else
+    // 查找第一个空闲页面
+    int page_idx = find_free_page_from(start);
+
+    while (page_idx != -1 && (size_t)page_idx < limit)
+    {
+        // 将该页面标记为已使用
+        mark_page_as_used(page_idx);
+        // 减少空闲页面计数
+        free_pages--;
+
+        // 如果分配的地址在内核和位图所在的区域，则继续查找下一个空闲页面
+        if ((uint64_t)page_idx * PAGE_SIZE >= KERNEL_RESERVED_END)
+        {
+            return page_idx;
+        }
+        page_idx = find_free_page_from(page_idx + 1);
+    }
+
+    return -1;
+#endif
+}
+
+/**
+ * @brief 取出一个空闲页面，内存不足时先回收再重试一次。
+ *
+ * 分配前检查水位：低于 min 时在当前线程直接回收，低于 low 时唤醒后台回收线程。
+ *
+ * @param highmem 是否优先使用高端内存。
+ *
+ * @return 页面索引，如果回收之后仍然没有空闲页面则返回 -1。
+ */
+static int alloc_page_index(int highmem)
+{
+    reclaim_throttle(1);
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        int page_idx = -1;
+
+        if (highmem && total_pages > LOWMEM_PAGES)
+        {
+            page_idx = take_free_page(LOWMEM_PAGES, total_pages);
+        }
+        if (page_idx == -1)
+        {
+            page_idx = take_free_page(0, LOWMEM_PAGES);
+        }
+        if (page_idx != -1)
+        {
+            TRACE_EVENT(TRACE_PAGE_ALLOC, page_idx, 1, 0, 0);
+            return page_idx;
+        }
+
+        // 没有空闲页面，回收缓存后再试一次
+        if (reclaim_direct(RECLAIM_BATCH) == 0)
+        {
+            break;
+        }
+    }
+
+    reclaim_alloc_failed();
+    return -1;
+}
+
 /**
  * @brief 分配一个物理页面。
  *
+ * 只会返回低端内存页面，调用者可以通过直接映射区访问它。
+ *
  * @return 分配的物理页面的地址，如果分配失败则返回 NULL。
  */
 void* alloc_physical_page()
 {
-    // 查找第一个空闲页面
-    int page_idx = find_first_free_page();
+    int page_idx = alloc_page_index(0);
     if (page_idx == -1)
     {
         // 没有空闲页面，打印错误信息并返回 NULL
-        kprintf("Out of memory!\n");
+        pr_err("Out of memory!\n");
         return NULL;
     }
 
-    // 将该页面标记为已使用
-    mark_page_as_used(page_idx);
-    // 减少空闲页面计数
-    free_pages--;
+    // 返回分配的物理地址
+    return (void*)(page_idx * PAGE_SIZE);
+}
 
-    // 计算分配的物理地址
-    uintptr_t alloc_address = (page_idx * PAGE_SIZE);
-    // 如果分配的地址在内核和位图所在的区域（前 2MB + BITMAP），则继续查找下一个空闲页面
-    if (alloc_address < 0x208000)
+/**
+ * @brief 分配一个物理页面，优先使用直接映射区之外的高端内存。
+ *
+ * 高端内存页面没有固定的虚拟地址，只能通过页表映射（或 kmap_atomic）访问。
+ *
+ * @return 分配的物理页面的地址，如果分配失败则返回 0。
+ */
+phys_addr_t alloc_highmem_page()
+{
+    int page_idx = alloc_page_index(1);
+    if (page_idx == -1)
     {
-        return alloc_physical_page();
+        pr_err("Out of memory!\n");
+        return 0;
     }
 
-    // 打印调试信息
-    kprintf("Allocated page %d at address %x\n", page_idx, (void*)(page_idx * PAGE_SIZE));
+    return (phys_addr_t)page_idx << 12;
+}
 
-    // 返回分配的物理地址
-    return (void*)(page_idx * PAGE_SIZE);
+/**
+ * @brief 释放一个由 alloc_highmem_page 分配的物理页面。
+ *
+ * @param page 物理页面的地址。
+ */
+void free_highmem_page(phys_addr_t page)
+{
+    TRACE_EVENT(TRACE_PAGE_FREE, page >> 12, 1, 0, 0);
+    mark_page_as_free(page >> 12);
+    free_pages++;
+#ifdef CONFIG_PHYS_ALLOC_BUDDY
+    buddy_free_block(page >> 12, 0);
+#endif
+}
+
+/**
+ * @brief 检查从 page_idx 开始的 count 个页面是否全部空闲。
+ */
+static int is_range_free(size_t page_idx, size_t count)
+{
+    for (size_t i = page_idx; i < page_idx + count;)
+    {
+        // 按字节对齐时整字节检查，避免逐位遍历
+        if (i % 8 == 0 && i + 8 <= page_idx + count)
+        {
+            if (memory_bitmap[i / 8] != 0)
+            {
+                return 0;
+            }
+            i += 8;
+        }
+        else
+        {
+            if (memory_bitmap[i / 8] & (1 << (i % 8)))
+            {
+                return 0;
+            }
+            i++;
+        }
+    }
+    return 1;
+}
+
+#ifndef CONFIG_PHYS_ALLOC_BUDDY
+/**
+ * @brief 在 [start, limit) 范围内查找按 align 对齐的连续空闲页面。
+ *
+ * @return 第一个页面的索引，如果找不到则返回 -1。
+ */
+static int find_free_range(size_t start, size_t limit, size_t count, size_t align)
+{
+    size_t reserved = (KERNEL_RESERVED_END + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (start < reserved)
+    {
+        start = reserved;
+    }
+    start = (start + align - 1) & ~(align - 1);
+
+    for (size_t page_idx = start; page_idx + count <= limit; page_idx += align)
+    {
+        if (is_range_free(page_idx, count))
+        {
+            return page_idx;
+        }
+    }
+    return -1;
+}
+#endif
+
+/**
+ * @brief 分配一段物理上连续且对齐的页面，例如用于大页映射。
+ *
+ * 与 alloc_highmem_page 一样优先使用高端内存。使用伙伴系统时
+ * count 和 align 都不能超过 2^(BUDDY_ORDERS - 1) 个页面。
+ *
+ * @param count 页面数量。
+ * @param align 对齐的页面数，必须是 2 的幂。
+ *
+ * @return 第一个页面的物理地址，如果找不到满足条件的页面则返回 0。
+ */
+phys_addr_t alloc_physical_pages_aligned(size_t count, size_t align)
+{
+    int page_idx = -1;
+
+    // 回收释放的页面不一定连续，所以这里只检查水位，找不到时不为它回收
+    reclaim_throttle(count);
+
+#ifdef CONFIG_PHYS_ALLOC_BUDDY
+    // 取一个同时满足数量和对齐的块，多出的尾部放回伙伴系统
+    int order = 0;
+    while (((size_t)1 << order) < count || ((size_t)1 << order) < align)
+    {
+        order++;
+    }
+    if (order >= BUDDY_ORDERS)
+    {
+        return 0;
+    }
+
+    if (total_pages > LOWMEM_PAGES)
+    {
+        page_idx = buddy_take_block(order, LOWMEM_PAGES, total_pages);
+    }
+    if (page_idx == -1)
+    {
+        page_idx = buddy_take_block(order, 0, total_pages < LOWMEM_PAGES ? total_pages : LOWMEM_PAGES);
+    }
+    if (page_idx != -1 && ((size_t)1 << order) > count)
+    {
+        buddy_free_range(page_idx + count, ((size_t)1 << order) - count);
+    }
+#else
+    if (total_pages > LOWMEM_PAGES)
+    {
+        page_idx = find_free_range(LOWMEM_PAGES, total_pages, count, align);
+    }
+    if (page_idx == -1)
+    {
+        page_idx = find_free_range(0, total_pages < LOWMEM_PAGES ? total_pages : LOWMEM_PAGES, count, align);
+    }
+#endif
+    if (page_idx == -1)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        mark_page_as_used(page_idx + i);
+    }
+    free_pages -= count;
+    TRACE_EVENT(TRACE_PAGE_ALLOC, page_idx, count, 0, 0);
+
+    return (phys_addr_t)page_idx << 12;
+}
+
+/**
+ * @brief 释放一段由 alloc_physical_pages_aligned 分配的连续页面。
+ *
+ * @param start 第一个页面的物理地址。
+ * @param count 页面数量。
+ */
+void free_physical_pages(phys_addr_t start, size_t count)
+{
+    TRACE_EVENT(TRACE_PAGE_FREE, start >> 12, count, 0, 0);
+    for (size_t i = 0; i < count; i++)
+    {
+        mark_page_as_free((start >> 12) + i);
+    }
+    free_pages += count;
+#ifdef CONFIG_PHYS_ALLOC_BUDDY
+    buddy_free_range(start >> 12, count);
+#endif
 }
 
 /**
@@ -148,12 +789,16 @@ void free_physical_page(void* ptr)
 {
     // 计算该页面的索引
     size_t page_idx = (size_t)ptr / PAGE_SIZE;
+    TRACE_EVENT(TRACE_PAGE_FREE, page_idx, 1, 0, 0);
 
     // 将该页面标记为空闲
     mark_page_as_free(page_idx);
 
     // 增加空闲页面计数
     free_pages++;
+#ifdef CONFIG_PHYS_ALLOC_BUDDY
+    buddy_free_block(page_idx, 0);
+#endif
 }
 
 /**
@@ -194,3 +839,85 @@ size_t get_free_page_count()
 {
     return free_pages;
 }
+
+
+/**
+ * @brief 获取物理页面总数。
+ *
+ * @return 物理页面总数。
+ */
+size_t get_total_page_count()
+{
+    return total_pages;
+}
+
+/**
+ * @brief 统计 [start, end) 范围内的空闲页面数。
+ */
+static size_t count_free_pages(size_t start, size_t end)
+{
+    // 每个半字节中置位的个数
+    static const uint8_t nibble_bits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+    size_t used = 0;
+    size_t i = start;
+
+    // 首尾不足一个字节的部分逐位统计，中间整字节查表
+    for (; i < end && i % 8 != 0; i++)
+    {
+        used += (memory_bitmap[i / 8] >> (i % 8)) & 1;
+    }
+    for (; i + 8 <= end; i += 8)
+    {
+        uint8_t byte = memory_bitmap[i / 8];
+        used += nibble_bits[byte & 0xF] + nibble_bits[byte >> 4];
+    }
+    for (; i < end; i++)
+    {
+        used += (memory_bitmap[i / 8] >> (i % 8)) & 1;
+    }
+
+    return (end - start) - used;
+}
+
+/**
+ * @brief 返回区域的页面范围 [start, end)。
+ */
+static void zone_range(int zone, size_t* start, size_t* end)
+{
+    size_t lowmem_end = total_pages < LOWMEM_PAGES ? total_pages : LOWMEM_PAGES;
+
+    *start = zone == ZONE_LOWMEM ? 0 : lowmem_end;
+    *end = zone == ZONE_LOWMEM ? lowmem_end : total_pages;
+}
+
+/**
+ * @brief 记录初始化结束时各区域中已经标记为使用的页面，作为保留页面。
+ */
+static void record_reserved_pages()
+{
+    for (int zone = 0; zone < NR_ZONES; zone++)
+    {
+        size_t start, end;
+        zone_range(zone, &start, &end);
+        zone_reserved[zone] = (end - start) - count_free_pages(start, end);
+    }
+}
+
+/**
+ * @brief 获取一个区域的页面统计。
+ *
+ * 需要扫描位图，只用于统计输出，不要在分配路径上调用。
+ *
+ * @param zone ZONE_LOWMEM 或 ZONE_HIGHMEM。
+ * @param stats 统计结果。
+ */
+void physical_memory_zone_stats(int zone, zone_stats_t* stats)
+{
+    size_t start, end;
+    zone_range(zone, &start, &end);
+
+    stats->total = end - start;
+    stats->free = count_free_pages(start, end);
+    stats->reserved = zone_reserved[zone];
+    stats->used = stats->total - stats->free > stats->reserved ? stats->total - stats->free - stats->reserved : 0;
+}
@@ -0,0 +1,214 @@
+#include <kernel/mm/reclaim.h>
+#include <kernel/init.h>
+
+// Free page watermarks. Below low the reclaimer thread is woken and frees
+// pages until high; below min the allocating thread reclaims directly.
+// All zero until reclaim_init(), which disables both.
+static size_t watermark_min = 0;
+static size_t watermark_low = 0;
+static size_t watermark_high = 0;
+
+static shrinker_t* shrinkers = NULL;
+static kthread_t* reclaimer = NULL;
+static reclaim_stats_t reclaim_stats;
+
+// Set while the shrinkers run. Their own allocations, such as a page table
+// for splitting a large page, dip into the pages below min instead of recursing.
+static volatile int reclaim_running = 0;
+
+// The heap first, its free tail is already unused; then clean file pages,
+// then cached metadata blocks, which are smaller and more often reused
+static shrinker_t heap_shrinker = { .name = "heap", .scan = heap_trim };
+static shrinker_t page_cache_shrinker = { .name = "page_cache", .scan = page_cache_shrink };
+static shrinker_t bcache_shrinker = { .name = "bcache", .scan = bcache_shrink };
+
+/**
+ * @brief Adds a cache to the ones asked for pages under memory pressure.
+ *
+ * Shrinkers are asked in registration order.
+ */
+void register_shrinker(shrinker_t* shrinker)
+{
+    shrinker->next = NULL;
+
+    shrinker_t** link = &shrinkers;
+    while (*link != NULL)
+    {
+        link = &(*link)->next;
+    }
+    *link = shrinker;
+}
+
+/**
+ * @brief Asks the shrinkers, in order, for up to `count` pages.
+ *
+ * @return The number of pages freed.
+ */
+size_t reclaim_pages(size_t count)
+{
+    if (reclaim_running)
+    {
+        return 0;
+    }
+    reclaim_running = 1;
+
+    size_t freed = 0;
+    for (shrinker_t* shrinker = shrinkers; shrinker != NULL && freed < count; shrinker = shrinker->next)
+    {
+        freed += shrinker->scan(count - freed);
+    }
+
+    reclaim_running = 0;
+    __atomic_fetch_add(&reclaim_stats.pages_reclaimed, freed, __ATOMIC_RELAXED);
+    return freed;
+}
+
+/**
+ * @brief Reclaims until free memory is back above the high watermark or
+ *        the shrinkers have nothing left.
+ */
+static size_t reclaim_to_high()
+{
+    size_t freed = 0;
+
+    while (get_free_page_count() < watermark_high)
+    {
+        size_t batch = reclaim_pages(RECLAIM_BATCH);
+        if (batch == 0)
+        {
+            break;
+        }
+        freed += batch;
+    }
+
+    return freed;
+}
+
+static void reclaimer_thread(void* arg)
+{
+    (void)arg;
+
+    for (;;)
+    {
+        if (get_free_page_count() < watermark_high)
+        {
+            __atomic_fetch_add(&reclaim_stats.background_runs, 1, __ATOMIC_RELAXED);
+            reclaim_to_high();
+        }
+        kthread_sleep();
+    }
+}
+
+/**
+ * @brief Wakes the reclaimer thread. It runs the next time the current thread yields.
+ */
+void reclaim_wake()
+{
+    if (reclaimer != NULL && reclaimer->state == KTHREAD_SLEEPING)
+    {
+        __atomic_fetch_add(&reclaim_stats.wakeups, 1, __ATOMIC_RELAXED);
+        kthread_wake(reclaimer);
+    }
+}
+
+/**
+ * @brief Reclaims in the allocating thread, for when waiting for the reclaimer is not an option.
+ *
+ * @return The number of pages freed; 0 when called from within reclaim.
+ */
+size_t reclaim_direct(size_t count)
+{
+    if (reclaim_running || shrinkers == NULL)
+    {
+        return 0;
+    }
+
+    __atomic_fetch_add(&reclaim_stats.direct_runs, 1, __ATOMIC_RELAXED);
+    size_t freed = reclaim_pages(count);
+    if (get_free_page_count() < watermark_high)
+    {
+        freed += reclaim_to_high();
+    }
+    return freed;
+}
+
+/**
+ * @brief Called by the page allocator before it takes `count` pages.
+ *
+ * Below the min watermark this reclaims directly; below low it wakes the
+ * reclaimer so the next allocations do not have to.
+ */
+void reclaim_throttle(size_t count)
+{
+    if (watermark_min == 0 || reclaim_running)
+    {
+        return;
+    }
+
+    size_t free = get_free_page_count();
+    if (free < watermark_min + count)
+    {
+        reclaim_direct(watermark_high - free + count);
+        free = get_free_page_count();
+    }
+    if (free < watermark_low + count)
+    {
+        reclaim_wake();
+    }
+}
+
+/**
+ * @brief Counts an allocation that failed even after reclaim.
+ */
+void reclaim_alloc_failed()
+{
+    __atomic_fetch_add(&reclaim_stats.failures, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Sets the watermarks from the memory present now, registers the
+ *        built-in shrinkers and starts the reclaimer thread.
+ *
+ * Needs the heap and vmalloc.
+ */
+void reclaim_init()
+{
+    size_t min = get_free_page_count() / 128;
+    if (min < WATERMARK_MIN_FLOOR)
+    {
+        min = WATERMARK_MIN_FLOOR;
+    }
+    if (min > WATERMARK_MIN_CEIL)
+    {
+        min = WATERMARK_MIN_CEIL;
+    }
+
+    register_shrinker(&heap_shrinker);
+    register_shrinker(&page_cache_shrinker);
+    register_shrinker(&bcache_shrinker);
+
+    reclaimer = kthread_create(reclaimer_thread, NULL, "kreclaimd");
+    if (reclaimer == NULL)
+    {
+        kprintf("reclaim: could not start the reclaimer, only direct reclaim is available\n");
+    }
+
+    watermark_min = min;
+    watermark_low = min * 2;
+    watermark_high = min * 3;
+
+    pr_info("reclaim: watermarks min %d low %d high %d pages\n", watermark_min, watermark_low, watermark_high);
+}
+INITCALL(INIT_SUBSYS, reclaim_init, NULL);
+
+void reclaim_get_watermarks(size_t* min, size_t* low, size_t* high)
+{
+    *min = watermark_min;
+    *low = watermark_low;
+    *high = watermark_high;
+}
+
+void reclaim_get_stats(reclaim_stats_t* stats)
+{
+    *stats = reclaim_stats;
+}
@@ -0,0 +1,330 @@
+#include <kernel/mm/tlb.h>
+#include <kernel/mm/paging.h>
+
+/**
+ * @brief Per-CPU shootdown state.
+ *
+ * Other CPUs append invalidations to `queue` under `lock` and raise a single
+ * IPI while `ipi_pending` is clear; later batches that arrive before the
+ * target has drained its queue are merged into it without another IPI.
+ */
+typedef struct tlb_cpu
+{
+    spinlock_t lock;
+    tlb_gather_t queue;            // Invalidations waiting for this CPU
+    volatile uint32_t queued_gen;  // Bumped for every batch merged into the queue
+    volatile uint32_t acked_gen;   // Newest batch generation this CPU has flushed
+    volatile uint32_t ipi_pending; // An IPI is already on its way
+    volatile uint32_t active_pd;   // CR3 currently loaded on this CPU
+    volatile uint32_t lazy;        // Running a kernel thread on a borrowed address space
+    volatile uint32_t need_flush;  // A user flush was deferred while lazy
+} __attribute__((aligned(64))) tlb_cpu_t;
+
+static tlb_cpu_t tlb_cpus[MAX_CPUS];
+
+/**
+ * @brief Resets a gather so it can collect a new batch of invalidations.
+ *
+ * @param tlb The gather to reset.
+ */
+void tlb_gather_init(tlb_gather_t* tlb)
+{
+    tlb->nr_ranges = 0;
+    tlb->nr_pages = 0;
+    tlb->flush_all = 0;
+    tlb->kernel = 0;
+    tlb->page_directory = read_cr3();
+}
+
+/**
+ * @brief Records that the translations for a range of pages have changed.
+ *
+ * A range overlapping or touching one already in the batch is merged into it,
+ * which keeps both sequential page table walks and merged remote queues
+ * compact. Once the batch grows past TLB_FLUSH_ALL_THRESHOLD pages, or runs
+ * out of range slots, the gather stops tracking pages and falls back to a
+ * full flush.
+ *
+ * @param tlb The gather collecting the batch.
+ * @param start The first virtual address of the range.
+ * @param end One past the last virtual address of the range.
+ */
+void tlb_gather_add_range(tlb_gather_t* tlb, uintptr_t start, uintptr_t end)
+{
+    start &= ~(PAGE_SIZE - 1);
+    end = (end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    if (start >= USER_SPACE_END || start < USER_SPACE_START)
+    {
+        tlb->kernel = 1;
+    }
+
+    if (tlb->flush_all)
+    {
+        return;
+    }
+
+    tlb->nr_pages += (end - start) / PAGE_SIZE;
+    if (tlb->nr_pages > TLB_FLUSH_ALL_THRESHOLD)
+    {
+        tlb->flush_all = 1;
+        return;
+    }
+
+    for (uint32_t i = 0; i < tlb->nr_ranges; i++)
+    {
+        if (start <= tlb->end[i] && end >= tlb->start[i])
+        {
+            tlb->start[i] = start < tlb->start[i] ? start : tlb->start[i];
+            tlb->end[i] = end > tlb->end[i] ? end : tlb->end[i];
+            return;
+        }
+    }
+
+    if (tlb->nr_ranges == TLB_GATHER_RANGES)
+    {
+        tlb->flush_all = 1;
+        return;
+    }
+
+    tlb->start[tlb->nr_ranges] = start;
+    tlb->end[tlb->nr_ranges] = end;
+    tlb->nr_ranges++;
+}
+
+/**
+ * @brief Records that the translation for a single page has changed.
+ *
+ * @param tlb The gather collecting the batch.
+ * @param virtual_addr The virtual address of the page whose entry changed.
+ */
+void tlb_gather_add(tlb_gather_t* tlb, uintptr_t virtual_addr)
+{
+    tlb_gather_add_range(tlb, virtual_addr, virtual_addr + PAGE_SIZE);
+}
+
+/**
+ * @brief Merges the pages of one batch into another.
+ */
+static void tlb_gather_merge(tlb_gather_t* dst, const tlb_gather_t* src)
+{
+    dst->kernel |= src->kernel;
+
+    if (src->flush_all)
+    {
+        dst->flush_all = 1;
+        return;
+    }
+
+    for (uint32_t i = 0; i < src->nr_ranges; i++)
+    {
+        tlb_gather_add_range(dst, src->start[i], src->end[i]);
+    }
+}
+
+/**
+ * @brief Invalidates the pages of a batch on the executing CPU only.
+ *
+ * Small batches are flushed page by page with invlpg so unrelated translations
+ * stay cached; large batches reload CR3 instead.
+ */
+static void tlb_flush_local(const tlb_gather_t* tlb)
+{
+    if (tlb->flush_all)
+    {
+        tlb_flush_all();
+        return;
+    }
+
+    for (uint32_t i = 0; i < tlb->nr_ranges; i++)
+    {
+        for (uintptr_t addr = tlb->start[i]; addr < tlb->end[i]; addr += PAGE_SIZE)
+        {
+            tlb_invalidate_page(addr);
+        }
+    }
+}
+
+/**
+ * @brief Propagates a batch to every other CPU that may cache its translations.
+ *
+ * User ranges only concern CPUs that have the batch's address space loaded;
+ * any other CPU flushes them anyway when it next loads CR3. CPUs running a
+ * kernel thread on a borrowed address space never touch user pages, so they
+ * only get a deferred flush and no IPI. All IPIs are sent before waiting, so
+ * the whole batch is acknowledged together.
+ */
+static void tlb_shootdown(const tlb_gather_t* tlb, uint32_t self)
+{
+    uint32_t wait_gen[MAX_CPUS];
+    uint32_t wait_mask = 0;
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        if (cpu == self || !(cpu_online_mask & (1 << cpu)))
+        {
+            continue;
+        }
+
+        tlb_cpu_t* target = &tlb_cpus[cpu];
+        if (!tlb->kernel && target->active_pd != tlb->page_directory)
+        {
+            continue;
+        }
+
+        uint32_t irq_flags = local_irq_save();
+        spin_lock(&target->lock);
+
+        if (!tlb->kernel && target->lazy)
+        {
+            target->need_flush = 1;
+            spin_unlock(&target->lock);
+            local_irq_restore(irq_flags);
+            continue;
+        }
+
+        tlb_gather_merge(&target->queue, tlb);
+        wait_gen[cpu] = ++target->queued_gen;
+        int send_ipi = !target->ipi_pending;
+        target->ipi_pending = 1;
+
+        spin_unlock(&target->lock);
+        local_irq_restore(irq_flags);
+
+        if (send_ipi)
+        {
+            lapic_send_ipi(cpu_apic_ids[cpu], TLB_SHOOTDOWN_VECTOR);
+        }
+        wait_mask |= 1 << cpu;
+    }
+
+    while (wait_mask)
+    {
+        for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+        {
+            if ((wait_mask & (1 << cpu)) && (int32_t)(tlb_cpus[cpu].acked_gen - wait_gen[cpu]) >= 0)
+            {
+                wait_mask &= ~(1 << cpu);
+            }
+        }
+
+        // Another CPU may be waiting on us at the same time
+        tlb_shootdown_poll();
+        cpu_relax();
+    }
+}
+
+/**
+ * @brief Invalidates every page collected by the gather on all CPUs and resets it.
+ *
+ * @param tlb The gather to flush.
+ */
+void tlb_gather_flush(tlb_gather_t* tlb)
+{
+    if (tlb->nr_ranges == 0 && !tlb->flush_all)
+    {
+        return;
+    }
+
+    tlb_flush_local(tlb);
+
+    uint32_t self = smp_processor_id();
+    if (cpu_online_mask & ~(1 << self))
+    {
+        tlb_shootdown(tlb, self);
+    }
+
+    tlb_gather_init(tlb);
+}
+
+/**
+ * @brief Records the address space loaded on the executing CPU and installs
+ *        the shootdown IPI handler.
+ *
+ * Must be called on each CPU once paging is enabled and the IDT is loaded.
+ */
+void tlb_cpu_init()
+{
+    tlb_cpu_t* cpu = &tlb_cpus[smp_processor_id()];
+    tlb_gather_init(&cpu->queue);
+    cpu->active_pd = read_cr3();
+    idt_register_handler(TLB_SHOOTDOWN_VECTOR, tlb_shootdown_interrupt);
+}
+
+/**
+ * @brief Informs the shootdown code that the executing CPU changes address space.
+ *
+ * @param page_directory The CR3 value of the address space to run.
+ * @param lazy Non-zero when switching to a kernel thread, which keeps the
+ *             current address space loaded and defers user flushes.
+ */
+void tlb_switch_address_space(uint32_t page_directory, int lazy)
+{
+    // The shootdown interrupt takes the same lock
+    uint32_t irq_flags = local_irq_save();
+    tlb_cpu_t* cpu = &tlb_cpus[smp_processor_id()];
+    spin_lock(&cpu->lock);
+
+    if (lazy)
+    {
+        cpu->lazy = 1;
+        spin_unlock(&cpu->lock);
+        local_irq_restore(irq_flags);
+        return;
+    }
+
+    cpu->lazy = 0;
+    if (page_directory != cpu->active_pd)
+    {
+        // Loading CR3 drops every non-global translation, deferred ones included
+        asm volatile("mov %0, %%cr3" : : "r"(page_directory) : "memory");
+        cpu->active_pd = page_directory;
+    }
+    else if (cpu->need_flush)
+    {
+        tlb_flush_all();
+    }
+    cpu->need_flush = 0;
+
+    spin_unlock(&cpu->lock);
+    local_irq_restore(irq_flags);
+}
+
+/**
+ * @brief Processes the invalidations other CPUs queued for the executing CPU.
+ *
+ * Everything queued up to this point is flushed at once and acknowledged with
+ * the newest generation, covering every batch that was coalesced into it.
+ */
+void tlb_shootdown_poll()
+{
+    tlb_cpu_t* cpu = &tlb_cpus[smp_processor_id()];
+
+    if (!cpu->ipi_pending)
+    {
+        return;
+    }
+
+    // Also called from thread context, where the interrupt could take the lock again
+    uint32_t irq_flags = local_irq_save();
+    spin_lock(&cpu->lock);
+    tlb_gather_t batch = cpu->queue;
+    uint32_t gen = cpu->queued_gen;
+    tlb_gather_init(&cpu->queue);
+    cpu->ipi_pending = 0;
+    spin_unlock(&cpu->lock);
+    local_irq_restore(irq_flags);
+
+    tlb_flush_local(&batch);
+    cpu->acked_gen = gen;
+}
+
+/**
+ * @brief Handler for TLB_SHOOTDOWN_VECTOR.
+ */
+void tlb_shootdown_interrupt(interrupt_frame_t* frame)
+{
+    (void)frame;
+    tlb_shootdown_poll();
+    lapic_eoi();
+}
@@ -0,0 +1,360 @@
+#include <kernel/mm/vmalloc.h>
+
+// One bit per page of the vmalloc range; set for mapped pages and for the guard page after each area
+static uint8_t vmalloc_bitmap[VMALLOC_PAGES / 8];
+// One bit per page, set only for guard pages, so an area's length is known from its start alone
+static uint8_t vmalloc_guards[VMALLOC_PAGES / 8];
+// Page index where the next search starts, so consecutive allocations do not rescan the used prefix
+static size_t vmalloc_next = 0;
+static size_t vmalloc_pages_in_use = 0;
+
+// Frames are allocated and mapped in batches of this many pages
+#define VMALLOC_BATCH 64
+
+static inline int vmalloc_page_used(size_t page_idx)
+{
+    return vmalloc_bitmap[page_idx / 8] & (1 << (page_idx % 8));
+}
+
+static void vmalloc_mark(size_t page_idx, size_t count, int used)
+{
+    for (size_t i = page_idx; i < page_idx + count; i++)
+    {
+        if (used)
+        {
+            vmalloc_bitmap[i / 8] |= 1 << (i % 8);
+        }
+        else
+        {
+            vmalloc_bitmap[i / 8] &= ~(1 << (i % 8));
+        }
+    }
+}
+
+/**
+ * @brief Finds `count` free pages in [start, limit) of the vmalloc range.
+ *
+ * Fully used bytes of the bitmap are skipped eight pages at a time.
+ *
+ * @return The first page index of the free run, or -1 if there is none.
+ */
+static int vmalloc_find_range(size_t start, size_t limit, size_t count)
+{
+    size_t run = 0;
+
+    for (size_t page_idx = start; page_idx < limit; page_idx++)
+    {
+        if (page_idx % 8 == 0 && vmalloc_bitmap[page_idx / 8] == 0xFF)
+        {
+            run = 0;
+            page_idx += 7;
+            continue;
+        }
+
+        run = vmalloc_page_used(page_idx) ? 0 : run + 1;
+        if (run == count)
+        {
+            return page_idx + 1 - count;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Releases the frames behind `count` mapped pages and unmaps them.
+ */
+static void vmalloc_release(uintptr_t virtual_addr, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        phys_addr_t frame = virt_to_phys(virtual_addr + i * PAGE_SIZE);
+        if (frame != 0)
+        {
+            free_highmem_page(frame);
+        }
+    }
+
+    // One walk and one flush for the whole area
+    unmap_range(virtual_addr, count * PAGE_SIZE);
+}
+
+/**
+ * @brief Reserves a virtual area of `count` pages plus its guard page.
+ *
+ * @return The first page index of the area, or -1 if the range is exhausted.
+ */
+static int vmalloc_reserve(size_t count)
+{
+    int page_idx = vmalloc_find_range(vmalloc_next, VMALLOC_PAGES, count + 1);
+    if (page_idx == -1)
+    {
+        page_idx = vmalloc_find_range(0, VMALLOC_PAGES, count + 1);
+    }
+    if (page_idx == -1)
+    {
+        kprintf("vmalloc: no virtual range for %d pages\n", count);
+        return -1;
+    }
+
+    vmalloc_mark(page_idx, count + 1, 1);
+    vmalloc_guards[(page_idx + count) / 8] |= 1 << ((page_idx + count) % 8);
+    vmalloc_next = page_idx + count + 1;
+    return page_idx;
+}
+
+/**
+ * @brief Returns the number of pages in the area starting at `page_idx`.
+ *
+ * The area ends at its guard page. Bytes of the guard bitmap without one
+ * are skipped eight pages at a time.
+ */
+static size_t vmalloc_area_pages(size_t page_idx)
+{
+    size_t end = page_idx;
+    while (end < VMALLOC_PAGES && !(vmalloc_guards[end / 8] & (1 << (end % 8))))
+    {
+        end = (end % 8 == 0 && vmalloc_guards[end / 8] == 0) ? end + 8 : end + 1;
+    }
+    return end - page_idx;
+}
+
+/**
+ * @brief Releases the virtual area starting at `page_idx` and its guard page.
+ */
+static void vmalloc_unreserve(size_t page_idx, size_t count)
+{
+    vmalloc_mark(page_idx, count + 1, 0);
+    vmalloc_guards[(page_idx + count) / 8] &= ~(1 << ((page_idx + count) % 8));
+
+    if (page_idx < vmalloc_next)
+    {
+        vmalloc_next = page_idx;
+    }
+}
+
+/**
+ * @brief Allocates a virtually contiguous kernel buffer.
+ *
+ * The buffer is backed by individual frames, which need not be physically
+ * contiguous and may come from high memory. Each area is followed by an
+ * unmapped guard page, which catches overruns and marks where the area ends.
+ *
+ * @param size The size of the buffer in bytes, rounded up to whole pages.
+ *
+ * @return The page aligned buffer, or NULL if either the virtual range or
+ *         physical memory is exhausted.
+ */
+void* vmalloc(size_t size)
+{
+    if (size == 0)
+    {
+        return NULL;
+    }
+
+    size_t count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    // Reserve the pages plus the trailing guard page
+    int page_idx = vmalloc_reserve(count);
+    if (page_idx == -1)
+    {
+        return NULL;
+    }
+
+    uintptr_t virtual_addr = VMALLOC_START + page_idx * PAGE_SIZE;
+    phys_addr_t frames[VMALLOC_BATCH];
+
+    for (size_t mapped = 0; mapped < count;)
+    {
+        size_t batch = count - mapped < VMALLOC_BATCH ? count - mapped : VMALLOC_BATCH;
+
+        for (size_t i = 0; i < batch; i++)
+        {
+            frames[i] = alloc_highmem_page();
+            if (frames[i] == 0)
+            {
+                // Give back this batch and everything mapped so far
+                while (i-- > 0)
+                {
+                    free_highmem_page(frames[i]);
+                }
+                vmalloc_release(virtual_addr, mapped);
+                vmalloc_unreserve(page_idx, count);
+                return NULL;
+            }
+        }
+
+        map_pages(virtual_addr + mapped * PAGE_SIZE, frames, batch, PG_PRESENT | PG_WRITE | PG_NX);
+        mapped += batch;
+    }
+
+    vmalloc_pages_in_use += count;
+    return (void*)virtual_addr;
+}
+
+/**
+ * @brief Frees a buffer returned by vmalloc().
+ *
+ * The frames go straight back to the physical allocator and the virtual
+ * range becomes available again immediately.
+ *
+ * @param ptr The buffer to free.
+ */
+void vfree(void* ptr)
+{
+    uintptr_t virtual_addr = (uintptr_t)ptr;
+
+    if (!is_vmalloc_addr(ptr) || (virtual_addr & (PAGE_SIZE - 1)))
+    {
+        pr_warn("vfree: invalid pointer %x\n", virtual_addr);
+        return;
+    }
+
+    size_t page_idx = (virtual_addr - VMALLOC_START) / PAGE_SIZE;
+    size_t count = vmalloc_area_pages(page_idx);
+
+    vmalloc_release(virtual_addr, count);
+    vmalloc_unreserve(page_idx, count);
+    vmalloc_pages_in_use -= count;
+}
+
+/**
+ * @brief Maps existing physically contiguous memory into the vmalloc range.
+ *
+ * No frames are allocated; the caller keeps ownership of the memory, which
+ * is typically reserved at boot (for example a multiboot module).
+ *
+ * @param physical_addr The physical start address; need not be page aligned.
+ * @param size The size of the memory in bytes.
+ * @param flags The flags for the mapping, e.g. PG_PRESENT alone for read-only.
+ *
+ * @return The virtual address corresponding to `physical_addr`, or NULL.
+ */
+void* vmap_range(phys_addr_t physical_addr, size_t size, pte_t flags)
+{
+    uint32_t offset = physical_addr & (PAGE_SIZE - 1);
+    size_t count = (offset + size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    if (count == 0)
+    {
+        return NULL;
+    }
+
+    int page_idx = vmalloc_reserve(count);
+    if (page_idx == -1)
+    {
+        return NULL;
+    }
+
+    uintptr_t virtual_addr = VMALLOC_START + page_idx * PAGE_SIZE;
+    map_range(virtual_addr, physical_addr - offset, count * PAGE_SIZE, flags | PG_PRESENT);
+
+    return (void*)(virtual_addr + offset);
+}
+
+/**
+ * @brief Maps existing frames, in order, into one virtually contiguous area.
+ *
+ * Like vmap_range(), the frames stay owned by the caller.
+ *
+ * @return The page aligned virtual address of the first frame, or NULL.
+ */
+void* vmap_pages(const phys_addr_t* frames, size_t count, pte_t flags)
+{
+    if (count == 0)
+    {
+        return NULL;
+    }
+
+    int page_idx = vmalloc_reserve(count);
+    if (page_idx == -1)
+    {
+        return NULL;
+    }
+
+    uintptr_t virtual_addr = VMALLOC_START + page_idx * PAGE_SIZE;
+    map_pages(virtual_addr, frames, count, flags | PG_PRESENT);
+
+    return (void*)virtual_addr;
+}
+
+/**
+ * @brief Removes a mapping created by vmap_range() or vmap_pages() without freeing the memory behind it.
+ *
+ * @param ptr The address returned by vmap_range().
+ */
+void vunmap(void* ptr)
+{
+    if (!is_vmalloc_addr(ptr))
+    {
+        pr_warn("vunmap: invalid pointer %x\n", ptr);
+        return;
+    }
+
+    size_t page_idx = ((uintptr_t)ptr - VMALLOC_START) / PAGE_SIZE;
+    size_t count = vmalloc_area_pages(page_idx);
+
+    unmap_range(VMALLOC_START + page_idx * PAGE_SIZE, count * PAGE_SIZE);
+    vmalloc_unreserve(page_idx, count);
+}
+
+/**
+ * @brief Returns non-zero if `ptr` lies in the vmalloc range.
+ */
+int is_vmalloc_addr(const void* ptr)
+{
+    return (uintptr_t)ptr >= VMALLOC_START && (uintptr_t)ptr < VMALLOC_END;
+}
+
+/**
+ * @brief Returns the number of pages currently backing vmalloc() areas.
+ */
+size_t vmalloc_used_pages()
+{
+    return vmalloc_pages_in_use;
+}
+
+/**
+ * @brief Allocates zeroed, physically contiguous memory for device DMA.
+ *
+ * The frames may come from high memory; they are reached through a mapping
+ * in the vmalloc range rather than the direct map.
+ *
+ * @param size The size in bytes, rounded up to whole pages.
+ * @param physical_addr Receives the physical address to hand to the device.
+ *
+ * @return The page aligned kernel address, or NULL if out of memory.
+ */
+void* dma_alloc(size_t size, phys_addr_t* physical_addr)
+{
+    size_t count = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    phys_addr_t frames = alloc_physical_pages_aligned(count, 1);
+    if (frames == 0)
+    {
+        return NULL;
+    }
+
+    void* ptr = vmap_range(frames, count * PAGE_SIZE, PG_WRITE | PG_NX);
+    if (ptr == NULL)
+    {
+        free_physical_pages(frames, count);
+        return NULL;
+    }
+
+    memset(ptr, 0, count * PAGE_SIZE);
+    *physical_addr = frames;
+    return ptr;
+}
+
+/**
+ * @brief Frees memory returned by dma_alloc().
+ */
+void dma_free(void* ptr)
+{
+    size_t page_idx = ((uintptr_t)ptr - VMALLOC_START) / PAGE_SIZE;
+    size_t count = vmalloc_area_pages(page_idx);
+    phys_addr_t frames = virt_to_phys((uintptr_t)ptr);
+
+    vunmap(ptr);
+    free_physical_pages(frames, count);
+}
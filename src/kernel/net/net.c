@@ -0,0 +1,665 @@
+#include <kernel/net/net.h>
+#include <kernel/init.h>
+
+static net_device_t* net_devices[NET_MAX_DEVICES];
+static size_t net_devices_count = 0;
+
+// Devices waiting to be polled, by id, taken by net_softirq()
+static volatile uint32_t net_poll_pending = 0;
+
+typedef struct net_arp_entry
+{
+    uint32_t ip;
+    uint8_t mac[ETH_ALEN];
+} net_arp_entry_t;
+
+// Replaced round robin once full
+static net_arp_entry_t net_arp_table[NET_ARP_ENTRIES];
+static uint32_t net_arp_next = 0;
+
+typedef struct net_port
+{
+    uint16_t port;              // 0 for a free slot
+    udp_handler_t handler;
+} net_port_t;
+
+static net_port_t net_ports[NET_MAX_PORTS];
+
+// Both tables are read in softirq context; thread context takes the lock with softirqs disabled
+static spinlock_t net_lock = SPINLOCK_INIT;
+static uint16_t net_ip_id = 0;
+
+static const uint8_t net_broadcast_mac[ETH_ALEN] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+static net_device_t net_loopback;
+static netbuf_t* net_loopback_head = NULL;
+static netbuf_t* net_loopback_tail = NULL;
+
+/**
+ * @brief The Internet checksum: the ones' complement of the ones' complement
+ *        sum of the data as big endian 16-bit words.
+ *
+ * @return The checksum in host order; 0 when run over data that includes a
+ *         correct checksum.
+ */
+uint16_t net_checksum(const void* data, size_t len)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint32_t sum = 0;
+
+    for (; len > 1; len -= 2, bytes += 2)
+    {
+        sum += (uint32_t)bytes[0] << 8 | bytes[1];
+    }
+    if (len != 0)
+    {
+        sum += (uint32_t)bytes[0] << 8;
+    }
+    while (sum >> 16)
+    {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+/**
+ * @brief Makes a driver's device available to the stack.
+ *
+ * The driver fills in name, flags, mac, ip, ops and private.
+ *
+ * @return The device id, or -1 if the device table is full.
+ */
+int net_register_device(net_device_t* dev)
+{
+    if (net_devices_count == NET_MAX_DEVICES)
+    {
+        pr_warn("net: too many devices, ignoring %s\n", dev->name);
+        return -1;
+    }
+
+    memset(&dev->stats, 0, sizeof(dev->stats));
+    dev->id = net_devices_count;
+    net_devices[net_devices_count++] = dev;
+
+    pr_info("net: %s registered as device %d, address %d.%d.%d.%d\n", dev->name, dev->id,
+            dev->ip >> 24, (dev->ip >> 16) & 0xFF, (dev->ip >> 8) & 0xFF, dev->ip & 0xFF);
+    return dev->id;
+}
+
+net_device_t* net_get_device(uint32_t id)
+{
+    return id < net_devices_count ? net_devices[id] : NULL;
+}
+
+size_t net_device_count()
+{
+    return net_devices_count;
+}
+
+/**
+ * @brief Picks the device to send to `ip` through: the loopback device for
+ *        127.0.0.0/8, the first other device for everything else.
+ *
+ * @return The device, or NULL if there is none.
+ */
+net_device_t* net_route(uint32_t ip)
+{
+    int loopback = (ip >> 24) == 127;
+    for (size_t i = 0; i < net_devices_count; i++)
+    {
+        if (((net_devices[i]->flags & NET_DEV_LOOPBACK) != 0) == loopback)
+        {
+            return net_devices[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Has the device polled in softirq context.
+ *
+ * Called by a driver's interrupt handler once it turned the receive
+ * interrupt off, and by the stack to keep polling. However often a device
+ * is scheduled before the softirq runs, it is polled once.
+ */
+void net_schedule(net_device_t* dev)
+{
+    __atomic_or_fetch(&net_poll_pending, 1u << dev->id, __ATOMIC_RELEASE);
+    raise_softirq(SOFTIRQ_NET);
+}
+
+/**
+ * @brief Softirq: polls every scheduled device.
+ *
+ * A device that fills its budget may have more frames waiting, so it stays
+ * scheduled with its interrupt off. The softirq then runs again at once,
+ * and under sustained load in ksoftirqd, which keeps the rest of the system
+ * running. A device that falls short of its budget goes back to interrupts.
+ */
+static void net_softirq()
+{
+    uint32_t pending = __atomic_exchange_n(&net_poll_pending, 0, __ATOMIC_ACQ_REL);
+    for (uint32_t id = 0; pending != 0; id++, pending >>= 1)
+    {
+        if (!(pending & 1))
+        {
+            continue;
+        }
+
+        net_device_t* dev = net_devices[id];
+        int done = dev->ops->poll(dev, CONFIG_NET_POLL_BUDGET);
+        dev->stats.polls++;
+        if (done >= CONFIG_NET_POLL_BUDGET)
+        {
+            dev->stats.polls_full++;
+            net_schedule(dev);
+        }
+        else if (dev->ops->irq_enable(dev))
+        {
+            net_schedule(dev);
+        }
+    }
+}
+
+/**
+ * @brief Sends a complete frame; the device takes the buffer in every case.
+ *
+ * @return 0 if the frame was queued, -1 if it was dropped.
+ */
+int net_transmit(net_device_t* dev, netbuf_t* nb)
+{
+    local_bh_disable();
+    int result = dev->ops->transmit(dev, nb);
+    if (result == 0)
+    {
+        dev->stats.tx_packets++;
+    }
+    else
+    {
+        dev->stats.tx_dropped++;
+    }
+    local_bh_enable();
+    return result;
+}
+
+static void net_arp_update(uint32_t ip, const uint8_t* mac)
+{
+    spin_lock(&net_lock);
+    net_arp_entry_t* entry = NULL;
+    for (size_t i = 0; i < NET_ARP_ENTRIES; i++)
+    {
+        if (net_arp_table[i].ip == ip)
+        {
+            entry = &net_arp_table[i];
+            break;
+        }
+    }
+    if (entry == NULL)
+    {
+        entry = &net_arp_table[net_arp_next++ % NET_ARP_ENTRIES];
+        entry->ip = ip;
+    }
+    memcpy(entry->mac, mac, ETH_ALEN);
+    spin_unlock(&net_lock);
+}
+
+/**
+ * @brief Looks up the link address of a neighbour.
+ *
+ * @return 0 and the address in `mac` if known, -1 otherwise.
+ */
+int net_arp_lookup(uint32_t ip, uint8_t* mac)
+{
+    int result = -1;
+
+    local_bh_disable();
+    spin_lock(&net_lock);
+    for (size_t i = 0; i < NET_ARP_ENTRIES; i++)
+    {
+        if (net_arp_table[i].ip == ip && ip != 0)
+        {
+            memcpy(mac, net_arp_table[i].mac, ETH_ALEN);
+            result = 0;
+            break;
+        }
+    }
+    spin_unlock(&net_lock);
+    local_bh_enable();
+    return result;
+}
+
+static void net_arp_request(net_device_t* dev, uint32_t ip)
+{
+    netbuf_t* nb = netbuf_alloc();
+    if (nb == NULL)
+    {
+        return;
+    }
+
+    eth_header_t* eth = (eth_header_t*)netbuf_data(nb);
+    arp_packet_t* arp = (arp_packet_t*)(eth + 1);
+    memcpy(eth->dest, net_broadcast_mac, ETH_ALEN);
+    memcpy(eth->src, dev->mac, ETH_ALEN);
+    eth->type = net_htons(ETH_TYPE_ARP);
+
+    arp->hw_type = net_htons(ARP_HW_ETHER);
+    arp->proto_type = net_htons(ETH_TYPE_IPV4);
+    arp->hw_len = ETH_ALEN;
+    arp->proto_len = sizeof(uint32_t);
+    arp->op = net_htons(ARP_OP_REQUEST);
+    memcpy(arp->sender_mac, dev->mac, ETH_ALEN);
+    arp->sender_ip = net_htonl(dev->ip);
+    memset(arp->target_mac, 0, ETH_ALEN);
+    arp->target_ip = net_htonl(ip);
+
+    nb->len = sizeof(eth_header_t) + sizeof(arp_packet_t);
+    net_transmit(dev, nb);
+}
+
+/**
+ * @brief Learns the sender of every ARP packet and answers requests for
+ *        our address, in the buffer they came in.
+ *
+ * @return 0 if the buffer was used, -1 if the packet is malformed.
+ */
+static int net_arp_input(net_device_t* dev, netbuf_t* nb)
+{
+    if (nb->len < sizeof(eth_header_t) + sizeof(arp_packet_t))
+    {
+        return -1;
+    }
+
+    eth_header_t* eth = (eth_header_t*)netbuf_data(nb);
+    arp_packet_t* arp = (arp_packet_t*)(eth + 1);
+    if (net_ntohs(arp->hw_type) != ARP_HW_ETHER || net_ntohs(arp->proto_type) != ETH_TYPE_IPV4 ||
+        arp->hw_len != ETH_ALEN || arp->proto_len != sizeof(uint32_t))
+    {
+        return -1;
+    }
+
+    net_arp_update(net_ntohl(arp->sender_ip), arp->sender_mac);
+    if (net_ntohs(arp->op) != ARP_OP_REQUEST || net_ntohl(arp->target_ip) != dev->ip)
+    {
+        netbuf_free(nb);
+        return 0;
+    }
+
+    arp->op = net_htons(ARP_OP_REPLY);
+    memcpy(arp->target_mac, arp->sender_mac, ETH_ALEN);
+    arp->target_ip = arp->sender_ip;
+    memcpy(arp->sender_mac, dev->mac, ETH_ALEN);
+    arp->sender_ip = net_htonl(dev->ip);
+    memcpy(eth->dest, arp->target_mac, ETH_ALEN);
+    memcpy(eth->src, dev->mac, ETH_ALEN);
+
+    nb->len = sizeof(eth_header_t) + sizeof(arp_packet_t);
+    net_transmit(dev, nb);
+    return 0;
+}
+
+static udp_handler_t net_udp_handler(uint16_t port)
+{
+    udp_handler_t handler = NULL;
+    spin_lock(&net_lock);
+    for (size_t i = 0; i < NET_MAX_PORTS; i++)
+    {
+        if (net_ports[i].port == port)
+        {
+            handler = net_ports[i].handler;
+            break;
+        }
+    }
+    spin_unlock(&net_lock);
+    return handler;
+}
+
+/**
+ * @brief Hands a datagram to the handler bound to its port.
+ *
+ * The UDP checksum is optional over IPv4; it is neither checked here nor
+ * filled in when sending.
+ *
+ * @return 0 if a handler took the buffer, -1 otherwise.
+ */
+static int net_udp_input(net_device_t* dev, netbuf_t* nb, ip_header_t* ip, size_t ihl, size_t total)
+{
+    if (total - ihl < sizeof(udp_header_t))
+    {
+        return -1;
+    }
+
+    udp_header_t* udp = (udp_header_t*)((uint8_t*)ip + ihl);
+    uint16_t len = net_ntohs(udp->len);
+    if (len < sizeof(udp_header_t) || len > total - ihl)
+    {
+        return -1;
+    }
+
+    udp_handler_t handler = net_udp_handler(net_ntohs(udp->dest_port));
+    if (handler == NULL)
+    {
+        return -1;
+    }
+
+    handler(dev, nb, net_ntohl(ip->src), net_ntohs(udp->src_port), (uint8_t*)(udp + 1), len - sizeof(udp_header_t));
+    return 0;
+}
+
+/**
+ * @brief Checks an IPv4 packet addressed to the device and passes UDP on.
+ *
+ * Fragments are not reassembled, and dropped.
+ *
+ * @return 0 if the buffer was used, -1 if the packet is dropped.
+ */
+static int net_ip_input(net_device_t* dev, netbuf_t* nb)
+{
+    if (nb->len < sizeof(eth_header_t) + sizeof(ip_header_t))
+    {
+        return -1;
+    }
+
+    ip_header_t* ip = (ip_header_t*)(netbuf_data(nb) + sizeof(eth_header_t));
+    size_t ihl = (ip->version_ihl & 0x0F) * 4;
+    size_t total = net_ntohs(ip->total_len);
+    if ((ip->version_ihl >> 4) != 4 || ihl < sizeof(ip_header_t) || total < ihl ||
+        total > nb->len - sizeof(eth_header_t) || net_checksum(ip, ihl) != 0)
+    {
+        return -1;
+    }
+    if (net_ntohl(ip->dest) != dev->ip || (net_ntohs(ip->frag) & IP_FRAG_MASK) != 0 || ip->proto != IP_PROTO_UDP)
+    {
+        return -1;
+    }
+
+    // Frames shorter than the Ethernet minimum arrive padded
+    nb->len = sizeof(eth_header_t) + total;
+    return net_udp_input(dev, nb, ip, ihl, total);
+}
+
+/**
+ * @brief Handles a received frame. Called from a device's poll function.
+ *
+ * The frame is parsed in place, and the buffer passes to whoever handles
+ * it, or back to the pool.
+ */
+void net_receive(net_device_t* dev, netbuf_t* nb)
+{
+    dev->stats.rx_packets++;
+
+    if (nb->len >= sizeof(eth_header_t))
+    {
+        uint16_t type = net_ntohs(((eth_header_t*)netbuf_data(nb))->type);
+        if ((type == ETH_TYPE_ARP && net_arp_input(dev, nb) == 0) ||
+            (type == ETH_TYPE_IPV4 && net_ip_input(dev, nb) == 0))
+        {
+            return;
+        }
+    }
+
+    dev->stats.rx_dropped++;
+    netbuf_free(nb);
+}
+
+/**
+ * @brief Has datagrams to a local port handed to `handler`.
+ *
+ * @return 0 on success, -1 if the port is taken or every slot is.
+ */
+int net_udp_bind(uint16_t port, udp_handler_t handler)
+{
+    int result = -1;
+
+    local_bh_disable();
+    spin_lock(&net_lock);
+    net_port_t* slot = NULL;
+    for (size_t i = 0; i < NET_MAX_PORTS; i++)
+    {
+        if (net_ports[i].port == port)
+        {
+            slot = NULL;
+            break;
+        }
+        if (net_ports[i].port == 0 && slot == NULL)
+        {
+            slot = &net_ports[i];
+        }
+    }
+    if (slot != NULL && port != 0)
+    {
+        slot->port = port;
+        slot->handler = handler;
+        result = 0;
+    }
+    spin_unlock(&net_lock);
+    local_bh_enable();
+    return result;
+}
+
+void net_udp_unbind(uint16_t port)
+{
+    local_bh_disable();
+    spin_lock(&net_lock);
+    for (size_t i = 0; i < NET_MAX_PORTS; i++)
+    {
+        if (net_ports[i].port == port)
+        {
+            net_ports[i].port = 0;
+            net_ports[i].handler = NULL;
+        }
+    }
+    spin_unlock(&net_lock);
+    local_bh_enable();
+}
+
+/**
+ * @brief Takes a buffer for a datagram; the payload goes at `*payload`,
+ *        the headers are filled in by net_udp_send().
+ *
+ * @return The buffer, or NULL if none is free.
+ */
+netbuf_t* net_udp_alloc(uint8_t** payload)
+{
+    netbuf_t* nb = netbuf_alloc();
+    if (nb != NULL)
+    {
+        *payload = netbuf_data(nb) + NET_UDP_HEADERS;
+    }
+    return nb;
+}
+
+/**
+ * @brief Sends a datagram whose `len` payload bytes are in a buffer from
+ *        net_udp_alloc(); the buffer is taken in every case.
+ *
+ * A neighbour without a known link address is asked for it, and the
+ * datagram dropped; the caller sends again later.
+ *
+ * @return 0 if the datagram was queued, -1 if it was dropped.
+ */
+int net_udp_send(uint32_t dest_ip, uint16_t src_port, uint16_t dest_port, netbuf_t* nb, uint16_t len)
+{
+    net_device_t* dev = net_route(dest_ip);
+    if (dev == NULL || len > NET_UDP_MAX_PAYLOAD)
+    {
+        netbuf_free(nb);
+        return -1;
+    }
+
+    uint8_t mac[ETH_ALEN];
+    memset(mac, 0, sizeof(mac));
+    if (!(dev->flags & NET_DEV_LOOPBACK))
+    {
+        uint32_t hop = ((dest_ip ^ dev->ip) & NET_NETMASK) == 0 ? dest_ip : NET_GATEWAY_IP;
+        if (net_arp_lookup(hop, mac) != 0)
+        {
+            net_arp_request(dev, hop);
+            dev->stats.tx_dropped++;
+            netbuf_free(nb);
+            return -1;
+        }
+    }
+
+    eth_header_t* eth = (eth_header_t*)netbuf_data(nb);
+    ip_header_t* ip = (ip_header_t*)(eth + 1);
+    udp_header_t* udp = (udp_header_t*)(ip + 1);
+
+    memcpy(eth->dest, mac, ETH_ALEN);
+    memcpy(eth->src, dev->mac, ETH_ALEN);
+    eth->type = net_htons(ETH_TYPE_IPV4);
+
+    ip->version_ihl = IP_VERSION_IHL;
+    ip->tos = 0;
+    ip->total_len = net_htons(sizeof(ip_header_t) + sizeof(udp_header_t) + len);
+    ip->id = net_htons(net_ip_id++);
+    ip->frag = 0;
+    ip->ttl = IP_DEFAULT_TTL;
+    ip->proto = IP_PROTO_UDP;
+    ip->checksum = 0;
+    ip->src = net_htonl(dev->ip);
+    ip->dest = net_htonl(dest_ip);
+    ip->checksum = net_htons(net_checksum(ip, sizeof(ip_header_t)));
+
+    udp->src_port = net_htons(src_port);
+    udp->dest_port = net_htons(dest_port);
+    udp->len = net_htons(sizeof(udp_header_t) + len);
+    udp->checksum = 0;
+
+    nb->len = NET_UDP_HEADERS + len;
+    return net_transmit(dev, nb);
+}
+
+/**
+ * @brief Sends a received datagram back where it came from, payload and
+ *        all, in the buffer it arrived in.
+ *
+ * Only for a buffer handed to a udp_handler_t, with the headers untouched.
+ *
+ * @return 0 if the reply was queued, -1 if it was dropped.
+ */
+int net_udp_reply(net_device_t* dev, netbuf_t* nb)
+{
+    eth_header_t* eth = (eth_header_t*)netbuf_data(nb);
+    ip_header_t* ip = (ip_header_t*)(eth + 1);
+    size_t ihl = (ip->version_ihl & 0x0F) * 4;
+    udp_header_t* udp = (udp_header_t*)((uint8_t*)ip + ihl);
+
+    memcpy(eth->dest, eth->src, ETH_ALEN);
+    memcpy(eth->src, dev->mac, ETH_ALEN);
+
+    uint32_t src = ip->src;
+    ip->src = ip->dest;
+    ip->dest = src;
+    ip->ttl = IP_DEFAULT_TTL;
+    ip->checksum = 0;
+    ip->checksum = net_htons(net_checksum(ip, ihl));
+
+    uint16_t port = udp->src_port;
+    udp->src_port = udp->dest_port;
+    udp->dest_port = port;
+    udp->checksum = 0;
+
+    return net_transmit(dev, nb);
+}
+
+static void net_echo(net_device_t* dev, netbuf_t* nb, uint32_t src_ip, uint16_t src_port, uint8_t* payload, uint16_t len)
+{
+    (void)src_ip, (void)src_port, (void)payload, (void)len;
+    net_udp_reply(dev, nb);
+}
+
+/**
+ * @brief Loopback: a sent frame is queued and comes back in on the next poll.
+ */
+static int net_loopback_transmit(net_device_t* dev, netbuf_t* nb)
+{
+    nb->next = NULL;
+    spin_lock(&net_lock);
+    if (net_loopback_tail != NULL)
+    {
+        net_loopback_tail->next = nb;
+    }
+    else
+    {
+        net_loopback_head = nb;
+    }
+    net_loopback_tail = nb;
+    spin_unlock(&net_lock);
+
+    net_schedule(dev);
+    return 0;
+}
+
+static int net_loopback_poll(net_device_t* dev, int budget)
+{
+    int done = 0;
+    while (done < budget)
+    {
+        spin_lock(&net_lock);
+        netbuf_t* nb = net_loopback_head;
+        if (nb != NULL)
+        {
+            net_loopback_head = nb->next;
+            if (net_loopback_head == NULL)
+            {
+                net_loopback_tail = NULL;
+            }
+        }
+        spin_unlock(&net_lock);
+
+        if (nb == NULL)
+        {
+            break;
+        }
+        net_receive(dev, nb);
+        done++;
+    }
+    return done;
+}
+
+static int net_loopback_irq_enable(net_device_t* dev)
+{
+    (void)dev;
+    return __atomic_load_n(&net_loopback_head, __ATOMIC_ACQUIRE) != NULL;
+}
+
+static const net_device_ops_t net_loopback_ops = {
+    .transmit = net_loopback_transmit,
+    .poll = net_loopback_poll,
+    .irq_enable = net_loopback_irq_enable,
+};
+
+void net_dump_stats()
+{
+    for (size_t i = 0; i < net_devices_count; i++)
+    {
+        net_device_t* dev = net_devices[i];
+        kprintf("net: %s rx %d tx %d, dropped rx %d tx %d, %d interrupts, %d polls, %d full\n", dev->name,
+                dev->stats.rx_packets, dev->stats.tx_packets, dev->stats.rx_dropped, dev->stats.tx_dropped,
+                dev->stats.interrupts, dev->stats.polls, dev->stats.polls_full);
+    }
+    kprintf("net: %d of %d buffers free\n", netbuf_free_count(), netbuf_count());
+}
+
+/**
+ * @brief Fills the buffer pool, and starts the loopback device and the
+ *        echo service. Needs softirqs; device drivers come later.
+ */
+void net_init()
+{
+    if (netbuf_init() != 0)
+    {
+        pr_err("net: no packet buffers, networking is off\n");
+        return;
+    }
+    open_softirq(SOFTIRQ_NET, net_softirq);
+
+    net_loopback.name = "lo";
+    net_loopback.flags = NET_DEV_LOOPBACK;
+    net_loopback.ip = NET_LOOPBACK_IP;
+    net_loopback.ops = &net_loopback_ops;
+    net_register_device(&net_loopback);
+
+    net_udp_bind(NET_ECHO_PORT, net_echo);
+}
+INITCALL(INIT_SUBSYS, net_init, NULL);
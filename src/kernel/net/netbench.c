@@ -0,0 +1,198 @@
+#include <kernel/net/netbench.h>
+#include <kernel/time/timer.h>
+
+#define NETBENCH_MAGIC 0x4E424E43
+#define NETBENCH_PROBE 0xFFFFFFFF
+
+typedef struct netbench_payload
+{
+    uint32_t magic;
+    uint32_t seq;
+    uint64_t tsc;               // When the datagram was sent
+} __attribute__((packed)) netbench_payload_t;
+
+// State of the run in progress, filled in by netbench_reply() in softirq context
+static uint32_t* netbench_samples;      // Round trip cycles by sequence number, 0 until the reply is in
+static uint32_t netbench_count;
+static volatile uint32_t netbench_received;
+
+static void netbench_reply(net_device_t* dev, netbuf_t* nb, uint32_t src_ip, uint16_t src_port,
+                           uint8_t* payload, uint16_t len)
+{
+    (void)dev, (void)src_ip, (void)src_port;
+
+    netbench_payload_t* p = (netbench_payload_t*)payload;
+    if (len >= sizeof(netbench_payload_t) && p->magic == NETBENCH_MAGIC && p->seq < netbench_count &&
+        netbench_samples[p->seq] == 0)
+    {
+        uint64_t cycles = rdtsc() - p->tsc;
+        netbench_samples[p->seq] = cycles > 0xFFFFFFFF ? 0xFFFFFFFF : cycles != 0 ? (uint32_t)cycles : 1;
+        __atomic_add_fetch(&netbench_received, 1, __ATOMIC_RELEASE);
+    }
+    netbuf_free(nb);
+}
+
+/**
+ * @brief Sends one datagram, stamped with the time and its sequence number.
+ *
+ * @return 0 if it was queued, -1 otherwise.
+ */
+static int netbench_send(uint32_t dest_ip, uint16_t dest_port, uint32_t seq)
+{
+    uint8_t* payload;
+    netbuf_t* nb = net_udp_alloc(&payload);
+    if (nb == NULL)
+    {
+        return -1;
+    }
+
+    memset(payload, 0, NETBENCH_PAYLOAD);
+    netbench_payload_t* p = (netbench_payload_t*)payload;
+    p->magic = NETBENCH_MAGIC;
+    p->seq = seq;
+    p->tsc = rdtsc();
+    return net_udp_send(dest_ip, NETBENCH_PORT, dest_port, nb, NETBENCH_PAYLOAD);
+}
+
+/**
+ * @brief Sends probes until one goes out, which means the next hop's link
+ *        address is known. Their replies are ignored.
+ */
+static int netbench_resolve(uint32_t dest_ip, uint16_t dest_port)
+{
+    for (uint32_t i = 0; i < NETBENCH_ARP_TRIES; i++)
+    {
+        if (netbench_send(dest_ip, dest_port, NETBENCH_PROBE) == 0)
+        {
+            return 0;
+        }
+        timer_sleep_ms(NETBENCH_IDLE_TIMEOUT_MS / NETBENCH_ARP_TRIES);
+    }
+    return -1;
+}
+
+static void netbench_sort(uint32_t* values, size_t count)
+{
+    for (size_t gap = count / 2; gap > 0; gap /= 2)
+    {
+        for (size_t i = gap; i < count; i++)
+        {
+            uint32_t value = values[i];
+            size_t j = i;
+            for (; j >= gap && values[j - gap] > value; j -= gap)
+            {
+                values[j] = values[j - gap];
+            }
+            values[j] = value;
+        }
+    }
+}
+
+static uint32_t netbench_ns(uint32_t cycles)
+{
+    return (uint32_t)div64_u32((uint64_t)cycles * 1000000, tsc_khz);
+}
+
+/**
+ * @brief Measures UDP round trips to an echo service.
+ *
+ * Keeps NETBENCH_WINDOW datagrams of NETBENCH_PAYLOAD bytes in flight until
+ * `count` were sent, and stops once every reply is in or none came for
+ * NETBENCH_IDLE_TIMEOUT_MS. The rate covers the time up to the last reply.
+ * Aimed at NET_LOOPBACK_IP, this measures the stack alone.
+ *
+ * @return 0 if the run took place, -1 if it could not start.
+ */
+int netbench_run(uint32_t dest_ip, uint16_t dest_port, uint32_t count, netbench_result_t* result)
+{
+    memset(result, 0, sizeof(netbench_result_t));
+    if (tsc_khz == 0 || count == 0 || count > NETBENCH_MAX_COUNT)
+    {
+        return -1;
+    }
+
+    netbench_samples = (uint32_t*)kmalloc(count * sizeof(uint32_t));
+    if (netbench_samples == NULL)
+    {
+        return -1;
+    }
+    memset(netbench_samples, 0, count * sizeof(uint32_t));
+    netbench_count = count;
+    netbench_received = 0;
+
+    if (net_udp_bind(NETBENCH_PORT, netbench_reply) != 0)
+    {
+        kfree(netbench_samples);
+        return -1;
+    }
+    if (netbench_resolve(dest_ip, dest_port) != 0)
+    {
+        kprintf("netbench: %d.%d.%d.%d cannot be reached\n", dest_ip >> 24, (dest_ip >> 16) & 0xFF,
+                (dest_ip >> 8) & 0xFF, dest_ip & 0xFF);
+        net_udp_unbind(NETBENCH_PORT);
+        kfree(netbench_samples);
+        return -1;
+    }
+
+    uint64_t idle_limit = (uint64_t)tsc_khz * NETBENCH_IDLE_TIMEOUT_MS;
+    uint64_t start = rdtsc();
+    uint64_t last_reply = start;
+    uint32_t received = 0;
+    uint32_t sent = 0;
+
+    while (received < count)
+    {
+        while (sent < count && sent - received < NETBENCH_WINDOW && netbench_send(dest_ip, dest_port, sent) == 0)
+        {
+            sent++;
+        }
+
+        uint64_t now = rdtsc();
+        uint32_t replies = __atomic_load_n(&netbench_received, __ATOMIC_ACQUIRE);
+        if (replies != received)
+        {
+            received = replies;
+            last_reply = now;
+        }
+        else if (now - last_reply > idle_limit)
+        {
+            break;
+        }
+        kthread_yield();
+    }
+    net_udp_unbind(NETBENCH_PORT);
+
+    // Gather the round trips that completed, in place
+    size_t samples = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (netbench_samples[i] != 0)
+        {
+            netbench_samples[samples++] = netbench_samples[i];
+        }
+    }
+    netbench_sort(netbench_samples, samples);
+
+    result->sent = sent;
+    result->received = samples;
+    if (samples != 0)
+    {
+        uint32_t elapsed_us = (uint32_t)div64_u32((last_reply - start) * 1000, tsc_khz);
+        result->pps = elapsed_us != 0 ? (uint32_t)div64_u32((uint64_t)samples * 1000000, elapsed_us) : 0;
+        result->p50_ns = netbench_ns(netbench_samples[(samples - 1) * 50 / 100]);
+        result->p90_ns = netbench_ns(netbench_samples[(samples - 1) * 90 / 100]);
+        result->p99_ns = netbench_ns(netbench_samples[(samples - 1) * 99 / 100]);
+        result->max_ns = netbench_ns(netbench_samples[samples - 1]);
+    }
+
+    kfree(netbench_samples);
+    netbench_samples = NULL;
+    return 0;
+}
+
+void netbench_report(const char* label, const netbench_result_t* result)
+{
+    kprintf("netbench: %s %d of %d replies, %d pps\n", label, result->received, result->sent, result->pps);
+    kprintf("netbench: %s round trip p50 %d ns, p90 %d ns, p99 %d ns, max %d ns\n", label,
+            result->p50_ns, result->p90_ns, result->p99_ns, result->max_ns);
+}
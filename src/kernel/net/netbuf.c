@@ -0,0 +1,90 @@
+#include <kernel/net/netbuf.h>
+
+static netbuf_t netbuf_pool[NETBUF_POOL];
+static netbuf_t* netbuf_free_list = NULL;
+static size_t netbuf_free_buffers = 0;
+static size_t netbuf_total = 0;
+static spinlock_t netbuf_lock = SPINLOCK_INIT;
+
+/**
+ * @brief Allocates the buffer pages, NETBUF_CHUNK_PAGES at a time.
+ *
+ * The pool is filled once and never grows, so a device that cannot post
+ * receive buffers drops frames rather than taking memory from the rest of
+ * the kernel.
+ *
+ * @return 0 if at least one chunk was allocated, -1 otherwise.
+ */
+int netbuf_init()
+{
+    for (size_t first = 0; first < NETBUF_POOL; first += NETBUF_CHUNK_PAGES)
+    {
+        size_t count = NETBUF_POOL - first < NETBUF_CHUNK_PAGES ? NETBUF_POOL - first : NETBUF_CHUNK_PAGES;
+        phys_addr_t phys;
+        uint8_t* pages = (uint8_t*)dma_alloc(count * PAGE_SIZE, &phys);
+        if (pages == NULL)
+        {
+            pr_warn("netbuf: out of memory after %d buffers\n", netbuf_total);
+            break;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            netbuf_t* nb = &netbuf_pool[first + i];
+            nb->page = pages + i * PAGE_SIZE;
+            nb->phys = phys + i * PAGE_SIZE;
+            netbuf_free(nb);
+        }
+        netbuf_total += count;
+    }
+
+    return netbuf_total != 0 ? 0 : -1;
+}
+
+/**
+ * @brief Takes a buffer from the pool, with the frame empty after the headroom.
+ *
+ * @return The buffer, or NULL if every buffer is in use.
+ */
+netbuf_t* netbuf_alloc()
+{
+    uint32_t irq_flags = local_irq_save();
+    spin_lock(&netbuf_lock);
+    netbuf_t* nb = netbuf_free_list;
+    if (nb != NULL)
+    {
+        netbuf_free_list = nb->next;
+        netbuf_free_buffers--;
+    }
+    spin_unlock(&netbuf_lock);
+    local_irq_restore(irq_flags);
+
+    if (nb != NULL)
+    {
+        nb->next = NULL;
+        nb->offset = NETBUF_HEADROOM;
+        nb->len = 0;
+    }
+    return nb;
+}
+
+void netbuf_free(netbuf_t* nb)
+{
+    uint32_t irq_flags = local_irq_save();
+    spin_lock(&netbuf_lock);
+    nb->next = netbuf_free_list;
+    netbuf_free_list = nb;
+    netbuf_free_buffers++;
+    spin_unlock(&netbuf_lock);
+    local_irq_restore(irq_flags);
+}
+
+size_t netbuf_free_count()
+{
+    return netbuf_free_buffers;
+}
+
+size_t netbuf_count()
+{
+    return netbuf_total;
+}
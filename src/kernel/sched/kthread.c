@@ -0,0 +1,306 @@
+#include <kernel/sched/kthread.h>
+#include <kernel/trace/trace.h>
+#include <kernel/init.h>
+
+// Kernel threads share the boot CPU and switch only at kthread_yield() and
+// kthread_sleep(); nothing is preempted, so the ring needs no lock.
+
+static kthread_t kthread_boot = {
+    .state = KTHREAD_RUNNABLE,
+    .name = "main",
+};
+
+static kthread_t* kthread_running = NULL;
+
+// A thread that exited; its stack is freed by the next thread to run
+static kthread_t* kthread_zombie = NULL;
+
+// Halts the CPU while every thread sleeps, see kthread_set_idle()
+static void (*kthread_idle)() = NULL;
+
+/**
+ * @brief Records a switch, with the start of the next thread's name so the
+ *        trace decoder can label threads.
+ */
+static void kthread_trace_switch(kthread_t* prev, kthread_t* next)
+{
+    uint32_t name[2] = { 0, 0 };
+    size_t len = strlen(next->name);
+    memcpy(name, next->name, len < sizeof(name) ? len : sizeof(name));
+    trace_write(TRACE_SWITCH, (uint32_t)prev, (uint32_t)next, name[0], name[1]);
+}
+
+static void kthread_reap()
+{
+    kthread_t* zombie = kthread_zombie;
+    if (zombie != NULL)
+    {
+        kthread_zombie = NULL;
+        vfree(zombie->stack);
+        kfree(zombie);
+    }
+}
+
+/**
+ * @brief Turns the boot context into the first thread.
+ */
+void kthread_init()
+{
+    kthread_boot.next = &kthread_boot;
+    kthread_running = &kthread_boot;
+}
+INITCALL(INIT_CORE, kthread_init, NULL);
+
+kthread_t* kthread_current()
+{
+    return kthread_running;
+}
+
+/**
+ * @brief First code run on a new thread's stack.
+ */
+static void kthread_start()
+{
+    kthread_reap();
+
+    kthread_t* self = kthread_running;
+    self->fn(self->arg);
+    kthread_exit();
+}
+
+/**
+ * @brief Makes `next` the running thread and resumes it.
+ */
+static void kthread_switch_to(kthread_t* prev, kthread_t* next)
+{
+    if (__builtin_expect(trace_enabled & (1u << TRACE_SWITCH), 0))
+    {
+        kthread_trace_switch(prev, next);
+    }
+    if (next->space != NULL)
+    {
+        tss_set_kernel_stack((uint32_t)next->stack + KTHREAD_STACK_SIZE);
+        address_space_switch(next->space);
+    }
+    else
+    {
+        // Kernel threads never touch the user range, so they borrow whatever is loaded
+        tlb_switch_address_space(0, 1);
+    }
+    kthread_running = next;
+    kthread_switch(&prev->esp, next->esp);
+}
+
+/**
+ * @brief Switches to the next runnable thread after the current one, if any.
+ *
+ * @return 1 if another thread ran, 0 if there was nothing else to run.
+ */
+static int kthread_schedule()
+{
+    kthread_t* prev = kthread_running;
+    kthread_t* next = prev->next;
+
+    while (next != prev && next->state != KTHREAD_RUNNABLE)
+    {
+        next = next->next;
+    }
+    if (next == prev)
+    {
+        return 0;
+    }
+
+    kthread_switch_to(prev, next);
+
+    kthread_reap();
+    return 1;
+}
+
+/**
+ * @brief Creates a runnable thread. It first runs when the current thread yields.
+ *
+ * @return The thread, or NULL if there was no memory for it.
+ */
+kthread_t* kthread_create(kthread_fn fn, void* arg, const char* name)
+{
+    if (kthread_running == NULL)
+    {
+        kthread_init();
+    }
+
+    kthread_t* thread = (kthread_t*)kmalloc(sizeof(kthread_t));
+    if (thread == NULL)
+    {
+        return NULL;
+    }
+    thread->stack = vmalloc(KTHREAD_STACK_SIZE);
+    if (thread->stack == NULL)
+    {
+        kfree(thread);
+        return NULL;
+    }
+
+    // The frame kthread_switch() pops: edi, esi, ebx, ebp, then the return address
+    uint32_t* sp = (uint32_t*)((uintptr_t)thread->stack + KTHREAD_STACK_SIZE);
+    *--sp = 0;                          // Return address of kthread_start, never used
+    *--sp = (uint32_t)kthread_start;
+    for (int i = 0; i < 4; i++)
+    {
+        *--sp = 0;
+    }
+
+    thread->esp = (uint32_t)sp;
+    thread->state = KTHREAD_RUNNABLE;
+    thread->wake_pending = 0;
+    thread->space = NULL;
+    thread->process = NULL;
+    thread->name = name;
+    thread->fn = fn;
+    thread->arg = arg;
+
+    thread->next = kthread_running->next;
+    kthread_running->next = thread;
+
+    return thread;
+}
+
+/**
+ * @brief Lets every other runnable thread run once before returning.
+ */
+void kthread_yield()
+{
+    if (kthread_running != NULL)
+    {
+        kthread_schedule();
+    }
+}
+
+/**
+ * @brief Installs what kthread_sleep() runs when no thread is runnable.
+ *
+ * @param idle Called with interrupts disabled; halts until the next
+ *             interrupt and returns with interrupts enabled.
+ */
+void kthread_set_idle(void (*idle)())
+{
+    kthread_idle = idle;
+}
+
+/**
+ * @brief Blocks the current thread until kthread_wake().
+ *
+ * A wakeup that arrived since the thread last slept is not lost: this then
+ * returns at once. While no thread can run, the CPU idles until an
+ * interrupt wakes one; without an idle handler this returns at once
+ * instead. Callers must check the condition they wait for again.
+ */
+void kthread_sleep()
+{
+    if (kthread_running == NULL)
+    {
+        return;
+    }
+
+    kthread_t* self = kthread_running;
+    __atomic_store_n(&self->state, KTHREAD_SLEEPING, __ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&self->wake_pending, 0, __ATOMIC_SEQ_CST))
+    {
+        self->state = KTHREAD_RUNNABLE;
+        return;
+    }
+
+    while (!kthread_schedule())
+    {
+        if (self->state != KTHREAD_SLEEPING)
+        {
+            return;
+        }
+        if (kthread_idle == NULL)
+        {
+            self->state = KTHREAD_RUNNABLE;
+            return;
+        }
+
+        local_irq_disable();
+        if (self->state == KTHREAD_SLEEPING && !kthread_has_runnable())
+        {
+            kthread_idle();
+        }
+        else
+        {
+            local_irq_enable();
+        }
+    }
+}
+
+/**
+ * @brief Makes a sleeping thread runnable. Safe from interrupt handlers.
+ */
+void kthread_wake(kthread_t* thread)
+{
+    if (thread == NULL)
+    {
+        return;
+    }
+
+    // Set before looking at the state, so a thread that is just going to
+    // sleep either sees the flag or is seen sleeping
+    __atomic_store_n(&thread->wake_pending, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&thread->state, __ATOMIC_SEQ_CST) == KTHREAD_SLEEPING)
+    {
+        thread->wake_pending = 0;
+        thread->state = KTHREAD_RUNNABLE;
+    }
+}
+
+/**
+ * @brief Returns nonzero if a thread other than the current one could run.
+ */
+int kthread_has_runnable()
+{
+    if (kthread_running == NULL)
+    {
+        return 0;
+    }
+
+    for (kthread_t* thread = kthread_running->next; thread != kthread_running; thread = thread->next)
+    {
+        if (thread->state == KTHREAD_RUNNABLE)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Ends the current thread. The boot thread cannot exit.
+ */
+void kthread_exit()
+{
+    kthread_t* self = kthread_running;
+    if (self == &kthread_boot)
+    {
+        kprintf("kthread: the boot thread cannot exit\n");
+        return;
+    }
+
+    kthread_t* prev = self;
+    while (prev->next != self)
+    {
+        prev = prev->next;
+    }
+    prev->next = self->next;
+
+    // The boot thread is always on the ring, and is made runnable to have somewhere to go
+    self->state = KTHREAD_DEAD;
+    kthread_zombie = self;
+    kthread_t* next = self->next;
+    while (next->state != KTHREAD_RUNNABLE && next != &kthread_boot)
+    {
+        next = next->next;
+    }
+    next->state = KTHREAD_RUNNABLE;
+
+    kthread_switch_to(self, next);
+}
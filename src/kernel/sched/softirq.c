@@ -0,0 +1,274 @@
+#include <kernel/sched/softirq.h>
+#include <kernel/init.h>
+
+// Touched only by its own CPU, with interrupts disabled where an interrupt could race
+typedef struct softirq_cpu
+{
+    volatile uint32_t pending;
+    uint32_t irq_depth;         // Hard interrupt handlers running
+    uint32_t bh_depth;          // Softirqs running or disabled by local_bh_disable()
+    tasklet_t* tasklets;
+    softirq_stats_t stats;
+} __attribute__((aligned(64))) softirq_cpu_t;
+
+static softirq_cpu_t softirq_cpus[MAX_CPUS];
+static softirq_handler_t softirq_handlers[SOFTIRQ_COUNT];
+static kthread_t* ksoftirqd = NULL;
+
+static inline softirq_cpu_t* softirq_this_cpu()
+{
+    return &softirq_cpus[smp_processor_id()];
+}
+
+/**
+ * @brief Runs the tasklets scheduled on this CPU, oldest first.
+ */
+static void tasklet_action()
+{
+    softirq_cpu_t* cpu = softirq_this_cpu();
+
+    uint32_t irq_flags = local_irq_save();
+    tasklet_t* list = cpu->tasklets;
+    cpu->tasklets = NULL;
+    local_irq_restore(irq_flags);
+
+    // The list was built by pushing at the head
+    tasklet_t* ordered = NULL;
+    while (list != NULL)
+    {
+        tasklet_t* next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+
+    while (ordered != NULL)
+    {
+        tasklet_t* tasklet = ordered;
+        ordered = tasklet->next;
+        // Cleared first, so the tasklet may schedule itself again
+        __atomic_store_n(&tasklet->scheduled, 0, __ATOMIC_RELEASE);
+        tasklet->fn(tasklet->data);
+    }
+}
+
+/**
+ * @brief Runs softirqs that were left over at interrupt exit or raised outside interrupts.
+ */
+static void ksoftirqd_main(void* arg)
+{
+    (void)arg;
+
+    for (;;)
+    {
+        do_softirq();
+        if (!softirq_this_cpu()->pending)
+        {
+            kthread_sleep();
+        }
+        else
+        {
+            kthread_yield();
+        }
+    }
+}
+
+/**
+ * @brief Registers the tasklet softirq and starts ksoftirqd. Needs the scheduler.
+ */
+void softirq_init()
+{
+    open_softirq(SOFTIRQ_TASKLET, tasklet_action);
+    ksoftirqd = kthread_create(ksoftirqd_main, NULL, "ksoftirqd");
+    if (ksoftirqd == NULL)
+    {
+        kprintf("softirq: could not start ksoftirqd\n");
+    }
+}
+INITCALL(INIT_CORE, softirq_init, "kthread_init");
+
+void open_softirq(uint32_t nr, softirq_handler_t handler)
+{
+    softirq_handlers[nr] = handler;
+}
+
+/**
+ * @brief Marks a softirq pending on this CPU.
+ *
+ * From an interrupt handler it runs at interrupt exit, batched with every
+ * other raise since; from a thread, ksoftirqd runs it.
+ */
+void raise_softirq(uint32_t nr)
+{
+    softirq_cpu_t* cpu = softirq_this_cpu();
+
+    uint32_t irq_flags = local_irq_save();
+    cpu->pending |= 1u << nr;
+    cpu->stats.raised++;
+    int wake = !in_interrupt();
+    local_irq_restore(irq_flags);
+
+    if (wake)
+    {
+        kthread_wake(ksoftirqd);
+    }
+}
+
+/**
+ * @brief Runs pending softirqs with interrupts enabled.
+ *
+ * Does nothing inside a hard interrupt handler, inside softirq context or
+ * with softirqs disabled. Softirqs raised meanwhile are picked up, for at
+ * most SOFTIRQ_MAX_RESTART passes; whatever is left goes to ksoftirqd so
+ * the interrupted thread is not starved. Handlers must not sleep.
+ */
+void do_softirq()
+{
+    softirq_cpu_t* cpu = softirq_this_cpu();
+    uint32_t irq_flags = local_irq_save();
+
+    if (cpu->irq_depth != 0 || cpu->bh_depth != 0)
+    {
+        local_irq_restore(irq_flags);
+        return;
+    }
+
+    cpu->bh_depth++;
+    for (int restart = 0; restart < SOFTIRQ_MAX_RESTART && cpu->pending; restart++)
+    {
+        uint32_t pending = cpu->pending;
+        cpu->pending = 0;
+        local_irq_enable();
+
+        for (uint32_t nr = 0; pending != 0; nr++, pending >>= 1)
+        {
+            if ((pending & 1) && softirq_handlers[nr] != NULL)
+            {
+                softirq_handlers[nr]();
+                cpu->stats.runs++;
+            }
+        }
+
+        local_irq_disable();
+    }
+    cpu->bh_depth--;
+
+    int defer = cpu->pending != 0;
+    if (defer)
+    {
+        cpu->stats.deferred++;
+    }
+    local_irq_restore(irq_flags);
+
+    if (defer)
+    {
+        kthread_wake(ksoftirqd);
+    }
+}
+
+/**
+ * @brief Marks the start of a hard interrupt handler. Called from interrupt_dispatch().
+ */
+void irq_enter()
+{
+    softirq_this_cpu()->irq_depth++;
+}
+
+/**
+ * @brief Marks the end of a hard interrupt handler and runs pending softirqs
+ *        if this was the outermost one.
+ */
+void irq_exit()
+{
+    softirq_cpu_t* cpu = softirq_this_cpu();
+    if (--cpu->irq_depth == 0 && cpu->pending && cpu->bh_depth == 0)
+    {
+        do_softirq();
+    }
+}
+
+/**
+ * @brief Returns nonzero in a hard interrupt handler or in softirq context.
+ */
+int in_interrupt()
+{
+    softirq_cpu_t* cpu = softirq_this_cpu();
+    return cpu->irq_depth != 0 || cpu->bh_depth != 0;
+}
+
+/**
+ * @brief Returns nonzero if softirqs wait to run on this CPU.
+ */
+int softirq_pending()
+{
+    return softirq_this_cpu()->pending != 0;
+}
+
+/**
+ * @brief Keeps softirqs from running on this CPU, for code that shares data with them.
+ *
+ * Calls nest; the CPU must not change before local_bh_enable().
+ */
+void local_bh_disable()
+{
+    softirq_this_cpu()->bh_depth++;
+}
+
+/**
+ * @brief Undoes local_bh_disable() and runs softirqs raised in the meantime.
+ */
+void local_bh_enable()
+{
+    softirq_cpu_t* cpu = softirq_this_cpu();
+    if (--cpu->bh_depth == 0 && cpu->irq_depth == 0 && cpu->pending)
+    {
+        do_softirq();
+    }
+}
+
+void tasklet_init(tasklet_t* tasklet, void (*fn)(void* data), void* data)
+{
+    tasklet->next = NULL;
+    tasklet->fn = fn;
+    tasklet->data = data;
+    tasklet->scheduled = 0;
+}
+
+/**
+ * @brief Runs a tasklet once in softirq context on this CPU.
+ *
+ * Scheduling a tasklet that has not run yet does nothing, so a burst of
+ * interrupts runs it once.
+ */
+void tasklet_schedule(tasklet_t* tasklet)
+{
+    if (__atomic_exchange_n(&tasklet->scheduled, 1, __ATOMIC_ACQ_REL))
+    {
+        return;
+    }
+
+    softirq_cpu_t* cpu = softirq_this_cpu();
+    uint32_t irq_flags = local_irq_save();
+    tasklet->next = cpu->tasklets;
+    cpu->tasklets = tasklet;
+    local_irq_restore(irq_flags);
+
+    raise_softirq(SOFTIRQ_TASKLET);
+}
+
+/**
+ * @brief Sums the counters of every CPU.
+ */
+void softirq_get_stats(softirq_stats_t* stats)
+{
+    stats->raised = 0;
+    stats->runs = 0;
+    stats->deferred = 0;
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        stats->raised += softirq_cpus[cpu].stats.raised;
+        stats->runs += softirq_cpus[cpu].stats.runs;
+        stats->deferred += softirq_cpus[cpu].stats.deferred;
+    }
+}
@@ -0,0 +1,173 @@
+#include <kernel/sched/workqueue.h>
+#include <kernel/init.h>
+
+workqueue_t* system_wq = NULL;
+
+static void worker_main(void* arg)
+{
+    worker_t* worker = (worker_t*)arg;
+
+    for (;;)
+    {
+        uint32_t irq_flags = local_irq_save();
+        spin_lock(&worker->lock);
+        work_t* work = worker->head;
+        worker->head = NULL;
+        worker->tail = NULL;
+        worker->busy = work != NULL;
+        spin_unlock(&worker->lock);
+        local_irq_restore(irq_flags);
+
+        if (work == NULL)
+        {
+            kthread_sleep();
+            continue;
+        }
+
+        // Everything queued so far runs as one batch
+        while (work != NULL)
+        {
+            work_t* next = work->next;
+            // Cleared first, so the item may queue itself again
+            __atomic_store_n(&work->pending, 0, __ATOMIC_RELEASE);
+            work->fn(work);
+            worker->completed++;
+            work = next;
+        }
+        worker->busy = 0;
+        __atomic_add_fetch(&worker->batches, 1, __ATOMIC_SEQ_CST);
+        futex_wake(&worker->batches, FUTEX_WAKE_ALL);
+    }
+}
+
+/**
+ * @brief Creates the shared queue. Needs the scheduler.
+ */
+void workqueue_init()
+{
+    system_wq = workqueue_create("events");
+    if (system_wq == NULL)
+    {
+        kprintf("workqueue: could not create the system queue\n");
+    }
+}
+INITCALL(INIT_CORE, workqueue_init, "kthread_init");
+
+/**
+ * @brief Creates a queue with a worker thread for every online CPU.
+ *
+ * Threads are scheduled on the boot CPU for now, but each CPU queues onto
+ * its own list, so interrupt handlers on different CPUs never contend.
+ *
+ * @return The queue, or NULL if there was no memory for it.
+ */
+workqueue_t* workqueue_create(const char* name)
+{
+    workqueue_t* wq = (workqueue_t*)kmalloc(sizeof(workqueue_t));
+    if (wq == NULL)
+    {
+        return NULL;
+    }
+    wq->name = name;
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        worker_t* worker = &wq->workers[cpu];
+        worker->lock = (spinlock_t)SPINLOCK_INIT;
+        worker->head = NULL;
+        worker->tail = NULL;
+        worker->busy = 0;
+        worker->completed = 0;
+        worker->batches = 0;
+        worker->thread = NULL;
+
+        if (cpu_online_mask & (1 << cpu))
+        {
+            worker->thread = kthread_create(worker_main, worker, name);
+            if (worker->thread == NULL)
+            {
+                kprintf("workqueue: no worker for %s on CPU %d\n", name, cpu);
+            }
+        }
+    }
+
+    return wq;
+}
+
+void work_init(work_t* work, void (*fn)(work_t* work))
+{
+    work->next = NULL;
+    work->fn = fn;
+    work->pending = 0;
+}
+
+/**
+ * @brief Queues an item on a CPU's worker. Safe from interrupt and softirq context.
+ *
+ * @return 1 if queued, 0 if the item was already pending or the CPU has no worker.
+ */
+int queue_work_on(uint32_t cpu, workqueue_t* wq, work_t* work)
+{
+    worker_t* worker = &wq->workers[cpu];
+    if (worker->thread == NULL || __atomic_exchange_n(&work->pending, 1, __ATOMIC_ACQ_REL))
+    {
+        return 0;
+    }
+
+    work->next = NULL;
+
+    uint32_t irq_flags = local_irq_save();
+    spin_lock(&worker->lock);
+    if (worker->tail != NULL)
+    {
+        worker->tail->next = work;
+    }
+    else
+    {
+        worker->head = work;
+    }
+    worker->tail = work;
+    spin_unlock(&worker->lock);
+    local_irq_restore(irq_flags);
+
+    kthread_wake(worker->thread);
+    return 1;
+}
+
+/**
+ * @brief Queues an item on the current CPU's worker.
+ */
+int queue_work(workqueue_t* wq, work_t* work)
+{
+    return queue_work_on(smp_processor_id(), wq, work);
+}
+
+int schedule_work(work_t* work)
+{
+    return system_wq != NULL ? queue_work(system_wq, work) : 0;
+}
+
+/**
+ * @brief Waits until everything queued before the call has run.
+ *
+ * Sleeps until the worker finishes a batch rather than polling it, and
+ * looks again then. Must not be called from an item on the same queue.
+ */
+void flush_workqueue(workqueue_t* wq)
+{
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        worker_t* worker = &wq->workers[cpu];
+        while (worker->thread != NULL)
+        {
+            // Read before the queue, so a batch ending in between fails the futex compare
+            uint32_t batches = __atomic_load_n(&worker->batches, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&worker->head, __ATOMIC_SEQ_CST) == NULL && !worker->busy)
+            {
+                break;
+            }
+            kthread_wake(worker->thread);
+            futex_wait(&worker->batches, batches);
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#include <kernel/sync/condvar.h>
+
+/**
+ * @brief Releases the mutex, sleeps until a signal, and takes the mutex again.
+ *
+ * May return without a signal; callers wait in a loop on their condition.
+ * The mutex is taken back as contended, since other waiters woken by a
+ * broadcast are likely to queue on it too.
+ */
+void cond_wait(condvar_t* cond, mutex_t* mutex)
+{
+    uint32_t seq = __atomic_load_n(&cond->seq, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&cond->waiters, 1, __ATOMIC_SEQ_CST);
+    mutex_unlock(mutex);
+
+    futex_wait(&cond->seq, seq);
+
+    __atomic_sub_fetch(&cond->waiters, 1, __ATOMIC_SEQ_CST);
+    mutex_lock_slow(mutex);
+}
@@ -0,0 +1,126 @@
+#include <kernel/sync/futex.h>
+
+static futex_bucket_t futex_buckets[FUTEX_HASH_SIZE];
+static futex_stats_t futex_stats;
+
+/**
+ * @brief Returns the address space a futex word belongs to.
+ *
+ * Kernel addresses are the same in every space; a user address names a
+ * different word in each program, so it is keyed by the current one.
+ */
+static address_space_t* futex_space(const volatile uint32_t* addr)
+{
+    uintptr_t value = (uintptr_t)addr;
+    if (value < USER_SPACE_START || value >= USER_SPACE_END)
+    {
+        return NULL;
+    }
+    kthread_t* self = kthread_current();
+    return self != NULL ? self->space : NULL;
+}
+
+static futex_bucket_t* futex_bucket(const volatile uint32_t* addr, address_space_t* space)
+{
+    uint32_t key = (uint32_t)(uintptr_t)addr ^ (uint32_t)(uintptr_t)space;
+    return &futex_buckets[(key * 0x9E3779B1u) >> (32 - FUTEX_HASH_BITS)];
+}
+
+/**
+ * @brief Sleeps until futex_wake() on `addr`, if it still holds `expected`.
+ *
+ * The word is compared with the queue's lock held, and wakers take the
+ * same lock, so a change followed by a wake between the caller reading the
+ * word and calling this is never missed: either the compare fails or the
+ * wake finds the waiter queued. Callers check their condition again after
+ * returning, as with any sleep.
+ *
+ * @return 0 once woken, -1 at once if the word no longer held `expected`.
+ */
+int futex_wait(const volatile uint32_t* addr, uint32_t expected)
+{
+    futex_waiter_t waiter;
+    waiter.addr = addr;
+    waiter.space = futex_space(addr);
+    waiter.thread = kthread_current();
+    waiter.woken = 0;
+    waiter.next = NULL;
+    futex_bucket_t* bucket = futex_bucket(addr, waiter.space);
+
+    uint32_t irq_flags = local_irq_save();
+    spin_lock(&bucket->lock);
+    if (__atomic_load_n(addr, __ATOMIC_SEQ_CST) != expected)
+    {
+        futex_stats.retries++;
+        spin_unlock(&bucket->lock);
+        local_irq_restore(irq_flags);
+        return -1;
+    }
+
+    futex_waiter_t** link = &bucket->head;
+    while (*link != NULL)
+    {
+        link = &(*link)->next;
+    }
+    *link = &waiter;
+    futex_stats.waits++;
+    spin_unlock(&bucket->lock);
+    local_irq_restore(irq_flags);
+
+    while (!__atomic_load_n(&waiter.woken, __ATOMIC_ACQUIRE))
+    {
+        kthread_sleep();
+    }
+
+    // The waker wakes this thread with the lock held; once it is released
+    // the waiter, on this stack, is no longer touched
+    irq_flags = local_irq_save();
+    spin_lock(&bucket->lock);
+    spin_unlock(&bucket->lock);
+    local_irq_restore(irq_flags);
+    return 0;
+}
+
+/**
+ * @brief Wakes up to `count` threads sleeping on `addr`, oldest first.
+ *
+ * Safe from interrupt handlers.
+ *
+ * @param count A number of threads, or FUTEX_WAKE_ALL.
+ *
+ * @return The number of threads woken.
+ */
+uint32_t futex_wake(const volatile uint32_t* addr, uint32_t count)
+{
+    address_space_t* space = futex_space(addr);
+    futex_bucket_t* bucket = futex_bucket(addr, space);
+    uint32_t woken = 0;
+
+    uint32_t irq_flags = local_irq_save();
+    spin_lock(&bucket->lock);
+    futex_waiter_t** link = &bucket->head;
+    while (*link != NULL && woken < count)
+    {
+        futex_waiter_t* waiter = *link;
+        if (waiter->addr != addr || waiter->space != space)
+        {
+            link = &waiter->next;
+            continue;
+        }
+
+        *link = waiter->next;
+        __atomic_store_n(&waiter->woken, 1, __ATOMIC_RELEASE);
+        kthread_wake(waiter->thread);
+        woken++;
+    }
+    futex_stats.wakes++;
+    futex_stats.woken += woken;
+    spin_unlock(&bucket->lock);
+    local_irq_restore(irq_flags);
+    return woken;
+}
+
+void futex_get_stats(futex_stats_t* stats)
+{
+    *stats = futex_stats;
+}
@@ -0,0 +1,25 @@
+#include <kernel/sync/mutex.h>
+
+/**
+ * @brief Takes a mutex that mutex_lock() found held.
+ *
+ * The state is set to contended before sleeping, so the holder's unlock
+ * knows to wake someone. A thread that gets the mutex here also leaves it
+ * contended, since others may still be sleeping behind it; that costs at
+ * most one needless wake.
+ */
+void mutex_lock_slow(mutex_t* mutex)
+{
+    while (__atomic_exchange_n(&mutex->state, MUTEX_CONTENDED, __ATOMIC_ACQUIRE) != MUTEX_UNLOCKED)
+    {
+        futex_wait(&mutex->state, MUTEX_CONTENDED);
+    }
+}
+
+/**
+ * @brief Wakes one waiter after mutex_unlock() released a contended mutex.
+ */
+void mutex_unlock_slow(mutex_t* mutex)
+{
+    futex_wake(&mutex->state, 1);
+}
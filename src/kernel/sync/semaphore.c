@@ -0,0 +1,18 @@
+#include <kernel/sync/semaphore.h>
+
+/**
+ * @brief Sleeps until a unit is available, after sem_down() found none.
+ *
+ * `waiters` is raised before the count is looked at again, so an up()
+ * either sees it and wakes this thread, or happened early enough for the
+ * count to show it.
+ */
+void sem_down_slow(semaphore_t* sem)
+{
+    __atomic_add_fetch(&sem->waiters, 1, __ATOMIC_SEQ_CST);
+    while (!sem_trydown(sem))
+    {
+        futex_wait(&sem->count, 0);
+    }
+    __atomic_sub_fetch(&sem->waiters, 1, __ATOMIC_SEQ_CST);
+}
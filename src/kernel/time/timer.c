@@ -0,0 +1,476 @@
+#include <kernel/time/timer.h>
+#include <kernel/init.h>
+
+// Jiffies measured for APIC timer calibration
+#define TIMER_CALIBRATE_JIFFIES 2
+
+typedef struct timer_wheel
+{
+    spinlock_t lock;
+    uint64_t timer_jiffies;     // The next jiffy whose slot has not run yet
+    ktimer_t* tv1[TIMER_TV1_SIZE];
+    ktimer_t* tvn[TIMER_TVN_LEVELS][TIMER_TVN_SIZE];
+} timer_wheel_t;
+
+typedef struct timer_sleeper
+{
+    ktimer_t timer;
+    kthread_t* thread;
+    volatile uint32_t done;
+} timer_sleeper_t;
+
+static timer_wheel_t timer_wheel = { .lock = SPINLOCK_INIT };
+static timer_stats_t timer_stats;
+
+// The clock: jiffies are derived from the TSC, so they stay right across stopped ticks
+static uint64_t timer_tsc_base = 0;
+static uint32_t timer_tsc_per_jiffy = 0;
+
+static uint32_t timer_lapic_per_jiffy = 0;
+static uint32_t timer_idle_max_jiffies = 0;
+static volatile uint32_t timer_idle = 0;
+
+static void timer_link(ktimer_t** head, ktimer_t* timer)
+{
+    timer->next = *head;
+    if (*head != NULL)
+    {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+}
+
+static void timer_unlink(ktimer_t* timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next != NULL)
+    {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/**
+ * @brief Files a timer in the slot for its expiry. Constant time.
+ *
+ * Expiries within 256 jiffies go to tv1 at exact jiffy resolution; later
+ * ones go to the level whose slots are just wide enough, and are moved
+ * down as the wheel turns. Called with the wheel locked.
+ */
+static void timer_enqueue(timer_wheel_t* wheel, ktimer_t* timer)
+{
+    uint64_t expires = timer->expires;
+    ktimer_t** head;
+
+    if (expires < wheel->timer_jiffies)
+    {
+        // Already due: the next slot to run
+        head = &wheel->tv1[wheel->timer_jiffies & TIMER_TV1_MASK];
+    }
+    else
+    {
+        uint64_t delta = expires - wheel->timer_jiffies;
+        if (delta > TIMER_MAX_DELTA)
+        {
+            delta = TIMER_MAX_DELTA;
+            expires = wheel->timer_jiffies + delta;
+        }
+
+        if (delta < TIMER_TV1_SIZE)
+        {
+            head = &wheel->tv1[expires & TIMER_TV1_MASK];
+        }
+        else
+        {
+            uint32_t level = 0;
+            uint32_t shift = TIMER_TV1_BITS;
+            while (level < TIMER_TVN_LEVELS - 1 && delta >= (1ULL << (shift + TIMER_TVN_BITS)))
+            {
+                level++;
+                shift += TIMER_TVN_BITS;
+            }
+            head = &wheel->tvn[level][(expires >> shift) & TIMER_TVN_MASK];
+        }
+    }
+
+    timer_link(head, timer);
+}
+
+/**
+ * @brief Refiles the timers of a level's current slot into the levels below.
+ *
+ * @return The slot index; 0 means the level wrapped and the next level up
+ *         is due as well.
+ */
+static uint32_t timer_cascade(timer_wheel_t* wheel, uint32_t level)
+{
+    uint32_t index = (wheel->timer_jiffies >> (TIMER_TV1_BITS + level * TIMER_TVN_BITS)) & TIMER_TVN_MASK;
+
+    ktimer_t* timer = wheel->tvn[level][index];
+    wheel->tvn[level][index] = NULL;
+    while (timer != NULL)
+    {
+        ktimer_t* next = timer->next;
+        timer_enqueue(wheel, timer);
+        timer_stats.cascades++;
+        timer = next;
+    }
+
+    return index;
+}
+
+/**
+ * @brief Softirq: runs every timer that expired up to now.
+ *
+ * Each jiffy's slot is detached as a whole and its callbacks run with the
+ * wheel unlocked, so a callback may add or delete timers. After a tickless
+ * idle this catches up on all the skipped jiffies at once.
+ */
+static void timer_softirq()
+{
+    timer_wheel_t* wheel = &timer_wheel;
+    uint64_t now = jiffies_now();
+
+    uint32_t irq_flags = local_irq_save();
+    spin_lock(&wheel->lock);
+
+    while (wheel->timer_jiffies <= now)
+    {
+        uint32_t index = wheel->timer_jiffies & TIMER_TV1_MASK;
+        if (index == 0)
+        {
+            for (uint32_t level = 0; level < TIMER_TVN_LEVELS && timer_cascade(wheel, level) == 0; level++)
+            {
+            }
+        }
+
+        ktimer_t* expired = NULL;
+        if (wheel->tv1[index] != NULL)
+        {
+            expired = wheel->tv1[index];
+            wheel->tv1[index] = NULL;
+            expired->pprev = &expired;
+        }
+        wheel->timer_jiffies++;
+
+        while (expired != NULL)
+        {
+            ktimer_t* timer = expired;
+            timer_unlink(timer);
+            timer_stats.expired++;
+
+            spin_unlock(&wheel->lock);
+            local_irq_restore(irq_flags);
+            timer->fn(timer);
+            irq_flags = local_irq_save();
+            spin_lock(&wheel->lock);
+        }
+    }
+
+    spin_unlock(&wheel->lock);
+    local_irq_restore(irq_flags);
+}
+
+static void timer_interrupt(interrupt_frame_t* frame)
+{
+    (void)frame;
+
+    timer_stats.ticks++;
+    // While idle the tick is stopped; cpu_idle() restarts it
+    if (!timer_idle)
+    {
+        lapic_timer_oneshot(LAPIC_TIMER_VECTOR, timer_lapic_per_jiffy);
+    }
+    raise_softirq(SOFTIRQ_TIMER);
+    lapic_eoi();
+}
+
+/**
+ * @brief Sets up the clock from the TSC, calibrates the local APIC timer
+ *        against it and starts the tick. Needs softirqs.
+ */
+void timers_init()
+{
+    open_softirq(SOFTIRQ_TIMER, timer_softirq);
+
+    if (tsc_khz == 0 || !lapic_present())
+    {
+        kprintf("timer: needs a calibrated TSC and a local APIC\n");
+        return;
+    }
+
+    timer_tsc_per_jiffy = (uint32_t)div64_u32((uint64_t)tsc_khz * 1000, TIMER_HZ);
+    timer_tsc_base = rdtsc();
+
+    // Let the APIC timer count down, masked, over a known number of TSC cycles
+    uint64_t window = (uint64_t)timer_tsc_per_jiffy * TIMER_CALIBRATE_JIFFIES;
+    lapic_timer_oneshot(LAPIC_LVT_MASKED | LAPIC_TIMER_VECTOR, 0xFFFFFFFF);
+    uint64_t start = rdtsc();
+    while (rdtsc() - start < window)
+    {
+        cpu_relax();
+    }
+    uint32_t elapsed = 0xFFFFFFFF - lapic_timer_current();
+    lapic_timer_stop();
+
+    timer_lapic_per_jiffy = elapsed / TIMER_CALIBRATE_JIFFIES;
+    if (timer_lapic_per_jiffy == 0)
+    {
+        kprintf("timer: the APIC timer does not count\n");
+        return;
+    }
+    timer_idle_max_jiffies = 0xFFFFFFFF / timer_lapic_per_jiffy;
+
+    timer_wheel.timer_jiffies = jiffies_now();
+    idt_register_handler(LAPIC_TIMER_VECTOR, timer_interrupt);
+    lapic_timer_oneshot(LAPIC_TIMER_VECTOR, timer_lapic_per_jiffy);
+    kthread_set_idle(cpu_idle);
+
+    kprintf("timer: %d Hz tick, APIC timer at %d ticks per jiffy\n", TIMER_HZ, timer_lapic_per_jiffy);
+}
+INITCALL(INIT_CORE, timers_init, "softirq_init");
+
+int timers_available()
+{
+    return timer_lapic_per_jiffy != 0;
+}
+
+/**
+ * @brief Returns the jiffies since timers_init(), 0 before it.
+ */
+uint64_t jiffies_now()
+{
+    if (timer_tsc_per_jiffy == 0)
+    {
+        return 0;
+    }
+    return div64_u32(rdtsc() - timer_tsc_base, timer_tsc_per_jiffy);
+}
+
+/**
+ * @brief Returns what jiffies_now() computes from: the TSC value at jiffy 0
+ *        and the TSC cycles per jiffy, 0 before timers_init().
+ */
+void timer_get_clock(uint64_t* tsc_base, uint32_t* tsc_per_jiffy)
+{
+    *tsc_base = timer_tsc_base;
+    *tsc_per_jiffy = timer_tsc_per_jiffy;
+}
+
+/**
+ * @brief Converts milliseconds to jiffies, rounding up.
+ */
+uint64_t msecs_to_jiffies(uint32_t ms)
+{
+    return div64_u32((uint64_t)ms * TIMER_HZ + 999, 1000);
+}
+
+void ktimer_init(ktimer_t* timer, void (*fn)(ktimer_t* timer))
+{
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires = 0;
+    timer->fn = fn;
+}
+
+/**
+ * @brief Arms a timer that is not pending. Constant time.
+ *
+ * The callback runs in softirq context at or shortly after `expires`,
+ * and must not sleep.
+ */
+void ktimer_add(ktimer_t* timer, uint64_t expires)
+{
+    uint32_t irq_flags = local_irq_save();
+    spin_lock(&timer_wheel.lock);
+
+    timer->expires = expires;
+    timer_enqueue(&timer_wheel, timer);
+
+    spin_unlock(&timer_wheel.lock);
+    local_irq_restore(irq_flags);
+}
+
+/**
+ * @brief Moves a timer to a new expiry, arming it if it was not pending.
+ *
+ * @return 1 if the timer was pending, 0 otherwise.
+ */
+int ktimer_mod(ktimer_t* timer, uint64_t expires)
+{
+    uint32_t irq_flags = local_irq_save();
+    spin_lock(&timer_wheel.lock);
+
+    int pending = timer->pprev != NULL;
+    if (pending)
+    {
+        timer_unlink(timer);
+    }
+    timer->expires = expires;
+    timer_enqueue(&timer_wheel, timer);
+
+    spin_unlock(&timer_wheel.lock);
+    local_irq_restore(irq_flags);
+    return pending;
+}
+
+/**
+ * @brief Cancels a timer. Constant time.
+ *
+ * @return 1 if the timer was pending, 0 if it had already run or was never armed.
+ */
+int ktimer_del(ktimer_t* timer)
+{
+    uint32_t irq_flags = local_irq_save();
+    spin_lock(&timer_wheel.lock);
+
+    int pending = timer->pprev != NULL;
+    if (pending)
+    {
+        timer_unlink(timer);
+    }
+
+    spin_unlock(&timer_wheel.lock);
+    local_irq_restore(irq_flags);
+    return pending;
+}
+
+int ktimer_pending(const ktimer_t* timer)
+{
+    return timer->pprev != NULL;
+}
+
+/**
+ * @brief Returns the jiffy of the next timer, or TIMER_NEVER.
+ *
+ * Exact for timers in tv1. Timers in higher levels report the next wrap of
+ * tv1, when they are cascaded, which is at most 256 jiffies away.
+ */
+uint64_t timer_next_expiry()
+{
+    timer_wheel_t* wheel = &timer_wheel;
+    uint64_t next = TIMER_NEVER;
+
+    uint32_t irq_flags = local_irq_save();
+    spin_lock(&wheel->lock);
+
+    uint64_t base = wheel->timer_jiffies;
+    uint32_t index = base & TIMER_TV1_MASK;
+    uint64_t wrap = base + (TIMER_TV1_SIZE - index);
+
+    for (uint32_t i = index; i < TIMER_TV1_SIZE && next == TIMER_NEVER; i++)
+    {
+        if (wheel->tv1[i] != NULL)
+        {
+            next = base + (i - index);
+        }
+    }
+
+    for (uint32_t level = 0; level < TIMER_TVN_LEVELS && next == TIMER_NEVER; level++)
+    {
+        for (uint32_t i = 0; i < TIMER_TVN_SIZE; i++)
+        {
+            if (wheel->tvn[level][i] != NULL)
+            {
+                next = wrap;
+                break;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < index && next == TIMER_NEVER; i++)
+    {
+        if (wheel->tv1[i] != NULL)
+        {
+            next = wrap + i;
+        }
+    }
+
+    spin_unlock(&wheel->lock);
+    local_irq_restore(irq_flags);
+    return next;
+}
+
+static void timer_sleeper_fn(ktimer_t* timer)
+{
+    timer_sleeper_t* sleeper = (timer_sleeper_t*)timer;
+    sleeper->done = 1;
+    kthread_wake(sleeper->thread);
+}
+
+/**
+ * @brief Blocks the current thread for at least `ms` milliseconds.
+ *
+ * Other threads run meanwhile; if there are none, the CPU idles with the
+ * tick stopped. Returns at once if there is no timer hardware.
+ */
+void timer_sleep_ms(uint32_t ms)
+{
+    if (!timers_available())
+    {
+        return;
+    }
+
+    timer_sleeper_t sleeper;
+    ktimer_init(&sleeper.timer, timer_sleeper_fn);
+    sleeper.thread = kthread_current();
+    sleeper.done = 0;
+    ktimer_add(&sleeper.timer, jiffies_now() + msecs_to_jiffies(ms) + 1);
+
+    while (!sleeper.done)
+    {
+        kthread_sleep();
+    }
+}
+
+/**
+ * @brief Halts until the next interrupt, with the tick stopped.
+ *
+ * Call with interrupts disabled, after finding nothing to do; returns with
+ * them enabled. Instead of a tick every jiffy, the APIC timer is programmed
+ * once for the next timer's expiry. Returns at once if a thread or a
+ * softirq is waiting to run.
+ */
+void cpu_idle()
+{
+    if (kthread_has_runnable() || softirq_pending())
+    {
+        local_irq_enable();
+        return;
+    }
+
+    uint64_t start = 0;
+    if (timers_available())
+    {
+        start = jiffies_now();
+        uint64_t next = timer_next_expiry();
+        uint64_t delta = next > start ? next - start : 1;
+        if (delta > timer_idle_max_jiffies)
+        {
+            delta = timer_idle_max_jiffies;
+        }
+
+        timer_idle = 1;
+        timer_stats.idle_entries++;
+        lapic_timer_oneshot(LAPIC_TIMER_VECTOR, (uint32_t)delta * timer_lapic_per_jiffy);
+    }
+
+    // sti takes effect after the next instruction, so no interrupt slips in before the halt
+    asm volatile("sti; hlt" : : : "memory");
+
+    if (timer_idle)
+    {
+        local_irq_disable();
+        timer_idle = 0;
+        timer_stats.idle_jiffies += (uint32_t)(jiffies_now() - start);
+        lapic_timer_oneshot(LAPIC_TIMER_VECTOR, timer_lapic_per_jiffy);
+        local_irq_enable();
+    }
+}
+
+void timer_get_stats(timer_stats_t* stats)
+{
+    *stats = timer_stats;
+}
@@ -0,0 +1,211 @@
+#include <kernel/trace/gcov.h>
+
+#ifdef CONFIG_GCOV
+
+// What gcc's -fprofile-arcs instrumentation registers for every object
+// file, in the layout of gcc 4.7 and later. Only the number of counter
+// kinds and the record units changed since.
+#if __GNUC__ >= 14
+#define GCOV_COUNTERS 9
+#elif __GNUC__ >= 10
+#define GCOV_COUNTERS 8
+#elif __GNUC__ >= 7
+#define GCOV_COUNTERS 9
+#elif __GNUC__ > 5 || (__GNUC__ == 5 && __GNUC_MINOR__ >= 1)
+#define GCOV_COUNTERS 10
+#else
+#define GCOV_COUNTERS 9
+#endif
+
+// Record lengths are counted in bytes since gcc 12, in words before
+#if __GNUC__ >= 12
+#define GCOV_UNIT_SIZE 4
+#else
+#define GCOV_UNIT_SIZE 1
+#endif
+
+#define GCOV_DATA_MAGIC 0x67636461      // "gcda"
+#define GCOV_TAG_FUNCTION 0x01000000
+#define GCOV_TAG_FUNCTION_LENGTH 3
+#define GCOV_TAG_COUNTER_BASE 0x01A10000
+#define GCOV_TAG_FOR_COUNTER(kind) (GCOV_TAG_COUNTER_BASE + ((uint32_t)(kind) << 17))
+
+typedef int64_t gcov_type;
+
+typedef struct gcov_ctr_info
+{
+    uint32_t num;
+    gcov_type* values;
+} gcov_ctr_info_t;
+
+typedef struct gcov_fn_info
+{
+    const struct gcov_info* key;
+    uint32_t ident;
+    uint32_t lineno_checksum;
+    uint32_t cfg_checksum;
+    gcov_ctr_info_t ctrs[];         // One per counter kind in use
+} gcov_fn_info_t;
+
+typedef struct gcov_info
+{
+    uint32_t version;
+    struct gcov_info* next;
+    uint32_t stamp;
+#if __GNUC__ >= 12
+    uint32_t checksum;
+#endif
+    const char* filename;           // The .gcda file, as the compiler named it
+    void (*merge[GCOV_COUNTERS])(gcov_type* counters, uint32_t count);
+    uint32_t n_functions;
+    const gcov_fn_info_t* const* functions;
+} gcov_info_t;
+
+// Set by the linker around the constructors, which call __gcov_init()
+extern void (*__init_array_start[])();
+extern void (*__init_array_end[])();
+
+static gcov_info_t* gcov_units = NULL;
+static uint32_t gcov_units_count = 0;
+
+/**
+ * @brief Called by each object's constructor with its counters.
+ */
+void __gcov_init(gcov_info_t* info)
+{
+    info->next = gcov_units;
+    gcov_units = info;
+    gcov_units_count++;
+}
+
+// Referenced by the instrumentation; counters are merged on the host, not here
+void __gcov_merge_add(gcov_type* counters, uint32_t count)
+{
+    (void)counters;
+    (void)count;
+}
+
+void __gcov_exit()
+{
+}
+
+/**
+ * @brief Registers the counters of every instrumented object file.
+ *
+ * There is no C runtime to run the constructors the compiler emits for
+ * that, so this does. Counting starts at boot regardless; this only has
+ * to run before gcov_dump_serial().
+ */
+void gcov_init()
+{
+    for (void (**ctor)() = __init_array_start; ctor < __init_array_end; ctor++)
+    {
+        (*ctor)();
+    }
+    pr_info("gcov: %d object files instrumented\n", gcov_units_count);
+}
+
+uint32_t gcov_unit_count()
+{
+    return gcov_units_count;
+}
+
+static uint32_t gcov_put_u32(uint32_t value, int write)
+{
+    if (write)
+    {
+        serial_write(&value, sizeof(value));
+    }
+    return sizeof(value);
+}
+
+static uint32_t gcov_put_u64(uint64_t value, int write)
+{
+    return gcov_put_u32((uint32_t)value, write) + gcov_put_u32((uint32_t)(value >> 32), write);
+}
+
+/**
+ * @brief Writes one object's counters in the .gcda format, or only sizes them.
+ *
+ * @return The size of the .gcda file in bytes.
+ */
+static uint32_t gcov_put_unit(const gcov_info_t* info, int write)
+{
+    uint32_t size = 0;
+    size += gcov_put_u32(GCOV_DATA_MAGIC, write);
+    size += gcov_put_u32(info->version, write);
+    size += gcov_put_u32(info->stamp, write);
+#if __GNUC__ >= 12
+    size += gcov_put_u32(0, write);     // Checksum of the unit, not checked
+#endif
+
+    for (uint32_t i = 0; i < info->n_functions; i++)
+    {
+        // Functions in COMDAT groups may be recorded by another object
+        const gcov_fn_info_t* fn = info->functions[i];
+        if (fn == NULL || fn->key != info)
+        {
+            continue;
+        }
+
+        size += gcov_put_u32(GCOV_TAG_FUNCTION, write);
+        size += gcov_put_u32(GCOV_TAG_FUNCTION_LENGTH * GCOV_UNIT_SIZE, write);
+        size += gcov_put_u32(fn->ident, write);
+        size += gcov_put_u32(fn->lineno_checksum, write);
+        size += gcov_put_u32(fn->cfg_checksum, write);
+
+        const gcov_ctr_info_t* ctr = fn->ctrs;
+        for (uint32_t kind = 0; kind < GCOV_COUNTERS; kind++)
+        {
+            if (info->merge[kind] == NULL)
+            {
+                continue;
+            }
+            size += gcov_put_u32(GCOV_TAG_FOR_COUNTER(kind), write);
+            size += gcov_put_u32(ctr->num * 2 * GCOV_UNIT_SIZE, write);
+            for (uint32_t j = 0; j < ctr->num; j++)
+            {
+                size += gcov_put_u64((uint64_t)ctr->values[j], write);
+            }
+            ctr++;
+        }
+    }
+    return size;
+}
+
+/**
+ * @brief Dumps every object's counters to the serial port, then asks QEMU to exit.
+ *
+ * The serial driver is instrumented too, so counts still move while this
+ * runs; a .gcda's size depends only on how many counters there are, so
+ * sizing and writing it in two passes stays consistent. Without the
+ * isa-debug-exit device the port write does nothing and the kernel
+ * carries on.
+ */
+void gcov_dump_serial()
+{
+    if (!serial_present())
+    {
+        kprintf("gcov: no serial port to dump to\n");
+        return;
+    }
+
+    serial_write(GCOV_DUMP_BEGIN, strlen(GCOV_DUMP_BEGIN));
+    for (const gcov_info_t* info = gcov_units; info != NULL; info = info->next)
+    {
+        gcov_dump_header_t header;
+        header.name_size = strlen(info->filename);
+        header.data_size = gcov_put_unit(info, 0);
+        serial_write(&header, sizeof(header));
+        serial_write(info->filename, header.name_size);
+        gcov_put_unit(info, 1);
+    }
+
+    gcov_dump_header_t end = { 0, 0 };
+    serial_write(&end, sizeof(end));
+    serial_write(GCOV_DUMP_END, strlen(GCOV_DUMP_END));
+
+    outb(GCOV_QEMU_EXIT_PORT, 0);
+}
+
+#endif
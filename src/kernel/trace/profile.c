@@ -0,0 +1,248 @@
+#include <kernel/trace/profile.h>
+#include <kernel/init.h>
+
+// Written only by its own CPU, from the timer interrupt
+typedef struct profile_buffer
+{
+    profile_sample_t* samples;
+    volatile uint32_t count;
+    volatile uint32_t dropped;
+} __attribute__((aligned(64))) profile_buffer_t;
+
+static profile_buffer_t profile_buffers[MAX_CPUS];
+static volatile uint32_t profile_hz = 0;
+
+/**
+ * @brief Allocates a sample buffer for every online CPU and installs the timer handler.
+ *
+ * The timer stays off until profile_start(). The PIT interrupts only the
+ * boot CPU, so that is where samples come from.
+ */
+void profile_init()
+{
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        if (!(cpu_online_mask & (1 << cpu)) || profile_buffers[cpu].samples != NULL)
+        {
+            continue;
+        }
+
+        profile_buffers[cpu].samples = (profile_sample_t*)vmalloc(PROFILE_SAMPLES * sizeof(profile_sample_t));
+        if (profile_buffers[cpu].samples == NULL)
+        {
+            kprintf("profile: no memory for the samples of CPU %d\n", cpu);
+        }
+    }
+
+    idt_register_handler(IRQ_VECTOR(PIT_IRQ), profile_sample);
+}
+INITCALL(INIT_SUBSYS, profile_init, NULL);
+
+/**
+ * @brief Discards earlier samples, for a new run of the timer or of another sample source.
+ */
+void profile_reset()
+{
+    uint32_t irq_flags = local_irq_save();
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        profile_buffers[cpu].count = 0;
+        profile_buffers[cpu].dropped = 0;
+    }
+    profile_hz = 0;
+
+    local_irq_restore(irq_flags);
+}
+
+/**
+ * @brief Discards earlier samples and starts sampling.
+ *
+ * @return The sampling rate actually programmed.
+ */
+uint32_t profile_start(uint32_t hz)
+{
+    profile_reset();
+
+    uint32_t irq_flags = local_irq_save();
+    profile_hz = pit_set_periodic(hz);
+    irq_unmask(PIT_IRQ);
+
+    local_irq_restore(irq_flags);
+    return profile_hz;
+}
+
+/**
+ * @brief Stops sampling; the samples stay for profile_dump_serial().
+ */
+void profile_stop()
+{
+    uint32_t irq_flags = local_irq_save();
+    irq_mask(PIT_IRQ);
+    pit_stop();
+    local_irq_restore(irq_flags);
+}
+
+/**
+ * @brief Follows saved frame pointers up a stack.
+ *
+ * Every frame must lie inside [stack_low, stack_high) and above the one
+ * before it, so a corrupt or missing frame pointer ends the walk instead
+ * of faulting. The walk also ends at a zero frame pointer or return
+ * address, which boot.S and kthread_create() leave at the stack base.
+ *
+ * @param fp The innermost frame pointer.
+ * @param pcs Receives the return addresses, innermost first.
+ *
+ * @return The number of return addresses stored.
+ */
+size_t profile_backtrace(uintptr_t fp, uintptr_t stack_low, uintptr_t stack_high, uint32_t* pcs, size_t max)
+{
+    size_t depth = 0;
+
+    while (depth < max && fp >= stack_low && fp <= stack_high - 8 && (fp & 3) == 0)
+    {
+        uint32_t* frame = (uint32_t*)fp;
+        if (frame[1] == 0)
+        {
+            break;
+        }
+        pcs[depth++] = frame[1];
+
+        if (frame[0] <= fp)
+        {
+            break;
+        }
+        fp = frame[0];
+    }
+
+    return depth;
+}
+
+/**
+ * @brief Timer handler: records where the interrupted code was and how it got there.
+ *
+ * Also called from the PMU overflow interrupt, see pmu_sample_start().
+ */
+void profile_sample(interrupt_frame_t* frame)
+{
+    profile_buffer_t* buffer = &profile_buffers[smp_processor_id()];
+    if (buffer->samples == NULL)
+    {
+        return;
+    }
+    if (buffer->count == PROFILE_SAMPLES)
+    {
+        buffer->dropped++;
+        return;
+    }
+
+    // No privilege change, so the interrupted stack continues right after the CPU-pushed words
+    uintptr_t stack_low = (uintptr_t)(&frame->eflags + 1);
+    uintptr_t stack_high = stack_low + PROFILE_STACK_LIMIT;
+    kthread_t* thread = kthread_current();
+    if (thread != NULL && thread->stack != NULL)
+    {
+        stack_high = (uintptr_t)thread->stack + KTHREAD_STACK_SIZE;
+    }
+
+    profile_sample_t* sample = &buffer->samples[buffer->count];
+    sample->thread = (uint32_t)thread;
+    sample->pcs[0] = frame->eip;
+    sample->depth = 1;
+    // User stacks are not walked; a user sample is just the interrupted instruction
+    if (!FRAME_FROM_USER(frame))
+    {
+        sample->depth += profile_backtrace(frame->ebp, stack_low, stack_high, &sample->pcs[1], PROFILE_MAX_DEPTH - 1);
+    }
+
+    buffer->count++;
+}
+
+size_t profile_count(uint32_t cpu)
+{
+    return cpu < MAX_CPUS ? profile_buffers[cpu].count : 0;
+}
+
+const profile_sample_t* profile_sample_at(uint32_t cpu, size_t index)
+{
+    if (index >= profile_count(cpu))
+    {
+        return NULL;
+    }
+    return &profile_buffers[cpu].samples[index];
+}
+
+/**
+ * @brief Streams the samples to the serial port in binary.
+ *
+ * Sampling is stopped first. Symbolize with tools/profile.py.
+ */
+void profile_dump_serial()
+{
+    if (!serial_present())
+    {
+        kprintf("profile: no serial port to dump to\n");
+        return;
+    }
+
+    profile_stop();
+
+    profile_dump_header_t header;
+    memcpy(header.magic, PROFILE_DUMP_MAGIC, sizeof(header.magic));
+    header.sample_size = sizeof(profile_sample_t);
+    header.hz = profile_hz;
+    header.cpus = 0;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        if (profile_buffers[cpu].samples != NULL)
+        {
+            header.cpus++;
+        }
+    }
+
+    serial_write(PROFILE_DUMP_BEGIN, strlen(PROFILE_DUMP_BEGIN));
+    serial_write(&header, sizeof(header));
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        profile_buffer_t* buffer = &profile_buffers[cpu];
+        if (buffer->samples == NULL)
+        {
+            continue;
+        }
+
+        uint32_t count = buffer->count;
+        uint32_t dropped = buffer->dropped;
+        serial_write(&cpu, sizeof(cpu));
+        serial_write(&count, sizeof(count));
+        serial_write(&dropped, sizeof(dropped));
+        serial_write(buffer->samples, count * sizeof(profile_sample_t));
+    }
+
+    serial_write(PROFILE_DUMP_END, strlen(PROFILE_DUMP_END));
+}
+
+/**
+ * @brief Runs a single-key profiler command.
+ *
+ * @return 1 if the key was a command, 0 otherwise.
+ */
+int profile_command(int command)
+{
+    switch (command)
+    {
+    case PROFILE_CMD_START:
+        kprintf("profile: sampling at %d Hz\n", profile_start(PROFILE_DEFAULT_HZ));
+        return 1;
+    case PROFILE_CMD_STOP:
+        profile_stop();
+        kprintf("profile: stopped, %d samples\n", profile_count(0));
+        return 1;
+    case PROFILE_CMD_DUMP:
+        profile_dump_serial();
+        return 1;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,182 @@
+#include <kernel/trace/trace.h>
+#include <kernel/init.h>
+
+// One writer per ring: its own CPU. Interrupts on that CPU may nest inside a
+// write, so slots are claimed with an atomic increment and never shared.
+typedef struct trace_ring
+{
+    trace_record_t* records;
+    volatile uint32_t head;     // Records ever written; head % TRACE_RING_RECORDS is the next slot
+} __attribute__((aligned(64))) trace_ring_t;
+
+volatile uint32_t trace_enabled = 0;
+
+static trace_ring_t trace_rings[MAX_CPUS];
+
+/**
+ * @brief Allocates a ring for every online CPU. Tracepoints stay disabled.
+ */
+void trace_init()
+{
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        if (!(cpu_online_mask & (1 << cpu)) || trace_rings[cpu].records != NULL)
+        {
+            continue;
+        }
+
+        trace_rings[cpu].records = (trace_record_t*)vmalloc(TRACE_RING_RECORDS * sizeof(trace_record_t));
+        if (trace_rings[cpu].records == NULL)
+        {
+            kprintf("trace: no memory for the ring of CPU %d\n", cpu);
+        }
+        trace_rings[cpu].head = 0;
+    }
+}
+INITCALL(INIT_SUBSYS, trace_init, NULL);
+
+void trace_enable(uint32_t mask)
+{
+    __atomic_or_fetch(&trace_enabled, mask, __ATOMIC_RELAXED);
+}
+
+void trace_disable(uint32_t mask)
+{
+    __atomic_and_fetch(&trace_enabled, ~mask, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Appends a record to the executing CPU's ring. Called through TRACE_EVENT.
+ */
+void trace_write(uint32_t event, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3)
+{
+    uint32_t cpu = smp_processor_id();
+    trace_ring_t* ring = &trace_rings[cpu];
+    if (ring->records == NULL)
+    {
+        return;
+    }
+
+    uint32_t slot = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED) & (TRACE_RING_RECORDS - 1);
+    trace_record_t* record = &ring->records[slot];
+
+    record->tsc = rdtsc();
+    record->event = event;
+    record->cpu = cpu;
+    record->reserved = 0;
+    record->thread = (uint32_t)kthread_current();
+    record->args[0] = a0;
+    record->args[1] = a1;
+    record->args[2] = a2;
+    record->args[3] = a3;
+}
+
+/**
+ * @brief Returns the number of records a CPU's ring currently holds.
+ */
+size_t trace_count(uint32_t cpu)
+{
+    if (cpu >= MAX_CPUS || trace_rings[cpu].records == NULL)
+    {
+        return 0;
+    }
+
+    uint32_t head = trace_rings[cpu].head;
+    return head < TRACE_RING_RECORDS ? head : TRACE_RING_RECORDS;
+}
+
+/**
+ * @brief Returns a held record, index 0 being the oldest.
+ */
+const trace_record_t* trace_record_at(uint32_t cpu, size_t index)
+{
+    size_t count = trace_count(cpu);
+    if (index >= count)
+    {
+        return NULL;
+    }
+
+    uint32_t first = trace_rings[cpu].head - count;
+    return &trace_rings[cpu].records[(first + index) & (TRACE_RING_RECORDS - 1)];
+}
+
+/**
+ * @brief Streams every ring to the serial port in binary, oldest record first.
+ *
+ * Tracing is paused for the dump, so it shows up neither in the rings nor
+ * as torn records, and resumed afterwards. Decode with tools/trace2json.py.
+ */
+void trace_dump_serial()
+{
+    if (!serial_present())
+    {
+        kprintf("trace: no serial port to dump to\n");
+        return;
+    }
+
+    uint32_t enabled = trace_enabled;
+    trace_disable(TRACE_ALL);
+    uint32_t irq_flags = local_irq_save();
+
+    trace_dump_header_t header;
+    memcpy(header.magic, TRACE_DUMP_MAGIC, sizeof(header.magic));
+    header.record_size = sizeof(trace_record_t);
+    header.tsc_khz = tsc_khz;
+    header.cpus = 0;
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        if (trace_rings[cpu].records != NULL)
+        {
+            header.cpus++;
+        }
+    }
+
+    serial_write(TRACE_DUMP_BEGIN, strlen(TRACE_DUMP_BEGIN));
+    serial_write(&header, sizeof(header));
+
+    for (uint32_t cpu = 0; cpu < MAX_CPUS; cpu++)
+    {
+        if (trace_rings[cpu].records == NULL)
+        {
+            continue;
+        }
+
+        uint32_t count = trace_count(cpu);
+        serial_write(&cpu, sizeof(cpu));
+        serial_write(&count, sizeof(count));
+        for (uint32_t i = 0; i < count; i++)
+        {
+            serial_write(trace_record_at(cpu, i), sizeof(trace_record_t));
+        }
+    }
+
+    serial_write(TRACE_DUMP_END, strlen(TRACE_DUMP_END));
+
+    local_irq_restore(irq_flags);
+    trace_enable(enabled);
+}
+
+/**
+ * @brief Runs a single-key tracing command.
+ *
+ * @return 1 if the key was a command, 0 otherwise.
+ */
+int trace_command(int command)
+{
+    switch (command)
+    {
+    case TRACE_CMD_ENABLE:
+        trace_enable(TRACE_ALL);
+        kprintf("trace: enabled\n");
+        return 1;
+    case TRACE_CMD_DISABLE:
+        trace_disable(TRACE_ALL);
+        kprintf("trace: disabled\n");
+        return 1;
+    case TRACE_CMD_DUMP:
+        trace_dump_serial();
+        return 1;
+    default:
+        return 0;
+    }
+}
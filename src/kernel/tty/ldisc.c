@@ -0,0 +1,76 @@
+#include <kernel/tty/ldisc.h>
+
+void ldisc_init(ldisc_t* ldisc, int echo)
+{
+    ldisc->line[0] = '\0';
+    ldisc->len = 0;
+    ldisc->echo = echo;
+    ldisc->done = 0;
+}
+
+static void ldisc_echo(ldisc_t* ldisc, const char* str)
+{
+    if (ldisc->echo)
+    {
+        kprintf("%s", str);
+    }
+}
+
+/**
+ * @brief Feeds one raw character to the line discipline.
+ *
+ * Enter, as either '\r' or '\n', completes the line. Backspace and delete
+ * erase the last character, ctrl-U the whole line, and ctrl-C abandons it,
+ * which hands out an empty line. Other control characters, and characters
+ * past LDISC_LINE_MAX, are dropped.
+ *
+ * @return 1 when ldisc->line holds a complete, NUL terminated line, valid
+ *         until the next call; 0 otherwise.
+ */
+int ldisc_input(ldisc_t* ldisc, int c)
+{
+    if (ldisc->done)
+    {
+        ldisc->len = 0;
+        ldisc->done = 0;
+    }
+
+    switch (c)
+    {
+    case '\r':
+    case '\n':
+        ldisc_echo(ldisc, "\n");
+        break;
+    case LDISC_CTRL_C:
+        ldisc_echo(ldisc, "^C\n");
+        ldisc->len = 0;
+        break;
+    case LDISC_BACKSPACE:
+    case LDISC_DELETE:
+        if (ldisc->len > 0)
+        {
+            ldisc->len--;
+            ldisc_echo(ldisc, "\b \b");
+        }
+        return 0;
+    case LDISC_CTRL_U:
+        while (ldisc->len > 0)
+        {
+            ldisc->len--;
+            ldisc_echo(ldisc, "\b \b");
+        }
+        return 0;
+    default:
+        if (c >= ' ' && c < LDISC_DELETE && ldisc->len < LDISC_LINE_MAX)
+        {
+            char echo[2] = {(char)c, '\0'};
+            ldisc->line[ldisc->len++] = (char)c;
+            ldisc_echo(ldisc, echo);
+        }
+        return 0;
+    }
+
+    ldisc->line[ldisc->len] = '\0';
+    ldisc->done = 1;
+    return 1;
+}
@@ -0,0 +1,377 @@
+#include <kernel/tty/shell.h>
+#include <kernel/init.h>
+#include <kernel/tty/tty.h>
+#include <kernel/drivers/keyboard.h>
+#include <kernel/drivers/serial.h>
+#include <kernel/mm/memstat.h>
+#include <kernel/sched/kthread.h>
+#include <kernel/time/timer.h>
+#include <kernel/trace/trace.h>
+#include <kernel/trace/profile.h>
+#include <kernel/user/process.h>
+#include <kernel/net/netbench.h>
+
+static int shell_help(int argc, char** argv);
+
+/**
+ * @brief Parses a decimal number.
+ *
+ * @return 0 on success, -1 if `str` is not one.
+ */
+static int shell_parse_uint(const char* str, uint32_t* value)
+{
+    uint32_t result = 0;
+    if (*str == '\0')
+    {
+        return -1;
+    }
+    for (; *str != '\0'; str++)
+    {
+        if (*str < '0' || *str > '9' || result > (0xFFFFFFFF - 9) / 10)
+        {
+            return -1;
+        }
+        result = result * 10 + (uint32_t)(*str - '0');
+    }
+    *value = result;
+    return 0;
+}
+
+static int shell_meminfo(int argc, char** argv)
+{
+    (void)argc, (void)argv;
+    memstat_dump_meminfo();
+    return 0;
+}
+
+static int shell_slabinfo(int argc, char** argv)
+{
+    (void)argc, (void)argv;
+    memstat_dump_slabinfo();
+    return 0;
+}
+
+static int shell_callers(int argc, char** argv)
+{
+    (void)argc, (void)argv;
+    memstat_dump_callers();
+    return 0;
+}
+
+static int shell_memstat(int argc, char** argv)
+{
+    memstat_dump_machine(argc > 1 ? argv[1] : "shell");
+    return 0;
+}
+
+static int shell_boot(int argc, char** argv)
+{
+    (void)argc, (void)argv;
+    boot_report();
+    return 0;
+}
+
+static int shell_trace(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        return -1;
+    }
+    if (strcmp(argv[1], "on") == 0)
+    {
+        return trace_command(TRACE_CMD_ENABLE) ? 0 : -1;
+    }
+    if (strcmp(argv[1], "off") == 0)
+    {
+        return trace_command(TRACE_CMD_DISABLE) ? 0 : -1;
+    }
+    if (strcmp(argv[1], "dump") == 0)
+    {
+        return trace_command(TRACE_CMD_DUMP) ? 0 : -1;
+    }
+    return -1;
+}
+
+static int shell_profile(int argc, char** argv)
+{
+    if (argc == 3 && strcmp(argv[1], "start") == 0)
+    {
+        uint32_t hz;
+        if (shell_parse_uint(argv[2], &hz) != 0 || hz == 0)
+        {
+            return -1;
+        }
+        kprintf("profile: sampling at %d Hz\n", profile_start(hz));
+        return 0;
+    }
+    if (argc != 2)
+    {
+        return -1;
+    }
+    if (strcmp(argv[1], "start") == 0)
+    {
+        return profile_command(PROFILE_CMD_START) ? 0 : -1;
+    }
+    if (strcmp(argv[1], "stop") == 0)
+    {
+        return profile_command(PROFILE_CMD_STOP) ? 0 : -1;
+    }
+    if (strcmp(argv[1], "dump") == 0)
+    {
+        return profile_command(PROFILE_CMD_DUMP) ? 0 : -1;
+    }
+    return -1;
+}
+
+/**
+ * @brief Runs a benchmark program from SHELL_BENCH_DIR and waits for it.
+ *
+ * The time reported is wall clock from spawn to exit, so it includes
+ * loading the program; the benchmarks print their own finer numbers.
+ */
+static int shell_bench(int argc, char** argv)
+{
+    uint32_t arg = 0;
+    if (argc < 2 || argc > 3 || (argc == 3 && shell_parse_uint(argv[2], &arg) != 0))
+    {
+        return -1;
+    }
+
+    char path[SHELL_PATH_MAX];
+    size_t dir_len = strlen(SHELL_BENCH_DIR);
+    size_t name_len = 0;
+    while (argv[1][name_len] != '\0' && argv[1][name_len] != '/')
+    {
+        name_len++;
+    }
+    if (argv[1][name_len] == '/' || dir_len + name_len >= sizeof(path))
+    {
+        kprintf("bench: bad program name %s\n", argv[1]);
+        return 1;
+    }
+    memcpy(path, SHELL_BENCH_DIR, dir_len);
+    memcpy(path + dir_len, argv[1], name_len + 1);
+
+    uint64_t start = rdtsc();
+    process_t* process = process_spawn(path, arg);
+    if (process == NULL)
+    {
+        return 1;
+    }
+    int code = process_wait(process);
+    uint64_t cycles = rdtsc() - start;
+
+    if (tsc_khz != 0)
+    {
+        kprintf("bench: %s exited with %d after %d us\n", argv[1], code,
+                (uint32_t)div64_u32(cycles * 1000, tsc_khz));
+    }
+    else
+    {
+        kprintf("bench: %s exited with %d\n", argv[1], code);
+    }
+    return code == 0 ? 0 : 1;
+}
+
+static int shell_net(int argc, char** argv)
+{
+    (void)argc, (void)argv;
+    net_dump_stats();
+    return 0;
+}
+
+/**
+ * @brief Measures UDP round trips, through loopback or to the host's
+ *        echo server behind the gateway.
+ */
+static int shell_netbench(int argc, char** argv)
+{
+    uint32_t count = NETBENCH_DEFAULT_COUNT;
+    if (argc > 3 || (argc == 3 && (shell_parse_uint(argv[2], &count) != 0 || count == 0)))
+    {
+        return -1;
+    }
+
+    const char* target = argc > 1 ? argv[1] : "lo";
+    netbench_result_t result;
+    int status;
+    if (strcmp(target, "lo") == 0)
+    {
+        status = netbench_run(NET_LOOPBACK_IP, NET_ECHO_PORT, count, &result);
+    }
+    else if (strcmp(target, "host") == 0)
+    {
+        status = netbench_run(NET_GATEWAY_IP, NETBENCH_HOST_PORT, count, &result);
+    }
+    else
+    {
+        return -1;
+    }
+
+    if (status != 0)
+    {
+        kprintf("netbench: %s run failed\n", target);
+        return 1;
+    }
+    netbench_report(target, &result);
+    return 0;
+}
+
+static const shell_command_t shell_commands[] = {
+    {"help", "help", shell_help},
+    {"meminfo", "meminfo", shell_meminfo},
+    {"slabinfo", "slabinfo", shell_slabinfo},
+    {"callers", "callers", shell_callers},
+    {"memstat", "memstat [tag]", shell_memstat},
+    {"trace", "trace on|off|dump", shell_trace},
+    {"profile", "profile start [hz]|stop|dump", shell_profile},
+    {"bench", "bench <program> [arg]", shell_bench},
+    {"boot", "boot", shell_boot},
+    {"net", "net", shell_net},
+    {"netbench", "netbench [lo|host] [count]", shell_netbench},
+};
+
+#define SHELL_COMMAND_COUNT (sizeof(shell_commands) / sizeof(shell_commands[0]))
+
+static int shell_help(int argc, char** argv)
+{
+    (void)argc, (void)argv;
+    for (size_t i = 0; i < SHELL_COMMAND_COUNT; i++)
+    {
+        kprintf("  %s\n", shell_commands[i].usage);
+    }
+    return 0;
+}
+
+/**
+ * @brief Splits a line in place into words separated by spaces.
+ *
+ * @return The number of words, at most `max`; words past that are ignored.
+ */
+int shell_split(char* line, char** argv, int max)
+{
+    int argc = 0;
+    while (*line != '\0' && argc < max)
+    {
+        while (*line == ' ')
+        {
+            *line++ = '\0';
+        }
+        if (*line == '\0')
+        {
+            break;
+        }
+
+        argv[argc++] = line;
+        while (*line != ' ' && *line != '\0')
+        {
+            line++;
+        }
+        if (*line == ' ')
+        {
+            *line++ = '\0';
+        }
+    }
+    return argc;
+}
+
+/**
+ * @brief Runs one command line; the line is modified.
+ *
+ * @return 0 on success or for an empty line, -1 for an unknown command or
+ *         bad arguments, otherwise what the command returned.
+ */
+int shell_execute(char* line)
+{
+    char* argv[SHELL_MAX_ARGS];
+    int argc = shell_split(line, argv, SHELL_MAX_ARGS);
+    if (argc == 0)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < SHELL_COMMAND_COUNT; i++)
+    {
+        if (strcmp(argv[0], shell_commands[i].name) != 0)
+        {
+            continue;
+        }
+
+        int result = shell_commands[i].fn(argc, argv);
+        if (result < 0)
+        {
+            kprintf("usage: %s\n", shell_commands[i].usage);
+        }
+        return result;
+    }
+
+    kprintf("shell: unknown command %s, try help\n", argv[0]);
+    return -1;
+}
+
+/**
+ * @brief The boot thread's console loop, after boot: never returns.
+ *
+ * Keyboard input always goes to the shell. Serial input is taken as the
+ * single-key commands the host tools send, except that SHELL_SERIAL_LINE
+ * starts a shell line, which ends with enter.
+ *
+ * The prompt only goes to the screen, and the serial line echoes the
+ * SHELL_SERIAL_LINE key in its place, so the serial log stays line
+ * oriented for the host tools. Commands run on the boot thread itself; the
+ * idle loop around them halts until the next keyboard or serial interrupt.
+ */
+void shell_run()
+{
+    static ldisc_t ldisc;
+    int serial_line = 0;
+
+    ldisc_init(&ldisc, 1);
+    serial_enable_rx_interrupt();
+    tty_put_str(SHELL_PROMPT);
+
+    for (;;)
+    {
+        int c;
+        int line = 0;
+        while (!line && (c = keyboard_getc()) != -1)
+        {
+            line = ldisc_input(&ldisc, c);
+        }
+        while (!line && (c = serial_getc()) != -1)
+        {
+            if (serial_line)
+            {
+                line = ldisc_input(&ldisc, c);
+            }
+            else if (c == SHELL_SERIAL_LINE)
+            {
+                serial_putc(SHELL_SERIAL_LINE);
+                serial_line = 1;
+            }
+            else if (!memstat_command(c) && !trace_command(c))
+            {
+                profile_command(c);
+            }
+        }
+
+        if (line)
+        {
+            serial_line = 0;
+            shell_execute(ldisc.line);
+            tty_put_str(SHELL_PROMPT);
+            continue;
+        }
+        kthread_yield();
+
+        local_irq_disable();
+        if (serial_rx_ready() || keyboard_pending())
+        {
+            local_irq_enable();
+        }
+        else
+        {
+            cpu_idle();
+        }
+    }
+}
@@ -34,6 +34,13 @@ void tty_put_char(char chr)
     {
         TTY_COLUMN = 0;
     }
+    else if (chr == '\b')
+    {
+        if (TTY_COLUMN > 0)
+        {
+            TTY_COLUMN--;
+        }
+    }
     else
     {
         *(buffer + TTY_COLUMN + TTY_ROW * TTY_WIDTH) = (theme_color | chr);
@@ -48,7 +55,6 @@ void tty_put_char(char chr)
     if (TTY_ROW >= TTY_HEIGHT)
     {
         tty_scroll_up();
-        TTY_ROW--;
     }
 }
 
@@ -0,0 +1,106 @@
+#include <kernel/user/elf.h>
+
+/**
+ * @brief Checks that a header describes a static 32-bit x86 executable
+ *        whose program headers lie inside the file.
+ *
+ * @return 0 if the executable can be loaded, -1 otherwise.
+ */
+int elf_check_header(const elf32_ehdr_t* header, uint64_t file_size)
+{
+    if (file_size < sizeof(elf32_ehdr_t) || header->magic != ELF_MAGIC)
+    {
+        return -1;
+    }
+    if (header->class != ELF_CLASS_32 || header->data != ELF_DATA_LSB ||
+        header->type != ELF_TYPE_EXEC || header->machine != ELF_MACHINE_386)
+    {
+        return -1;
+    }
+    if (header->phentsize != sizeof(elf32_phdr_t) || header->phnum == 0 || header->phnum > ELF_MAX_PHDRS)
+    {
+        return -1;
+    }
+    if ((uint64_t)header->phoff + header->phnum * sizeof(elf32_phdr_t) > file_size)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks that a loadable segment lies inside the file and inside
+ *        the user range below `limit`.
+ *
+ * @return 0 if the segment can be loaded, -1 otherwise.
+ */
+int elf_check_segment(const elf32_phdr_t* phdr, uint64_t file_size, uintptr_t limit)
+{
+    if (phdr->filesz > phdr->memsz || (uint64_t)phdr->offset + phdr->filesz > file_size)
+    {
+        return -1;
+    }
+    if (phdr->vaddr < USER_SPACE_START || phdr->memsz > limit - phdr->vaddr || phdr->vaddr >= limit)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reserves the user range of an executable's segments.
+ *
+ * Only the headers are read here. Each loadable segment becomes an area
+ * backed by the file, and its pages are filled in by vma_fault() when the
+ * program first touches them, so starting a program costs the same
+ * whatever the size of the file. Segments may not share a page.
+ *
+ * @param inode The executable.
+ * @param limit Segments must end at or below this address.
+ * @param vmas The areas of the program, extended by one per segment.
+ * @param entry Receives the entry point.
+ *
+ * @return 0 on success, -1 if the file is not a loadable executable or memory ran out.
+ */
+int elf_load(inode_t* inode, uintptr_t limit, vma_t** vmas, uint32_t* entry)
+{
+    elf32_ehdr_t header;
+    if (file_read(inode, 0, &header, sizeof(header)) != sizeof(header) ||
+        elf_check_header(&header, inode->size) != 0)
+    {
+        kprintf("elf: not a 32-bit x86 executable\n");
+        return -1;
+    }
+
+    elf32_phdr_t phdrs[ELF_MAX_PHDRS];
+    size_t phdrs_size = header.phnum * sizeof(elf32_phdr_t);
+    if (file_read(inode, header.phoff, phdrs, phdrs_size) != phdrs_size)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < header.phnum; i++)
+    {
+        elf32_phdr_t* phdr = &phdrs[i];
+        if (phdr->type != ELF_PT_LOAD || phdr->memsz == 0)
+        {
+            continue;
+        }
+
+        if (elf_check_segment(phdr, inode->size, limit) != 0)
+        {
+            kprintf("elf: segment at %x does not fit the user range\n", phdr->vaddr);
+            return -1;
+        }
+
+        pte_t flags = (phdr->flags & ELF_PF_W ? PG_WRITE : 0) | (phdr->flags & ELF_PF_X ? 0 : PG_NX);
+        if (vma_map_file(vmas, phdr->vaddr, phdr->memsz, flags, inode, phdr->offset, phdr->filesz) != 0)
+        {
+            kprintf("elf: segment at %x overlaps another one\n", phdr->vaddr);
+            return -1;
+        }
+    }
+
+    *entry = header.entry;
+    return 0;
+}
@@ -0,0 +1,283 @@
+#include <kernel/user/ipc.h>
+#include <kernel/user/process.h>
+
+static ipc_port_t ipc_ports[IPC_MAX_PORTS];
+static spinlock_t ipc_lock = SPINLOCK_INIT;
+static ipc_stats_t ipc_stats;
+
+/**
+ * @brief Returns the open port with the given id. Called with ipc_lock held.
+ */
+static ipc_port_t* ipc_find(uint32_t id)
+{
+    ipc_port_t* port = &ipc_ports[id % IPC_MAX_PORTS];
+    return port->open && port->id == id ? port : NULL;
+}
+
+/**
+ * @brief Completes a message and lets its sender return.
+ *
+ * The message lives on the sender's stack, so it is not touched afterwards.
+ */
+static void ipc_finish(ipc_message_t* msg, int status)
+{
+    kthread_t* thread = msg->thread;
+    msg->status = status;
+    if (status != 0)
+    {
+        ipc_stats.refused++;
+    }
+    __atomic_store_n(&msg->done, 1, __ATOMIC_RELEASE);
+    kthread_wake(thread);
+}
+
+/**
+ * @brief Opens a port.
+ *
+ * A slot's id grows by IPC_MAX_PORTS each time it is reused, so an id
+ * always maps to its slot and a closed one never finds a newer port.
+ *
+ * @param owner The program whose exit closes the port, NULL for the kernel.
+ *
+ * @return The port id, or -1 if every slot is taken.
+ */
+int ipc_port_create(struct process* owner)
+{
+    spin_lock(&ipc_lock);
+    for (uint32_t i = 0; i < IPC_MAX_PORTS; i++)
+    {
+        ipc_port_t* port = &ipc_ports[i];
+        if (port->open)
+        {
+            continue;
+        }
+
+        port->id = (port->id != 0 ? port->id : i) + IPC_MAX_PORTS;
+        port->open = 1;
+        port->owner = owner;
+        port->head = NULL;
+        port->tail = NULL;
+        port->receiver = NULL;
+        spin_unlock(&ipc_lock);
+        return (int)port->id;
+    }
+    spin_unlock(&ipc_lock);
+    return -1;
+}
+
+/**
+ * @brief Closes a port: waiting senders get -1 and their pages back, and a
+ *        waiting receiver returns -1.
+ */
+void ipc_port_close(uint32_t id)
+{
+    spin_lock(&ipc_lock);
+    ipc_port_t* port = ipc_find(id);
+    if (port == NULL)
+    {
+        spin_unlock(&ipc_lock);
+        return;
+    }
+
+    ipc_message_t* msg = port->head;
+    kthread_t* receiver = port->receiver;
+    port->open = 0;
+    port->owner = NULL;
+    port->head = NULL;
+    port->tail = NULL;
+    port->receiver = NULL;
+    spin_unlock(&ipc_lock);
+
+    while (msg != NULL)
+    {
+        ipc_message_t* next = msg->next;
+        ipc_finish(msg, -1);
+        msg = next;
+    }
+    kthread_wake(receiver);
+}
+
+/**
+ * @brief Sends a message and sleeps until a receiver has taken it.
+ *
+ * The pages are taken out of the sender's address space before it sleeps,
+ * in one batch, and only their frame numbers travel with the message. If
+ * the message is refused they are mapped back where they were.
+ *
+ * @param words IPC_WORDS words.
+ * @param pages Page aligned start of the pages to move, in the current program.
+ * @param count Pages to move; only programs can move pages, not kernel threads.
+ *
+ * @return 0 once received, -1 if the port is closed, the message refused or
+ *         the pages unusable.
+ */
+int ipc_send(uint32_t id, const uint32_t* words, uintptr_t pages, uint32_t count)
+{
+    process_t* process = process_current();
+    if (count > IPC_MAX_PAGES || (count != 0 && process == NULL))
+    {
+        return -1;
+    }
+
+    ipc_message_t msg;
+    memcpy(msg.words, words, sizeof(msg.words));
+    msg.count = count;
+    msg.sender = process != NULL ? process->pid : 0;
+    msg.thread = kthread_current();
+    msg.done = 0;
+    msg.status = -1;
+    msg.next = NULL;
+
+    // Not worth taking the pages out for a port that is already gone
+    spin_lock(&ipc_lock);
+    int open = ipc_find(id) != NULL;
+    spin_unlock(&ipc_lock);
+    if (!open || (count != 0 && vma_detach_pages(process->vmas, pages, count, msg.frames) != 0))
+    {
+        return -1;
+    }
+
+    spin_lock(&ipc_lock);
+    ipc_port_t* port = ipc_find(id);
+    kthread_t* receiver = NULL;
+    if (port != NULL)
+    {
+        if (port->tail != NULL)
+        {
+            port->tail->next = &msg;
+        }
+        else
+        {
+            port->head = &msg;
+        }
+        port->tail = &msg;
+        receiver = port->receiver;
+        port->receiver = NULL;
+    }
+    spin_unlock(&ipc_lock);
+
+    if (port != NULL)
+    {
+        kthread_wake(receiver);
+        while (!__atomic_load_n(&msg.done, __ATOMIC_ACQUIRE))
+        {
+            kthread_sleep();
+        }
+        if (msg.status == 0)
+        {
+            return 0;
+        }
+    }
+
+    if (count != 0)
+    {
+        vma_attach_pages(process->vmas, pages, count, msg.frames);
+    }
+    return -1;
+}
+
+/**
+ * @brief Sleeps until a message arrives on a port and takes it.
+ *
+ * The message's pages are mapped over the window in one batch; messages
+ * with more pages than `max` are refused and the next one is tried.
+ *
+ * @param window Page aligned start of the range receiving the pages, in the current program.
+ * @param max Pages the window holds.
+ * @param words Receives IPC_WORDS words.
+ * @param sender Receives the sender's pid, 0 for a kernel thread.
+ *
+ * @return The number of pages received, or -1 if the port is closed,
+ *         another thread is receiving on it, or the window is unusable.
+ */
+int ipc_recv(uint32_t id, uintptr_t window, uint32_t max, uint32_t* words, uint32_t* sender)
+{
+    process_t* process = process_current();
+    kthread_t* self = kthread_current();
+    if (max > IPC_MAX_PAGES)
+    {
+        max = IPC_MAX_PAGES;
+    }
+    if (process == NULL)
+    {
+        max = 0;
+    }
+
+    ipc_message_t* msg;
+    spin_lock(&ipc_lock);
+    for (;;)
+    {
+        ipc_port_t* port = ipc_find(id);
+        if (port == NULL || (port->receiver != NULL && port->receiver != self))
+        {
+            spin_unlock(&ipc_lock);
+            return -1;
+        }
+
+        msg = port->head;
+        if (msg != NULL)
+        {
+            port->head = msg->next;
+            if (port->head == NULL)
+            {
+                port->tail = NULL;
+            }
+            if (msg->count <= max)
+            {
+                break;
+            }
+            ipc_finish(msg, -1);
+            continue;
+        }
+
+        port->receiver = self;
+        spin_unlock(&ipc_lock);
+        kthread_sleep();
+        spin_lock(&ipc_lock);
+
+        port = ipc_find(id);
+        if (port != NULL && port->receiver == self)
+        {
+            port->receiver = NULL;
+        }
+    }
+    spin_unlock(&ipc_lock);
+
+    if (msg->count != 0 && vma_attach_pages(process->vmas, window, msg->count, msg->frames) != 0)
+    {
+        ipc_finish(msg, -1);
+        return -1;
+    }
+
+    int count = (int)msg->count;
+    memcpy(words, msg->words, sizeof(msg->words));
+    *sender = msg->sender;
+    ipc_stats.messages++;
+    ipc_stats.pages += count;
+    ipc_finish(msg, 0);
+    return count;
+}
+
+/**
+ * @brief Closes every port an exiting program created.
+ */
+void ipc_exit(struct process* process)
+{
+    for (uint32_t i = 0; i < IPC_MAX_PORTS; i++)
+    {
+        spin_lock(&ipc_lock);
+        uint32_t id = ipc_ports[i].id;
+        int owned = ipc_ports[i].open && ipc_ports[i].owner == process;
+        spin_unlock(&ipc_lock);
+
+        if (owned)
+        {
+            ipc_port_close(id);
+        }
+    }
+}
+
+void ipc_get_stats(ipc_stats_t* stats)
+{
+    *stats = ipc_stats;
+}
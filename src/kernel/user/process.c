@@ -0,0 +1,327 @@
+#include <kernel/user/process.h>
+
+// Every process not yet waited for, newest first
+static process_t* process_list = NULL;
+static uint32_t process_next_pid = 1;
+static spinlock_t process_lock = SPINLOCK_INIT;
+
+/**
+ * @brief Thread body of a program: drops to ring 3 and never comes back.
+ *
+ * The switch to this thread loaded the program's address space, so the
+ * vDSO is mapped into it here. The thread leaves the kernel for good
+ * through process_exit().
+ */
+static void process_thread(void* arg)
+{
+    process_t* process = (process_t*)arg;
+    kthread_t* self = kthread_current();
+
+    vdso_map();
+    tss_set_kernel_stack((uint32_t)self->stack + KTHREAD_STACK_SIZE);
+    user_enter(process->entry, USER_STACK_TOP, process->arg);
+}
+
+static void process_unlink(process_t* process)
+{
+    spin_lock(&process_lock);
+    process_t** link = &process_list;
+    while (*link != process)
+    {
+        link = &(*link)->next;
+    }
+    *link = process->next;
+    spin_unlock(&process_lock);
+}
+
+/**
+ * @brief Loads an executable and starts it on a thread of its own, in an
+ *        address space of its own.
+ *
+ * @param path The executable, looked up through the VFS.
+ * @param arg Passed to the program's main().
+ *
+ * @return The process, or NULL if it could not be started.
+ */
+process_t* process_spawn(const char* path, uint32_t arg)
+{
+    inode_t* inode = vfs_lookup(path);
+    if (inode == NULL)
+    {
+        kprintf("process: %s not found\n", path);
+        return NULL;
+    }
+
+    const char* name = path;
+    for (const char* p = path; *p != '\0'; p++)
+    {
+        if (*p == '/')
+        {
+            name = p + 1;
+        }
+    }
+    return process_spawn_inode(inode, name, arg);
+}
+
+/**
+ * @brief Starts the executable `inode` as process_spawn() does.
+ *
+ * Only the ELF headers are read; the program's pages, and its stack, are
+ * filled in as it touches them, see process_page_fault(). The program first
+ * runs when the caller yields or sleeps, for example in process_wait().
+ *
+ * @param name The program's name, cut to PROCESS_NAME_MAX - 1 characters.
+ *
+ * @return The process, or NULL if it could not be started.
+ */
+process_t* process_spawn_inode(inode_t* inode, const char* name, uint32_t arg)
+{
+    process_t* process = (process_t*)kmalloc(sizeof(process_t));
+    if (process == NULL)
+    {
+        return NULL;
+    }
+    memset(process, 0, sizeof(process_t));
+
+    size_t len = strlen(name);
+    if (len >= PROCESS_NAME_MAX)
+    {
+        len = PROCESS_NAME_MAX - 1;
+    }
+    memcpy(process->name, name, len);
+    process->arg = arg;
+
+    // The areas are only recorded here; nothing is mapped until the program runs
+    process->space = address_space_create();
+    if (process->space == NULL ||
+        elf_load(inode, USER_IMAGE_END, &process->vmas, &process->entry) != 0 ||
+        vma_map_anon(&process->vmas, USER_STACK_TOP - USER_STACK_SIZE, USER_STACK_SIZE, PG_WRITE | PG_NX) != 0)
+    {
+        kprintf("process: could not load %s\n", name);
+        goto fail;
+    }
+
+    process->thread = kthread_create(process_thread, process, process->name);
+    if (process->thread == NULL)
+    {
+        goto fail;
+    }
+    process->thread->space = process->space;
+    process->thread->process = process;
+    process->parent = process_current();
+
+    spin_lock(&process_lock);
+    process->pid = process_next_pid++;
+    process->next = process_list;
+    process_list = process;
+    spin_unlock(&process_lock);
+    return process;
+
+fail:
+    // Nothing was mapped yet, and the loaded address space is the caller's
+    vma_free_all(&process->vmas);
+    if (process->space != NULL)
+    {
+        address_space_destroy(process->space);
+    }
+    kfree(process);
+    return NULL;
+}
+
+/**
+ * @brief Sleeps until a program exits, then frees the process.
+ *
+ * Each process is waited for once, by the kernel code or the program that
+ * spawned it.
+ *
+ * @return The program's exit code, -1 if it was killed by an exception.
+ */
+int process_wait(process_t* process)
+{
+    while (!__atomic_load_n(&process->exited, __ATOMIC_SEQ_CST))
+    {
+        futex_wait(&process->exited, 0);
+    }
+
+    int code = process->exit_code;
+    process_unlink(process);
+    kfree(process);
+    return code;
+}
+
+/**
+ * @brief Looks up a child of `parent` that has not been waited for.
+ *
+ * @return The child, or NULL if `pid` is not one.
+ */
+process_t* process_find_child(process_t* parent, uint32_t pid)
+{
+    spin_lock(&process_lock);
+    process_t* process = process_list;
+    while (process != NULL && (process->pid != pid || process->parent != parent))
+    {
+        process = process->next;
+    }
+    spin_unlock(&process_lock);
+    return process;
+}
+
+/**
+ * @brief Returns the program the current thread runs, NULL on a kernel thread.
+ */
+process_t* process_current()
+{
+    kthread_t* self = kthread_current();
+    return self != NULL ? self->process : NULL;
+}
+
+/**
+ * @brief Hands the children of an exiting program over to nobody.
+ *
+ * Children that already exited are freed; the others free themselves when
+ * they exit.
+ */
+static void process_orphan_children(process_t* parent)
+{
+    process_t* reap = NULL;
+
+    spin_lock(&process_lock);
+    process_t** link = &process_list;
+    while (*link != NULL)
+    {
+        process_t* process = *link;
+        if (process->parent != parent)
+        {
+            link = &process->next;
+            continue;
+        }
+
+        process->parent = NULL;
+        if (__atomic_load_n(&process->exited, __ATOMIC_SEQ_CST))
+        {
+            *link = process->next;
+            process->next = reap;
+            reap = process;
+            continue;
+        }
+        process->detached = 1;
+        link = &process->next;
+    }
+    spin_unlock(&process_lock);
+
+    while (reap != NULL)
+    {
+        process_t* next = reap->next;
+        kfree(reap);
+        reap = next;
+    }
+}
+
+/**
+ * @brief Ends the running program from its own thread, in a system call or exception.
+ *
+ * Closes its ports, frees its memory and address space, and wakes the
+ * waiter. The thread finishes on the kernel's address space and exits; its
+ * kernel stack is freed by the next thread to run.
+ */
+void process_exit(int code)
+{
+    process_t* process = process_current();
+    kthread_t* self = kthread_current();
+
+    local_irq_enable();
+    ipc_exit(process);
+    vma_unmap_all(&process->vmas);
+
+    self->space = NULL;
+    self->process = NULL;
+    address_space_switch(NULL);
+    address_space_destroy(process->space);
+    process->space = NULL;
+
+    process_orphan_children(process);
+    process->exit_code = code;
+
+    spin_lock(&process_lock);
+    int detached = process->detached;
+    spin_unlock(&process_lock);
+
+    if (detached)
+    {
+        process_unlink(process);
+        kfree(process);
+    }
+    else
+    {
+        __atomic_store_n(&process->exited, 1, __ATOMIC_SEQ_CST);
+        futex_wake(&process->exited, FUTEX_WAKE_ALL);
+    }
+    kthread_exit();
+
+    // The boot thread never runs user code, so kthread_exit() does not return
+    for (;;)
+    {
+        kthread_sleep();
+    }
+}
+
+/**
+ * @brief Page fault handler: fills in pages of the running program on first touch.
+ *
+ * Faults on the program's areas are resolved with interrupts enabled if the
+ * faulting code had them enabled, since filling a page may wait for the
+ * disk. Any other fault kills the program if it came from ring 3, and
+ * halts otherwise.
+ */
+void process_page_fault(interrupt_frame_t* frame)
+{
+    uint32_t cr2;
+    asm volatile("mov %%cr2, %0" : "=r"(cr2));
+
+    process_t* process = process_current();
+    if (process != NULL && cr2 >= USER_SPACE_START && cr2 < USER_SPACE_END)
+    {
+        if (frame->eflags & EFLAGS_IF)
+        {
+            local_irq_enable();
+        }
+        int result = vma_fault(process->vmas, cr2, frame->error);
+        local_irq_disable();
+
+        if (result == 0)
+        {
+            return;
+        }
+    }
+
+    if (frame->error & PF_ERROR_FETCH)
+    {
+        kprintf("Instruction fetch from non-executable page %x\n", cr2);
+    }
+    if (FRAME_FROM_USER(frame))
+    {
+        process_fault(frame);
+    }
+    exception_panic(frame);
+}
+
+/**
+ * @brief Kills the running program after an exception it raised in ring 3.
+ *
+ * Returns only on a kernel thread; the exception then halts as in the kernel.
+ */
+void process_fault(interrupt_frame_t* frame)
+{
+    process_t* process = process_current();
+    if (process == NULL)
+    {
+        return;
+    }
+
+    uint32_t cr2;
+    asm volatile("mov %%cr2, %0" : "=r"(cr2));
+
+    kprintf("process: %s killed by exception %d, error %x at eip %x, cr2 %x\n",
+            process->name, frame->vector, frame->error, frame->eip, cr2);
+    process_exit(-1);
+}
@@ -0,0 +1,253 @@
+#include <kernel/user/syscall.h>
+#include <kernel/user/process.h>
+#include <kernel/init.h>
+
+// Entry points in entry.S
+extern uint8_t syscall_int80_entry[];
+extern uint8_t syscall_sysenter_entry[];
+
+static int syscall_sysenter = 0;
+static syscall_stats_t syscall_stats;
+
+/**
+ * @brief Returns nonzero if every page of a user buffer is mapped for user
+ *        mode, and writable if `write` is set.
+ *
+ * Pages of the program not touched yet are filled in here, so the kernel
+ * never faults on them. Only the program's own thread changes its
+ * mappings, so the answer holds until the system call returns.
+ */
+int user_access_ok(uintptr_t addr, size_t size, int write)
+{
+    if (addr < USER_SPACE_START || addr >= USER_SPACE_END || size > USER_SPACE_END - addr)
+    {
+        return 0;
+    }
+
+    pte_t required = PG_PRESENT | PG_ALLOW_USER | (write ? PG_WRITE : 0);
+    uintptr_t end = addr + size;
+    for (uintptr_t page = addr & ~(PAGE_SIZE - 1); page < end; page += PAGE_SIZE)
+    {
+        pte_t* pte = get_pte(page, 0);
+        if (pte != NULL && (*pte & required) == required)
+        {
+            continue;
+        }
+
+        // As the CPU would report it: a page that is mapped without the access is a protection fault
+        uint32_t error = PF_ERROR_USER | (write ? PF_ERROR_WRITE : 0) |
+                         (pte != NULL && (*pte & PG_PRESENT) ? PF_ERROR_PRESENT : 0);
+        process_t* process = process_current();
+        if (process == NULL || vma_fault(process->vmas, page, error) != 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Copies a NUL-terminated string out of user memory.
+ *
+ * @return 0 on success, -1 if it is not readable or does not fit `size` bytes.
+ */
+static int user_copy_string(char* dest, uintptr_t src, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        if ((i == 0 || ((src + i) & (PAGE_SIZE - 1)) == 0) && !user_access_ok(src + i, 1, 0))
+        {
+            return -1;
+        }
+        dest[i] = ((const char*)src)[i];
+        if (dest[i] == '\0')
+        {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Returns the frame the current program entered the kernel with.
+ *
+ * Both entry paths build it at the top of the thread's kernel stack, which
+ * is where the TSS and the SYSENTER MSR point for a program's thread.
+ */
+static interrupt_frame_t* syscall_user_frame()
+{
+    return (interrupt_frame_t*)((uintptr_t)kthread_current()->stack + KTHREAD_STACK_SIZE) - 1;
+}
+
+static int32_t sys_exit(uint32_t code, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5)
+{
+    (void)arg2, (void)arg3, (void)arg4, (void)arg5;
+    process_exit((int)code);
+}
+
+static int32_t sys_write(uint32_t buf, uint32_t len, uint32_t arg3, uint32_t arg4, uint32_t arg5)
+{
+    (void)arg3, (void)arg4, (void)arg5;
+    if (!user_access_ok(buf, len, 0))
+    {
+        return -1;
+    }
+
+    char chunk[SYSCALL_WRITE_CHUNK + 1];
+    const char* src = (const char*)buf;
+    for (uint32_t done = 0; done < len; )
+    {
+        uint32_t size = len - done < SYSCALL_WRITE_CHUNK ? len - done : SYSCALL_WRITE_CHUNK;
+        memcpy(chunk, src + done, size);
+        chunk[size] = '\0';
+        kprintf("%s", chunk);
+        done += size;
+    }
+    return (int32_t)len;
+}
+
+static int32_t sys_yield(uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5)
+{
+    (void)arg1, (void)arg2, (void)arg3, (void)arg4, (void)arg5;
+    kthread_yield();
+    return 0;
+}
+
+static int32_t sys_sleep(uint32_t ms, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5)
+{
+    (void)arg2, (void)arg3, (void)arg4, (void)arg5;
+    timer_sleep_ms(ms);
+    return 0;
+}
+
+static int32_t sys_null(uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5)
+{
+    (void)arg1, (void)arg2, (void)arg3, (void)arg4, (void)arg5;
+    return 0;
+}
+
+static int32_t sys_spawn(uint32_t path, uint32_t arg, uint32_t arg3, uint32_t arg4, uint32_t arg5)
+{
+    (void)arg3, (void)arg4, (void)arg5;
+    char buffer[PROCESS_PATH_MAX];
+    if (user_copy_string(buffer, path, sizeof(buffer)) != 0)
+    {
+        return -1;
+    }
+
+    process_t* child = process_spawn(buffer, arg);
+    return child != NULL ? (int32_t)child->pid : -1;
+}
+
+static int32_t sys_wait(uint32_t pid, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5)
+{
+    (void)arg2, (void)arg3, (void)arg4, (void)arg5;
+    process_t* child = process_find_child(process_current(), pid);
+    return child != NULL ? process_wait(child) : -1;
+}
+
+static int32_t sys_port(uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5)
+{
+    (void)arg1, (void)arg2, (void)arg3, (void)arg4, (void)arg5;
+    return ipc_port_create(process_current());
+}
+
+static int32_t sys_send(uint32_t port, uint32_t word0, uint32_t word1, uint32_t pages, uint32_t count)
+{
+    uint32_t words[IPC_WORDS] = { word0, word1 };
+    return ipc_send(port, words, pages, count);
+}
+
+static int32_t sys_recv(uint32_t port, uint32_t window, uint32_t max, uint32_t arg4, uint32_t arg5)
+{
+    (void)arg4, (void)arg5;
+    uint32_t words[IPC_WORDS];
+    uint32_t sender;
+
+    int32_t count = ipc_recv(port, window, max, words, &sender);
+    if (count >= 0)
+    {
+        // ecx and edx carry the user eip and esp back through sysexit, so
+        // the message returns in registers both paths restore
+        interrupt_frame_t* frame = syscall_user_frame();
+        frame->ebx = words[0];
+        frame->esi = words[1];
+        frame->edi = sender;
+    }
+    return count;
+}
+
+static const syscall_fn_t syscall_table[SYS_COUNT] = {
+    [SYS_EXIT] = sys_exit,
+    [SYS_WRITE] = sys_write,
+    [SYS_YIELD] = sys_yield,
+    [SYS_SLEEP] = sys_sleep,
+    [SYS_NULL] = sys_null,
+    [SYS_SPAWN] = sys_spawn,
+    [SYS_WAIT] = sys_wait,
+    [SYS_PORT] = sys_port,
+    [SYS_SEND] = sys_send,
+    [SYS_RECV] = sys_recv,
+};
+
+/**
+ * @brief Opens the int 0x80 gate, points sysenter at the kernel if the CPU
+ *        has it, and maps the vDSO. Needs the timers.
+ */
+void syscall_init()
+{
+    idt_set_user_gate(SYSCALL_VECTOR, (uintptr_t)syscall_int80_entry);
+    idt_set_user_exception_handler(process_fault);
+    idt_register_handler(PAGE_FAULT_VECTOR, process_page_fault);
+
+    if (gdt_sysenter_supported())
+    {
+        tss_enable_sysenter((uintptr_t)syscall_sysenter_entry);
+        syscall_sysenter = 1;
+    }
+    vdso_init(syscall_sysenter);
+
+    kprintf("syscall: %s, int 0x80 fallback\n", syscall_sysenter ? "sysenter" : "no sysenter");
+}
+INITCALL(INIT_SUBSYS, syscall_init, NULL);
+
+int syscall_sysenter_enabled()
+{
+    return syscall_sysenter;
+}
+
+/**
+ * @brief Common C entry for both system call paths, called from entry.S.
+ *
+ * Calls run with interrupts enabled and may sleep; the result replaces the
+ * saved eax.
+ */
+void syscall_dispatch(interrupt_frame_t* frame)
+{
+    local_irq_enable();
+
+    uint32_t nr = frame->eax;
+    syscall_stats.calls++;
+    if (frame->eip == sysenter_return)
+    {
+        syscall_stats.sysenter++;
+    }
+
+    int32_t result = -1;
+    if (nr < SYS_COUNT)
+    {
+        result = syscall_table[nr](frame->ebx, frame->ecx, frame->edx, frame->esi, frame->edi);
+    }
+    else
+    {
+        syscall_stats.invalid++;
+    }
+    frame->eax = (uint32_t)result;
+
+    local_irq_disable();
+}
+
+void syscall_get_stats(syscall_stats_t* stats)
+{
+    *stats = syscall_stats;
+}
@@ -0,0 +1,80 @@
+#include <kernel/user/vdso.h>
+
+// The stubs in vdso.S, copied into the text page
+extern uint8_t vdso_text_start[];
+extern uint8_t vdso_text_end[];
+extern uint8_t vdso_sysenter[];
+extern uint8_t vdso_sysenter_return[];
+extern uint8_t vdso_int80[];
+
+// Kernel view of the data page; user code sees it read-only at VDSO_DATA_ADDR
+static vdso_data_t* vdso_data = NULL;
+
+// Frames of the two pages, mapped into every address space
+static phys_addr_t vdso_text_frame = 0;
+static phys_addr_t vdso_data_frame = 0;
+
+// Address of a vdso.S symbol in the user mapping
+#define VDSO_USER_ADDR(symbol) (VDSO_TEXT_ADDR + (uint32_t)((symbol) - vdso_text_start))
+
+/**
+ * @brief Builds the vDSO pages and maps them read-only into the user range
+ *        of the kernel's address space.
+ *
+ * Programs get the same pages at the same addresses, see vdso_map(). Needs
+ * the timers, for the clock parameters.
+ *
+ * @param sysenter Nonzero if system calls should enter through sysenter.
+ */
+void vdso_init(int sysenter)
+{
+    uint8_t* text = (uint8_t*)vmalloc(PAGE_SIZE);
+    vdso_data = (vdso_data_t*)vmalloc(PAGE_SIZE);
+    if (text == NULL || vdso_data == NULL)
+    {
+        kprintf("vdso: out of memory\n");
+        vdso_data = NULL;
+        return;
+    }
+
+    memset(text, 0, PAGE_SIZE);
+    memcpy(text, vdso_text_start, vdso_text_end - vdso_text_start);
+
+    memset(vdso_data, 0, PAGE_SIZE);
+    vdso_data->version = VDSO_VERSION;
+    vdso_data->int80_entry = VDSO_USER_ADDR(vdso_int80);
+    vdso_data->syscall_entry = sysenter ? VDSO_USER_ADDR(vdso_sysenter) : vdso_data->int80_entry;
+    vdso_data->tsc_khz = tsc_khz;
+    vdso_data->hz = TIMER_HZ;
+    timer_get_clock(&vdso_data->tsc_base, &vdso_data->tsc_per_jiffy);
+
+    sysenter_return = VDSO_USER_ADDR(vdso_sysenter_return);
+
+    vdso_text_frame = virt_to_phys((uintptr_t)text);
+    vdso_data_frame = virt_to_phys((uintptr_t)vdso_data);
+    vdso_map();
+}
+
+/**
+ * @brief Maps the vDSO pages read-only into the running address space.
+ *
+ * The frames belong to the kernel; the page table they end up in is freed
+ * with the address space, never the frames.
+ */
+void vdso_map()
+{
+    if (vdso_data == NULL)
+    {
+        return;
+    }
+    map_page(VDSO_TEXT_ADDR, vdso_text_frame, PG_PRESENT | PG_ALLOW_USER);
+    map_page(VDSO_DATA_ADDR, vdso_data_frame, PG_PRESENT | PG_ALLOW_USER | PG_NX);
+}
+
+/**
+ * @brief Returns the kernel's view of the data page, NULL before vdso_init().
+ */
+const vdso_data_t* vdso_get_data()
+{
+    return vdso_data;
+}
@@ -0,0 +1,401 @@
+#include <kernel/user/vma.h>
+
+static vma_stats_t vma_stats;
+
+/**
+ * @brief Links a new area into the sorted list.
+ *
+ * @return 0 on success, -1 if it overlaps an existing area.
+ */
+static int vma_insert(vma_t** vmas, vma_t* vma)
+{
+    vma_t** link = vmas;
+    while (*link != NULL && (*link)->end <= vma->start)
+    {
+        link = &(*link)->next;
+    }
+    if (*link != NULL && (*link)->start < vma->end)
+    {
+        return -1;
+    }
+
+    vma->next = *link;
+    *link = vma;
+    return 0;
+}
+
+/**
+ * @brief Reserves [start, start + size) for a file mapping, as for an ELF segment.
+ *
+ * The first `file_size` bytes come from the file at `offset`; the rest of
+ * the area, and the part of the first page before `start`, read as zero.
+ * Nothing is read or mapped until the pages are touched.
+ *
+ * @param flags PG_WRITE and PG_NX; writes go to private copies, never to the file.
+ *
+ * @return 0 on success, -1 if the range overlaps another area or memory ran out.
+ */
+int vma_map_file(vma_t** vmas, uintptr_t start, size_t size, pte_t flags,
+                 inode_t* inode, uint64_t offset, size_t file_size)
+{
+    vma_t* vma = (vma_t*)kmalloc(sizeof(vma_t));
+    if (vma == NULL)
+    {
+        return -1;
+    }
+
+    vma->start = start & ~(PAGE_SIZE - 1);
+    vma->end = (start + size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    vma->flags = flags & (PG_WRITE | PG_NX);
+    vma->inode = inode;
+    vma->file_start = start;
+    vma->file_end = start + file_size;
+    vma->offset = offset;
+    vma->pages = NULL;
+
+    if (inode != NULL && file_size != 0)
+    {
+        size_t pages_size = (vma->end - vma->start) / PAGE_SIZE * sizeof(page_t*);
+        vma->pages = (page_t**)kmalloc(pages_size);
+        if (vma->pages == NULL)
+        {
+            kfree(vma);
+            return -1;
+        }
+        memset(vma->pages, 0, pages_size);
+    }
+
+    if (vma_insert(vmas, vma) != 0)
+    {
+        kfree(vma->pages);
+        kfree(vma);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reserves [start, start + size) for zero-filled memory.
+ */
+int vma_map_anon(vma_t** vmas, uintptr_t start, size_t size, pte_t flags)
+{
+    return vma_map_file(vmas, start, size, flags, NULL, 0, 0);
+}
+
+vma_t* vma_find(vma_t* vmas, uintptr_t addr)
+{
+    for (vma_t* vma = vmas; vma != NULL && vma->start <= addr; vma = vma->next)
+    {
+        if (addr < vma->end)
+        {
+            return vma;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns nonzero if the page at `addr` is a whole, page aligned page
+ *        of the file, which can be mapped straight from the page cache.
+ */
+static int vma_can_share(const vma_t* vma, uintptr_t addr)
+{
+    return vma->pages != NULL && addr >= vma->file_start && addr + PAGE_SIZE <= vma->file_end &&
+        ((vma->offset + (addr - vma->file_start)) & (PAGE_SIZE - 1)) == 0;
+}
+
+static pte_t vma_page_flags(const vma_t* vma, int writable)
+{
+    return PG_PRESENT | PG_ALLOW_USER | (writable ? PG_WRITE : 0) | (vma->flags & PG_NX);
+}
+
+/**
+ * @brief Maps a page cache frame in place, read-only even in a writable area.
+ *
+ * The first write copies it, see vma_cow().
+ */
+static int vma_map_shared(vma_t* vma, uintptr_t addr)
+{
+    uint64_t offset = vma->offset + (addr - vma->file_start);
+    page_t* page = page_cache_get(vma->inode, offset / PAGE_SIZE);
+    if (page == NULL)
+    {
+        return -1;
+    }
+
+    vma->pages[(addr - vma->start) / PAGE_SIZE] = page;
+    map_page(addr, page->phys, vma_page_flags(vma, 0));
+    vma_stats.shared++;
+    return 0;
+}
+
+/**
+ * @brief Backs a page with a fresh frame holding the file bytes that fall
+ *        into it, and zeroes everywhere else.
+ *
+ * The frame is filled through a kernel-only mapping at its final address,
+ * so the program never sees it half written.
+ */
+static int vma_map_private(vma_t* vma, uintptr_t addr)
+{
+    phys_addr_t frame = alloc_highmem_page();
+    if (frame == 0)
+    {
+        return -1;
+    }
+
+    map_page(addr, frame, PG_PRESENT | PG_WRITE | PG_NX);
+    memset((void*)addr, 0, PAGE_SIZE);
+
+    uintptr_t copy_start = addr > vma->file_start ? addr : vma->file_start;
+    uintptr_t copy_end = addr + PAGE_SIZE < vma->file_end ? addr + PAGE_SIZE : vma->file_end;
+    if (vma->inode != NULL && copy_start < copy_end)
+    {
+        size_t size = copy_end - copy_start;
+        if (file_read(vma->inode, vma->offset + (copy_start - vma->file_start), (void*)copy_start, size) != size)
+        {
+            unmap_page(addr);
+            free_highmem_page(frame);
+            return -1;
+        }
+    }
+
+    protect_range(addr, PAGE_SIZE, vma_page_flags(vma, vma->flags & PG_WRITE));
+    vma_stats.private++;
+    return 0;
+}
+
+/**
+ * @brief Replaces a shared page cache page by a private copy on the first write.
+ */
+static int vma_cow(vma_t* vma, uintptr_t addr)
+{
+    uint32_t index = (addr - vma->start) / PAGE_SIZE;
+    phys_addr_t frame = alloc_highmem_page();
+    if (frame == 0)
+    {
+        return -1;
+    }
+
+    void* dest = kmap_atomic(frame);
+    if (dest == NULL)
+    {
+        free_highmem_page(frame);
+        return -1;
+    }
+    memcpy(dest, (const void*)addr, PAGE_SIZE);
+    kunmap_atomic(dest);
+
+    map_page(addr, frame, vma_page_flags(vma, 1));
+    page_cache_release(vma->pages[index]);
+    vma->pages[index] = NULL;
+    vma_stats.cow++;
+    return 0;
+}
+
+/**
+ * @brief Fills in the page behind a fault at `addr`.
+ *
+ * Whole file pages are mapped from the page cache without copying, or
+ * straight from the initrd module when the filesystem shares its frames;
+ * pages with partial file data or none at all get a private frame. A write
+ * to a shared page copies it first; that is the only protection fault
+ * resolved, any other would recur on every retry. `error` holds the
+ * PF_ERROR_* bits of the fault. Called with interrupts enabled.
+ *
+ * @return 0 if the access can be retried, -1 if it is not allowed or memory ran out.
+ */
+int vma_fault(vma_t* vmas, uintptr_t addr, uint32_t error)
+{
+    int write = (error & PF_ERROR_WRITE) != 0;
+    vma_t* vma = vma_find(vmas, addr);
+    if (vma == NULL || (write && !(vma->flags & PG_WRITE)))
+    {
+        return -1;
+    }
+
+    vma_stats.faults++;
+    addr &= ~(PAGE_SIZE - 1);
+
+    pte_t* pte = get_pte(addr, 0);
+    if (pte != NULL && (*pte & PG_PRESENT))
+    {
+        // Present and read-only in a writable area is always a shared page
+        if (write && !(*pte & PG_WRITE))
+        {
+            return vma_cow(vma, addr);
+        }
+        // Otherwise only a missing page that was filled in meanwhile can be retried
+        return (error & PF_ERROR_PRESENT) ? -1 : 0;
+    }
+
+    if (!write && vma_can_share(vma, addr))
+    {
+        return vma_map_shared(vma, addr);
+    }
+    return vma_map_private(vma, addr);
+}
+
+typedef struct vma_unmap_ctx
+{
+    vma_t* vma;
+    tlb_gather_t tlb;
+} vma_unmap_ctx_t;
+
+/**
+ * @brief Page walk callback: drops one page of an area.
+ */
+static int vma_unmap_page(uintptr_t virtual_addr, pte_t* entry, void* ctx)
+{
+    vma_unmap_ctx_t* unmap = (vma_unmap_ctx_t*)ctx;
+    vma_t* vma = unmap->vma;
+    uint32_t index = (virtual_addr - vma->start) / PAGE_SIZE;
+    page_t* page = vma->pages ? vma->pages[index] : NULL;
+
+    if (page != NULL)
+    {
+        page_cache_release(page);
+        vma->pages[index] = NULL;
+    }
+    else
+    {
+        free_highmem_page(*entry & PTE_ADDR_MASK);
+    }
+
+    *entry = 0;
+    tlb_gather_add(&unmap->tlb, virtual_addr);
+    return 0;
+}
+
+/**
+ * @brief Returns the writable area holding all of [addr, addr + count pages), or NULL.
+ */
+static vma_t* vma_find_writable(vma_t* vmas, uintptr_t addr, size_t count)
+{
+    vma_t* vma = vma_find(vmas, addr);
+    if (vma == NULL || !(vma->flags & PG_WRITE) || (addr & (PAGE_SIZE - 1)) ||
+        count > (vma->end - addr) / PAGE_SIZE)
+    {
+        return NULL;
+    }
+    return vma;
+}
+
+/**
+ * @brief Takes the frames behind a range out of the program, to move them to another.
+ *
+ * Every page is first made private and writable, faulting it in or copying
+ * it as a write would, so each frame belongs to the area alone. The range
+ * is then unmapped in one batch, and the next touch fills it in like a page
+ * never touched: zeroes in anonymous memory, the file's data again in a
+ * file-backed area.
+ *
+ * @param frames Receives one frame per page; the caller owns them afterwards.
+ *
+ * @return 0 on success, -1 if the range is not page aligned inside one
+ *         writable area, or memory ran out.
+ */
+int vma_detach_pages(vma_t* vmas, uintptr_t addr, size_t count, phys_addr_t* frames)
+{
+    if (vma_find_writable(vmas, addr, count) == NULL)
+    {
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uintptr_t page = addr + i * PAGE_SIZE;
+        pte_t* pte = get_pte(page, 0);
+        if (pte == NULL || (*pte & (PG_PRESENT | PG_WRITE)) != (PG_PRESENT | PG_WRITE))
+        {
+            if (vma_fault(vmas, page, PF_ERROR_WRITE | (pte != NULL && (*pte & PG_PRESENT) ? PF_ERROR_PRESENT : 0)) != 0)
+            {
+                return -1;
+            }
+            pte = get_pte(page, 0);
+        }
+        frames[i] = *pte & PTE_ADDR_MASK;
+    }
+
+    unmap_range(addr, count * PAGE_SIZE);
+    vma_stats.detached += count;
+    return 0;
+}
+
+/**
+ * @brief Maps frames taken out of another program over a range, as private pages.
+ *
+ * Whatever the range held is dropped first. The old entries are cleared and
+ * the new ones written before a single TLB flush for the whole range.
+ *
+ * @param frames One frame per page, owned by the area afterwards.
+ *
+ * @return 0 on success, -1 if the range is not page aligned inside one writable area.
+ */
+int vma_attach_pages(vma_t* vmas, uintptr_t addr, size_t count, const phys_addr_t* frames)
+{
+    vma_t* vma = vma_find_writable(vmas, addr, count);
+    if (vma == NULL)
+    {
+        return -1;
+    }
+
+    vma_unmap_ctx_t unmap;
+    unmap.vma = vma;
+    tlb_gather_init(&unmap.tlb);
+    walk(addr, count * PAGE_SIZE, vma_unmap_page, &unmap);
+
+    map_pages(addr, frames, count, vma_page_flags(vma, 1));
+    tlb_gather_flush(&unmap.tlb);
+
+    vma_stats.attached += count;
+    return 0;
+}
+
+/**
+ * @brief Unmaps every area, frees private frames and releases page cache pages.
+ */
+void vma_unmap_all(vma_t** vmas)
+{
+    vma_unmap_ctx_t unmap;
+    tlb_gather_init(&unmap.tlb);
+
+    vma_t* vma = *vmas;
+    while (vma != NULL)
+    {
+        vma_t* next = vma->next;
+        unmap.vma = vma;
+        walk(vma->start, vma->end - vma->start, vma_unmap_page, &unmap);
+        kfree(vma->pages);
+        kfree(vma);
+        vma = next;
+    }
+
+    tlb_gather_flush(&unmap.tlb);
+    *vmas = NULL;
+}
+
+/**
+ * @brief Frees the areas of a program that never ran, without touching page tables.
+ *
+ * Nothing may have been mapped in them. The address space they were
+ * reserved for is not loaded, so walking the current one would free
+ * another program's pages.
+ */
+void vma_free_all(vma_t** vmas)
+{
+    vma_t* vma = *vmas;
+    while (vma != NULL)
+    {
+        vma_t* next = vma->next;
+        kfree(vma->pages);
+        kfree(vma);
+        vma = next;
+    }
+    *vmas = NULL;
+}
+
+void vma_get_stats(vma_stats_t* stats)
+{
+    *stats = vma_stats;
+}
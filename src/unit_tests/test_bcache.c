@@ -0,0 +1,100 @@
+#include <unit_tests/test_bcache.h>
+
+void test_bcache_hit(block_device_t* dev)
+{
+    bcache_stats_t before, after;
+    bcache_get_stats(&before);
+
+    buffer_t* first = bread(dev, 0);
+    if (first == NULL)
+    {
+        kprintf("Error: bcache could not read block 0 of %s.\n", dev->name);
+        return;
+    }
+    brelse(first);
+
+    buffer_t* second = bread(dev, 0);
+    bcache_get_stats(&after);
+    if (second != first || after.hits == before.hits)
+    {
+        kprintf("Error: bcache missed on a block it had just read.\n");
+    }
+    if (second != NULL)
+    {
+        brelse(second);
+    }
+}
+
+void test_bcache_sequential(block_device_t* dev)
+{
+    uint64_t blocks = dev->sectors / BCACHE_BLOCK_SECTORS;
+    if (blocks > 256)
+    {
+        blocks = 256;
+    }
+
+    bcache_stats_t before, after;
+    bcache_get_stats(&before);
+    uint32_t requests = dev->stats.requests;
+
+    // Start past block 0, which the hit test already cached
+    for (uint64_t block = 1; block < blocks; block++)
+    {
+        buffer_t* buf = bread(dev, block);
+        if (buf == NULL)
+        {
+            kprintf("Error: bcache failed to read block %d.\n", (uint32_t)block);
+            return;
+        }
+        brelse(buf);
+    }
+
+    bcache_get_stats(&after);
+    requests = dev->stats.requests - requests;
+    kprintf("bcache: %d blocks in %d requests, %d read ahead\n", (uint32_t)blocks - 1, requests, after.readahead - before.readahead);
+
+    if (blocks > BCACHE_READAHEAD_MIN + 1 && after.readahead == before.readahead)
+    {
+        kprintf("Error: sequential reads did not trigger read-ahead.\n");
+    }
+}
+
+void test_bcache_writeback(block_device_t* dev)
+{
+    bcache_stats_t before, after;
+    bcache_get_stats(&before);
+
+    // Rewrite block 0 with its own contents so the disk is left unchanged
+    buffer_t* buf = bread(dev, 0);
+    if (buf == NULL)
+    {
+        return;
+    }
+    bdirty(buf);
+    brelse(buf);
+
+    if (bsync(dev) != 0)
+    {
+        kprintf("Error: bcache write-back to %s failed.\n", dev->name);
+    }
+
+    bcache_get_stats(&after);
+    if (after.writebacks == before.writebacks || after.dirty != 0)
+    {
+        kprintf("Error: bsync left a dirty buffer behind.\n");
+    }
+}
+
+void run_bcache_tests()
+{
+    block_device_t* dev = blk_get_device(0);
+    if (dev == NULL)
+    {
+        kprintf("bcache: no block device, skipping tests.\n");
+        return;
+    }
+
+    test_bcache_hit(dev);
+    test_bcache_sequential(dev);
+    test_bcache_writeback(dev);
+}
@@ -0,0 +1,214 @@
+#include <unit_tests/test_futex.h>
+
+#define TEST_FUTEX_ROUNDS 1000
+#define TEST_FUTEX_ITEMS 8
+#define TEST_FUTEX_YIELDS 20
+
+static mutex_t test_futex_mutex = MUTEX_INIT;
+static semaphore_t test_futex_sem = SEMAPHORE_INIT(0);
+static condvar_t test_futex_cond = CONDVAR_INIT;
+static volatile uint32_t test_futex_ready;
+static volatile uint32_t test_futex_taken;
+static volatile uint32_t test_futex_done;
+
+/**
+ * @brief Yields until the helper thread finished, or gives up.
+ */
+static void test_futex_join()
+{
+    for (int i = 0; i < TEST_FUTEX_YIELDS && !test_futex_done; i++)
+    {
+        kthread_yield();
+    }
+}
+
+void test_futex_mismatch()
+{
+    volatile uint32_t word = 1;
+    if (futex_wait(&word, 0) != -1)
+    {
+        kprintf("Error: futex_wait() slept on a changed word.\n");
+    }
+    if (futex_wake(&word, FUTEX_WAKE_ALL) != 0)
+    {
+        kprintf("Error: futex_wake() woke a thread that was not waiting.\n");
+    }
+}
+
+void test_futex_uncontended()
+{
+    mutex_t mutex = MUTEX_INIT;
+    semaphore_t sem = SEMAPHORE_INIT(1);
+    condvar_t cond = CONDVAR_INIT;
+    futex_stats_t before, after;
+
+    futex_get_stats(&before);
+    for (int i = 0; i < TEST_FUTEX_ROUNDS; i++)
+    {
+        mutex_lock(&mutex);
+        mutex_unlock(&mutex);
+        sem_down(&sem);
+        sem_up(&sem);
+        cond_signal(&cond);
+        cond_broadcast(&cond);
+    }
+    if (!mutex_trylock(&mutex) || mutex_trylock(&mutex))
+    {
+        kprintf("Error: mutex_trylock() is wrong.\n");
+    }
+    mutex_unlock(&mutex);
+    futex_get_stats(&after);
+
+    if (after.waits != before.waits || after.wakes != before.wakes || after.retries != before.retries)
+    {
+        kprintf("Error: uncontended locking entered the kernel %d times.\n",
+                (after.waits - before.waits) + (after.wakes - before.wakes) + (after.retries - before.retries));
+    }
+    if (mutex.state != MUTEX_UNLOCKED || sem.count != 1)
+    {
+        kprintf("Error: uncontended locking left the mutex %d, the semaphore %d.\n", mutex.state, sem.count);
+    }
+}
+
+static void test_futex_mutex_thread(void* arg)
+{
+    (void)arg;
+    mutex_lock(&test_futex_mutex);
+    test_futex_taken = 1;
+    mutex_unlock(&test_futex_mutex);
+    test_futex_done = 1;
+}
+
+void test_futex_mutex_contended()
+{
+    futex_stats_t before, after;
+    futex_get_stats(&before);
+    test_futex_taken = 0;
+    test_futex_done = 0;
+
+    mutex_lock(&test_futex_mutex);
+    if (kthread_create(test_futex_mutex_thread, NULL, "futex-test") == NULL)
+    {
+        kprintf("Error: could not start the mutex test thread.\n");
+        mutex_unlock(&test_futex_mutex);
+        return;
+    }
+
+    // The other thread finds the mutex held and goes to sleep on it
+    for (int i = 0; i < TEST_FUTEX_YIELDS && test_futex_mutex.state != MUTEX_CONTENDED; i++)
+    {
+        kthread_yield();
+    }
+    if (test_futex_taken || test_futex_mutex.state != MUTEX_CONTENDED)
+    {
+        kprintf("Error: a held mutex was taken, or left in state %d.\n", test_futex_mutex.state);
+    }
+
+    mutex_unlock(&test_futex_mutex);
+    test_futex_join();
+    futex_get_stats(&after);
+
+    if (!test_futex_taken || test_futex_mutex.state != MUTEX_UNLOCKED)
+    {
+        kprintf("Error: a released mutex was not handed over.\n");
+    }
+    if (after.waits == before.waits || after.woken == before.woken)
+    {
+        kprintf("Error: a contended mutex did not sleep and wake.\n");
+    }
+}
+
+static void test_futex_sem_thread(void* arg)
+{
+    (void)arg;
+    for (int i = 0; i < TEST_FUTEX_ITEMS; i++)
+    {
+        sem_down(&test_futex_sem);
+        test_futex_taken++;
+    }
+    test_futex_done = 1;
+}
+
+void test_futex_semaphore()
+{
+    test_futex_taken = 0;
+    test_futex_done = 0;
+    sem_init(&test_futex_sem, 0);
+
+    if (kthread_create(test_futex_sem_thread, NULL, "futex-test") == NULL)
+    {
+        kprintf("Error: could not start the semaphore test thread.\n");
+        return;
+    }
+
+    // Half the units go to a sleeping consumer, half are already there when it looks
+    for (int i = 0; i < TEST_FUTEX_ITEMS; i++)
+    {
+        if (i % 2 == 0)
+        {
+            kthread_yield();
+        }
+        sem_up(&test_futex_sem);
+    }
+    test_futex_join();
+
+    if (test_futex_taken != TEST_FUTEX_ITEMS || test_futex_sem.count != 0 || test_futex_sem.waiters != 0)
+    {
+        kprintf("Error: the semaphore gave out %d of %d units.\n", test_futex_taken, TEST_FUTEX_ITEMS);
+    }
+}
+
+static void test_futex_cond_thread(void* arg)
+{
+    (void)arg;
+    mutex_lock(&test_futex_mutex);
+    while (!test_futex_ready)
+    {
+        cond_wait(&test_futex_cond, &test_futex_mutex);
+    }
+    test_futex_taken = 1;
+    mutex_unlock(&test_futex_mutex);
+    test_futex_done = 1;
+}
+
+void test_futex_condvar()
+{
+    test_futex_ready = 0;
+    test_futex_taken = 0;
+    test_futex_done = 0;
+
+    if (kthread_create(test_futex_cond_thread, NULL, "futex-test") == NULL)
+    {
+        kprintf("Error: could not start the condition variable test thread.\n");
+        return;
+    }
+
+    for (int i = 0; i < TEST_FUTEX_YIELDS && test_futex_cond.waiters == 0; i++)
+    {
+        kthread_yield();
+    }
+    if (test_futex_taken || test_futex_cond.waiters != 1)
+    {
+        kprintf("Error: the condition variable did not wait.\n");
+    }
+
+    mutex_lock(&test_futex_mutex);
+    test_futex_ready = 1;
+    cond_signal(&test_futex_cond);
+    mutex_unlock(&test_futex_mutex);
+    test_futex_join();
+
+    if (!test_futex_taken || test_futex_cond.waiters != 0 || test_futex_mutex.state != MUTEX_UNLOCKED)
+    {
+        kprintf("Error: a signalled waiter did not wake with the mutex.\n");
+    }
+}
+
+void run_futex_tests()
+{
+    test_futex_mismatch();
+    test_futex_uncontended();
+    test_futex_mutex_contended();
+    test_futex_semaphore();
+    test_futex_condvar();
+}
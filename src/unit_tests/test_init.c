@@ -0,0 +1,77 @@
+#include <unit_tests/test_init.h>
+
+/**
+ * @brief Checks that every initcall ran, and that levels ran in order.
+ */
+static int test_initcalls_levels()
+{
+    uint32_t level = 0;
+    uint32_t level_first = 0;
+    uint32_t last = 0;
+
+    for (const initcall_t* call = __initcall_start; call < __initcall_end; call++)
+    {
+        if (call->order == 0)
+        {
+            kprintf("Error: initcall %s did not run!\n", call->name);
+            return 1;
+        }
+        if (call->level < level)
+        {
+            kprintf("Error: initcall %s is out of level order!\n", call->name);
+            return 1;
+        }
+        if (call->level != level)
+        {
+            // Every initcall of the new level ran after every one of the previous levels
+            level = call->level;
+            level_first = last + 1;
+        }
+        if (call->order < level_first)
+        {
+            kprintf("Error: initcall %s ran before an earlier level finished!\n", call->name);
+            return 1;
+        }
+        if (call->order > last)
+        {
+            last = call->order;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Checks that `name` ran after `dep`.
+ */
+static int test_initcall_after(const char* name, const char* dep)
+{
+    const initcall_t* call = initcall_lookup(name);
+    const initcall_t* before = initcall_lookup(dep);
+    if (call == NULL || before == NULL)
+    {
+        kprintf("Error: initcall %s or %s is not registered!\n", name, dep);
+        return 1;
+    }
+    if (call->order < before->order)
+    {
+        kprintf("Error: initcall %s ran before %s!\n", name, dep);
+        return 1;
+    }
+    return 0;
+}
+
+void run_init_tests()
+{
+    kprintf("Running init tests...\n");
+    int failed = test_initcalls_levels();
+    failed |= test_initcall_after("softirq_init", "kthread_init");
+    failed |= test_initcall_after("timers_init", "softirq_init");
+    failed |= test_initcall_after("virtio_blk_init", "pci_init");
+    failed |= test_initcall_after("ata_probe", "virtio_blk_init");
+    if (initcall_lookup("no_such_initcall") != NULL)
+    {
+        kprintf("Error: initcall_lookup found an initcall that does not exist!\n");
+        failed = 1;
+    }
+    kprintf(failed ? "Init tests failed.\n" : "Init tests complete.\n");
+}
@@ -0,0 +1,56 @@
+#include <unit_tests/test_initrd.h>
+
+void test_initrd_lookup()
+{
+    const initrd_file_t* file = initrd_file_at(0);
+    if (file == NULL)
+    {
+        kprintf("initrd: no files loaded, skipping lookup test.\n");
+        return;
+    }
+
+    // Lookups ignore a leading "/" or "./"
+    char path[128] = "./";
+    if (strlen(file->name) + 3 > sizeof(path))
+    {
+        return;
+    }
+    strcpy(path + 2, file->name);
+
+    if (initrd_lookup(file->name) != file || initrd_lookup(path) != file || initrd_lookup(path + 1) != file)
+    {
+        kprintf("Error: initrd lookup of %s failed.\n", file->name);
+    }
+
+    if (initrd_lookup("no/such/file") != NULL)
+    {
+        kprintf("Error: initrd lookup found a file that does not exist.\n");
+    }
+}
+
+void test_initrd_read()
+{
+    const initrd_file_t* file = initrd_file_at(0);
+    if (file == NULL || file->size == 0)
+    {
+        return;
+    }
+
+    // A read at the end of the file returns the last byte only
+    uint8_t last = 0;
+    if (initrd_read(file, file->size - 1, &last, 16) != 1 || last != file->data[file->size - 1])
+    {
+        kprintf("Error: initrd read past the end of %s.\n", file->name);
+    }
+
+    if (initrd_read(file, file->size, &last, 1) != 0)
+    {
+        kprintf("Error: initrd read at the end of %s returned data.\n", file->name);
+    }
+}
+
+void run_initrd_tests()
+{
+    test_initrd_lookup();
+    test_initrd_read();
+}
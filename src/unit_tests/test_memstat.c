@@ -0,0 +1,60 @@
+#include <unit_tests/test_memstat.h>
+
+void test_memstat_zones()
+{
+    size_t total = 0;
+    size_t free = 0;
+
+    for (int zone = 0; zone < NR_ZONES; zone++)
+    {
+        zone_stats_t stats;
+        physical_memory_zone_stats(zone, &stats);
+        if (stats.free + stats.used + stats.reserved != stats.total)
+        {
+            kprintf("Error: zone %d pages do not add up: %d free, %d used, %d reserved of %d.\n",
+                zone, stats.free, stats.used, stats.reserved, stats.total);
+        }
+        total += stats.total;
+        free += stats.free;
+    }
+
+    if (total != get_total_page_count() || free != get_free_page_count())
+    {
+        kprintf("Error: zone totals %d/%d differ from the allocator's %d/%d.\n",
+            free, total, get_free_page_count(), get_total_page_count());
+    }
+}
+
+void test_memstat_heap()
+{
+    heap_stats_t before, during, after;
+    heap_get_stats(&before);
+
+    void* ptr = kmalloc(100);
+    heap_get_stats(&during);
+    kfree(ptr);
+    heap_get_stats(&after);
+
+    // 100 bytes fall in the 128 byte class, or in the smallest one if that is larger
+    int class = HEAP_CLASS_MIN_SHIFT >= 7 ? 0 : 7 - HEAP_CLASS_MIN_SHIFT;
+    if (during.in_use <= before.in_use || during.classes[class].allocs != before.classes[class].allocs + 1)
+    {
+        kprintf("Error: kmalloc(100) was not counted in size class %d.\n", class);
+    }
+    if (after.in_use != before.in_use || after.classes[class].frees != before.classes[class].frees + 1)
+    {
+        kprintf("Error: kfree did not undo the heap accounting.\n");
+    }
+    if (after.largest_free > after.free)
+    {
+        kprintf("Error: largest free block %d exceeds free bytes %d.\n", after.largest_free, after.free);
+    }
+}
+
+void run_memstat_tests()
+{
+    test_memstat_zones();
+    test_memstat_heap();
+    memstat_dump_meminfo();
+    memstat_dump_slabinfo();
+}
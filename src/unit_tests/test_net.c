@@ -0,0 +1,263 @@
+#include <unit_tests/test_net.h>
+
+// Neither registered nor routed to: frames are handed to it directly, and what it sends is kept
+#define TEST_NET_PEER_IP NET_IP(169, 254, 0, 1)
+#define TEST_NET_PORT    40001
+
+static const uint8_t test_net_peer_mac[ETH_ALEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+static netbuf_t* test_net_sent;
+static uint16_t test_net_delivered;
+
+static int test_net_transmit(net_device_t* dev, netbuf_t* nb)
+{
+    (void)dev;
+    if (test_net_sent != NULL)
+    {
+        netbuf_free(test_net_sent);
+    }
+    test_net_sent = nb;
+    return 0;
+}
+
+static int test_net_poll(net_device_t* dev, int budget)
+{
+    (void)dev, (void)budget;
+    return 0;
+}
+
+static int test_net_irq_enable(net_device_t* dev)
+{
+    (void)dev;
+    return 0;
+}
+
+static const net_device_ops_t test_net_ops = {
+    .transmit = test_net_transmit,
+    .poll = test_net_poll,
+    .irq_enable = test_net_irq_enable,
+};
+
+static net_device_t test_net_dev = {
+    .name = "test",
+    .mac = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02},
+    .ip = NET_LOCAL_IP,
+    .ops = &test_net_ops,
+};
+
+static void test_net_handler(net_device_t* dev, netbuf_t* nb, uint32_t src_ip, uint16_t src_port,
+                             uint8_t* payload, uint16_t len)
+{
+    (void)dev, (void)src_ip, (void)src_port, (void)payload;
+    test_net_delivered = len;
+    netbuf_free(nb);
+}
+
+/**
+ * @brief Hands a frame to the stack as a driver's poll function would.
+ */
+static void test_net_receive(netbuf_t* nb)
+{
+    local_bh_disable();
+    net_receive(&test_net_dev, nb);
+    local_bh_enable();
+}
+
+static int test_net_checksum()
+{
+    // A sample header, checksum zeroed
+    const uint8_t header[20] = {0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11,
+                                0x00, 0x00, 0xc0, 0xa8, 0x00, 0x01, 0xc0, 0xa8, 0x00, 0xc7};
+    uint8_t odd[3] = {0x01, 0x02, 0x03};
+
+    if (net_checksum(header, sizeof(header)) != 0xb861)
+    {
+        kprintf("Error: the IPv4 header checksum is %x, not b861!\n", net_checksum(header, sizeof(header)));
+        return 1;
+    }
+    if (net_checksum(odd, sizeof(odd)) != (uint16_t)~0x0402)
+    {
+        kprintf("Error: the checksum of an odd length is wrong!\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int test_net_arp()
+{
+    netbuf_t* nb = netbuf_alloc();
+    if (nb == NULL)
+    {
+        kprintf("Error: no network buffer for the ARP test!\n");
+        return 1;
+    }
+
+    eth_header_t* eth = (eth_header_t*)netbuf_data(nb);
+    arp_packet_t* arp = (arp_packet_t*)(eth + 1);
+    memset(eth->dest, 0xFF, ETH_ALEN);
+    memcpy(eth->src, test_net_peer_mac, ETH_ALEN);
+    eth->type = net_htons(ETH_TYPE_ARP);
+    arp->hw_type = net_htons(ARP_HW_ETHER);
+    arp->proto_type = net_htons(ETH_TYPE_IPV4);
+    arp->hw_len = ETH_ALEN;
+    arp->proto_len = sizeof(uint32_t);
+    arp->op = net_htons(ARP_OP_REQUEST);
+    memcpy(arp->sender_mac, test_net_peer_mac, ETH_ALEN);
+    arp->sender_ip = net_htonl(TEST_NET_PEER_IP);
+    memset(arp->target_mac, 0, ETH_ALEN);
+    arp->target_ip = net_htonl(NET_LOCAL_IP);
+    nb->len = sizeof(eth_header_t) + sizeof(arp_packet_t);
+
+    test_net_receive(nb);
+
+    int failed = 0;
+    netbuf_t* reply = test_net_sent;
+    test_net_sent = NULL;
+    if (reply == NULL)
+    {
+        kprintf("Error: an ARP request for our address was not answered!\n");
+        return 1;
+    }
+
+    eth = (eth_header_t*)netbuf_data(reply);
+    arp = (arp_packet_t*)(eth + 1);
+    if (net_ntohs(arp->op) != ARP_OP_REPLY || memcmp(eth->dest, test_net_peer_mac, ETH_ALEN) != 0 ||
+        memcmp(arp->sender_mac, test_net_dev.mac, ETH_ALEN) != 0 || net_ntohl(arp->sender_ip) != NET_LOCAL_IP ||
+        net_ntohl(arp->target_ip) != TEST_NET_PEER_IP)
+    {
+        kprintf("Error: the ARP reply is malformed!\n");
+        failed = 1;
+    }
+    netbuf_free(reply);
+
+    uint8_t mac[ETH_ALEN];
+    if (net_arp_lookup(TEST_NET_PEER_IP, mac) != 0 || memcmp(mac, test_net_peer_mac, ETH_ALEN) != 0)
+    {
+        kprintf("Error: the sender of an ARP request was not learnt!\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+/**
+ * @brief Builds a datagram from the peer to TEST_NET_PORT.
+ */
+static netbuf_t* test_net_datagram(uint16_t len)
+{
+    netbuf_t* nb = netbuf_alloc();
+    if (nb == NULL)
+    {
+        return NULL;
+    }
+
+    eth_header_t* eth = (eth_header_t*)netbuf_data(nb);
+    ip_header_t* ip = (ip_header_t*)(eth + 1);
+    udp_header_t* udp = (udp_header_t*)(ip + 1);
+    memcpy(eth->dest, test_net_dev.mac, ETH_ALEN);
+    memcpy(eth->src, test_net_peer_mac, ETH_ALEN);
+    eth->type = net_htons(ETH_TYPE_IPV4);
+
+    memset(ip, 0, sizeof(ip_header_t));
+    ip->version_ihl = IP_VERSION_IHL;
+    ip->total_len = net_htons(sizeof(ip_header_t) + sizeof(udp_header_t) + len);
+    ip->ttl = IP_DEFAULT_TTL;
+    ip->proto = IP_PROTO_UDP;
+    ip->src = net_htonl(TEST_NET_PEER_IP);
+    ip->dest = net_htonl(NET_LOCAL_IP);
+    ip->checksum = net_htons(net_checksum(ip, sizeof(ip_header_t)));
+
+    udp->src_port = net_htons(TEST_NET_PORT);
+    udp->dest_port = net_htons(TEST_NET_PORT);
+    udp->len = net_htons(sizeof(udp_header_t) + len);
+    udp->checksum = 0;
+    memset(udp + 1, 0x5A, len);
+
+    // Padded to the Ethernet minimum, as short frames arrive
+    nb->len = NET_UDP_HEADERS + len < ETH_ZLEN ? ETH_ZLEN : NET_UDP_HEADERS + len;
+    return nb;
+}
+
+static int test_net_udp()
+{
+    if (net_udp_bind(TEST_NET_PORT, test_net_handler) != 0)
+    {
+        kprintf("Error: could not bind a UDP port!\n");
+        return 1;
+    }
+
+    int failed = 0;
+    netbuf_t* good = test_net_datagram(5);
+    netbuf_t* bad = test_net_datagram(5);
+    if (good == NULL || bad == NULL)
+    {
+        kprintf("Error: no network buffers for the UDP test!\n");
+        net_udp_unbind(TEST_NET_PORT);
+        return 1;
+    }
+
+    test_net_delivered = 0;
+    test_net_receive(good);
+    if (test_net_delivered != 5)
+    {
+        kprintf("Error: a padded datagram was delivered with %d bytes, not 5!\n", test_net_delivered);
+        failed = 1;
+    }
+
+    ip_header_t* ip = (ip_header_t*)(netbuf_data(bad) + sizeof(eth_header_t));
+    ip->checksum ^= 0x0100;
+    uint32_t dropped = test_net_dev.stats.rx_dropped;
+    test_net_delivered = 0;
+    test_net_receive(bad);
+    if (test_net_delivered != 0 || test_net_dev.stats.rx_dropped != dropped + 1)
+    {
+        kprintf("Error: a packet with a bad header checksum was not dropped!\n");
+        failed = 1;
+    }
+
+    net_udp_unbind(TEST_NET_PORT);
+    return failed;
+}
+
+static int test_net_loopback()
+{
+    if (tsc_khz == 0)
+    {
+        return 0;
+    }
+
+    netbench_result_t result;
+    if (netbench_run(NET_LOOPBACK_IP, NET_ECHO_PORT, 256, &result) != 0)
+    {
+        kprintf("Error: the loopback benchmark did not run!\n");
+        return 1;
+    }
+    netbench_report("lo", &result);
+    if (result.sent != 256 || result.received != 256)
+    {
+        kprintf("Error: %d of %d datagrams came back through loopback!\n", result.received, result.sent);
+        return 1;
+    }
+    if (result.p50_ns > result.p90_ns || result.p90_ns > result.p99_ns || result.p99_ns > result.max_ns)
+    {
+        kprintf("Error: the latency percentiles are out of order!\n");
+        return 1;
+    }
+    return 0;
+}
+
+void run_net_tests()
+{
+    kprintf("Running net tests...\n");
+    size_t free = netbuf_free_count();
+
+    int failed = test_net_checksum();
+    failed |= test_net_arp();
+    failed |= test_net_udp();
+    failed |= test_net_loopback();
+
+    if (netbuf_free_count() != free)
+    {
+        kprintf("Error: %d network buffers were lost!\n", free - netbuf_free_count());
+        failed = 1;
+    }
+    kprintf(failed ? "Net tests failed.\n" : "Net tests complete.\n");
+}
@@ -0,0 +1,93 @@
+#include <unit_tests/test_page_cache.h>
+
+void test_page_cache_shared(inode_t* inode)
+{
+    page_t* first = page_cache_get(inode, 0);
+    page_t* second = page_cache_get(inode, 0);
+    if (first == NULL || first != second)
+    {
+        kprintf("Error: page cache returned different pages for the same offset.\n");
+    }
+    if (first != NULL)
+    {
+        page_cache_release(first);
+    }
+    if (second != NULL)
+    {
+        page_cache_release(second);
+    }
+}
+
+void test_page_cache_mmap(const char* path, inode_t* inode)
+{
+    size_t size = inode->size < 0x10000 ? inode->size : 0x10000;
+    uint8_t* copy = (uint8_t*)vmalloc(size);
+    if (copy == NULL)
+    {
+        return;
+    }
+
+    if (file_read(inode, 0, copy, size) != size)
+    {
+        kprintf("Error: short read of %s through the page cache.\n", path);
+        vfree(copy);
+        return;
+    }
+
+    // The mapping must show the very frames the read path copied from
+    const uint8_t* mapped = (const uint8_t*)file_mmap(inode, 0, size);
+    if (mapped == NULL)
+    {
+        kprintf("Error: could not map %s.\n", path);
+        vfree(copy);
+        return;
+    }
+
+    page_t* page = page_cache_get(inode, 0);
+    if (page == NULL || virt_to_phys((uintptr_t)mapped) != page->phys || memcmp(mapped, copy, size) != 0)
+    {
+        kprintf("Error: mapping of %s does not share the cached pages.\n", path);
+    }
+    if (page != NULL)
+    {
+        page_cache_release(page);
+    }
+
+    file_munmap((void*)mapped);
+    vfree(copy);
+}
+
+void test_page_cache_shrink(inode_t* inode)
+{
+    // Every page is unreferenced now, so reclaim can drop them all and reads refill the cache
+    page_cache_shrink(page_cache_pages());
+    if (inode->nr_pages != 0)
+    {
+        kprintf("Error: page cache kept %d idle pages.\n", inode->nr_pages);
+    }
+
+    uint8_t byte;
+    if (file_read(inode, 0, &byte, 1) != 1)
+    {
+        kprintf("Error: read after reclaim failed.\n");
+    }
+}
+
+void run_page_cache_tests()
+{
+    const char* paths[] = { "/motd", "/disk/README.txt" };
+
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++)
+    {
+        inode_t* inode = vfs_lookup(paths[i]);
+        if (inode == NULL || inode->size == 0)
+        {
+            kprintf("page cache: %s not found, skipping.\n", paths[i]);
+            continue;
+        }
+
+        test_page_cache_shared(inode);
+        test_page_cache_mmap(paths[i], inode);
+        test_page_cache_shrink(inode);
+    }
+}
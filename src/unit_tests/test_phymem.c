@@ -24,4 +24,63 @@ void test_physical_memory_limits()
             return;
         }
     }
-}
\ No newline at end of file
+}
+
+void test_highmem_mapping()
+{
+    phys_addr_t frame = alloc_highmem_page();
+    if (frame == 0)
+    {
+        kprintf("Error: Could not allocate a highmem page!\n");
+        return;
+    }
+
+    uint32_t* data = (uint32_t*)kmap_atomic(frame);
+    data[0] = 0xC0FFEE;
+    data[PAGE_SIZE / 4 - 1] = (uint32_t)(frame >> 12);
+    kunmap_atomic(data);
+
+    // Map the frame again, most likely through the same slot, and read the values back
+    data = (uint32_t*)kmap_atomic(frame);
+    if (data[0] != 0xC0FFEE || data[PAGE_SIZE / 4 - 1] != (uint32_t)(frame >> 12))
+    {
+        kprintf("Error: Highmem page %x%x lost its contents!\n", (uint32_t)((uint64_t)frame >> 32), (uint32_t)frame);
+    }
+    else
+    {
+        kprintf("Highmem mapping test passed for frame %x%x\n", (uint32_t)((uint64_t)frame >> 32), (uint32_t)frame);
+    }
+    kunmap_atomic(data);
+
+    free_highmem_page(frame);
+}
+
+void test_physical_pages_aligned()
+{
+    size_t free_before = get_free_page_count();
+
+    // Not a power of two, so the buddy allocator has a tail to give back
+    phys_addr_t start = alloc_physical_pages_aligned(12, 16);
+    if (start == 0)
+    {
+        kprintf("Error: Could not allocate 12 pages aligned to 16!\n");
+        return;
+    }
+    if ((start >> 12) % 16 != 0)
+    {
+        kprintf("Error: Aligned allocation returned %x%x!\n", (uint32_t)((uint64_t)start >> 32), (uint32_t)start);
+    }
+    if (get_free_page_count() != free_before - 12)
+    {
+        kprintf("Error: Aligned allocation took %d pages instead of 12!\n", free_before - get_free_page_count());
+    }
+
+    free_physical_pages(start, 12);
+    if (get_free_page_count() != free_before)
+    {
+        kprintf("Error: Free page count is %d after freeing, expected %d!\n", get_free_page_count(), free_before);
+        return;
+    }
+
+    kprintf("Aligned page allocation test passed\n");
+}
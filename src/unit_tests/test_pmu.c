@@ -0,0 +1,74 @@
+#include <unit_tests/test_pmu.h>
+
+#define TEST_PMU_ITERATIONS 1000
+
+void test_pmu_set_init()
+{
+    pmu_set_t set;
+    uint8_t events[PMU_MAX_COUNTERS + 1] = { PMU_EVENT_CYCLES };
+
+    if (pmu_set_init(&set, events, pmu_num_counters() + 1) == 0)
+    {
+        kprintf("Error: a counter set took more events than there are counters.\n");
+    }
+
+    events[0] = PMU_EVENT_COUNT;
+    if (pmu_set_init(&set, events, 1) == 0)
+    {
+        kprintf("Error: a counter set took an unknown event.\n");
+    }
+}
+
+void test_pmu_count()
+{
+    pmu_set_t set;
+    const uint8_t events[] = { PMU_EVENT_CYCLES, PMU_EVENT_INSTRUCTIONS };
+    if (pmu_set_init(&set, events, 2) != 0)
+    {
+        return;
+    }
+
+    pmu_start(&set);
+    for (int i = 0; i < TEST_PMU_ITERATIONS; i++)
+    {
+        kfree(kmalloc(64));
+    }
+    pmu_stop(&set);
+
+    if (set.values[0] == 0 || set.values[1] < TEST_PMU_ITERATIONS)
+    {
+        kprintf("Error: the counters did not count a kmalloc loop.\n");
+    }
+    pmu_print(&set, "kmalloc_kfree_x1000");
+}
+
+void test_pmu_sample()
+{
+    if (pmu_sample_start(PMU_EVENT_CYCLES, 100000) != 0)
+    {
+        return;
+    }
+
+    for (uint32_t polls = 0; profile_count(0) == 0 && polls < 0x1000000; polls++)
+    {
+        cpu_relax();
+    }
+    pmu_sample_stop();
+
+    if (profile_count(0) == 0)
+    {
+        kprintf("Error: no sample was taken on counter overflow.\n");
+    }
+}
+
+void run_pmu_tests()
+{
+    if (!pmu_available())
+    {
+        return;
+    }
+
+    test_pmu_set_init();
+    test_pmu_count();
+    test_pmu_sample();
+}
@@ -0,0 +1,94 @@
+#include <unit_tests/test_profile.h>
+
+// A return address into a function lies this close past its entry point in these small test functions
+#define TEST_PROFILE_FN_SIZE 0x100
+
+static __attribute__((noinline)) size_t test_profile_inner(uint32_t* pcs, size_t max)
+{
+    uintptr_t fp = (uintptr_t)__builtin_frame_address(0);
+    return profile_backtrace(fp, fp, fp + PROFILE_STACK_LIMIT, pcs, max);
+}
+
+static __attribute__((noinline)) size_t test_profile_outer(uint32_t* pcs, size_t max)
+{
+    size_t depth = test_profile_inner(pcs, max);
+    asm volatile("" : : : "memory");    // Keeps the call from becoming a tail call
+    return depth;
+}
+
+void test_profile_backtrace()
+{
+    uint32_t pcs[PROFILE_MAX_DEPTH];
+    size_t depth = test_profile_outer(pcs, PROFILE_MAX_DEPTH);
+
+    uintptr_t outer = (uintptr_t)test_profile_outer;
+    if (depth < 2 || pcs[0] <= outer || pcs[0] >= outer + TEST_PROFILE_FN_SIZE)
+    {
+        kprintf("Error: the backtrace does not start in the caller.\n");
+        return;
+    }
+
+    uintptr_t self = (uintptr_t)test_profile_backtrace;
+    if (pcs[1] <= self || pcs[1] >= self + TEST_PROFILE_FN_SIZE)
+    {
+        kprintf("Error: the backtrace does not reach the caller's caller.\n");
+    }
+}
+
+void test_profile_backtrace_bounds()
+{
+    // A frame whose saved frame pointer points below itself ends the walk
+    uint32_t frame[2] = { 0, 0x1234 };
+    frame[0] = (uint32_t)&frame[0] - 16;
+    uint32_t pcs[PROFILE_MAX_DEPTH];
+
+    uintptr_t fp = (uintptr_t)frame;
+    if (profile_backtrace(fp, fp, fp + sizeof(frame), pcs, PROFILE_MAX_DEPTH) != 1 || pcs[0] != 0x1234)
+    {
+        kprintf("Error: the backtrace followed a frame pointer downward.\n");
+    }
+    if (profile_backtrace(fp, fp + 4, fp + sizeof(frame), pcs, PROFILE_MAX_DEPTH) != 0)
+    {
+        kprintf("Error: the backtrace read a frame below the stack.\n");
+    }
+}
+
+void test_profile_sample()
+{
+    profile_start(PROFILE_DEFAULT_HZ);
+
+    // A timer tick may land in between; only the sample taken here is checked
+    uint32_t irq_flags = local_irq_save();
+    interrupt_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.eip = 0xC0FFEE;
+    frame.ebp = (uint32_t)__builtin_frame_address(0);
+    profile_sample(&frame);
+    size_t count = profile_count(0);
+    const profile_sample_t* sample = profile_sample_at(0, count - 1);
+    local_irq_restore(irq_flags);
+
+    if (sample == NULL || sample->pcs[0] != 0xC0FFEE || sample->depth < 2 || sample->thread != (uint32_t)kthread_current())
+    {
+        kprintf("Error: the profiler did not record a sample.\n");
+    }
+
+    // Wait for the timer itself, for at most about a second of polling
+    for (uint32_t polls = 0; profile_count(0) == count && polls < 0x4000000; polls++)
+    {
+        cpu_relax();
+    }
+    profile_stop();
+
+    if (profile_count(0) == count)
+    {
+        kprintf("Error: the profiling timer never fired.\n");
+    }
+}
+
+void run_profile_tests()
+{
+    test_profile_backtrace();
+    test_profile_backtrace_bounds();
+    test_profile_sample();
+}
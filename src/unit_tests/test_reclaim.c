@@ -0,0 +1,148 @@
+#include <unit_tests/test_reclaim.h>
+
+// The pressure tests hold every page they take; above this many they are skipped
+#define TEST_RECLAIM_MAX_PAGES 0x10000
+
+/**
+ * @brief Takes pages until only `target` are free or allocation fails.
+ *
+ * @return The number of pages taken, all recorded in `frames`.
+ */
+static size_t test_reclaim_drain(phys_addr_t* frames, size_t target)
+{
+    size_t taken = 0;
+
+    while (taken < TEST_RECLAIM_MAX_PAGES && get_free_page_count() > target)
+    {
+        phys_addr_t frame = alloc_highmem_page();
+        if (frame == 0)
+        {
+            break;
+        }
+        frames[taken++] = frame;
+    }
+
+    return taken;
+}
+
+static void test_reclaim_refill(phys_addr_t* frames, size_t taken)
+{
+    for (size_t i = 0; i < taken; i++)
+    {
+        free_highmem_page(frames[i]);
+    }
+}
+
+void test_reclaim_watermarks()
+{
+    size_t min, low, high;
+    reclaim_get_watermarks(&min, &low, &high);
+
+    if (min == 0 || min >= low || low >= high)
+    {
+        kprintf("Error: watermarks are not ordered: min %d low %d high %d.\n", min, low, high);
+    }
+}
+
+void test_heap_trim()
+{
+    void* blocks[128];
+
+    for (size_t i = 0; i < 128; i++)
+    {
+        blocks[i] = kmalloc(0x2000);
+    }
+    for (size_t i = 0; i < 128; i++)
+    {
+        kfree(blocks[i]);
+    }
+
+    // The blocks were coalesced back into the tail of the heap, beyond its minimum size
+    if (heap_trim(0x1000) == 0)
+    {
+        kprintf("Error: heap_trim returned no pages after freeing 1 MiB.\n");
+    }
+
+    void* ptr = kmalloc(0x2000);
+    if (ptr == NULL)
+    {
+        kprintf("Error: kmalloc failed after heap_trim.\n");
+    }
+    kfree(ptr);
+}
+
+void test_reclaim_background(phys_addr_t* frames)
+{
+    size_t min, low, high;
+    reclaim_get_watermarks(&min, &low, &high);
+
+    reclaim_stats_t before, after;
+    reclaim_get_stats(&before);
+
+    // Stop between min and low: the reclaimer is woken, but nothing reclaims directly
+    size_t taken = test_reclaim_drain(frames, low - 1);
+    reclaim_get_stats(&after);
+    if (after.wakeups == before.wakeups)
+    {
+        kprintf("Error: dropping below the low watermark did not wake the reclaimer.\n");
+    }
+
+    kthread_yield();
+    reclaim_get_stats(&after);
+    if (after.background_runs == before.background_runs)
+    {
+        kprintf("Error: the reclaimer did not run when the boot thread yielded.\n");
+    }
+    kprintf("reclaim: %d pages reclaimed in the background\n", after.pages_reclaimed - before.pages_reclaimed);
+
+    test_reclaim_refill(frames, taken);
+}
+
+void test_reclaim_exhaustion(phys_addr_t* frames)
+{
+    reclaim_stats_t before, after;
+    reclaim_get_stats(&before);
+
+    size_t taken = test_reclaim_drain(frames, 0);
+
+    // With every page gone, allocations fail cleanly instead of mapping frame 0
+    void* ptr = kmalloc(HEAP_VMALLOC_THRESHOLD);
+    if (ptr != NULL)
+    {
+        kprintf("Error: kmalloc succeeded with no free pages.\n");
+        kfree(ptr);
+    }
+
+    reclaim_get_stats(&after);
+    if (after.direct_runs == before.direct_runs || after.failures == before.failures)
+    {
+        kprintf("Error: exhausting memory did not go through direct reclaim.\n");
+    }
+
+    test_reclaim_refill(frames, taken);
+}
+
+void run_reclaim_tests()
+{
+    kprintf("Running reclaim tests...\n");
+    test_reclaim_watermarks();
+    test_heap_trim();
+
+    if (get_free_page_count() > TEST_RECLAIM_MAX_PAGES)
+    {
+        kprintf("reclaim: too much memory for the pressure tests, skipping.\n");
+        return;
+    }
+
+    phys_addr_t* frames = (phys_addr_t*)vmalloc(TEST_RECLAIM_MAX_PAGES * sizeof(phys_addr_t));
+    if (frames == NULL)
+    {
+        kprintf("Error: no memory for the reclaim tests.\n");
+        return;
+    }
+
+    test_reclaim_background(frames);
+    test_reclaim_exhaustion(frames);
+    vfree(frames);
+    kprintf("Reclaim tests complete.\n");
+}
@@ -0,0 +1,173 @@
+#include <unit_tests/test_shell.h>
+
+/**
+ * @brief Queues scancodes as the interrupt would and reads back what they type.
+ *
+ * Interrupts are off meanwhile, so a real key cannot slip in between.
+ */
+static void test_keyboard_type(const uint8_t* scancodes, size_t count, char* out, size_t max)
+{
+    uint32_t flags = local_irq_save();
+    keyboard_reset();
+    for (size_t i = 0; i < count; i++)
+    {
+        keyboard_push(scancodes[i]);
+    }
+
+    size_t len = 0;
+    int c;
+    while ((c = keyboard_getc()) != -1 && len < max - 1)
+    {
+        out[len++] = (char)c;
+    }
+    out[len] = '\0';
+    keyboard_reset();
+    local_irq_restore(flags);
+}
+
+static int test_keyboard_decode()
+{
+    // "Hi" with shift held for the H, a released key, then caps lock "a1",
+    // ctrl-C, and the keypad enter behind its extended prefix
+    static const uint8_t scancodes[] = {
+        0x2A, 0x23, 0x23 | 0x80, 0xAA, 0x17, 0x97,
+        0x3A, 0xBA, 0x1E, 0x02, 0x3A, 0xBA,
+        0x1D, 0x2E, 0x9D,
+        0xE0, 0x1C, 0xE0, 0x9C,
+    };
+    char typed[16];
+
+    test_keyboard_type(scancodes, sizeof(scancodes), typed, sizeof(typed));
+    if (strcmp(typed, "HiA1\003\n") != 0)
+    {
+        kprintf("Error: scancodes were decoded as %s!\n", typed);
+        return 1;
+    }
+    return 0;
+}
+
+static int test_keyboard_overflow()
+{
+    keyboard_stats_t before, after;
+    keyboard_get_stats(&before);
+
+    uint32_t flags = local_irq_save();
+    for (uint32_t i = 0; i < KEYBOARD_RING_SIZE + 3; i++)
+    {
+        keyboard_push(0x1E);
+    }
+    size_t count = 0;
+    while (keyboard_getc() != -1)
+    {
+        count++;
+    }
+    local_irq_restore(flags);
+
+    keyboard_get_stats(&after);
+    if (count != KEYBOARD_RING_SIZE || after.dropped - before.dropped != 3)
+    {
+        kprintf("Error: a full scancode ring kept %d keys and dropped %d!\n", count, after.dropped - before.dropped);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Feeds characters to a line discipline without echo.
+ *
+ * @return The number of lines it completed; `line` receives the last one.
+ */
+static int test_ldisc_feed(ldisc_t* ldisc, const char* input, char* line)
+{
+    int lines = 0;
+    for (; *input != '\0'; input++)
+    {
+        if (ldisc_input(ldisc, *input))
+        {
+            strcpy(line, ldisc->line);
+            lines++;
+        }
+    }
+    return lines;
+}
+
+static int test_ldisc()
+{
+    ldisc_t ldisc;
+    char line[LDISC_LINE_MAX + 1];
+    int failed = 0;
+
+    ldisc_init(&ldisc, 0);
+    if (test_ldisc_feed(&ldisc, "mem\bminfoo\x7F\r", line) != 1 || strcmp(line, "meminfo") != 0)
+    {
+        kprintf("Error: erasing gave the line %s!\n", line);
+        failed = 1;
+    }
+    if (test_ldisc_feed(&ldisc, "bad\x15trace dump\n", line) != 1 || strcmp(line, "trace dump") != 0)
+    {
+        kprintf("Error: killing the line gave %s!\n", line);
+        failed = 1;
+    }
+    if (test_ldisc_feed(&ldisc, "bench\003", line) != 1 || line[0] != '\0')
+    {
+        kprintf("Error: ctrl-C did not abandon the line!\n");
+        failed = 1;
+    }
+
+    // Characters past the end are dropped, the line is still completed
+    ldisc_init(&ldisc, 0);
+    for (uint32_t i = 0; i < LDISC_LINE_MAX + 10; i++)
+    {
+        ldisc_input(&ldisc, 'x');
+    }
+    if (!ldisc_input(&ldisc, '\n') || strlen(ldisc.line) != LDISC_LINE_MAX)
+    {
+        kprintf("Error: an overlong line was not cut at %d characters!\n", LDISC_LINE_MAX);
+        failed = 1;
+    }
+    return failed;
+}
+
+static int test_shell_commands()
+{
+    char line[] = "  bench  ipcbench 7 ";
+    char* argv[SHELL_MAX_ARGS];
+    int failed = 0;
+
+    int argc = shell_split(line, argv, SHELL_MAX_ARGS);
+    if (argc != 3 || strcmp(argv[0], "bench") != 0 || strcmp(argv[1], "ipcbench") != 0 || strcmp(argv[2], "7") != 0)
+    {
+        kprintf("Error: a command line was split into %d words!\n", argc);
+        failed = 1;
+    }
+
+    char many[] = "w1 w2 w3 w4 w5 w6 w7 w8 w9 w10";
+    argc = shell_split(many, argv, SHELL_MAX_ARGS);
+    if (argc != SHELL_MAX_ARGS || strcmp(argv[SHELL_MAX_ARGS - 1], "w8") != 0)
+    {
+        kprintf("Error: the last of %d words kept the rest of the line!\n", argc);
+        failed = 1;
+    }
+
+    char empty[] = "   ";
+    char unknown[] = "no_such_command";
+    char usage[] = "trace sideways";
+    char help[] = "help";
+    if (shell_execute(empty) != 0 || shell_execute(unknown) != -1 || shell_execute(usage) != -1 ||
+        shell_execute(help) != 0)
+    {
+        kprintf("Error: the shell returned the wrong status for a command!\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+void run_shell_tests()
+{
+    kprintf("Running shell tests...\n");
+    int failed = test_keyboard_decode();
+    failed |= test_keyboard_overflow();
+    failed |= test_ldisc();
+    failed |= test_shell_commands();
+    kprintf(failed ? "Shell tests failed.\n" : "Shell tests complete.\n");
+}
@@ -0,0 +1,79 @@
+#include <unit_tests/test_softirq.h>
+
+static volatile uint32_t test_softirq_runs;
+
+static void test_softirq_tasklet_fn(void* data)
+{
+    (void)data;
+    test_softirq_runs++;
+}
+
+void test_softirq_irq_exit()
+{
+    tasklet_t tasklet;
+    tasklet_init(&tasklet, test_softirq_tasklet_fn, NULL);
+    test_softirq_runs = 0;
+
+    // As an interrupt handler would: both schedules are batched into one run at the outermost exit
+    uint32_t irq_flags = local_irq_save();
+    irq_enter();
+    irq_enter();
+    tasklet_schedule(&tasklet);
+    tasklet_schedule(&tasklet);
+    irq_exit();
+    if (test_softirq_runs != 0)
+    {
+        kprintf("Error: softirqs ran at a nested interrupt exit.\n");
+    }
+    irq_exit();
+    local_irq_restore(irq_flags);
+
+    if (test_softirq_runs != 1)
+    {
+        kprintf("Error: a tasklet scheduled twice ran %d times at interrupt exit.\n", test_softirq_runs);
+    }
+}
+
+void test_softirq_bh_disable()
+{
+    tasklet_t tasklet;
+    tasklet_init(&tasklet, test_softirq_tasklet_fn, NULL);
+    test_softirq_runs = 0;
+
+    local_bh_disable();
+    tasklet_schedule(&tasklet);
+    do_softirq();
+    if (test_softirq_runs != 0)
+    {
+        kprintf("Error: a softirq ran while softirqs were disabled.\n");
+    }
+    local_bh_enable();
+
+    if (test_softirq_runs != 1)
+    {
+        kprintf("Error: local_bh_enable() did not run the pending softirq.\n");
+    }
+}
+
+void test_softirq_ksoftirqd()
+{
+    tasklet_t tasklet;
+    tasklet_init(&tasklet, test_softirq_tasklet_fn, NULL);
+    test_softirq_runs = 0;
+
+    // Raised from a thread, so ksoftirqd runs it
+    tasklet_schedule(&tasklet);
+    kthread_yield();
+
+    if (test_softirq_runs != 1)
+    {
+        kprintf("Error: ksoftirqd did not run a tasklet scheduled from a thread.\n");
+    }
+}
+
+void run_softirq_tests()
+{
+    test_softirq_irq_exit();
+    test_softirq_bh_disable();
+    test_softirq_ksoftirqd();
+}
@@ -0,0 +1,111 @@
+#include <unit_tests/test_timer.h>
+
+#define TEST_TIMER_COUNT 4
+
+static volatile uint32_t test_timer_fired;
+
+static void test_timer_fn(ktimer_t* timer)
+{
+    (void)timer;
+    test_timer_fired++;
+}
+
+void test_timer_div64()
+{
+    uint64_t value = 0x123456789ABCDEFULL;
+    if (div64_u32(value, 1000) != 81985529216486ULL || div64_u32(999, 1000) != 0)
+    {
+        kprintf("Error: 64-bit division is wrong.\n");
+    }
+}
+
+void test_timer_add_del()
+{
+    // One timer per wheel level, from tv1 to tv4
+    const uint32_t deltas[TEST_TIMER_COUNT] = { 100, 1000, 20000, 2000000 };
+    ktimer_t timers[TEST_TIMER_COUNT];
+    uint64_t now = jiffies_now();
+
+    for (int i = 0; i < TEST_TIMER_COUNT; i++)
+    {
+        ktimer_init(&timers[i], test_timer_fn);
+        ktimer_add(&timers[i], now + deltas[i]);
+        if (!ktimer_pending(&timers[i]))
+        {
+            kprintf("Error: an armed timer is not pending.\n");
+        }
+    }
+
+    uint64_t next = timer_next_expiry();
+    if (next == TIMER_NEVER || next > now + deltas[0])
+    {
+        kprintf("Error: the next expiry is past the earliest timer.\n");
+    }
+
+    for (int i = 0; i < TEST_TIMER_COUNT; i++)
+    {
+        if (!ktimer_del(&timers[i]) || ktimer_pending(&timers[i]))
+        {
+            kprintf("Error: a pending timer could not be cancelled.\n");
+        }
+    }
+    if (ktimer_del(&timers[0]))
+    {
+        kprintf("Error: a cancelled timer was still pending.\n");
+    }
+}
+
+void test_timer_expiry()
+{
+    ktimer_t early, late, cancelled;
+    uint64_t now = jiffies_now();
+    test_timer_fired = 0;
+
+    ktimer_init(&early, test_timer_fn);
+    ktimer_init(&late, test_timer_fn);
+    ktimer_init(&cancelled, test_timer_fn);
+    ktimer_add(&early, now + 2);
+    ktimer_add(&late, now + 5);
+    ktimer_add(&cancelled, now + 3);
+    ktimer_del(&cancelled);
+
+    timer_sleep_ms(10);
+
+    if (jiffies_now() < now + msecs_to_jiffies(10))
+    {
+        kprintf("Error: timer_sleep_ms() returned early.\n");
+    }
+    if (test_timer_fired != 2 || ktimer_pending(&early) || ktimer_pending(&late))
+    {
+        kprintf("Error: %d of 2 timers fired.\n", test_timer_fired);
+    }
+    ktimer_del(&early);
+    ktimer_del(&late);
+}
+
+void test_timer_tickless()
+{
+    timer_stats_t before, after;
+    timer_get_stats(&before);
+    timer_sleep_ms(50);
+    timer_get_stats(&after);
+
+    // A sleep with nothing else to run halts without a tick per jiffy
+    if (after.idle_entries == before.idle_entries)
+    {
+        kprintf("Error: the CPU did not go idle while sleeping.\n");
+    }
+}
+
+void run_timer_tests()
+{
+    test_timer_div64();
+    if (!timers_available())
+    {
+        return;
+    }
+
+    test_timer_add_del();
+    test_timer_expiry();
+    test_timer_tickless();
+}
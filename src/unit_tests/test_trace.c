@@ -0,0 +1,81 @@
+#include <unit_tests/test_trace.h>
+
+static const trace_record_t* test_trace_last(size_t back)
+{
+    size_t count = trace_count(0);
+    return back < count ? trace_record_at(0, count - 1 - back) : NULL;
+}
+
+void test_trace_disabled()
+{
+    size_t before = trace_count(0);
+    kfree(kmalloc(32));
+
+    if (trace_count(0) != before)
+    {
+        kprintf("Error: disabled tracepoints wrote records.\n");
+    }
+}
+
+void test_trace_kmalloc()
+{
+    trace_enable((1u << TRACE_KMALLOC) | (1u << TRACE_KFREE));
+    void* ptr = kmalloc(48);
+    kfree(ptr);
+    trace_disable(TRACE_ALL);
+
+    const trace_record_t* alloc = test_trace_last(1);
+    const trace_record_t* free = test_trace_last(0);
+    if (alloc == NULL || alloc->event != TRACE_KMALLOC || alloc->args[0] != (uint32_t)ptr || alloc->args[1] != 48)
+    {
+        kprintf("Error: kmalloc was not traced.\n");
+        return;
+    }
+    if (free == NULL || free->event != TRACE_KFREE || free->args[0] != (uint32_t)ptr)
+    {
+        kprintf("Error: kfree was not traced.\n");
+        return;
+    }
+    if (free->tsc < alloc->tsc)
+    {
+        kprintf("Error: trace timestamps go backwards.\n");
+    }
+}
+
+static void test_trace_thread(void* arg)
+{
+    (void)arg;
+}
+
+void test_trace_switch()
+{
+    kthread_t* thread = kthread_create(test_trace_thread, NULL, "tracetest");
+    if (thread == NULL)
+    {
+        kprintf("Error: could not create a thread for the trace test.\n");
+        return;
+    }
+
+    size_t before = trace_count(0);
+    trace_enable(1u << TRACE_SWITCH);
+    kthread_yield();
+    trace_disable(TRACE_ALL);
+
+    for (size_t i = before; i < trace_count(0); i++)
+    {
+        const trace_record_t* record = trace_record_at(0, i);
+        if (record->event == TRACE_SWITCH && record->args[1] == (uint32_t)thread &&
+            memcmp(&record->args[2], "tracetes", 8) == 0)
+        {
+            return;
+        }
+    }
+    kprintf("Error: the switch to a new thread was not traced.\n");
+}
+
+void run_trace_tests()
+{
+    test_trace_disabled();
+    test_trace_kmalloc();
+    test_trace_switch();
+}
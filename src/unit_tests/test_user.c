@@ -0,0 +1,489 @@
+#include <unit_tests/test_user.h>
+
+// Scratch user range for the demand paging tests, far from any program
+#define TEST_USER_VMA_ADDR 0x10000000
+
+static void test_user_elf_header_init(elf32_ehdr_t* header)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = ELF_MAGIC;
+    header->class = ELF_CLASS_32;
+    header->data = ELF_DATA_LSB;
+    header->type = ELF_TYPE_EXEC;
+    header->machine = ELF_MACHINE_386;
+    header->phoff = sizeof(elf32_ehdr_t);
+    header->phentsize = sizeof(elf32_phdr_t);
+    header->phnum = 1;
+}
+
+void test_user_elf_header()
+{
+    elf32_ehdr_t header;
+    uint64_t size = sizeof(elf32_ehdr_t) + sizeof(elf32_phdr_t);
+
+    test_user_elf_header_init(&header);
+    if (elf_check_header(&header, size) != 0)
+    {
+        kprintf("Error: a valid ELF header was rejected.\n");
+    }
+
+    header.machine = 62;
+    if (elf_check_header(&header, size) == 0)
+    {
+        kprintf("Error: an x86-64 executable was accepted.\n");
+    }
+
+    test_user_elf_header_init(&header);
+    header.phnum = 2;
+    if (elf_check_header(&header, size) == 0)
+    {
+        kprintf("Error: program headers past the end of the file were accepted.\n");
+    }
+
+    test_user_elf_header_init(&header);
+    header.magic = 0;
+    if (elf_check_header(&header, size) == 0)
+    {
+        kprintf("Error: a file without the ELF magic was accepted.\n");
+    }
+}
+
+void test_user_elf_segment()
+{
+    elf32_phdr_t phdr = {
+        .type = ELF_PT_LOAD,
+        .offset = 0x1000,
+        .vaddr = 0x08048000,
+        .filesz = 0x800,
+        .memsz = 0x2000,
+    };
+
+    if (elf_check_segment(&phdr, 0x2000, USER_IMAGE_END) != 0)
+    {
+        kprintf("Error: a valid segment was rejected.\n");
+    }
+    if (elf_check_segment(&phdr, 0x1400, USER_IMAGE_END) == 0)
+    {
+        kprintf("Error: a segment past the end of the file was accepted.\n");
+    }
+
+    phdr.vaddr = KERNEL_BASE_VIRTUAL_ADDR;
+    if (elf_check_segment(&phdr, 0x2000, USER_IMAGE_END) == 0)
+    {
+        kprintf("Error: a segment in kernel space was accepted.\n");
+    }
+
+    phdr.vaddr = USER_IMAGE_END - 0x1000;
+    if (elf_check_segment(&phdr, 0x2000, USER_IMAGE_END) == 0)
+    {
+        kprintf("Error: a segment running into the stack was accepted.\n");
+    }
+}
+
+void test_user_vdso()
+{
+    const vdso_data_t* data = vdso_get_data();
+    if (data == NULL)
+    {
+        kprintf("Error: the vDSO is not set up.\n");
+        return;
+    }
+
+    if (data->version != VDSO_VERSION || data->tsc_khz != tsc_khz || data->hz != TIMER_HZ)
+    {
+        kprintf("Error: the vDSO data page does not match the kernel clock.\n");
+    }
+    if (data->syscall_entry < VDSO_TEXT_ADDR || data->syscall_entry >= VDSO_TEXT_ADDR + PAGE_SIZE ||
+        (data->syscall_entry == data->int80_entry) == syscall_sysenter_enabled())
+    {
+        kprintf("Error: the vDSO entry points are wrong.\n");
+    }
+
+    if (!user_access_ok(VDSO_DATA_ADDR, sizeof(vdso_data_t), 0) || user_access_ok(VDSO_DATA_ADDR, 4, 1))
+    {
+        kprintf("Error: the vDSO data page is not read-only for user mode.\n");
+    }
+    if (user_access_ok(KERNEL_BASE_VIRTUAL_ADDR, 4, 0) || user_access_ok(USER_SPACE_END - 4, 8, 0))
+    {
+        kprintf("Error: a kernel address passed as user memory.\n");
+    }
+}
+
+static int test_user_count_page(uintptr_t virtual_addr, pte_t* entry, void* ctx)
+{
+    (void)virtual_addr, (void)entry;
+    (*(size_t*)ctx)++;
+    return 0;
+}
+
+void test_user_vma()
+{
+    inode_t* inode = vfs_lookup("/bin/sysbench");
+    if (inode == NULL || inode->size < PAGE_SIZE + 16)
+    {
+        return;
+    }
+
+    // A whole file page, a page with 16 bytes of file data, and a page of zeroes
+    vma_t* vmas = NULL;
+    if (vma_map_file(&vmas, TEST_USER_VMA_ADDR, 3 * PAGE_SIZE, PG_WRITE | PG_NX, inode, 0, PAGE_SIZE + 16) != 0 ||
+        vma_map_anon(&vmas, TEST_USER_VMA_ADDR + 4 * PAGE_SIZE, PAGE_SIZE, PG_NX) != 0)
+    {
+        kprintf("Error: an area could not be reserved.\n");
+        vma_unmap_all(&vmas);
+        return;
+    }
+    if (vma_map_anon(&vmas, TEST_USER_VMA_ADDR + 2 * PAGE_SIZE, 2 * PAGE_SIZE, 0) == 0)
+    {
+        kprintf("Error: overlapping areas were reserved.\n");
+    }
+
+    vma_stats_t before, after;
+    vma_get_stats(&before);
+
+    const uint8_t* base = (const uint8_t*)TEST_USER_VMA_ADDR;
+    if (vma_fault(vmas, TEST_USER_VMA_ADDR + 8, 0) != 0 || *(const uint32_t*)base != ELF_MAGIC ||
+        (*get_pte(TEST_USER_VMA_ADDR, 0) & PG_WRITE))
+    {
+        kprintf("Error: a file page was not mapped read-only from the page cache.\n");
+    }
+
+    uint8_t head[16];
+    file_read(inode, PAGE_SIZE, head, sizeof(head));
+    if (vma_fault(vmas, TEST_USER_VMA_ADDR + PAGE_SIZE, 0) != 0 ||
+        memcmp(base + PAGE_SIZE, head, sizeof(head)) != 0 || base[PAGE_SIZE + sizeof(head)] != 0)
+    {
+        kprintf("Error: a partial file page was not filled with the file data and zeroes.\n");
+    }
+
+    if (virt_to_phys(TEST_USER_VMA_ADDR + 2 * PAGE_SIZE) != 0)
+    {
+        kprintf("Error: a page was mapped before it was touched.\n");
+    }
+
+    phys_addr_t shared = virt_to_phys(TEST_USER_VMA_ADDR);
+    if (vma_fault(vmas, TEST_USER_VMA_ADDR, PF_ERROR_PRESENT | PF_ERROR_WRITE) != 0 ||
+        virt_to_phys(TEST_USER_VMA_ADDR) == shared ||
+        *(const uint32_t*)base != ELF_MAGIC || !(*get_pte(TEST_USER_VMA_ADDR, 0) & PG_WRITE))
+    {
+        kprintf("Error: writing a shared file page did not copy it.\n");
+    }
+
+    if (vma_fault(vmas, TEST_USER_VMA_ADDR + 3 * PAGE_SIZE, 0) == 0 ||
+        vma_fault(vmas, TEST_USER_VMA_ADDR + 4 * PAGE_SIZE, PF_ERROR_WRITE) == 0 ||
+        vma_fault(vmas, TEST_USER_VMA_ADDR, PF_ERROR_PRESENT | PF_ERROR_FETCH) == 0)
+    {
+        kprintf("Error: a fault outside an area or against its protection was resolved.\n");
+    }
+
+    vma_get_stats(&after);
+    if (after.shared != before.shared + 1 || after.private != before.private + 1 || after.cow != before.cow + 1)
+    {
+        kprintf("Error: the fault counters are off.\n");
+    }
+
+    vma_unmap_all(&vmas);
+    size_t mapped = 0;
+    walk(TEST_USER_VMA_ADDR, 5 * PAGE_SIZE, test_user_count_page, &mapped);
+    if (vmas != NULL || mapped != 0)
+    {
+        kprintf("Error: unmapping the areas left pages behind.\n");
+    }
+}
+
+void test_user_address_space()
+{
+    size_t before = address_space_count();
+    address_space_t* space = address_space_create();
+    if (space == NULL)
+    {
+        kprintf("Error: an address space could not be created.\n");
+        return;
+    }
+    if (address_space_count() != before + 1)
+    {
+        kprintf("Error: the address space was not counted.\n");
+    }
+
+    // A user page mapped in one address space is invisible in the other,
+    // while the kernel stays mapped in both
+    address_space_switch(space);
+    map_page(TEST_USER_VMA_ADDR, 0x100000, PG_PRESENT | PG_WRITE);
+    if (virt_to_phys(TEST_USER_VMA_ADDR) != 0x100000 ||
+        virt_to_phys(RECURSIVE_PD_ADDR) != space->directories[0] ||
+        virt_to_phys((uintptr_t)&before) == 0)
+    {
+        kprintf("Error: the new address space does not map what it should.\n");
+    }
+    address_space_switch(NULL);
+
+    if (virt_to_phys(TEST_USER_VMA_ADDR) != 0)
+    {
+        kprintf("Error: a user mapping leaked into the kernel's address space.\n");
+    }
+
+    address_space_destroy(space);
+    if (address_space_count() != before)
+    {
+        kprintf("Error: the address space was not destroyed.\n");
+    }
+}
+
+void test_user_vma_move()
+{
+    vma_t* vmas = NULL;
+    uintptr_t from = TEST_USER_VMA_ADDR;
+    uintptr_t to = TEST_USER_VMA_ADDR + 4 * PAGE_SIZE;
+    if (vma_map_anon(&vmas, from, 2 * PAGE_SIZE, PG_WRITE | PG_NX) != 0 ||
+        vma_map_anon(&vmas, to, 2 * PAGE_SIZE, PG_WRITE | PG_NX) != 0 ||
+        vma_map_anon(&vmas, to + 4 * PAGE_SIZE, PAGE_SIZE, PG_NX) != 0)
+    {
+        kprintf("Error: an area could not be reserved.\n");
+        vma_unmap_all(&vmas);
+        return;
+    }
+
+    // The first page is written, the second never touched
+    vma_fault(vmas, from, PF_ERROR_WRITE);
+    *(uint32_t*)from = 0x1234;
+    vma_fault(vmas, to, PF_ERROR_WRITE);
+
+    phys_addr_t frames[2];
+    if (vma_detach_pages(vmas, from, 2, frames) != 0 || virt_to_phys(from) != 0 || virt_to_phys(from + PAGE_SIZE) != 0)
+    {
+        kprintf("Error: detaching pages left them mapped.\n");
+        vma_unmap_all(&vmas);
+        return;
+    }
+
+    if (vma_attach_pages(vmas, to, 2, frames) != 0 ||
+        virt_to_phys(to) != frames[0] || virt_to_phys(to + PAGE_SIZE) != frames[1] ||
+        *(uint32_t*)to != 0x1234 || *(uint32_t*)(to + PAGE_SIZE) != 0)
+    {
+        kprintf("Error: attached pages do not hold the detached frames.\n");
+    }
+
+    if (vma_detach_pages(vmas, to + 4 * PAGE_SIZE, 1, frames) == 0 || vma_detach_pages(vmas, to, 3, frames) == 0 ||
+        vma_attach_pages(vmas, to + 1, 1, frames) == 0)
+    {
+        kprintf("Error: pages were moved out of a read-only, short or unaligned range.\n");
+    }
+
+    vma_unmap_all(&vmas);
+}
+
+static uint32_t test_user_ipc_port;
+static uint32_t test_user_ipc_words[IPC_WORDS];
+static int test_user_ipc_result;
+
+static void test_user_ipc_receiver(void* arg)
+{
+    (void)arg;
+    uint32_t sender = 1;
+    test_user_ipc_result = ipc_recv(test_user_ipc_port, 0, 0, test_user_ipc_words, &sender);
+    if (sender != 0)
+    {
+        test_user_ipc_result = -1;
+    }
+}
+
+void test_user_ipc()
+{
+    int port = ipc_port_create(NULL);
+    if (port < 0)
+    {
+        kprintf("Error: an IPC port could not be created.\n");
+        return;
+    }
+    test_user_ipc_port = port;
+    test_user_ipc_result = -2;
+
+    kthread_t* receiver = kthread_create(test_user_ipc_receiver, NULL, "ipc-test");
+    uint32_t words[IPC_WORDS] = { 0xCAFE, 0xF00D };
+    if (receiver == NULL || ipc_send(port, words, 0, 0) != 0)
+    {
+        kprintf("Error: a message between kernel threads was not delivered.\n");
+    }
+
+    // The receiver returns from ipc_recv() once it runs again
+    for (int i = 0; i < 10 && test_user_ipc_result == -2; i++)
+    {
+        kthread_yield();
+    }
+    if (test_user_ipc_result != 0 || test_user_ipc_words[0] != 0xCAFE || test_user_ipc_words[1] != 0xF00D)
+    {
+        kprintf("Error: the message arrived as %x %x.\n", test_user_ipc_words[0], test_user_ipc_words[1]);
+    }
+
+    if (ipc_send(port, words, TEST_USER_VMA_ADDR, 1) == 0)
+    {
+        kprintf("Error: a kernel thread sent pages.\n");
+    }
+
+    ipc_port_close(port);
+    uint32_t sender;
+    if (ipc_send(port, words, 0, 0) == 0 || ipc_recv(port, 0, 0, words, &sender) >= 0)
+    {
+        kprintf("Error: a closed port still passes messages.\n");
+    }
+}
+
+// An executable whose second segment overlaps the first, so loading fails after one area is reserved
+static uint8_t test_user_bad_elf[PAGE_SIZE];
+static inode_t test_user_bad_inode;
+
+static int test_user_bad_readpage(inode_t* inode, page_t* page)
+{
+    (void)inode;
+    uint8_t* dest = (uint8_t*)kmap_atomic(page->phys);
+    if (dest == NULL)
+    {
+        page_end_read(page, 0);
+        return -1;
+    }
+    memcpy(dest, test_user_bad_elf, PAGE_SIZE);
+    kunmap_atomic(dest);
+    page_end_read(page, 1);
+    return 0;
+}
+
+static const inode_ops_t test_user_bad_ops = {
+    .readpage = test_user_bad_readpage,
+};
+
+/**
+ * @brief A failed spawn must leave the loaded address space alone, even
+ *        where the new program's areas overlap its pages.
+ */
+void test_user_spawn_failure()
+{
+    elf32_ehdr_t* header = (elf32_ehdr_t*)test_user_bad_elf;
+    elf32_phdr_t* phdrs = (elf32_phdr_t*)(header + 1);
+    test_user_elf_header_init(header);
+    header->phnum = 2;
+    header->entry = TEST_USER_VMA_ADDR;
+    for (size_t i = 0; i < 2; i++)
+    {
+        phdrs[i].type = ELF_PT_LOAD;
+        phdrs[i].vaddr = TEST_USER_VMA_ADDR;
+        phdrs[i].filesz = PAGE_SIZE;
+        phdrs[i].memsz = PAGE_SIZE;
+        phdrs[i].flags = ELF_PF_R | ELF_PF_X;
+    }
+    inode_init(&test_user_bad_inode, PAGE_SIZE, &test_user_bad_ops, NULL, NULL);
+
+    address_space_t* space = address_space_create();
+    vma_t* vmas = NULL;
+    if (space == NULL || vma_map_anon(&vmas, TEST_USER_VMA_ADDR, PAGE_SIZE, PG_WRITE | PG_NX) != 0)
+    {
+        kprintf("Error: a resident program could not be set up.\n");
+        if (space != NULL)
+        {
+            address_space_destroy(space);
+        }
+        return;
+    }
+
+    // As if a program, or a kernel thread borrowing its address space, spawned the bad one
+    address_space_switch(space);
+    vma_fault(vmas, TEST_USER_VMA_ADDR, PF_ERROR_WRITE);
+    *(volatile uint32_t*)TEST_USER_VMA_ADDR = 0x5A5A5A5A;
+    phys_addr_t frame = virt_to_phys(TEST_USER_VMA_ADDR);
+
+    if (process_spawn_inode(&test_user_bad_inode, "badelf", 0) != NULL)
+    {
+        kprintf("Error: an executable with overlapping segments was started.\n");
+    }
+    if (frame == 0 || virt_to_phys(TEST_USER_VMA_ADDR) != frame || *(volatile uint32_t*)TEST_USER_VMA_ADDR != 0x5A5A5A5A)
+    {
+        kprintf("Error: a failed spawn unmapped the running program's page.\n");
+    }
+
+    vma_unmap_all(&vmas);
+    address_space_switch(NULL);
+    address_space_destroy(space);
+}
+
+/**
+ * @brief Runs a program from the initrd and returns its exit code, or 1 if it is not there.
+ */
+static int test_user_run(const char* path, int expected)
+{
+    if (vfs_lookup(path) == NULL)
+    {
+        return 1;
+    }
+
+    process_t* process = process_spawn(path, 0);
+    if (process == NULL)
+    {
+        kprintf("Error: %s could not be started.\n", path);
+        return 1;
+    }
+
+    int code = process_wait(process);
+    if (code != expected)
+    {
+        kprintf("Error: %s exited with %d instead of %d.\n", path, code, expected);
+    }
+    if (process_current() != NULL || address_space_count() != 0)
+    {
+        kprintf("Error: %s left its address space behind.\n", path);
+    }
+    return 0;
+}
+
+void test_user_programs()
+{
+    syscall_stats_t before, after;
+    syscall_get_stats(&before);
+
+    if (test_user_run("/bin/sysbench", 0) != 0)
+    {
+        return;
+    }
+
+    syscall_get_stats(&after);
+    if (after.calls == before.calls || (syscall_sysenter_enabled() && after.sysenter == before.sysenter))
+    {
+        kprintf("Error: the benchmark made no system calls.\n");
+    }
+
+    test_user_run("/bin/fault", -1);
+
+    // Two programs at once, each in an address space of its own
+    process_t* first = process_spawn("/bin/fault", 0);
+    process_t* second = process_spawn("/bin/fault", 0);
+    if (first == NULL || second == NULL || first->space == second->space || address_space_count() != 2)
+    {
+        kprintf("Error: two programs could not be loaded side by side.\n");
+    }
+    if ((first != NULL && process_wait(first) != -1) || (second != NULL && process_wait(second) != -1))
+    {
+        kprintf("Error: a program running next to another exited wrongly.\n");
+    }
+
+    ipc_stats_t ipc_before, ipc_after;
+    ipc_get_stats(&ipc_before);
+    if (test_user_run("/bin/ipcbench", 0) == 0)
+    {
+        ipc_get_stats(&ipc_after);
+        if (ipc_after.messages == ipc_before.messages || ipc_after.pages == ipc_before.pages)
+        {
+            kprintf("Error: the IPC benchmark passed no messages or pages.\n");
+        }
+    }
+}
+
+void run_user_tests()
+{
+    test_user_elf_header();
+    test_user_elf_segment();
+    test_user_vdso();
+    test_user_vma();
+    test_user_address_space();
+    test_user_vma_move();
+    test_user_ipc();
+    test_user_spawn_failure();
+    test_user_programs();
+}
@@ -0,0 +1,87 @@
+#include <unit_tests/test_vmalloc.h>
+
+void test_vmalloc_large_buffer()
+{
+    size_t size = 3 * 1024 * 1024 + 123;
+
+    // Page tables for the range stay allocated after vfree, so create them before counting
+    vfree(vmalloc(size));
+    size_t free_before = get_free_page_count();
+
+    uint8_t* buffer = (uint8_t*)vmalloc(size);
+    if (buffer == NULL)
+    {
+        kprintf("Error: vmalloc failed to allocate %d bytes.\n", size);
+        return;
+    }
+
+    // Touch every page, first and last byte included
+    for (size_t i = 0; i < size; i += PAGE_SIZE)
+    {
+        buffer[i] = (uint8_t)(i >> 12);
+    }
+    buffer[size - 1] = 0x5A;
+
+    if (buffer[PAGE_SIZE * 5] != 5 || buffer[size - 1] != 0x5A)
+    {
+        kprintf("Error: vmalloc buffer at %x lost its contents.\n", buffer);
+    }
+
+    vfree(buffer);
+
+    if (get_free_page_count() != free_before)
+    {
+        kprintf("Error: vfree leaked pages, %d free instead of %d.\n", get_free_page_count(), free_before);
+    }
+    else
+    {
+        kprintf("vmalloc large buffer test passed! Address: %x\n", buffer);
+    }
+}
+
+void test_vmalloc_reuse()
+{
+    void* first = vmalloc(PAGE_SIZE);
+    vfree(first);
+    void* second = vmalloc(PAGE_SIZE);
+
+    if (second != first)
+    {
+        kprintf("Error: vmalloc did not reuse the freed range %x, got %x.\n", first, second);
+    }
+    else
+    {
+        kprintf("vmalloc reuse test passed! Address: %x\n", second);
+    }
+    vfree(second);
+}
+
+void test_vmap_frame_zero()
+{
+    // Frame 0 translates to 0 like an unmapped page; the area's length must not depend on that
+    uint8_t* mapped = (uint8_t*)vmap_range(0, 2 * PAGE_SIZE, PG_NX);
+    if (mapped == NULL)
+    {
+        kprintf("Error: vmap_range could not map frame 0.\n");
+        return;
+    }
+
+    vunmap(mapped);
+    if (get_pte((uintptr_t)mapped, 0) != NULL && *get_pte((uintptr_t)mapped, 0) != 0)
+    {
+        kprintf("Error: vunmap left a mapping of frame 0 at %x.\n", mapped);
+    }
+    if (get_pte((uintptr_t)mapped + PAGE_SIZE, 0) != NULL && *get_pte((uintptr_t)mapped + PAGE_SIZE, 0) != 0)
+    {
+        kprintf("Error: vunmap left the second page at %x mapped.\n", mapped + PAGE_SIZE);
+    }
+}
+
+void run_vmalloc_tests()
+{
+    kprintf("Running vmalloc tests...\n");
+    test_vmalloc_large_buffer();
+    test_vmalloc_reuse();
+    test_vmap_frame_zero();
+    kprintf("vmalloc tests complete.\n");
+}
@@ -0,0 +1,93 @@
+#include <unit_tests/test_workqueue.h>
+
+#define TEST_WORKQUEUE_ITEMS 4
+
+typedef struct test_work
+{
+    work_t work;
+    uint32_t id;
+} test_work_t;
+
+static uint32_t test_workqueue_order[TEST_WORKQUEUE_ITEMS];
+static uint32_t test_workqueue_done;
+
+static void test_workqueue_fn(work_t* work)
+{
+    test_work_t* item = (test_work_t*)work;
+    if (test_workqueue_done < TEST_WORKQUEUE_ITEMS)
+    {
+        test_workqueue_order[test_workqueue_done] = item->id;
+    }
+    test_workqueue_done++;
+}
+
+void test_workqueue_order_and_flush()
+{
+    test_work_t items[TEST_WORKQUEUE_ITEMS];
+    test_workqueue_done = 0;
+
+    for (uint32_t i = 0; i < TEST_WORKQUEUE_ITEMS; i++)
+    {
+        work_init(&items[i].work, test_workqueue_fn);
+        items[i].id = i;
+        if (!schedule_work(&items[i].work))
+        {
+            kprintf("Error: could not queue work item %d.\n", i);
+            return;
+        }
+    }
+
+    if (schedule_work(&items[0].work))
+    {
+        kprintf("Error: a pending work item was queued twice.\n");
+    }
+
+    flush_workqueue(system_wq);
+
+    if (test_workqueue_done != TEST_WORKQUEUE_ITEMS)
+    {
+        kprintf("Error: flush_workqueue() returned after %d of %d items.\n", test_workqueue_done, TEST_WORKQUEUE_ITEMS);
+        return;
+    }
+    for (uint32_t i = 0; i < TEST_WORKQUEUE_ITEMS; i++)
+    {
+        if (test_workqueue_order[i] != i)
+        {
+            kprintf("Error: work items ran out of order.\n");
+            return;
+        }
+    }
+}
+
+void test_workqueue_requeue()
+{
+    test_work_t item;
+    work_init(&item.work, test_workqueue_fn);
+    item.id = 0;
+    test_workqueue_done = 0;
+
+    schedule_work(&item.work);
+    flush_workqueue(system_wq);
+    if (!schedule_work(&item.work))
+    {
+        kprintf("Error: a finished work item could not be queued again.\n");
+    }
+    flush_workqueue(system_wq);
+
+    if (test_workqueue_done != 2)
+    {
+        kprintf("Error: a requeued work item ran %d times.\n", test_workqueue_done);
+    }
+}
+
+void run_workqueue_tests()
+{
+    if (system_wq == NULL)
+    {
+        kprintf("Error: there is no system workqueue.\n");
+        return;
+    }
+
+    test_workqueue_order_and_flush();
+    test_workqueue_requeue();
+}
@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""Write out the branch counters a pgo-gen kernel dumped over the serial port.
+
+make pgo runs this between booting the pgo-gen kernel and building pgo-use.
+The dump holds one .gcda file per object, named as the compiler named it,
+under the pgo-gen object directory; each is written to the same place
+under the destination object directory, where -fbranch-probabilities
+looks for it when compiling the same source there.
+
+usage: gcov_extract.py <serial.log> <pgo-gen object dir> <destination object dir>
+"""
+
+import os
+import struct
+import sys
+
+BEGIN = b"\n@@GCOV\n"
+END = b"\n@@END\n"
+
+HEADER = struct.Struct("<II")
+
+
+def read_dump(data):
+    start = data.rfind(BEGIN)
+    if start < 0:
+        raise ValueError("no gcov dump found; did the pgo-gen kernel finish booting?")
+    offset = start + len(BEGIN)
+
+    units = []
+    while True:
+        name_size, data_size = HEADER.unpack_from(data, offset)
+        offset += HEADER.size
+        if name_size == 0:
+            break
+        name = data[offset:offset + name_size].decode()
+        offset += name_size
+        units.append((name, data[offset:offset + data_size]))
+        offset += data_size
+        if offset > len(data):
+            raise ValueError("the dump is cut short")
+
+    if data[offset:offset + len(END)] != END:
+        raise ValueError("the dump does not end where expected")
+    return units
+
+
+def relocate(name, source, dest):
+    """Maps a .gcda path under the source object directory to the destination one."""
+    name = os.path.normpath(name)
+    for prefix in (os.path.abspath(source), os.path.normpath(source)):
+        if name.startswith(prefix + os.sep):
+            return os.path.join(dest, os.path.relpath(name, prefix))
+
+    # The compiler may have made the path absolute from another working directory
+    marker = os.sep + os.path.normpath(source) + os.sep
+    index = name.find(marker)
+    if index < 0:
+        return None
+    return os.path.join(dest, name[index + len(marker):])
+
+
+def main():
+    if len(sys.argv) != 4:
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        return 1
+
+    with open(sys.argv[1], "rb") as f:
+        units = read_dump(f.read())
+
+    written = 0
+    for name, contents in units:
+        path = relocate(name, sys.argv[2], sys.argv[3])
+        if path is None:
+            print(f"gcov_extract: skipping {name}, not under {sys.argv[2]}", file=sys.stderr)
+            continue
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "wb") as f:
+            f.write(contents)
+        written += 1
+
+    print(f"gcov_extract: wrote {written} of {len(units)} .gcda files under {sys.argv[3]}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
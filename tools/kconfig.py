@@ -0,0 +1,283 @@
+#!/usr/bin/env python3
+"""Resolve the kernel configuration and write the headers the build uses.
+
+Reads the option definitions from a Kconfig file, in the subset of the
+Kconfig language the kernel uses: config entries of type bool, int, hex
+or string with defaults (optionally conditional on a bool), ranges and
+help, grouped in menus and choices. Values come from, in increasing
+priority, the defaults, an optional config fragment and NAME=value
+overrides on the command line.
+
+Writes to the output directory:
+  config.h   #defines for every C file, included with -include
+  config.ld  the same values as linker script symbols, bools as 0 or 1
+  .config    the resolved configuration, usable as a fragment again
+
+Files are only rewritten when their contents change, so the objects that
+depend on them are not rebuilt needlessly. With --print, the resolved
+options are also listed.
+
+usage: kconfig.py [--print] <Kconfig> <output dir> [fragment] [NAME=value...]
+"""
+
+import os
+import re
+import sys
+
+
+class Option:
+    def __init__(self, name, line):
+        self.name = name
+        self.line = line
+        self.type = None
+        self.prompt = ""
+        self.defaults = []      # (value, condition or None), first match wins
+        self.range = None
+        self.choice = None
+        self.value = None
+
+
+class Choice:
+    def __init__(self, line):
+        self.line = line
+        self.prompt = ""
+        self.default = None
+        self.members = []
+
+
+class KconfigError(Exception):
+    pass
+
+
+def parse(path):
+    options = {}
+    choices = []
+    current = None
+    choice = None
+    in_help = False
+
+    with open(path) as f:
+        lines = f.read().splitlines()
+
+    for number, raw in enumerate(lines, 1):
+        where = f"{path}:{number}"
+        if in_help:
+            if raw.strip() == "" or raw[:1].isspace():
+                continue
+            in_help = False
+
+        line = raw.strip()
+        if line == "" or line.startswith("#"):
+            continue
+        words = line.split(None, 1)
+        keyword = words[0]
+        rest = words[1] if len(words) > 1 else ""
+
+        if keyword in ("mainmenu", "menu", "endmenu", "comment"):
+            current = None
+        elif keyword == "config":
+            if rest in options:
+                raise KconfigError(f"{where}: {rest} is defined twice")
+            current = Option(rest, where)
+            options[rest] = current
+            if choice is not None:
+                current.choice = choice
+                choice.members.append(current)
+        elif keyword == "choice":
+            choice = Choice(where)
+            choices.append(choice)
+            current = choice
+        elif keyword == "endchoice":
+            if choice is None:
+                raise KconfigError(f"{where}: endchoice without choice")
+            choice = None
+            current = None
+        elif keyword in ("bool", "int", "hex", "string"):
+            if not isinstance(current, Option):
+                raise KconfigError(f"{where}: {keyword} outside a config entry")
+            current.type = keyword
+            current.prompt = rest.strip('"')
+        elif keyword == "prompt":
+            current.prompt = rest.strip('"')
+        elif keyword == "default":
+            match = re.match(r'^("[^"]*"|\S+)(?:\s+if\s+(\w+))?$', rest)
+            if match is None:
+                raise KconfigError(f"{where}: cannot parse default {rest}")
+            if isinstance(current, Choice):
+                current.default = match.group(1)
+            else:
+                current.defaults.append((match.group(1).strip('"'), match.group(2)))
+        elif keyword == "range":
+            low, high = rest.split()
+            current.range = (int(low, 0), int(high, 0))
+        elif keyword == "help":
+            in_help = True
+        else:
+            raise KconfigError(f"{where}: unknown keyword {keyword}")
+
+    for option in options.values():
+        if option.type is None:
+            raise KconfigError(f"{option.line}: {option.name} has no type")
+        if option.choice is not None and option.type != "bool":
+            raise KconfigError(f"{option.line}: choice member {option.name} must be a bool")
+    for choice in choices:
+        names = [member.name for member in choice.members]
+        if choice.default not in names:
+            raise KconfigError(f"{choice.line}: the default must be one of {', '.join(names)}")
+    return options, choices
+
+
+def read_fragment(path):
+    values = []
+    with open(path) as f:
+        for number, raw in enumerate(f.read().splitlines(), 1):
+            line = raw.strip()
+            match = re.match(r"^# CONFIG_(\w+) is not set$", line)
+            if match:
+                values.append((match.group(1), "n", f"{path}:{number}"))
+                continue
+            if line == "" or line.startswith("#"):
+                continue
+            match = re.match(r"^CONFIG_(\w+)=(.*)$", line)
+            if match is None:
+                raise KconfigError(f"{path}:{number}: expected CONFIG_NAME=value")
+            values.append((match.group(1), match.group(2).strip('"'), f"{path}:{number}"))
+    return values
+
+
+def parse_value(option, text, where):
+    if option.type == "bool":
+        if text not in ("y", "n"):
+            raise KconfigError(f"{where}: {option.name} takes y or n, not {text}")
+        return text == "y"
+    if option.type in ("int", "hex"):
+        try:
+            value = int(text, 0)
+        except ValueError:
+            raise KconfigError(f"{where}: {option.name} takes a number, not {text}")
+        if option.range is not None and not option.range[0] <= value <= option.range[1]:
+            raise KconfigError(f"{where}: {option.name}={text} is outside {option.range[0]}..{option.range[1]}")
+        return value
+    return text
+
+
+def resolve(options, choices, assignments):
+    explicit = {}
+    for name, text, where in assignments:
+        name = name[len("CONFIG_"):] if name.startswith("CONFIG_") else name
+        if name not in options:
+            raise KconfigError(f"{where}: unknown option {name}")
+        explicit[name] = parse_value(options[name], text, where)
+
+    # In file order, so a conditional default sees the options above it
+    for option in options.values():
+        if option.choice is not None:
+            continue
+        if option.name in explicit:
+            option.value = explicit[option.name]
+            continue
+        for text, condition in option.defaults:
+            if condition is not None and (condition not in options or options[condition].type != "bool"):
+                raise KconfigError(f"{option.line}: {option.name} depends on {condition}, which is not a bool")
+            if condition is None or options[condition].value is True:
+                option.value = parse_value(option, text, option.line)
+                break
+        if option.value is None:
+            option.value = False if option.type == "bool" else None
+        if option.value is None:
+            raise KconfigError(f"{option.line}: {option.name} has no value")
+
+    # The last member set to y wins; setting every member to n falls back to the default
+    for choice in choices:
+        selected = choice.default
+        for name, _, _ in assignments:
+            name = name[len("CONFIG_"):] if name.startswith("CONFIG_") else name
+            if options[name].choice is choice and explicit[name]:
+                selected = name
+        for member in choice.members:
+            member.value = member.name == selected
+
+
+def config_h(options):
+    lines = ["// Generated by tools/kconfig.py from Kconfig; do not edit", "#ifndef CONFIG_H", "#define CONFIG_H", ""]
+    for option in options.values():
+        if option.type == "bool":
+            lines.append(f"#define CONFIG_{option.name} 1" if option.value else f"// CONFIG_{option.name} is not set")
+        elif option.type == "int":
+            lines.append(f"#define CONFIG_{option.name} {option.value}")
+        elif option.type == "hex":
+            lines.append(f"#define CONFIG_{option.name} 0x{option.value:X}")
+        else:
+            lines.append(f'#define CONFIG_{option.name} "{option.value}"')
+    lines += ["", "#endif //CONFIG_H", ""]
+    return "\n".join(lines)
+
+
+def config_ld(options):
+    lines = ["/* Generated by tools/kconfig.py from Kconfig; do not edit */"]
+    for option in options.values():
+        if option.type == "bool":
+            lines.append(f"CONFIG_{option.name} = {1 if option.value else 0};")
+        elif option.type in ("int", "hex"):
+            lines.append(f"CONFIG_{option.name} = 0x{option.value:X};")
+    return "\n".join(lines) + "\n"
+
+
+def dot_config(options):
+    lines = []
+    for option in options.values():
+        if option.type == "bool":
+            lines.append(f"CONFIG_{option.name}=y" if option.value else f"# CONFIG_{option.name} is not set")
+        elif option.type == "hex":
+            lines.append(f"CONFIG_{option.name}=0x{option.value:X}")
+        elif option.type == "int":
+            lines.append(f"CONFIG_{option.name}={option.value}")
+        else:
+            lines.append(f'CONFIG_{option.name}="{option.value}"')
+    return "\n".join(lines) + "\n"
+
+
+def write_if_changed(path, contents):
+    if os.path.exists(path):
+        with open(path) as f:
+            if f.read() == contents:
+                return
+    with open(path, "w") as f:
+        f.write(contents)
+
+
+def main():
+    args = sys.argv[1:]
+    show = "--print" in args
+    args = [arg for arg in args if arg != "--print"]
+    if len(args) < 2:
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        return 1
+
+    kconfig, out_dir = args[0], args[1]
+    assignments = []
+    for arg in args[2:]:
+        if "=" in arg:
+            name, text = arg.split("=", 1)
+            assignments.append((name, text, "command line"))
+        elif arg != "":
+            assignments += read_fragment(arg)
+
+    try:
+        options, choices = parse(kconfig)
+        resolve(options, choices, assignments)
+    except KconfigError as error:
+        print(f"kconfig: {error}", file=sys.stderr)
+        return 1
+
+    os.makedirs(out_dir, exist_ok=True)
+    write_if_changed(os.path.join(out_dir, "config.h"), config_h(options))
+    write_if_changed(os.path.join(out_dir, "config.ld"), config_ld(options))
+    write_if_changed(os.path.join(out_dir, ".config"), dot_config(options))
+    if show:
+        sys.stdout.write(dot_config(options))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""Pack a directory into a ustar archive for the kernel initrd.
+
+Every regular file's contents start on a page boundary inside the archive.
+Multiboot loads modules page aligned, so the kernel can map file pages
+straight out of the module. Alignment comes from pax extended headers
+with a padding comment; any tar reader accepts these.
+
+usage: mkinitrd.py <directory> <output.tar>
+"""
+
+import os
+import sys
+
+BLOCK = 512
+PAGE = 4096
+
+
+def octal(value, width):
+    return ("%0*o" % (width - 1, value)).encode() + b"\0"
+
+
+def header(name, size, typeflag):
+    prefix = b""
+    if len(name) > 100:
+        split = name.rfind(b"/", 0, 156)
+        if split <= 0 or len(name) - split - 1 > 100:
+            raise ValueError("path too long for ustar: %s" % name.decode())
+        prefix, name = name[:split], name[split + 1:]
+
+    fields = [
+        name.ljust(100, b"\0"),
+        octal(0o644, 8),
+        octal(0, 8),
+        octal(0, 8),
+        octal(size, 12),
+        octal(0, 12),
+        b" " * 8,
+        typeflag,
+        b"\0" * 100,
+        b"ustar\0",
+        b"00",
+        b"\0" * 32,
+        b"\0" * 32,
+        octal(0, 8),
+        octal(0, 8),
+        prefix.ljust(155, b"\0"),
+        b"\0" * 12,
+    ]
+    block = bytearray(b"".join(fields))
+    block[148:156] = ("%06o\0 " % sum(block)).encode()
+    return bytes(block)
+
+
+def pad(data):
+    return data + b"\0" * (-len(data) % BLOCK)
+
+
+def pax_padding(length):
+    """A pax record "<len> comment=xxx\\n" of exactly `length` bytes."""
+    body = length - len(" comment=\n")
+    while True:
+        record = "%d comment=%s\n" % (length, "x" * body)
+        if len(record) == length:
+            return record.encode()
+        body -= len(record) - length
+
+
+def pack(root, out):
+    archive = bytearray()
+    for directory, dirs, files in os.walk(root):
+        dirs.sort()
+        for filename in sorted(files):
+            path = os.path.join(directory, filename)
+            name = os.path.relpath(path, root).replace(os.sep, "/").encode()
+            with open(path, "rb") as f:
+                data = f.read()
+
+            # Data follows the file header; put a pax header in front when it would start mid-page
+            if (len(archive) + BLOCK) % PAGE:
+                gap = -(len(archive) + 2 * BLOCK) % PAGE
+                record = pax_padding(gap) if gap else b""
+                archive += header(b"PaxHeader/" + name[-90:], len(record), b"x")
+                archive += pad(record)
+
+            archive += header(name, len(data), b"0")
+            archive += pad(data)
+
+    archive += b"\0" * (2 * BLOCK)
+    out.write(archive)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write(__doc__)
+        return 1
+    with open(sys.argv[2], "wb") as out:
+        pack(sys.argv[1], out)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Symbolize a kernel profile dump captured from the serial port.
+
+Capture the serial port to a file (qemu -serial file:serial.log), send 'p'
+to start sampling and 'f' to stop and dump. The last dump in the log is
+read and symbolized with nm against the kernel image, which must be the
+build that produced it. Prints a flat profile; with a third argument also
+writes folded stacks for flamegraph.pl or speedscope.
+
+Set NM to use a cross nm, e.g. NM=i686-elf-nm.
+
+usage: profile.py <serial.log> [build/bin/Os.bin] [out.folded]
+"""
+
+import bisect
+import os
+import struct
+import subprocess
+import sys
+from collections import Counter
+
+BEGIN = b"\n@@PROFILE\n"
+END = b"\n@@END\n"
+MAGIC = b"OSPROF01"
+
+HEADER = struct.Struct("<8sIII")
+CPU_HEADER = struct.Struct("<III")
+SAMPLE_HEADER = struct.Struct("<II")
+
+TOP = 40
+
+
+def read_dump(data):
+    start = data.rfind(BEGIN)
+    if start < 0:
+        raise ValueError("no profile dump found")
+    offset = start + len(BEGIN)
+
+    magic, sample_size, hz, cpus = HEADER.unpack_from(data, offset)
+    if magic != MAGIC:
+        raise ValueError("unsupported dump format")
+    offset += HEADER.size
+    max_depth = (sample_size - SAMPLE_HEADER.size) // 4
+
+    samples = []
+    dropped = 0
+    for _ in range(cpus):
+        cpu, count, cpu_dropped = CPU_HEADER.unpack_from(data, offset)
+        offset += CPU_HEADER.size
+        dropped += cpu_dropped
+        for _ in range(count):
+            thread, depth = SAMPLE_HEADER.unpack_from(data, offset)
+            pcs = struct.unpack_from("<%dI" % max_depth, data, offset + SAMPLE_HEADER.size)
+            samples.append((cpu, thread, pcs[:min(depth, max_depth)]))
+            offset += sample_size
+
+    if data[offset:offset + len(END)] != END:
+        raise ValueError("profile dump is truncated")
+    return hz, samples, dropped
+
+
+def load_symbols(image):
+    nm = os.environ.get("NM", "nm")
+    output = subprocess.run([nm, "-n", "--defined-only", image], check=True, capture_output=True, text=True).stdout
+
+    addresses = []
+    names = []
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[1] in "TtWw":
+            addresses.append(int(fields[0], 16))
+            names.append(fields[2])
+    return addresses, names
+
+
+def symbolize(addresses, names, pc):
+    index = bisect.bisect_right(addresses, pc) - 1
+    return names[index] if index >= 0 else "0x%x" % pc
+
+
+def main():
+    if len(sys.argv) not in (2, 3, 4):
+        sys.exit(__doc__)
+
+    with open(sys.argv[1], "rb") as f:
+        hz, samples, dropped = read_dump(f.read())
+    addresses, names = load_symbols(sys.argv[2] if len(sys.argv) > 2 else "build/bin/Os.bin")
+
+    flat = Counter()
+    inclusive = Counter()
+    folded = Counter()
+    for _, _, pcs in samples:
+        # Return addresses point after the call; look up the call itself
+        frames = [symbolize(addresses, names, pc if i == 0 else pc - 1) for i, pc in enumerate(pcs)]
+        if not frames:
+            continue
+        flat[frames[0]] += 1
+        for frame in set(frames):
+            inclusive[frame] += 1
+        folded[";".join(reversed(frames))] += 1
+
+    total = len(samples)
+    rate = "%d Hz" % hz if hz else "counter overflows"
+    print("%d samples from %s, %d dropped" % (total, rate, dropped))
+    if total == 0:
+        return
+
+    print("%8s %7s %8s %7s  %s" % ("self", "self%", "total", "total%", "function"))
+    for name, count in flat.most_common(TOP):
+        print("%8d %6.2f%% %8d %6.2f%%  %s" % (count, 100.0 * count / total, inclusive[name],
+                                              100.0 * inclusive[name] / total, name))
+
+    if len(sys.argv) == 4:
+        with open(sys.argv[3], "w") as f:
+            for stack, count in sorted(folded.items()):
+                f.write("%s %d\n" % (stack, count))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""Convert a kernel trace dump captured from the serial port to Chrome trace JSON.
+
+Capture the serial port to a file (qemu -serial file:serial.log), send 'e'
+to enable tracing and 't' to dump, then load the output in chrome://tracing
+or https://ui.perfetto.dev. The last dump in the log is converted.
+
+The record layout and event numbers match includes/kernel/trace/trace.h.
+
+usage: trace2json.py <serial.log> [output.json]
+"""
+
+import json
+import struct
+import sys
+
+BEGIN = b"\n@@TRACE\n"
+END = b"\n@@END\n"
+MAGIC = b"OSTRACE1"
+
+HEADER = struct.Struct("<8sIII")
+CPU_HEADER = struct.Struct("<II")
+RECORD = struct.Struct("<QHBBI4I")
+
+PAGE_ALLOC, PAGE_FREE, KMALLOC, KFREE, MAP_PAGE, UNMAP_PAGE, IRQ_ENTRY, IRQ_EXIT, SWITCH, PMU = range(10)
+
+# Indexed by the PMU_EVENT_* numbers in includes/kernel/cpu/pmu.h
+PMU_EVENTS = ["cycles", "instructions", "llc_references", "llc_misses", "branches", "branch_misses",
+              "dtlb_load_misses"]
+
+INSTANT_EVENTS = {
+    PAGE_ALLOC: ("page_alloc", ("frame", "pages")),
+    PAGE_FREE: ("page_free", ("frame", "pages")),
+    KMALLOC: ("kmalloc", ("ptr", "size", "caller")),
+    KFREE: ("kfree", ("ptr",)),
+    MAP_PAGE: ("map", ("virt", "pages", "frame", "flags")),
+    UNMAP_PAGE: ("unmap", ("virt", "pages")),
+}
+
+
+def read_dump(data):
+    start = data.rfind(BEGIN)
+    if start < 0:
+        raise ValueError("no trace dump found")
+    offset = start + len(BEGIN)
+
+    magic, record_size, tsc_khz, cpus = HEADER.unpack_from(data, offset)
+    if magic != MAGIC or record_size != RECORD.size:
+        raise ValueError("unsupported dump format")
+    offset += HEADER.size
+
+    records = {}
+    for _ in range(cpus):
+        cpu, count = CPU_HEADER.unpack_from(data, offset)
+        offset += CPU_HEADER.size
+        records[cpu] = [RECORD.unpack_from(data, offset + i * RECORD.size) for i in range(count)]
+        offset += count * RECORD.size
+
+    if data[offset:offset + len(END)] != END:
+        raise ValueError("trace dump is truncated")
+    return tsc_khz, records
+
+
+def to_chrome(tsc_khz, records):
+    first = min((r[0][0] for r in records.values() if r), default=0)
+    # Without a calibrated TSC, show cycles as microseconds
+    scale = 1000.0 / tsc_khz if tsc_khz else 1.0
+
+    def ts(tsc):
+        return (tsc - first) * scale
+
+    events = []
+    names = {}
+    for cpu, cpu_records in sorted(records.items()):
+        events.append({"ph": "M", "name": "process_name", "pid": cpu, "args": {"name": "CPU %d" % cpu}})
+        running = None
+        for tsc, event, _, _, thread, a0, a1, a2, a3 in cpu_records:
+            args = (a0, a1, a2, a3)
+            base = {"pid": cpu, "tid": thread, "ts": ts(tsc)}
+
+            if event == SWITCH:
+                name = struct.pack("<II", a2, a3).split(b"\0")[0].decode("ascii", "replace")
+                names[(cpu, a1)] = name
+                if running is not None:
+                    start, tid = running
+                    events.append({"ph": "X", "name": "run", "pid": cpu, "tid": tid,
+                                   "ts": ts(start), "dur": ts(tsc) - ts(start)})
+                running = (tsc, a1)
+            elif event == IRQ_ENTRY:
+                events.append(dict(base, ph="B", name="irq %d" % a0, args={"eip": hex(a1)}))
+            elif event == IRQ_EXIT:
+                events.append(dict(base, ph="E", name="irq %d" % a0))
+            elif event == PMU:
+                counts = {}
+                for i, value in enumerate(args[1:min(a0 & 0xFF, 3) + 1]):
+                    number = (a0 >> (8 * (i + 1))) & 0xFF
+                    counts[PMU_EVENTS[number] if number < len(PMU_EVENTS) else "event %d" % number] = value
+                events.append(dict(base, ph="C", name="pmu", args=counts))
+            elif event in INSTANT_EVENTS:
+                name, fields = INSTANT_EVENTS[event]
+                values = {field: hex(value) for field, value in zip(fields, args)}
+                events.append(dict(base, ph="i", s="t", name=name, args=values))
+            else:
+                events.append(dict(base, ph="i", s="t", name="event %d" % event))
+
+    for (cpu, tid), name in names.items():
+        events.append({"ph": "M", "name": "thread_name", "pid": cpu, "tid": tid, "args": {"name": name}})
+
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit(__doc__)
+
+    with open(sys.argv[1], "rb") as f:
+        tsc_khz, records = read_dump(f.read())
+
+    trace = to_chrome(tsc_khz, records)
+    if len(sys.argv) == 3:
+        with open(sys.argv[2], "w") as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+        sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
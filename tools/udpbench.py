@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""UDP round trips between the host and the kernel under QEMU user networking.
+
+By default, sends datagrams to the kernel's echo service through the port
+make run forwards to it (NET_HOST_PORT, 5555) and reports the rate and
+latency percentiles, as the kernel's netbench command does from its side.
+With --serve, echoes datagrams back instead, for "netbench host" in the
+kernel, which reaches the host as 10.0.2.2:7777.
+
+usage: udpbench.py [--host <addr>] [--port <n>] [--count <n>] [--window <n>] [--size <n>]
+       udpbench.py --serve [--port <n>]
+"""
+
+import argparse
+import select
+import socket
+import struct
+import sys
+import time
+
+MAGIC = 0x4E424E43
+PAYLOAD = struct.Struct("<IIQ")
+
+# Seconds without a reply before the rest are counted as lost, as in the kernel
+IDLE_TIMEOUT = 0.5
+
+
+def serve(port):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("0.0.0.0", port))
+    print(f"udpbench: echoing on port {port}", file=sys.stderr)
+    while True:
+        data, addr = sock.recvfrom(65536)
+        sock.sendto(data, addr)
+
+
+def percentile(samples, p):
+    return samples[(len(samples) - 1) * p // 100]
+
+
+def run(host, port, count, window, size):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.connect((host, port))
+    sock.setblocking(False)
+
+    padding = bytes(max(size - PAYLOAD.size, 0))
+    sent_at = {}
+    rtts = []
+    sent = 0
+    start = last_reply = time.perf_counter()
+
+    while len(rtts) < count:
+        while sent < count and sent - len(rtts) < window:
+            sent_at[sent] = time.perf_counter_ns()
+            try:
+                sock.send(PAYLOAD.pack(MAGIC, sent, 0) + padding)
+            except ConnectionRefusedError:
+                pass            # An earlier datagram was refused; this one counts as lost
+            sent += 1
+
+        if not select.select([sock], [], [], IDLE_TIMEOUT)[0]:
+            if time.perf_counter() - last_reply > IDLE_TIMEOUT:
+                break
+            continue
+        while True:
+            try:
+                data = sock.recv(65536)
+            except (BlockingIOError, ConnectionRefusedError):
+                break
+            now = time.perf_counter_ns()
+            if len(data) < PAYLOAD.size:
+                continue
+            magic, seq, _ = PAYLOAD.unpack_from(data)
+            if magic == MAGIC and seq in sent_at:
+                rtts.append(now - sent_at.pop(seq))
+                last_reply = time.perf_counter()
+
+    elapsed = last_reply - start
+    print(f"udpbench: {len(rtts)} of {sent} replies, {int(len(rtts) / elapsed) if elapsed > 0 else 0} pps")
+    if rtts:
+        rtts.sort()
+        print(f"udpbench: round trip p50 {percentile(rtts, 50)} ns, p90 {percentile(rtts, 90)} ns, "
+              f"p99 {percentile(rtts, 99)} ns, max {rtts[-1]} ns")
+    return 0 if rtts else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(usage=__doc__.strip().split("usage: ")[1])
+    parser.add_argument("--serve", action="store_true")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int)
+    parser.add_argument("--count", type=int, default=1000)
+    parser.add_argument("--window", type=int, default=8)
+    parser.add_argument("--size", type=int, default=64)
+    args = parser.parse_args()
+
+    if args.serve:
+        serve(args.port or 7777)
+        return 0
+    return run(args.host, args.port or 5555, args.count, max(args.window, 1), args.size)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
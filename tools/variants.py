@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Compare kernel build variants by image size and benchmark results.
+
+Each argument is a build directory, as left by make VARIANT=<name> bench:
+bin/Os.bin is measured, and benchmark lines of the form
+"<name>: <label> <n> cycles" are read from serial.log if the variant was
+booted. The first directory that exists is the baseline; the others are
+reported as deltas from it. Directories not built yet are skipped.
+
+usage: variants.py <build dir> [<build dir>...]
+"""
+
+import os
+import re
+import struct
+import sys
+
+IMAGE = os.path.join("bin", "Os.bin")
+LOG = "serial.log"
+
+BENCH = re.compile(r"^(\w+: .+?) (\d+) cycles\s*$")
+
+SHF_ALLOC = 0x2
+SHF_WRITE = 0x1
+SHF_EXECINSTR = 0x4
+SHT_NOBITS = 8
+
+
+def image_sizes(path):
+    """Returns (text, data, bss) of a 32-bit ELF image, as size(1) counts them."""
+    with open(path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF" or elf[4] != 1:
+        raise ValueError(f"{path} is not a 32-bit ELF file")
+
+    shoff, = struct.unpack_from("<I", elf, 0x20)
+    shentsize, shnum = struct.unpack_from("<HH", elf, 0x2E)
+    text = data = bss = 0
+    for i in range(shnum):
+        _, sh_type, flags, _, _, size = struct.unpack_from("<IIIIII", elf, shoff + i * shentsize)
+        if not flags & SHF_ALLOC:
+            continue
+        if sh_type == SHT_NOBITS:
+            bss += size
+        elif flags & SHF_WRITE:
+            data += size
+        else:
+            text += size
+    return text, data, bss
+
+
+def benchmarks(path):
+    results = {}
+    if not os.path.exists(path):
+        return results
+    with open(path, "rb") as f:
+        for line in f.read().decode(errors="replace").splitlines():
+            match = BENCH.match(line.strip("\r"))
+            if match:
+                results[match.group(1)] = int(match.group(2))
+    return results
+
+
+def delta(value, base):
+    if base == 0:
+        return ""
+    return f" ({(value - base) * 100.0 / base:+.1f}%)"
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        return 1
+
+    variants = []
+    for build in sys.argv[1:]:
+        image = os.path.join(build, IMAGE)
+        if os.path.exists(image):
+            variants.append((build, image_sizes(image), benchmarks(os.path.join(build, LOG))))
+    if not variants:
+        print("variants: nothing built yet", file=sys.stderr)
+        return 1
+
+    base_name, base_sizes, base_bench = variants[0]
+    print(f"{'build':<20} {'text':>10} {'data':>8} {'bss':>10} {'total':>10}")
+    for name, sizes, _ in variants:
+        total = sum(sizes)
+        base_total = sum(base_sizes)
+        print(f"{name:<20} {sizes[0]:>10} {sizes[1]:>8} {sizes[2]:>10} {total:>10}{delta(total, base_total) if name != base_name else ''}")
+
+    labels = sorted(set().union(*(bench for _, _, bench in variants)))
+    if not labels:
+        print("\nno benchmark results; run make VARIANT=<name> bench first")
+        return 0
+
+    print(f"\ncycles, relative to {base_name}")
+    for label in labels:
+        print(label)
+        for name, _, bench in variants:
+            if label not in bench:
+                continue
+            base = base_bench.get(label, 0)
+            print(f"    {name:<20} {bench[label]:>10}{delta(bench[label], base) if name != base_name else ''}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,11 @@
+#include "os.h"
+
+// Writes to the read-only vDSO data page; the kernel must kill the program
+// instead of halting.
+
+int main()
+{
+    *(volatile uint32_t*)VDSO_DATA_ADDR = 0;
+    print("fault: wrote to a read-only page\n");
+    return 0;
+}
@@ -0,0 +1,194 @@
+#include "os.h"
+
+// Measures message passing between two programs: a ping-pong of messages
+// that fit in registers, and payloads of whole pages moved by remapping,
+// next to what copying the same bytes costs. The program spawns a copy of
+// itself as the echo side and checks every reply.
+
+#define IPCBENCH_WARMUP 100
+#define IPCBENCH_ROUNDS 5000
+#define IPCBENCH_PAGES 16
+#define IPCBENCH_BULK_ROUNDS 200
+#define IPCBENCH_QUIT 0xFFFFFFFF
+
+static uint8_t ipcbench_buffer[IPCBENCH_PAGES * PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+static uint8_t ipcbench_copy[IPCBENCH_PAGES * PAGE_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+static int ipcbench_request;
+static int ipcbench_reply;
+
+static uint32_t* ipcbench_page(uint32_t index)
+{
+    return (uint32_t*)(ipcbench_buffer + index * PAGE_SIZE);
+}
+
+/**
+ * @brief The child: returns every message with the first word incremented,
+ *        and the first word of every page incremented too.
+ */
+static int ipcbench_echo(uint32_t ports)
+{
+    int request = (int)(ports >> 16);
+    int reply = (int)(ports & 0xFFFF);
+    message_t msg;
+
+    for (;;)
+    {
+        int count = recv(request, ipcbench_buffer, IPCBENCH_PAGES, &msg);
+        if (count < 0)
+        {
+            return 1;
+        }
+        if (msg.words[0] == IPCBENCH_QUIT)
+        {
+            return 0;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            ipcbench_page(i)[0]++;
+        }
+        if (send(reply, msg.words[0] + 1, msg.words[1], ipcbench_buffer, count) != 0)
+        {
+            return 1;
+        }
+    }
+}
+
+/**
+ * @brief Returns the average TSC cycles of a round trip without pages, 0 on a wrong reply.
+ */
+static uint32_t ipcbench_ping()
+{
+    message_t msg;
+
+    for (uint32_t i = 0; i < IPCBENCH_WARMUP; i++)
+    {
+        send(ipcbench_request, i, 0, NULL, 0);
+        recv(ipcbench_reply, NULL, 0, &msg);
+    }
+
+    uint64_t start = rdtsc();
+    for (uint32_t i = 0; i < IPCBENCH_ROUNDS; i++)
+    {
+        if (send(ipcbench_request, i, 0, NULL, 0) != 0 ||
+            recv(ipcbench_reply, NULL, 0, &msg) != 0 || msg.words[0] != i + 1)
+        {
+            return 0;
+        }
+    }
+    return (uint32_t)div64_u32(rdtsc() - start, IPCBENCH_ROUNDS);
+}
+
+/**
+ * @brief Returns the average TSC cycles per page moved, 0 if a page came back wrong.
+ *
+ * Only the send and receive are timed; each round moves the pages there
+ * and back. Writing the payload faults in fresh pages, since the ones sent
+ * the round before went to the child.
+ */
+static uint32_t ipcbench_bulk()
+{
+    message_t msg;
+    uint64_t cycles = 0;
+
+    for (uint32_t round = 0; round < IPCBENCH_BULK_ROUNDS; round++)
+    {
+        for (uint32_t i = 0; i < IPCBENCH_PAGES; i++)
+        {
+            ipcbench_page(i)[0] = round + i;
+        }
+
+        uint64_t start = rdtsc();
+        if (send(ipcbench_request, round, 0, ipcbench_buffer, IPCBENCH_PAGES) != 0 ||
+            recv(ipcbench_reply, ipcbench_buffer, IPCBENCH_PAGES, &msg) != IPCBENCH_PAGES)
+        {
+            return 0;
+        }
+        cycles += rdtsc() - start;
+
+        if (msg.words[0] != round + 1)
+        {
+            return 0;
+        }
+        for (uint32_t i = 0; i < IPCBENCH_PAGES; i++)
+        {
+            if (ipcbench_page(i)[0] != round + i + 1)
+            {
+                return 0;
+            }
+        }
+    }
+    return (uint32_t)div64_u32(cycles, IPCBENCH_BULK_ROUNDS * IPCBENCH_PAGES * 2);
+}
+
+/**
+ * @brief Returns the average TSC cycles of copying one page, for comparison.
+ */
+static uint32_t ipcbench_copy_page()
+{
+    uint64_t start = rdtsc();
+    for (uint32_t round = 0; round < IPCBENCH_BULK_ROUNDS; round++)
+    {
+        void* dest = ipcbench_copy;
+        const void* src = ipcbench_buffer;
+        uint32_t words = sizeof(ipcbench_buffer) / 4;
+        asm volatile("rep movsl" : "+D"(dest), "+S"(src), "+c"(words) : : "memory");
+    }
+    return (uint32_t)div64_u32(rdtsc() - start, IPCBENCH_BULK_ROUNDS * IPCBENCH_PAGES);
+}
+
+static void ipcbench_report(const char* label, uint32_t cycles)
+{
+    print("ipcbench: ");
+    print(label);
+    print(" ");
+    print_uint(cycles);
+    print(" cycles\n");
+}
+
+int main(uint32_t arg)
+{
+    if (arg != 0)
+    {
+        return ipcbench_echo(arg);
+    }
+
+    ipcbench_request = port();
+    ipcbench_reply = port();
+    if (ipcbench_request < 0 || ipcbench_reply < 0 || ipcbench_request > 0xFFFF || ipcbench_reply > 0xFFFF)
+    {
+        print("ipcbench: could not open ports\n");
+        return 1;
+    }
+
+    int child = spawn("/bin/ipcbench", (uint32_t)ipcbench_request << 16 | (uint32_t)ipcbench_reply);
+    if (child < 0)
+    {
+        print("ipcbench: could not start the echo side\n");
+        return 1;
+    }
+
+    int status = 0;
+    uint32_t ping = ipcbench_ping();
+    uint32_t bulk = ping != 0 ? ipcbench_bulk() : 0;
+    if (ping == 0 || bulk == 0)
+    {
+        print("ipcbench: a reply came back wrong\n");
+        status = 1;
+    }
+    else
+    {
+        ipcbench_report("round trip", ping);
+        ipcbench_report("page moved", bulk);
+        ipcbench_report("page copied", ipcbench_copy_page());
+    }
+
+    send(ipcbench_request, IPCBENCH_QUIT, 0, NULL, 0);
+    if (wait(child) != 0)
+    {
+        print("ipcbench: the echo side failed\n");
+        status = 1;
+    }
+    return status;
+}
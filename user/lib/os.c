@@ -0,0 +1,120 @@
+#include "os.h"
+
+void exit(int code)
+{
+    syscall(SYS_EXIT, (uint32_t)code, 0, 0);
+    for (;;)
+    {
+    }
+}
+
+int write(const void* buf, size_t len)
+{
+    return syscall(SYS_WRITE, (uint32_t)buf, len, 0);
+}
+
+void yield()
+{
+    syscall(SYS_YIELD, 0, 0, 0);
+}
+
+void sleep_ms(uint32_t ms)
+{
+    syscall(SYS_SLEEP, ms, 0, 0);
+}
+
+size_t strlen(const char* str)
+{
+    size_t len = 0;
+    while (str[len] != '\0')
+    {
+        len++;
+    }
+    return len;
+}
+
+void print(const char* str)
+{
+    write(str, strlen(str));
+}
+
+void print_uint(uint32_t value)
+{
+    char digits[10];
+    size_t count = 0;
+    do
+    {
+        digits[sizeof(digits) - 1 - count++] = '0' + value % 10;
+        value /= 10;
+    } while (value != 0);
+
+    write(digits + sizeof(digits) - count, count);
+}
+
+/**
+ * @brief Returns the kernel's jiffies, read from the vDSO clock page
+ *        without entering the kernel. 0 if there is no clock.
+ */
+uint64_t clock_jiffies()
+{
+    const volatile vdso_data_t* vdso = VDSO_DATA;
+    uint32_t tsc_per_jiffy = vdso->tsc_per_jiffy;
+    if (tsc_per_jiffy == 0)
+    {
+        return 0;
+    }
+    return div64_u32(rdtsc() - vdso->tsc_base, tsc_per_jiffy);
+}
+
+/**
+ * @brief Returns the milliseconds since the kernel started its clock.
+ */
+uint32_t clock_ms()
+{
+    return (uint32_t)div64_u32(clock_jiffies() * 1000, VDSO_DATA->hz);
+}
+
+int spawn(const char* path, uint32_t arg)
+{
+    return syscall(SYS_SPAWN, (uint32_t)path, arg, 0);
+}
+
+int wait(int pid)
+{
+    return syscall(SYS_WAIT, (uint32_t)pid, 0, 0);
+}
+
+int port()
+{
+    return syscall(SYS_PORT, 0, 0, 0);
+}
+
+/**
+ * @brief Sends two words, and moves `count` pages starting at `pages` to the receiver.
+ *
+ * Returns once the message is received. The pages read as zeroes afterwards.
+ */
+int send(int port, uint32_t word0, uint32_t word1, const void* pages, uint32_t count)
+{
+    return syscall5(SYS_SEND, (uint32_t)port, word0, word1, (uint32_t)pages, count);
+}
+
+/**
+ * @brief Waits for a message, mapping up to `max` pages of it at `window`.
+ *
+ * @return The number of pages received, or -1.
+ */
+int recv(int port, void* window, uint32_t max, message_t* msg)
+{
+    int32_t result;
+    uint32_t word0, word1, sender;
+    asm volatile("call *%[entry]"
+                 : "=a"(result), "=b"(word0), "=S"(word1), "=D"(sender)
+                 : [entry] "m"(VDSO_DATA->syscall_entry), "0"(SYS_RECV), "1"(port), "c"(window), "d"(max)
+                 : "memory", "cc");
+
+    msg->words[0] = word0;
+    msg->words[1] = word1;
+    msg->sender = sender;
+    return result;
+}
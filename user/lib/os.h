@@ -0,0 +1,77 @@
+#ifndef OS_H
+#define OS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <uapi/syscall.h>
+#include <uapi/vdso.h>
+#include <uapi/ipc.h>
+#include <kernel/lib/div64.h>
+
+/**
+ * @brief Makes a system call through a vDSO entry stub.
+ *
+ * @param entry vdso_data_t.syscall_entry, or int80_entry to force the fallback.
+ */
+static inline int32_t syscall_via(uint32_t entry, uint32_t nr, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+    int32_t result;
+    asm volatile("call *%[entry]"
+                 : "=a"(result)
+                 : [entry] "r"(entry), "0"(nr), "b"(arg1), "c"(arg2), "d"(arg3)
+                 : "memory", "cc");
+    return result;
+}
+
+static inline int32_t syscall(uint32_t nr, uint32_t arg1, uint32_t arg2, uint32_t arg3)
+{
+    return syscall_via(VDSO_DATA->syscall_entry, nr, arg1, arg2, arg3);
+}
+
+/**
+ * @brief Makes a system call with five arguments, every register but ebp in use.
+ *
+ * The entry is read straight from the vDSO page, so it needs no register.
+ */
+static inline int32_t syscall5(uint32_t nr, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4, uint32_t arg5)
+{
+    int32_t result;
+    asm volatile("call *%[entry]"
+                 : "=a"(result)
+                 : [entry] "m"(VDSO_DATA->syscall_entry), "0"(nr), "b"(arg1), "c"(arg2), "d"(arg3), "S"(arg4), "D"(arg5)
+                 : "memory", "cc");
+    return result;
+}
+
+static inline uint64_t rdtsc()
+{
+    uint32_t low, high;
+    asm volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+#define PAGE_SIZE 4096
+
+// A message taken by recv(), see uapi/ipc.h
+typedef struct message
+{
+    uint32_t words[IPC_WORDS];
+    uint32_t sender;
+} message_t;
+
+void exit(int code) __attribute__((noreturn));
+int write(const void* buf, size_t len);
+void yield();
+void sleep_ms(uint32_t ms);
+size_t strlen(const char* str);
+void print(const char* str);
+void print_uint(uint32_t value);
+uint64_t clock_jiffies();
+uint32_t clock_ms();
+int spawn(const char* path, uint32_t arg);
+int wait(int pid);
+int port();
+int send(int port, uint32_t word0, uint32_t word1, const void* pages, uint32_t count);
+int recv(int port, void* window, uint32_t max, message_t* msg);
+
+#endif //OS_H
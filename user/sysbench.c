@@ -0,0 +1,93 @@
+#include "os.h"
+
+// Measures what a null system call costs through each entry path, and
+// checks the vDSO clock against the kernel's sleep.
+
+#define SYSBENCH_WARMUP 100
+#define SYSBENCH_ROUNDS 10000
+#define SYSBENCH_SLEEP_MS 10
+
+/**
+ * @brief Returns the average TSC cycles of a SYS_NULL round trip through `entry`.
+ */
+static uint32_t sysbench_syscall(uint32_t entry)
+{
+    for (int i = 0; i < SYSBENCH_WARMUP; i++)
+    {
+        syscall_via(entry, SYS_NULL, 0, 0, 0);
+    }
+
+    uint64_t start = rdtsc();
+    for (int i = 0; i < SYSBENCH_ROUNDS; i++)
+    {
+        syscall_via(entry, SYS_NULL, 0, 0, 0);
+    }
+    return (uint32_t)div64_u32(rdtsc() - start, SYSBENCH_ROUNDS);
+}
+
+/**
+ * @brief Returns the average TSC cycles of reading the clock from the vDSO.
+ */
+static uint32_t sysbench_clock()
+{
+    uint64_t sum = 0;
+    uint64_t start = rdtsc();
+    for (int i = 0; i < SYSBENCH_ROUNDS; i++)
+    {
+        sum += clock_jiffies();
+    }
+    uint64_t cycles = rdtsc() - start;
+
+    // Keeps the reads from being optimized away
+    if (sum == 1)
+    {
+        print("");
+    }
+    return (uint32_t)div64_u32(cycles, SYSBENCH_ROUNDS);
+}
+
+static void sysbench_report(const char* label, uint32_t cycles)
+{
+    print("sysbench: ");
+    print(label);
+    print(" ");
+    print_uint(cycles);
+    print(" cycles\n");
+}
+
+int main()
+{
+    const volatile vdso_data_t* vdso = VDSO_DATA;
+    if (vdso->version != VDSO_VERSION)
+    {
+        print("sysbench: unknown vDSO version\n");
+        return 1;
+    }
+
+    if (vdso->syscall_entry != vdso->int80_entry)
+    {
+        sysbench_report("sysenter round trip", sysbench_syscall(vdso->syscall_entry));
+    }
+    else
+    {
+        print("sysbench: no sysenter on this CPU\n");
+    }
+    sysbench_report("int 0x80 round trip", sysbench_syscall(vdso->int80_entry));
+
+    if (vdso->tsc_per_jiffy == 0)
+    {
+        print("sysbench: no clock\n");
+        return 0;
+    }
+    sysbench_report("vDSO clock read", sysbench_clock());
+
+    uint64_t before = clock_jiffies();
+    sleep_ms(SYSBENCH_SLEEP_MS);
+    uint32_t slept = (uint32_t)(clock_jiffies() - before);
+    if (slept * 1000 < SYSBENCH_SLEEP_MS * vdso->hz)
+    {
+        print("sysbench: the vDSO clock is behind the kernel's sleep\n");
+        return 2;
+    }
+    return 0;
+}